@@ -1,3 +1,4 @@
+import os
 import re
 from operator import mul
 from functools import reduce
@@ -21,7 +22,9 @@ class Metadata:
 def loadMetadata(fname):
     "Load metadata from first line of file."
 
-    paramStr = open(fname, "r").readline()
+    # read as bytes such that binary files are supported as well
+    with open(fname, "rb") as infile:
+        paramStr = infile.readline().decode()
 
     match = re.match(r"# J=([^ ]+) h=([^ ]+) shape=\[(\d+(, \d+)*)\]", paramStr)
     if not match or len(match.groups()) < 4:
@@ -47,3 +50,152 @@ def loadCorrFile(fname):
     corrs = np.loadtxt(fname, skiprows=2, delimiter=",")
     return meta, distances, corrs
 
+def loadModesFile(fname):
+    "Load meta data, momenta, and Fourier modes |m(k)|^2, one row per dimension, from file."
+    meta = loadMetadata(fname)
+
+    with open(fname, "r") as infile:
+        infile.readline()  # skip metadata
+        momenta = [float(k) for k in re.match(r"# momenta=\[([^\]]+)\]",
+                                              infile.readline())[1].split(",")]
+    modes = np.loadtxt(fname, skiprows=2, delimiter=",", ndmin=2)
+    return meta, momenta, modes
+
+def loadHistogramFile(fname):
+    """
+    Load meta data and joint histogram from file.
+    Returns the metadata, the parameters (J, h) and an array with columns coupling sum,
+    spin sum, and count.
+    """
+    meta = loadMetadata(fname)
+
+    with open(fname, "r") as infile:
+        infile.readline()  # skip metadata
+        match = re.match(r"# format=histogram version=1 J=(\S+) h=(\S+)", infile.readline())
+    if match is None:
+        raise RuntimeError(f"File {fname} is not a histogram file")
+    histogram = np.loadtxt(fname, skiprows=3, delimiter=",", dtype=np.int64, ndmin=2)
+    return meta, (float(match[1]), float(match[2])), histogram
+
+def secondMomentCorrelationLength(m2, mk2, k):
+    """
+    Compute the second moment correlation length from the mean of m^2 and
+    the mean of |m(k)|^2 at the smallest nonzero momentum k.
+    """
+    return np.sqrt(m2/mk2 - 1) / (2*np.sin(k/2))
+
+
+BINARY_FORMAT_LINE = b"# format=binary version=1\n"
+CHUNK_HEADER_SIZE = 32
+
+def loadChunks(fname):
+    """
+    Load meta data and all chunks from a binary file.
+    Returns the metadata and a dict mapping chunk names to lists of arrays,
+    one per chunk with that name in order of appearance in the file.
+    Spins ('bits' chunks) are returned as flat arrays of +1, -1 in row-major order.
+    """
+
+    meta = loadMetadata(fname)
+    chunks = {}
+    with open(fname, "rb") as infile:
+        infile.readline()  # skip metadata
+        if infile.readline() != BINARY_FORMAT_LINE:
+            raise RuntimeError(f"File {fname} is not in the binary format")
+
+        while header := infile.read(CHUNK_HEADER_SIZE):
+            if len(header) != CHUNK_HEADER_SIZE:
+                raise RuntimeError(f"Truncated chunk header in file {fname}")
+            name = header[:16].rstrip(b"\0").decode()
+            dtype = header[16:20].rstrip(b"\0").decode()
+            count = int.from_bytes(header[24:32], "little")
+
+            if dtype == "bits":
+                raw = np.frombuffer(infile.read((count+7)//8), dtype=np.uint8)
+                data = np.unpackbits(raw, bitorder="little")[:count].astype(np.int8)*2 - 1
+            else:
+                dt = np.dtype("<"+dtype)
+                data = np.frombuffer(infile.read(count*dt.itemsize), dtype=dt)
+            if len(data) != count:
+                raise RuntimeError(f"Truncated chunk '{name}' in file {fname}")
+            chunks.setdefault(name, []).append(data)
+
+    return meta, chunks
+
+def loadBinaryFile(fname):
+    """
+    Load meta- and 'normal' data from binary file.
+    Returns the same layout as loadFile, i.e. rows of energy and magnetisation
+    for NNNN.dat.bin and one row per configuration for NNNN.cfg.bin.
+    """
+
+    meta, chunks = loadChunks(fname)
+    if "cfg" in chunks:
+        return meta, np.stack(chunks["cfg"])
+    return meta, np.stack([chunks["energy"][0], chunks["magnetisation"][0]])
+
+def loadBinaryCorrFile(fname):
+    "Load meta- and correlator data from binary file, same layout as loadCorrFile."
+
+    meta, chunks = loadChunks(fname)
+    distances = list(chunks["distances"][0])
+    corrs = np.stack(chunks["correlator"]) if "correlator" in chunks else np.empty((0, 0))
+    return meta, distances, corrs
+
+def loadBinaryModesFile(fname):
+    "Load meta data, momenta, and Fourier modes from binary file, same layout as loadModesFile."
+
+    meta, chunks = loadChunks(fname)
+    momenta = list(chunks["momenta"][0])
+    modes = np.stack(chunks["fourier_mode"])
+    return meta, momenta, modes
+
+RECORDS_FORMAT_PREFIX = b"# format=records version=1 record_size="
+
+def openRecordFile(fname):
+    """
+    Memory map all configurations of a record file (NNNN.cfg.rec).
+    Returns the metadata and a read only array of packed records with shape
+    (number of configurations, record size), so only records that are accessed are read.
+    Use unpackRecord to get the spins of a record.
+    """
+
+    meta = loadMetadata(fname)
+    with open(fname, "rb") as infile:
+        infile.readline()  # skip metadata
+        formatLine = infile.readline()
+        if not formatLine.startswith(RECORDS_FORMAT_PREFIX):
+            raise RuntimeError(f"File {fname} is not in the records format")
+        recordSize = int(formatLine[len(RECORDS_FORMAT_PREFIX):])
+        headerSize = infile.tell()
+
+    nrecords = (os.path.getsize(fname) - headerSize) // recordSize
+    if nrecords == 0:
+        return meta, np.empty((0, recordSize), dtype=np.uint8)
+    return meta, np.memmap(fname, dtype=np.uint8, mode="r", offset=headerSize,
+                           shape=(nrecords, recordSize))
+
+def unpackRecord(meta, record):
+    "Unpack a record into a flat array of spins +1, -1 in row-major order."
+    return np.unpackbits(record, bitorder="little")[:meta.latsize()].astype(np.int8)*2 - 1
+
+def loadRecord(fname, n):
+    "Load metadata and configuration n from a record file, negative n counts from the end."
+    meta, records = openRecordFile(fname)
+    return meta, unpackRecord(meta, records[n])
+
+def loadStatsFile(fname):
+    """
+    Load meta- and summary data from a file written in streaming mode.
+    Returns a dict mapping observable names to tuples (mean, error, tau_int, nmeas).
+    """
+
+    meta = loadMetadata(fname)
+    stats = dict()
+    with open(fname, "r") as infile:
+        infile.readline()  # skip metadata
+        infile.readline()  # skip column names
+        for line in infile:
+            name, mean, error, tauInt, nmeas = [field.strip() for field in line.split(",")]
+            stats[name] = (float(mean), float(error), float(tauInt), int(nmeas))
+    return meta, stats
@@ -0,0 +1,290 @@
+/**
+ * Microbenchmarks of the kernels that Monte-Carlo runs spend their time in.
+ *
+ * Every benchmark is run for hypercubic lattices of dimension 1 to 4 with
+ * several extents L, from lattices that fit into L1 cache up to ones that only
+ * fit into main memory. Reported are
+ * - items_per_second: sites (or spin updates) processed per second,
+ * - bytes/site: memory of the configuration and neighbour list per site.
+ *
+ * BM_EvolveLayout compares the site layouts of Lattice on dimensions 2 to 4.
+ *
+ * Usage: ising-bench [google benchmark options], e.g. --benchmark_filter=Evolve
+ */
+
+#include <cmath>
+#include <cstdint>
+
+#include <benchmark/benchmark.h>
+
+#include "localupdate.hpp"
+#include "montecarlo.hpp"
+
+namespace {
+    /// Maximum distance for correlators, as in a typical input file.
+    constexpr double maxDist = 3.0;
+
+    /// Physical parameters close to the critical point in 2D.
+    constexpr Parameters params{0.44, 0.01};
+
+    /// Shape of a hypercubic lattice with given dimension and extent.
+    MultiIndex hypercube(benchmark::State const &state)
+    {
+        return MultiIndex(static_cast<size_t>(state.range(0)),
+                          Index{static_cast<size_t>(state.range(1))});
+    }
+
+    /// Record the number of sites processed in total and the memory per site.
+    void report(benchmark::State &state, Lattice const &lat)
+    {
+        auto const volume = static_cast<int64_t>(size(lat).get());
+        state.SetItemsProcessed(state.iterations() * volume);
+        state.counters["bytes/site"] = static_cast<double>(
+            sizeof(Spin)*size(lat).get() + sizeof(Index)*std::size(lat.neighbourList()))
+            / static_cast<double>(volume);
+    }
+
+    /// Dimensions and extents to run on, up to 2^22 sites.
+    void hypercubes(benchmark::internal::Benchmark *bench)
+    {
+        bench->ArgNames({"ndim", "L"});
+        for (int64_t const ndim : {1, 2, 3, 4}) {
+            for (int64_t const extent : {8, 16, 64, 256, 1024, 4096}) {
+                double const volume = std::pow(static_cast<double>(extent),
+                                               static_cast<double>(ndim));
+                if (volume >= 64 and volume <= static_cast<double>(1 << 22)) {
+                    bench->Args({ndim, extent});
+                }
+            }
+        }
+    }
+
+    void BM_DeltaE(benchmark::State &state)
+    {
+        Lattice const lat{hypercube(state), maxDist};
+        Rng rng{size(lat), 1};
+        Configuration const cfg = randomCfg(size(lat), rng);
+
+        for (auto _ : state) {
+            for (Index site = 0_i; site < size(lat); ++site) {
+                benchmark::DoNotOptimize(deltaE(cfg, site, params, lat));
+            }
+        }
+        report(state, lat);
+    }
+    BENCHMARK(BM_DeltaE)->Apply(hypercubes);
+
+    void BM_BoltzmannTable(benchmark::State &state)
+    {
+        Lattice const lat{hypercube(state), maxDist};
+        Rng rng{size(lat), 1};
+        Configuration const cfg = randomCfg(size(lat), rng);
+        BoltzmannTable const boltzmann{params, lat.ndim()};
+
+        for (auto _ : state) {
+            for (Index site = 0_i; site < size(lat); ++site) {
+                size_t const idx = boltzmann.index(cfg[site], sumOfNeighbours(cfg, site, lat));
+                benchmark::DoNotOptimize(boltzmann.acceptance(idx));
+            }
+        }
+        report(state, lat);
+    }
+    BENCHMARK(BM_BoltzmannTable)->Apply(hypercubes);
+
+    void BM_SumOfNeighbours(benchmark::State &state)
+    {
+        Lattice const lat{hypercube(state), maxDist};
+        Rng rng{size(lat), 1};
+        Configuration const cfg = randomCfg(size(lat), rng);
+
+        for (auto _ : state) {
+            for (Index site = 0_i; site < size(lat); ++site) {
+                benchmark::DoNotOptimize(sumOfNeighbours(cfg, site, lat));
+            }
+        }
+        report(state, lat);
+    }
+    BENCHMARK(BM_SumOfNeighbours)->Apply(hypercubes);
+
+    /// Like BM_SumOfNeighbours but computing neighbours on the fly.
+    void BM_SumOfNeighboursStencil(benchmark::State &state)
+    {
+        Lattice const lat{hypercube(state), maxDist, Lattice::DistanceFn::EUCLIDEAN,
+                          Lattice::NeighbourMode::STENCIL};
+        Rng rng{size(lat), 1};
+        Configuration const cfg = randomCfg(size(lat), rng);
+
+        for (auto _ : state) {
+            for (Index site = 0_i; site < size(lat); ++site) {
+                benchmark::DoNotOptimize(sumOfNeighbours(cfg, site, lat));
+            }
+        }
+        report(state, lat);
+    }
+    BENCHMARK(BM_SumOfNeighboursStencil)->Apply(hypercubes);
+
+    void BM_Hamiltonian(benchmark::State &state)
+    {
+        Lattice const lat{hypercube(state), maxDist};
+        Rng rng{size(lat), 1};
+        Configuration const cfg = randomCfg(size(lat), rng);
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(hamiltonian(cfg, params, lat));
+        }
+        report(state, lat);
+    }
+    BENCHMARK(BM_Hamiltonian)->Apply(hypercubes);
+
+    void BM_Magnetisation(benchmark::State &state)
+    {
+        Lattice const lat{hypercube(state), maxDist};
+        Rng rng{size(lat), 1};
+        Configuration const cfg = randomCfg(size(lat), rng);
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(magnetisation(cfg));
+        }
+        report(state, lat);
+    }
+    BENCHMARK(BM_Magnetisation)->Apply(hypercubes);
+
+    /// Full measurement including the correlator, which dominates the cost.
+    void BM_MeasureCorrelator(benchmark::State &state,
+                              Observables::Correlator::Method const method)
+    {
+        Lattice const lat{hypercube(state), maxDist};
+        Rng rng{size(lat), 1};
+        Configuration const cfg = randomCfg(size(lat), rng);
+        double const energy = hamiltonian(cfg, params, lat);
+        // streaming, so memory does not grow with the number of iterations
+        Observables obs{lat, method, Observables::Mode::STREAMING};
+
+        for (auto _ : state) {
+            measure(obs, lat, cfg, energy);
+        }
+        report(state, lat);
+    }
+    BENCHMARK_CAPTURE(BM_MeasureCorrelator, pairs, Observables::Correlator::Method::PAIR_SUM)
+        ->Apply(hypercubes);
+    BENCHMARK_CAPTURE(BM_MeasureCorrelator, fft, Observables::Correlator::Method::FFT)
+        ->Apply(hypercubes);
+
+    void BM_LatticeConstruction(benchmark::State &state)
+    {
+        MultiIndex const shape = hypercube(state);
+        for (auto _ : state) {
+            Lattice const lat{shape, maxDist};
+            benchmark::DoNotOptimize(std::data(lat.neighbourList()));
+        }
+        report(state, Lattice{shape, maxDist});
+    }
+    BENCHMARK(BM_LatticeConstruction)->Apply(hypercubes);
+
+    /// One sweep of random site updates with a given rule, i.e. size(lat) spin update attempts.
+    void BM_EvolveSweep(benchmark::State &state, UpdateRule const rule)
+    {
+        Lattice const lat{hypercube(state), maxDist};
+        Rng rng{size(lat), 1, Rng::Generator::XOSHIRO256PP};
+        Configuration cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+
+        for (auto _ : state) {
+            std::tie(cfg, std::ignore, std::ignore, std::ignore)
+                = evolveLocal(std::move(cfg), coupling, params, lat, rng, 1, nullptr, {},
+                              rule, SiteOrder::RANDOM);
+        }
+        report(state, lat);
+    }
+    BENCHMARK_CAPTURE(BM_EvolveSweep, metropolis, UpdateRule::METROPOLIS)->Apply(hypercubes);
+    BENCHMARK_CAPTURE(BM_EvolveSweep, heat_bath, UpdateRule::HEAT_BATH)->Apply(hypercubes);
+    BENCHMARK_CAPTURE(BM_EvolveSweep, demon, UpdateRule::DEMON)->Apply(hypercubes);
+
+    /// Dimensions and extents to compare site layouts on, up to 2^23 sites.
+    /**
+     * Extents are multiples of the blocks, 4D lattices with L=48 exceed typical L3 caches.
+     */
+    void blockedHypercubes(benchmark::internal::Benchmark *bench)
+    {
+        bench->ArgNames({"ndim", "L"});
+        for (int64_t const ndim : {2, 3, 4}) {
+            for (int64_t const extent : {16, 32, 48, 64, 256, 1024}) {
+                double const volume = std::pow(static_cast<double>(extent),
+                                               static_cast<double>(ndim));
+                if (volume <= static_cast<double>(1 << 23)) {
+                    bench->Args({ndim, extent});
+                }
+            }
+        }
+    }
+
+    /// One Metropolis sweep in a given site order with a given site layout.
+    void BM_EvolveLayout(benchmark::State &state, Lattice::SiteLayout const layout,
+                         SiteOrder const order)
+    {
+        Lattice const lat{hypercube(state), maxDist, Lattice::DistanceFn::EUCLIDEAN,
+                          Lattice::NeighbourMode::STORED, layout};
+        Rng rng{size(lat), 1, Rng::Generator::XOSHIRO256PP};
+        Configuration cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+
+        for (auto _ : state) {
+            std::tie(cfg, std::ignore, std::ignore, std::ignore)
+                = evolveLocal(std::move(cfg), coupling, params, lat, rng, 1, nullptr, {},
+                              UpdateRule::METROPOLIS, order);
+        }
+        report(state, lat);
+    }
+    BENCHMARK_CAPTURE(BM_EvolveLayout, row_major_typewriter,
+                      Lattice::SiteLayout::ROW_MAJOR, SiteOrder::TYPEWRITER)->Apply(blockedHypercubes);
+    BENCHMARK_CAPTURE(BM_EvolveLayout, blocked_typewriter,
+                      Lattice::SiteLayout::BLOCKED, SiteOrder::TYPEWRITER)->Apply(blockedHypercubes);
+    BENCHMARK_CAPTURE(BM_EvolveLayout, row_major_checkerboard,
+                      Lattice::SiteLayout::ROW_MAJOR, SiteOrder::CHECKERBOARD)->Apply(blockedHypercubes);
+    BENCHMARK_CAPTURE(BM_EvolveLayout, blocked_checkerboard,
+                      Lattice::SiteLayout::BLOCKED, SiteOrder::CHECKERBOARD)->Apply(blockedHypercubes);
+    BENCHMARK_CAPTURE(BM_EvolveLayout, row_major_random,
+                      Lattice::SiteLayout::ROW_MAJOR, SiteOrder::RANDOM)->Apply(blockedHypercubes);
+    BENCHMARK_CAPTURE(BM_EvolveLayout, blocked_random,
+                      Lattice::SiteLayout::BLOCKED, SiteOrder::RANDOM)->Apply(blockedHypercubes);
+
+    /// Sweep plus accumulation of magnetisation moments through a std::function.
+    void BM_EvolveMeasureDynamic(benchmark::State &state)
+    {
+        Lattice const lat{hypercube(state), maxDist};
+        Rng rng{size(lat), 1, Rng::Generator::XOSHIRO256PP};
+        Configuration cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+
+        // needs to recompute the magnetisation since only cfg and energy are passed
+        MeasurementSet moments{MagnetisationMoments{}};
+        std::vector<Measurement> const meas{asMeasurement<Configuration>(moments, lat)};
+        for (auto _ : state) {
+            std::tie(cfg, std::ignore, std::ignore, std::ignore)
+                = evolve(std::move(cfg), coupling, params, lat, rng, 1, nullptr, meas);
+        }
+        benchmark::DoNotOptimize(moments.get<0>().sum2);
+        report(state, lat);
+    }
+    BENCHMARK(BM_EvolveMeasureDynamic)->Apply(hypercubes);
+
+    /// Sweep plus accumulation of magnetisation moments in a MeasurementSet.
+    void BM_EvolveMeasureStatic(benchmark::State &state)
+    {
+        Lattice const lat{hypercube(state), maxDist};
+        Rng rng{size(lat), 1, Rng::Generator::XOSHIRO256PP};
+        Configuration cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+
+        MeasurementSet meas{MagnetisationMoments{}};
+        for (auto _ : state) {
+            std::tie(cfg, std::ignore, std::ignore, std::ignore)
+                = evolveLocal(std::move(cfg), coupling, params, lat, rng, 1, nullptr, meas);
+        }
+        benchmark::DoNotOptimize(meas.get<0>().sum2);
+        report(state, lat);
+    }
+    BENCHMARK(BM_EvolveMeasureStatic)->Apply(hypercubes);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,163 @@
+/**
+ * Benchmark of Metropolis sweeps with different site orders.
+ *
+ * Measures updated sites per second for random, sequential (typewriter),
+ * and checkerboard-sequential orders on 2D lattices of increasing size,
+ * from lattices that fit into L1 cache up to ones that only fit into main memory.
+ * Then compares single threaded checkerboard updates site by site with the
+ * vectorised kernel for all instruction sets supported by the CPU on 2D and 3D lattices.
+ * Finally compares the single spin update rules of evolveLocal() in all site orders
+ * by sites per second and the integrated autocorrelation time of the energy
+ * in sweeps near the critical point.
+ *
+ * Usage: ising-sweep-bench [maxL]
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "montecarlo.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    /// Minimum number of site updates per measurement.
+    constexpr double minUpdates = 1 << 24;
+
+    /// Run sweeps with a given function and return the number of sites updated per second.
+    template <typename Sweep>
+    double sitesPerSecond(Index const latsize, Sweep const &sweep)
+    {
+        sweep(1);  // warm up caches
+
+        size_t const nsweep = std::max(size_t{2},
+            static_cast<size_t>(minUpdates / static_cast<double>(latsize.get())));
+        auto const start = Clock::now();
+        sweep(nsweep);
+        std::chrono::duration<double> const elapsed = Clock::now() - start;
+        return static_cast<double>(nsweep) * static_cast<double>(latsize.get()) / elapsed.count();
+    }
+
+    /// Print sites per second of checkerboard updates with and without the SIMD kernel.
+    template <typename Lat>
+    void benchCheckerboard(Lat const &lat, Parameters const &params)
+    {
+        Rng rng{size(lat), 1, Rng::Generator::XOSHIRO256PP};
+        std::vector<Rng> rngs{Rng{size(lat), 1, 1, Rng::Generator::XOSHIRO256PP}};
+        Configuration cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+
+        auto const run = [&](std::optional<SimdLevel> const simd) {
+            if (simd and not simdSupported(*simd)) {
+                return 0.0;
+            }
+            return sitesPerSecond(size(lat), [&](size_t const nsweep) {
+                std::tie(cfg, std::ignore, std::ignore, std::ignore) = evolveCheckerboard(
+                    cfg, coupling, params, lat, rngs, nsweep, nullptr, {}, simd);
+            });
+        };
+
+        std::string shape;
+        for (Index const extent : lat.shape()) {
+            shape += (shape.empty() ? "" : "x") + std::to_string(extent.get());
+        }
+        std::cout << std::setw(14) << shape << std::setprecision(4)
+                  << std::setw(14) << run(std::nullopt)
+                  << std::setw(14) << run(SimdLevel::SCALAR)
+                  << std::setw(14) << run(SimdLevel::AVX2)
+                  << std::setw(14) << run(SimdLevel::AVX512) << '\n';
+    }
+
+    /// Print sites per second and autocorrelation time of the energy of an update rule.
+    void benchRule(char const *name, UpdateRule const rule, Parameters const &params)
+    {
+        constexpr size_t ntherm = 1000;
+        constexpr size_t nsweep = 20000;
+        FixedLattice<2> const lat{{32_i, 32_i}, 0.0};
+
+        for (auto const order : {SiteOrder::RANDOM, SiteOrder::TYPEWRITER, SiteOrder::CHECKERBOARD}) {
+            Rng rng{size(lat), 1, Rng::Generator::XOSHIRO256PP};
+            Configuration cfg = randomCfg(size(lat), rng);
+            std::int64_t coupling = couplingSum(cfg, lat);
+            std::tie(cfg, std::ignore, std::ignore, std::ignore) = evolveLocal(
+                cfg, coupling, params, lat, rng, ntherm, nullptr, {}, rule, order);
+
+            Observables obs{lat, Observables::Correlator::Method::PAIR_SUM,
+                            Observables::Mode::STREAMING, MeasurementIntervals{1, 1, 0}};
+            double accRate;
+            auto const start = Clock::now();
+            std::tie(cfg, std::ignore, std::ignore, accRate) = evolveLocal(
+                cfg, coupling, params, lat, rng, nsweep, &obs, {}, rule, order);
+            std::chrono::duration<double> const elapsed = Clock::now() - start;
+
+            std::cout << std::setw(12) << name
+                      << std::setw(14) << (order == SiteOrder::RANDOM ? "random"
+                                           : order == SiteOrder::TYPEWRITER ? "sequential"
+                                           : "checkerboard")
+                      << std::setprecision(4)
+                      << std::setw(14) << static_cast<double>(nsweep*size(lat).get()) / elapsed.count()
+                      << std::setw(14) << accRate
+                      << std::setw(14) << obs.summary->energy.tauInt() << '\n';
+        }
+    }
+}
+
+int main(int const argc, char const * const argv[])
+{
+    size_t const maxL = argc > 1 ? std::stoul(argv[1]) : 1024;
+    Parameters const params{0.44, 0.0};
+
+    std::cout << std::setw(6) << "L" << std::setw(12) << "working set"
+              << std::setw(14) << "random" << std::setw(14) << "sequential"
+              << std::setw(14) << "checkerboard" << "   [sites/s]\n";
+
+    for (size_t L = 16; L <= maxL; L *= 2) {
+        FixedLattice<2> const lat{{Index{L}, Index{L}}, 0.0};
+        Rng rng{size(lat), 1, Rng::Generator::XOSHIRO256PP};
+        Configuration cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+
+        auto const random = sitesPerSecond(size(lat), [&](size_t const nsweep) {
+            std::tie(cfg, std::ignore, std::ignore, std::ignore) = evolve(
+                cfg, coupling, params, lat, rng, nsweep, nullptr);
+        });
+        auto const sequential = [&](SiteOrder const order) {
+            return sitesPerSecond(size(lat), [&](size_t const nsweep) {
+                std::tie(cfg, std::ignore, std::ignore, std::ignore) = evolveSequential(
+                    cfg, coupling, params, lat, rng, nsweep, nullptr, {}, order);
+            });
+        };
+        auto const typewriter = sequential(SiteOrder::TYPEWRITER);
+        auto const checkerboard = sequential(SiteOrder::CHECKERBOARD);
+
+        // spins and stored neighbour indices
+        double const bytes = static_cast<double>(size(lat).get())
+            * static_cast<double>(sizeof(Spin) + 4*sizeof(Index));
+        std::cout << std::setw(6) << L << std::setw(10) << std::fixed << std::setprecision(0)
+                  << bytes/1024.0 << "kB" << std::defaultfloat
+                  << std::setw(14) << std::setprecision(4) << random
+                  << std::setw(14) << typewriter
+                  << std::setw(14) << checkerboard << '\n';
+    }
+
+    std::cout << '\n' << std::setw(14) << "shape" << std::setw(14) << "site by site"
+              << std::setw(14) << "scalar" << std::setw(14) << "avx2"
+              << std::setw(14) << "avx512" << "   [sites/s, 0 = unsupported]\n";
+    for (size_t L = 16; L <= maxL; L *= 4) {
+        benchCheckerboard(FixedLattice<2>{{Index{L}, Index{L}}, 0.0}, params);
+    }
+    Parameters const params3D{0.22, 0.0};
+    for (size_t L = 8; L*L*L <= maxL*maxL; L *= 2) {
+        benchCheckerboard(FixedLattice<3>{{Index{L}, Index{L}, Index{L}}, 0.0}, params3D);
+    }
+
+    std::cout << '\n' << std::setw(12) << "rule" << std::setw(14) << "order"
+              << std::setw(14) << "sites/s" << std::setw(14) << "flip rate"
+              << std::setw(14) << "tau_int(E)" << "   [32x32, tau in sweeps]\n";
+    benchRule("metropolis", UpdateRule::METROPOLIS, params);
+    benchRule("heat-bath", UpdateRule::HEAT_BATH, params);
+    benchRule("demon", UpdateRule::DEMON, params);
+}
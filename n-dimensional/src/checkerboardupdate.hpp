@@ -0,0 +1,409 @@
+#ifndef ISING_CHECKERBOARDUPDATE_HPP
+#define ISING_CHECKERBOARDUPDATE_HPP
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "configuration.hpp"
+#include "ising.hpp"
+#include "lattice.hpp"
+#include "localupdate.hpp"
+#include "measurements.hpp"
+#include "montecarlo.hpp"
+#include "ndebug.hpp"
+#include "packedconfiguration.hpp"
+#include "rng.hpp"
+#include "simd.hpp"
+
+/// Block threads until a given number of threads has arrived.
+class Barrier
+{
+public:
+    explicit Barrier(size_t const nthreads)
+        : nthreads_{nthreads}, nwaiting_{0}, generation_{0}
+    { }
+
+    /// Wait for all other threads to arrive at the barrier.
+    void wait()
+    {
+        std::unique_lock lock{mutex_};
+        size_t const generation = generation_;
+        if (++nwaiting_ == nthreads_) {
+            // last thread to arrive, release all others
+            nwaiting_ = 0;
+            ++generation_;
+            cv_.notify_all();
+        }
+        else {
+            cv_.wait(lock, [this, generation]{ return generation != generation_; });
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    size_t const nthreads_;
+    size_t nwaiting_;
+    size_t generation_;
+};
+
+/// Return the range [first, last) of n items a given thread is responsible for.
+inline std::pair<size_t, size_t> threadChunk(size_t const n, size_t const thread,
+                                             size_t const nthreads) noexcept
+{
+    size_t const chunkSize = n / nthreads;
+    size_t const remainder = n % nthreads;
+    // the first `remainder` threads get one extra item
+    size_t const first = thread*chunkSize + std::min(thread, remainder);
+    size_t const last = first + chunkSize + (thread < remainder ? 1 : 0);
+    return {first, last};
+}
+
+/// Return the part of a sublattice a given thread is responsible for.
+inline auto sublatticeChunk(std::vector<Index> const &sublattice,
+                            size_t const thread, size_t const nthreads)
+{
+    using diff = std::vector<Index>::const_iterator::difference_type;
+
+    auto const [first, last] = threadChunk(std::size(sublattice), thread, nthreads);
+    return std::make_tuple(std::cbegin(sublattice)+static_cast<diff>(first),
+                           std::cbegin(sublattice)+static_cast<diff>(last));
+}
+
+/// Return a function for checkerboardSweeps() that updates single elements of sublattices.
+/**
+ * \param updateSite Function
+ *        `(Cfg &cfg, Index idx, Rng &rng, size_t &naccept, std::int64_t &magn) -> std::int64_t`
+ *        which updates the element of cfg with index idx, adds the change in the
+ *        sum of spins to magn, and returns the change in the coupling sum.
+ */
+template <typename UpdateSite>
+auto sublatticeUpdate(std::array<std::vector<Index>, 2> sublattices,
+                      UpdateSite const &updateSite)
+{
+    return [sublattices=std::move(sublattices), &updateSite](
+        auto &cfg, size_t const colour, size_t const thread, size_t const nthreads,
+        Rng &rng, std::int64_t &dcoupling, std::int64_t &magn, size_t &naccept) {
+
+        for (auto [it, end] = sublatticeChunk(sublattices[colour], thread, nthreads);
+             it != end; ++it) {
+            dcoupling += updateSite(cfg, *it, rng, naccept, magn);
+        }
+    };
+}
+
+/// Run sweeps over two sublattices in parallel.
+/**
+ * \param updateColour Function
+ *        `(Cfg &cfg, size_t colour, size_t thread, size_t nthreads, Rng &rng,
+ *          std::int64_t &dcoupling, std::int64_t &dmagn, size_t &naccept) -> void`
+ *        which updates the part of sublattice `colour` that belongs to `thread`,
+ *        adds the change in the coupling sum to dcoupling, the change in the sum
+ *        of spins to dmagn, and the number of accepted flips to naccept.
+ *        Called concurrently by all threads for the same sublattice.
+ *
+ * Both sums are tracked as integers starting from coupling and spinSum(cfg).
+ * The energy is only computed from them when measuring and on return.
+ * coupling is updated to the final configuration.
+ *
+ * Thread 0 calls meas after every sweep, all threads wait for it only in sweeps
+ * in which obs is given or a measurement of meas is due.
+ *
+ * \returns Tuple of the final configuration, final energy, final sum of spins,
+ *          and the total number of accepted spin flips.
+ */
+template <typename Cfg, typename UpdateColour, typename... Ms>
+std::tuple<Cfg, double, std::int64_t, size_t>
+checkerboardSweeps(Cfg cfg, std::int64_t &coupling, Parameters const &params,
+                   Lattice const &lat, std::vector<Rng> &rngs, size_t const nsweep,
+                   Observables * const obs, MeasurementSet<Ms...> &meas,
+                   UpdateColour const &updateColour)
+{
+    size_t const nthreads = std::size(rngs);
+    if (nthreads == 0) {
+        throw std::invalid_argument("Need at least one rng for checkerboard updates");
+    }
+
+    double const volume = static_cast<double>(size(lat).get());
+    checkCoupling(cfg, coupling, lat);
+    std::int64_t magn = spinSum(cfg);
+
+    // per thread results of the last sweep, only accessed between barriers
+    std::vector<std::int64_t> dcouplings(nthreads, 0);
+    std::vector<std::int64_t> dmagns(nthreads, 0);
+    std::vector<size_t> naccepts(nthreads, 0);
+
+    Barrier barrier{nthreads};
+    // set by thread 0 before the second barrier of every sweep and read by all threads after it
+    bool synchronise = false;
+    bool abort = false;  // set by thread 0 if a measurement failed
+    std::exception_ptr error;
+
+    auto worker = [&](size_t const thread) {
+        Rng &rng = rngs[thread];
+        size_t naccept = 0;
+        std::int64_t dcoupling = 0;
+        std::int64_t dmagn = 0;
+
+        for (size_t sweep = 0; sweep < nsweep; ++sweep) {
+            dcoupling = 0;
+            dmagn = 0;
+            updateColour(cfg, 0, thread, nthreads, rng, dcoupling, dmagn, naccept);
+            // sublattice 1 needs the updated neighbours
+            barrier.wait();
+            updateColour(cfg, 1, thread, nthreads, rng, dcoupling, dmagn, naccept);
+
+            dcouplings[thread] = dcoupling;
+            dmagns[thread] = dmagn;
+            naccepts[thread] = naccept;
+            if (thread == 0) {
+                // meas is only accessed by thread 0
+                // in debug builds, cfg must not change while thread 0 checks for drift
+                synchronise = obs or meas.due() or driftCheckDue(sweep);
+            }
+            barrier.wait();
+
+            if (thread == 0) {
+                for (size_t t = 0; t < nthreads; ++t) {
+                    coupling += dcouplings[t];
+                    magn += dmagns[t];
+                }
+
+                if (synchronise) {
+                    try {
+                        double const currentEnergy = energyFromSums(params, coupling, magn);
+                        checkDrift(sweep, cfg, currentEnergy, magn, params, lat);
+                        measure(obs, lat, cfg, currentEnergy, magn, nullptr, coupling);
+                        if (meas.due()) {
+                            meas(ChainState<Cfg>{cfg, currentEnergy,
+                                                 static_cast<double>(magn) / volume, lat});
+                        }
+                        else {
+                            meas.skip();
+                        }
+                    }
+                    catch (...) {
+                        error = std::current_exception();
+                        abort = true;
+                    }
+                }
+                else {
+                    meas.skip();
+                }
+            }
+
+            if (synchronise) {
+                // don't change cfg while thread 0 is measuring
+                barrier.wait();
+                if (abort) {
+                    return;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t thread = 1; thread < nthreads; ++thread) {
+        threads.emplace_back(worker, thread);
+    }
+    worker(0);
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    size_t naccept = 0;
+    for (size_t const n : naccepts) {
+        naccept += n;
+    }
+
+    return std::make_tuple(std::move(cfg), energyFromSums(params, coupling, magn),
+                           magn, naccept);
+}
+
+/// Maximum number of bits in counters of anti-aligned neighbours for packed updates.
+inline constexpr size_t maxCounterPlanes = 8;
+
+/// Perform multi-spin coded Metropolis-Hastings updates of all spins in a word.
+/**
+ * Flips all spins whose update is accepted and adds the change in
+ * the sum of all spins to magn.
+ * \param nplanes Number of bits needed to store the coordination number 2*ndim.
+ * \returns The change in the coupling sum.
+ */
+inline std::int64_t metropolisWord(PackedConfiguration &cfg, Index const word,
+                                   BoltzmannTable const &boltzmann, Lattice const &wordLat,
+                                   size_t const nplanes, Rng &rng, size_t &naccept,
+                                   std::int64_t &magn) noexcept(ndebug)
+{
+    using Word = PackedConfiguration::Word;
+
+    Word const spins = cfg.word(word);
+    Index const ncoord = 2_i*wordLat.ndim();
+
+    // Count anti-aligned neighbours of all spins at once using bit-sliced counters:
+    // Bit b of counter[p] is bit p of the number of anti-aligned neighbours of spin b.
+    std::array<Word, maxCounterPlanes> counter{};
+    for (Index n = 0_i; n < ncoord; ++n) {
+        Word carry = spins ^ alignedNeighbour(cfg, word, n, wordLat);
+        for (size_t p = 0; p < nplanes and carry != 0; ++p) {
+            Word const nextCarry = counter[p] & carry;
+            counter[p] ^= carry;
+            carry = nextCarry;
+        }
+    }
+
+    // Accept-reject all spins with the same number of anti-aligned neighbours
+    // and the same sign together.
+    Word flips{0};
+    std::int64_t dcoupling = 0;
+    for (size_t nantialigned = 0; nantialigned <= ncoord.get(); ++nantialigned) {
+        // select bits whose counter equals nantialigned
+        Word candidates = ~Word{0};
+        for (size_t p = 0; p < nplanes; ++p) {
+            candidates &= (nantialigned >> p) & 1 ? counter[p] : ~counter[p];
+        }
+        if (candidates == 0) {
+            continue;
+        }
+
+        for (Spin const spin : {Spin{+1}, Spin{-1}}) {
+            Word remaining = candidates & (spin == Spin{+1} ? spins : ~spins);
+            Spin const neighbourSum = spin*Spin{static_cast<int>(ncoord.get()) - 2*static_cast<int>(nantialigned)};
+            size_t const idx = boltzmann.index(spin, neighbourSum);
+            double const acceptance = boltzmann.acceptance(idx);
+
+            Word accepted{0};
+            if (acceptance >= 1.0) {
+                accepted = remaining;
+            }
+            else {
+                // draw a random number for each spin individually
+                while (remaining != 0) {
+                    Word const lowest = remaining & (~remaining + 1);
+                    if (acceptance > rng.genReal()) {
+                        accepted |= lowest;
+                    }
+                    remaining ^= lowest;
+                }
+            }
+
+            flips |= accepted;
+            dcoupling += static_cast<std::int64_t>(std::bitset<64>(accepted).count())
+                * boltzmann.deltaCoupling(idx);
+        }
+    }
+
+    cfg.word(word) ^= flips;
+    naccept += std::bitset<64>(flips).count();
+    // up spins become down and vice versa
+    magn += 2*(static_cast<std::int64_t>(std::bitset<64>(flips & ~spins).count())
+               - static_cast<std::int64_t>(std::bitset<64>(flips & spins).count()));
+    return dcoupling;
+}
+
+/// Evolve a configuration using checkerboard sweeps and a compile time set of measurements.
+/**
+ * Same as evolveCheckerboard() in montecarlo.hpp but calls meas after every sweep instead
+ * of a std::vector<Measurement>. Threads only wait for measurements in sweeps
+ * in which one of meas is due.
+ * meas keeps its state, so it can be passed to several calls and read out afterwards.
+ */
+template <typename Lat, typename... Ms>
+std::tuple<Configuration, double, double, double>
+evolveCheckerboard(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+                   Lat const &lat, std::vector<Rng> &rngs, size_t const nsweep,
+                   Observables * const obs, MeasurementSet<Ms...> &meas,
+                   std::optional<SimdLevel> const simd=std::nullopt)
+{
+    double energy;
+    std::int64_t magn;
+    size_t naccept;
+    if (simd) {
+        CheckerboardKernel const kernel{lat, params, *simd};
+        // derived from the thread rngs such that their states determine the chain
+        std::vector<LaneRng> laneRngs(std::begin(rngs), std::end(rngs));
+
+        std::tie(cfg, energy, magn, naccept) = checkerboardSweeps(
+            std::move(cfg), coupling, params, lat, rngs, nsweep, obs, meas,
+            [&kernel, &laneRngs](Configuration &c, size_t const colour, size_t const thread,
+                                 size_t const nthreads, Rng &, std::int64_t &dcoupling,
+                                 std::int64_t &dmagn, size_t &nacc) {
+                auto const [first, last] = threadChunk(kernel.nrows(), thread, nthreads);
+                dcoupling += kernel.update(c, colour, first, last, laneRngs[thread], nacc, dmagn);
+            });
+    }
+    else {
+        BoltzmannTable const boltzmann{params, lat.ndim()};
+        auto const updateSite = [&boltzmann, &lat](Configuration &c, Index const site,
+                                                   Rng &rng, size_t &nacc, std::int64_t &dmagn) {
+            return metropolis(c, site, boltzmann, lat, rng, nacc, dmagn);
+        };
+        std::tie(cfg, energy, magn, naccept) = checkerboardSweeps(
+            std::move(cfg), coupling, params, lat, rngs, nsweep, obs, meas,
+            sublatticeUpdate(checkerboard(lat), updateSite));
+    }
+
+    return std::make_tuple(std::move(cfg), energy,
+                           static_cast<double>(magn) / static_cast<double>(size(lat).get()),
+                           static_cast<double>(naccept)
+                           / static_cast<double>(nsweep)
+                           / static_cast<double>(size(lat).get()));
+}
+
+/// Evolve a packed configuration using checkerboard sweeps and a compile time set of measurements.
+/**
+ * Same as evolveCheckerboard() for PackedConfiguration in montecarlo.hpp
+ * but takes a MeasurementSet like the overload for Configuration above.
+ */
+template <typename... Ms>
+std::tuple<PackedConfiguration, double, double, double>
+evolveCheckerboard(PackedConfiguration cfg, std::int64_t &coupling, Parameters const& params,
+                   Lattice const &lat, std::vector<Rng> &rngs, size_t const nsweep,
+                   Observables * const obs, MeasurementSet<Ms...> &meas)
+{
+    BoltzmannTable const boltzmann{params, lat.ndim()};
+    Lattice const &wordLat = cfg.wordLattice();  // outlives the move of cfg below
+
+    size_t nplanes = 0;  // number of bits needed to count up to 2*ndim
+    while ((2_i*lat.ndim()).get() >> nplanes) {
+        ++nplanes;
+    }
+    if (nplanes > maxCounterPlanes) {
+        throw std::invalid_argument("Too many dimensions for packed configurations");
+    }
+
+    auto const updateWord = [&boltzmann, &wordLat, nplanes](PackedConfiguration &c, Index const word,
+                                                            Rng &rng, size_t &nacc,
+                                                            std::int64_t &dmagn) {
+        return metropolisWord(c, word, boltzmann, wordLat, nplanes, rng, nacc, dmagn);
+    };
+    double energy;
+    std::int64_t magn;
+    size_t naccept;
+    std::tie(cfg, energy, magn, naccept) = checkerboardSweeps(
+        std::move(cfg), coupling, params, lat, rngs, nsweep, obs, meas,
+        sublatticeUpdate(checkerboard(wordLat), updateWord));
+
+    return std::make_tuple(std::move(cfg), energy,
+                           static_cast<double>(magn) / static_cast<double>(size(lat).get()),
+                           static_cast<double>(naccept)
+                           / static_cast<double>(nsweep)
+                           / static_cast<double>(size(lat).get()));
+}
+
+#endif  // ndef ISING_CHECKERBOARDUPDATE_HPP
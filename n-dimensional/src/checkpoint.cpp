@@ -0,0 +1,287 @@
+#include "checkpoint.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+namespace {
+    constexpr char magic[8] = {'I', 'S', 'I', 'N', 'G', 'C', 'K', 'P'};
+    constexpr std::uint32_t version = 6;
+
+    template <typename T>
+    void writeRaw(std::ostream &os, T const value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        os.write(reinterpret_cast<char const*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    T readRaw(std::istream &is)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        is.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void writeVector(std::ostream &os, std::vector<T> const &vec)
+    {
+        writeRaw<std::uint64_t>(os, std::size(vec));
+        os.write(reinterpret_cast<char const*>(vec.data()),
+                 static_cast<std::streamsize>(sizeof(T)*std::size(vec)));
+    }
+
+    template <typename T>
+    std::vector<T> readVector(std::istream &is)
+    {
+        std::vector<T> vec(readRaw<std::uint64_t>(is));
+        is.read(reinterpret_cast<char*>(vec.data()),
+                static_cast<std::streamsize>(sizeof(T)*std::size(vec)));
+        return vec;
+    }
+
+    void writeString(std::ostream &os, std::string const &str)
+    {
+        writeVector(os, std::vector<char>(str.begin(), str.end()));
+    }
+
+    std::string readString(std::istream &is)
+    {
+        auto const chars = readVector<char>(is);
+        return {chars.begin(), chars.end()};
+    }
+
+    void writeRng(std::ostream &os, Rng const &rng)
+    {
+        std::ostringstream oss;
+        oss << rng;
+        writeString(os, oss.str());
+    }
+
+    Rng readRng(std::istream &is, Index const latsize)
+    {
+        Rng rng{latsize, 0};
+        std::istringstream iss{readString(is)};
+        iss >> rng;
+        if (not iss) {
+            throw std::runtime_error("Invalid rng state in checkpoint");
+        }
+        return rng;
+    }
+
+    void writeAccumulator(std::ostream &os, BinningAccumulator const &acc)
+    {
+        writeRaw<std::uint64_t>(os, acc.nlevels());
+        for (auto const &level : acc.levels()) {
+            writeRaw<std::uint64_t>(os, level.count);
+            writeRaw(os, level.mean);
+            writeRaw(os, level.m2);
+            writeRaw(os, level.pending);
+            writeRaw<std::uint8_t>(os, level.hasPending);
+        }
+    }
+
+    BinningAccumulator readAccumulator(std::istream &is)
+    {
+        std::vector<BinningAccumulator::Level> levels(readRaw<std::uint64_t>(is));
+        for (auto &level : levels) {
+            level.count = readRaw<std::uint64_t>(is);
+            level.mean = readRaw<double>(is);
+            level.m2 = readRaw<double>(is);
+            level.pending = readRaw<double>(is);
+            level.hasPending = readRaw<std::uint8_t>(is) != 0;
+        }
+        return BinningAccumulator{std::move(levels)};
+    }
+
+    void writeObservables(std::ostream &os, Observables const &obs)
+    {
+        writeVector(os, obs.energy);
+        writeVector(os, obs.magnetisation);
+        writeRaw<std::uint64_t>(os, std::size(obs.corr.correlator));
+        for (auto const &corr : obs.corr.correlator) {
+            writeVector(os, corr);
+        }
+        writeRaw<std::uint64_t>(os, std::size(obs.fourierModes));
+        for (auto const &modes : obs.fourierModes) {
+            writeVector(os, modes);
+        }
+
+        writeRaw<std::uint8_t>(os, obs.histogram.has_value());
+        if (obs.histogram) {
+            auto const &counts = obs.histogram->counts();
+            writeRaw<std::uint64_t>(os, std::size(counts));
+            for (auto const &[key, count] : counts) {
+                writeRaw<std::int64_t>(os, key.first);
+                writeRaw<std::int64_t>(os, key.second);
+                writeRaw<std::uint64_t>(os, count);
+            }
+        }
+
+        writeRaw<std::uint8_t>(os, obs.summary.has_value());
+        if (obs.summary) {
+            writeAccumulator(os, obs.summary->energy);
+            writeAccumulator(os, obs.summary->magnetisation);
+            for (auto const &acc : obs.summary->correlator) {
+                writeAccumulator(os, acc);
+            }
+            for (auto const &acc : obs.summary->fourierModes) {
+                writeAccumulator(os, acc);
+            }
+        }
+    }
+
+    void readObservables(std::istream &is, Observables &obs)
+    {
+        obs.energy = readVector<double>(is);
+        obs.magnetisation = readVector<double>(is);
+        if (readRaw<std::uint64_t>(is) != std::size(obs.corr.correlator)) {
+            throw std::runtime_error("Number of distances in checkpoint does not match the lattice");
+        }
+        for (auto &corr : obs.corr.correlator) {
+            corr = readVector<double>(is);
+        }
+        if (readRaw<std::uint64_t>(is) != std::size(obs.fourierModes)) {
+            throw std::runtime_error("Number of Fourier modes in checkpoint does not match the lattice");
+        }
+        for (auto &modes : obs.fourierModes) {
+            modes = readVector<double>(is);
+        }
+
+        if ((readRaw<std::uint8_t>(is) != 0) != obs.histogram.has_value()) {
+            throw std::runtime_error("Checkpoint was written with a different setting of 'histogram'");
+        }
+        if (obs.histogram) {
+            obs.histogram.emplace();
+            auto const npairs = readRaw<std::uint64_t>(is);
+            for (std::uint64_t i = 0; i < npairs; ++i) {
+                auto const coupling = readRaw<std::int64_t>(is);
+                auto const spinSum = readRaw<std::int64_t>(is);
+                obs.histogram->add(coupling, spinSum, readRaw<std::uint64_t>(is));
+            }
+        }
+
+        if ((readRaw<std::uint8_t>(is) != 0) != obs.summary.has_value()) {
+            throw std::runtime_error("Checkpoint was written with a different setting of 'streaming'");
+        }
+        if (obs.summary) {
+            obs.summary->energy = readAccumulator(is);
+            obs.summary->magnetisation = readAccumulator(is);
+            for (auto &acc : obs.summary->correlator) {
+                acc = readAccumulator(is);
+            }
+            for (auto &acc : obs.summary->fourierModes) {
+                acc = readAccumulator(is);
+            }
+        }
+    }
+}
+
+void saveCheckpoint(fs::path const &fname, Checkpoint const &checkpoint,
+                    Observables const &obs)
+{
+    fs::path tmpname = fname;
+    tmpname += ".tmp";
+
+    {
+        std::ofstream ofs;
+        ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+        ofs.open(tmpname, std::ios::trunc | std::ios::binary);
+
+        ofs.write(magic, sizeof magic);
+        writeRaw(ofs, version);
+
+        writeRaw<std::uint64_t>(ofs, checkpoint.rngSeed);
+        std::vector<std::uint64_t> shape;
+        for (Index const extent : checkpoint.shape) {
+            shape.emplace_back(extent.get());
+        }
+        writeVector(ofs, shape);
+
+        writeRaw<std::uint64_t>(ofs, checkpoint.ensemble);
+        writeRaw<std::uint64_t>(ofs, checkpoint.sweep);
+        writeRaw(ofs, checkpoint.rateSum);
+        writeRaw<std::uint64_t>(ofs, checkpoint.nclustersPerSweep);
+
+        std::vector<std::int8_t> spins;
+        for (Spin const s : checkpoint.cfg) {
+            spins.emplace_back(static_cast<std::int8_t>(s.get()));
+        }
+        writeVector(ofs, spins);
+        writeRaw(ofs, checkpoint.coupling);
+
+        writeRng(ofs, checkpoint.rng);
+        writeRaw<std::uint64_t>(ofs, std::size(checkpoint.threadRngs));
+        for (auto const &rng : checkpoint.threadRngs) {
+            writeRng(ofs, rng);
+        }
+
+        writeRaw<std::uint64_t>(ofs, checkpoint.cfgFileSize);
+        writeObservables(ofs, obs);
+    }
+
+    fs::rename(tmpname, fname);
+}
+
+Checkpoint loadCheckpoint(fs::path const &fname, Observables &obs)
+{
+    std::ifstream ifs;
+    ifs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    try {
+        ifs.open(fname, std::ios::binary);
+
+        char fileMagic[sizeof magic];
+        ifs.read(fileMagic, sizeof fileMagic);
+        if (std::memcmp(fileMagic, magic, sizeof magic) != 0
+            or readRaw<std::uint32_t>(ifs) != version) {
+            throw std::runtime_error("File " + fname.string() + " is not a checkpoint");
+        }
+
+        unsigned long const rngSeed = readRaw<std::uint64_t>(ifs);
+        MultiIndex shape;
+        for (auto const extent : readVector<std::uint64_t>(ifs)) {
+            shape.emplace_back(extent);
+        }
+        Index const latsize = std::accumulate(shape.begin(), shape.end(), 1_i,
+                                              [](Index const a, Index const b) { return a*b; });
+
+        std::size_t const ensemble = readRaw<std::uint64_t>(ifs);
+        std::size_t const sweep = readRaw<std::uint64_t>(ifs);
+        double const rateSum = readRaw<double>(ifs);
+        std::size_t const nclustersPerSweep = readRaw<std::uint64_t>(ifs);
+
+        auto const spins = readVector<std::int8_t>(ifs);
+        if (Index{std::size(spins)} != latsize) {
+            throw std::runtime_error("Configuration in checkpoint does not match the lattice");
+        }
+        Configuration cfg{latsize};
+        for (Index i = 0_i; i < latsize; ++i) {
+            cfg[i] = Spin{spins[i.get()]};
+        }
+        std::int64_t const coupling = readRaw<std::int64_t>(ifs);
+
+        Rng rng = readRng(ifs, latsize);
+        std::vector<Rng> threadRngs;
+        for (std::uint64_t const nthreads = readRaw<std::uint64_t>(ifs);
+             std::size(threadRngs) < nthreads; ) {
+            threadRngs.emplace_back(readRng(ifs, latsize));
+        }
+
+        std::uintmax_t const cfgFileSize = readRaw<std::uint64_t>(ifs);
+        readObservables(ifs, obs);
+
+        return Checkpoint{rngSeed, std::move(shape), ensemble, sweep, rateSum,
+                          nclustersPerSweep, std::move(cfg), coupling,
+                          std::move(rng), std::move(threadRngs), cfgFileSize};
+    }
+    catch (std::ios_base::failure const &) {
+        throw std::runtime_error("Unable to read checkpoint from " + fname.string());
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef ISING_CHECKPOINT_HPP
+#define ISING_CHECKPOINT_HPP
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "configuration.hpp"
+#include "lattice.hpp"
+#include "montecarlo.hpp"
+#include "rng.hpp"
+
+/// State of the Markov chain during production, enough to continue it exactly.
+struct Checkpoint
+{
+    /// Seed from the input file, only used to check that a restart is consistent.
+    unsigned long rngSeed;
+    /// Shape of the lattice, only used to check that a restart is consistent.
+    MultiIndex shape;
+
+    /// Index of the ensemble (set of parameters) in production.
+    std::size_t ensemble;
+    /// Number of production sweeps of that ensemble that have been completed.
+    std::size_t sweep;
+    /// Sum over completed chunks of sweeps of acceptance rate (or cluster size) times nsweep.
+    double rateSum;
+    /// Number of clusters per sweep of Wolff updates of that ensemble, 0 if not calibrated.
+    std::size_t nclustersPerSweep;
+
+    /// Current configuration, unpacked if packed storage is used.
+    Configuration cfg;
+    /// Coupling sum of cfg, see couplingSum().
+    std::int64_t coupling;
+
+    /// Main random number generator.
+    Rng rng;
+    /// Generators of parallel update schemes, may be empty.
+    std::vector<Rng> threadRngs;
+
+    /// Size in bytes of the output file of configurations of the ensemble, 0 if none is written.
+    std::uintmax_t cfgFileSize;
+};
+
+/// Write a checkpoint and the partial observables of its ensemble to a binary file.
+/**
+ * Writes to a temporary file first and renames it at the end such that the target
+ * is never left with an incomplete checkpoint if the program is killed.
+ * The file uses the native byte order and is only meant to be read on the same machine.
+ */
+void saveCheckpoint(std::filesystem::path const &fname, Checkpoint const &checkpoint,
+                    Observables const &obs);
+
+/// Read a checkpoint written by saveCheckpoint().
+/**
+ * \param fname File to read from.
+ * \param obs Is overwritten by the observables stored in the file.
+ *            Must be constructed for the same lattice and mode as when saving.
+ * \throws std::runtime_error if the file is not a valid checkpoint or does not match obs.
+ */
+Checkpoint loadCheckpoint(std::filesystem::path const &fname, Observables &obs);
+
+#endif  // ndef ISING_CHECKPOINT_HPP
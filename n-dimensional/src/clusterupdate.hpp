@@ -0,0 +1,291 @@
+#ifndef ISING_CLUSTERUPDATE_HPP
+#define ISING_CLUSTERUPDATE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include "configuration.hpp"
+#include "ising.hpp"
+#include "lattice.hpp"
+#include "localupdate.hpp"
+#include "measurements.hpp"
+#include "montecarlo.hpp"
+#include "rng.hpp"
+
+/// Return the probability to bond two neighbours with a satisfied link in cluster updates.
+inline double bondProbability(Parameters const &params) noexcept
+{
+    return 1.0 - std::exp(-2.0*std::abs(params.JT));
+}
+
+/// Return true if the link between two spins minimises the coupling energy.
+/**
+ * These are aligned spins for ferromagnetic and anti-aligned spins
+ * for anti-ferromagnetic couplings. Only such links can be bonded into clusters.
+ */
+inline bool satisfied(Spin const a, Spin const b, Parameters const &params) noexcept
+{
+    return params.JT * static_cast<double>((a*b).get()) > 0.0;
+}
+
+/// Grow a single Wolff cluster from a random site and flip it.
+/**
+ * The coupling is fully taken into account by the bond probability.
+ * The cluster is flipped with probability min(1, exp(-2 h/kT M_C))
+ * where M_C is the magnetisation of the cluster before the flip.
+ *
+ * \param cluster Work space for sites in the cluster, used as a queue.
+ *                Must have capacity size(lat) to avoid allocations.
+ * \param inCluster Marks sites in the cluster, must be all false on entry
+ *                  and is reset to all false on exit.
+ * \returns Tuple of size of the cluster, difference of the coupling sum, and
+ *          difference of the sum of spins.
+ */
+template <typename Lat>
+std::tuple<size_t, std::int64_t, std::int64_t>
+wolffCluster(Configuration &cfg, Parameters const &params,
+             double const pbond, Lat const &lat, Rng &rng,
+             std::vector<Index> &cluster,
+             std::vector<unsigned char> &inCluster)
+{
+    Index const nneigh = 2_i*lat.ndim();
+
+    Index const seed = rng.genIndex();
+    cluster.clear();
+    cluster.push_back(seed);
+    inCluster[seed.get()] = true;
+
+    for (size_t head = 0; head < std::size(cluster); ++head) {
+        Index const site = cluster[head];
+        for (Index n = 0_i; n < nneigh; ++n) {
+            Index const neighbour = lat.neighbour(site, n);
+            if (not inCluster[neighbour.get()]
+                and satisfied(cfg[site], cfg[neighbour], params)
+                and rng.genReal() < pbond) {
+                inCluster[neighbour.get()] = true;
+                cluster.push_back(neighbour);
+            }
+        }
+    }
+
+    // links across the boundary and magnetisation of the cluster
+    std::int64_t boundary = 0;
+    std::int64_t magn = 0;
+    for (Index const site : cluster) {
+        magn += cfg[site].get();
+        for (Index n = 0_i; n < nneigh; ++n) {
+            Index const neighbour = lat.neighbour(site, n);
+            if (not inCluster[neighbour.get()]) {
+                boundary += (cfg[site]*cfg[neighbour]).get();
+            }
+        }
+    }
+
+    double const fieldDelta = 2.0*params.hT*static_cast<double>(magn);
+    bool const accept = fieldDelta <= 0.0 or std::exp(-fieldDelta) > rng.genReal();
+    for (Index const site : cluster) {
+        if (accept) {
+            cfg.flip(site);
+        }
+        inCluster[site.get()] = false;
+    }
+
+    return {std::size(cluster), accept ? -2*boundary : 0, accept ? -2*magn : 0};
+}
+
+/// Find the root of a site in a union-find forest using path halving.
+inline Index findRoot(std::vector<Index> &parent, Index site) noexcept
+{
+    while (parent[site.get()] != site) {
+        parent[site.get()] = parent[parent[site.get()].get()];
+        site = parent[site.get()];
+    }
+    return site;
+}
+
+/// Perform one Swendsen-Wang sweep, i.e. decompose the lattice into clusters and flip them.
+/**
+ * Each cluster is flipped with probability 1/(1 + exp(2 h/kT M_C))
+ * where M_C is the magnetisation of the cluster before the flip.
+ *
+ * \param parent Work space for the union-find forest, must have size size(lat).
+ * \param clusterMagn Work space for magnetisations of clusters, must have size size(lat).
+ * \param flipCluster Work space for flip decisions, must have size size(lat).
+ * \returns Tuple of number of clusters, difference of the coupling sum, and
+ *          difference of the sum of spins.
+ */
+template <typename Lat>
+std::tuple<size_t, std::int64_t, std::int64_t>
+swendsenWangSweep(Configuration &cfg, Parameters const &params,
+                  double const pbond, Lat const &lat, Rng &rng,
+                  std::vector<Index> &parent,
+                  std::vector<std::int64_t> &clusterMagn,
+                  std::vector<unsigned char> &flipCluster)
+{
+    Index const latsize = size(lat);
+
+    for (Index site = 0_i; site < latsize; ++site) {
+        parent[site.get()] = site;
+    }
+
+    // bond links in positive directions only, so each link is considered once
+    for (Index site = 0_i; site < latsize; ++site) {
+        for (Index d = 0_i; d < lat.ndim(); ++d) {
+            Index const neighbour = lat.neighbour(site, 2_i*d);
+            if (satisfied(cfg[site], cfg[neighbour], params) and rng.genReal() < pbond) {
+                Index const a = findRoot(parent, site);
+                Index const b = findRoot(parent, neighbour);
+                if (a != b) {
+                    // keep the smaller index as root
+                    parent[std::max(a, b).get()] = std::min(a, b);
+                }
+            }
+        }
+    }
+
+    std::fill(clusterMagn.begin(), clusterMagn.end(), std::int64_t{0});
+    for (Index site = 0_i; site < latsize; ++site) {
+        Index const root = findRoot(parent, site);
+        parent[site.get()] = root;  // compress fully for the passes below
+        clusterMagn[root.get()] += cfg[site].get();
+    }
+
+    size_t nclusters = 0;
+    for (Index site = 0_i; site < latsize; ++site) {
+        if (parent[site.get()] == site) {
+            ++nclusters;
+            double const fieldDelta = 2.0*params.hT*static_cast<double>(clusterMagn[site.get()]);
+            flipCluster[site.get()] = rng.genReal() * (1.0 + std::exp(fieldDelta)) < 1.0;
+        }
+    }
+
+    // coupling difference from links between clusters with different decisions
+    std::int64_t boundary = 0;
+    std::int64_t magn = 0;
+    for (Index site = 0_i; site < latsize; ++site) {
+        bool const flipped = flipCluster[parent[site.get()].get()];
+        if (flipped) {
+            magn += cfg[site].get();
+        }
+        for (Index d = 0_i; d < lat.ndim(); ++d) {
+            Index const neighbour = lat.neighbour(site, 2_i*d);
+            if (flipped != static_cast<bool>(flipCluster[parent[neighbour.get()].get()])) {
+                boundary += (cfg[site]*cfg[neighbour]).get();
+            }
+        }
+    }
+
+    for (Index site = 0_i; site < latsize; ++site) {
+        if (flipCluster[parent[site.get()].get()]) {
+            cfg.flip(site);
+        }
+    }
+
+    return {nclusters, -2*boundary, -2*magn};
+}
+
+/// Evolve a configuration using Wolff cluster updates and a compile time set of measurements.
+/**
+ * Same as evolveWolff() in montecarlo.hpp but calls meas after every sweep instead
+ * of a std::vector<Measurement>.
+ * meas keeps its state, so it can be passed to several calls and read out afterwards.
+ */
+template <typename Lat, typename... Ms>
+std::tuple<Configuration, double, double, double>
+evolveWolff(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+            Lat const &lat, Rng &rng, size_t const nsweep,
+            Observables * const obs, MeasurementSet<Ms...> &meas,
+            size_t * const nclustersPerSweep=nullptr)
+{
+    double const volume = static_cast<double>(size(lat).get());
+    double const pbond = bondProbability(params);
+    std::vector<Index> cluster;
+    cluster.reserve(size(lat).get());
+    std::vector<unsigned char> inCluster(size(lat).get(), false);
+
+    checkCoupling(cfg, coupling, lat);
+    std::int64_t magn = spinSum(cfg);
+    size_t nclusters = 0;
+    size_t totalSize = 0;
+    auto const flipCluster = [&]() {
+        auto const [clusterSize, dcoupling, dmagn] = wolffCluster(cfg, params, pbond, lat, rng,
+                                                                  cluster, inCluster);
+        coupling += dcoupling;
+        magn += dmagn;
+        return clusterSize;
+    };
+
+    // Find the number of clusters per sweep by flipping clusters until as many spins
+    // have been visited as there are sites. This number is kept fixed afterwards because
+    // measuring when the visited spins reach size(lat) would bias towards large clusters.
+    // Unless the number was found by a previous call with the same nclustersPerSweep.
+    // The calibration clusters are not counted in the mean cluster size.
+    size_t localClustersPerSweep = 0;
+    size_t &clustersPerSweep = nclustersPerSweep ? *nclustersPerSweep : localClustersPerSweep;
+    if (clustersPerSweep == 0) {
+        for (size_t visited = 0; nsweep > 0 and visited < size(lat).get(); ++clustersPerSweep) {
+            visited += flipCluster();
+        }
+    }
+
+    for (size_t sweep = 0; sweep < nsweep; ++sweep) {
+        for (size_t i = 0; i < clustersPerSweep; ++i) {
+            totalSize += flipCluster();
+        }
+        nclusters += clustersPerSweep;
+
+        double const energy = energyFromSums(params, coupling, magn);
+        checkDrift(sweep, cfg, energy, magn, params, lat);
+        measure(obs, lat, cfg, energy, magn, nullptr, coupling);
+        meas(ChainState<Configuration>{cfg, energy, static_cast<double>(magn) / volume, lat});
+    }
+
+    return std::make_tuple(std::move(cfg), energyFromSums(params, coupling, magn),
+                           static_cast<double>(magn) / volume,
+                           static_cast<double>(totalSize)
+                           / static_cast<double>(std::max(nclusters, size_t{1})));
+}
+
+/// Evolve a configuration using Swendsen-Wang updates and a compile time set of measurements.
+/**
+ * Same as evolveSwendsenWang() in montecarlo.hpp but takes a MeasurementSet
+ * like evolveWolff() above.
+ */
+template <typename Lat, typename... Ms>
+std::tuple<Configuration, double, double, double>
+evolveSwendsenWang(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+                   Lat const &lat, Rng &rng, size_t const nsweep,
+                   Observables * const obs, MeasurementSet<Ms...> &meas)
+{
+    double const volume = static_cast<double>(size(lat).get());
+    double const pbond = bondProbability(params);
+    std::vector<Index> parent(size(lat).get(), 0_i);
+    std::vector<std::int64_t> clusterMagn(size(lat).get(), 0);
+    std::vector<unsigned char> flipCluster(size(lat).get(), false);
+
+    checkCoupling(cfg, coupling, lat);
+    std::int64_t magn = spinSum(cfg);
+    size_t nclusters = 0;
+    for (size_t sweep = 0; sweep < nsweep; ++sweep) {
+        auto const [n, dcoupling, dmagn] = swendsenWangSweep(cfg, params, pbond, lat, rng,
+                                                             parent, clusterMagn, flipCluster);
+        coupling += dcoupling;
+        magn += dmagn;
+        nclusters += n;
+
+        double const energy = energyFromSums(params, coupling, magn);
+        checkDrift(sweep, cfg, energy, magn, params, lat);
+        measure(obs, lat, cfg, energy, magn, nullptr, coupling);
+        meas(ChainState<Configuration>{cfg, energy, static_cast<double>(magn) / volume, lat});
+    }
+
+    return std::make_tuple(std::move(cfg), energyFromSums(params, coupling, magn),
+                           static_cast<double>(magn) / volume,
+                           static_cast<double>(nsweep) * volume
+                           / static_cast<double>(std::max(nclusters, size_t{1})));
+}
+
+#endif  // ndef ISING_CLUSTERUPDATE_HPP
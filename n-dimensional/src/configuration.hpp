@@ -2,6 +2,7 @@
 #define ISING_CONFIGURATION_HPP
 
 #include <vector>
+#include <stdexcept>
 
 #include "lattice.hpp"
 #include "arithmetic.hpp"
@@ -91,4 +92,30 @@ inline Index size(Configuration const &cfg) noexcept
     return cfg.size();
 }
 
+/// Return a copy of a configuration in the layout of lat with spins in row-major order.
+inline Configuration toRowMajor(Configuration const &cfg, Lattice const &lat)
+{
+    if (lat.layout() == Lattice::SiteLayout::ROW_MAJOR) {
+        return cfg;
+    }
+    Configuration rowMajor{size(cfg)};
+    for (Index site = 0_i; site < size(cfg); ++site) {
+        rowMajor[lat.toRowMajor(site)] = cfg[site];
+    }
+    return rowMajor;
+}
+
+/// Return a copy of a configuration in row-major order with spins in the layout of lat.
+inline Configuration fromRowMajor(Configuration const &rowMajor, Lattice const &lat)
+{
+    if (lat.layout() == Lattice::SiteLayout::ROW_MAJOR) {
+        return rowMajor;
+    }
+    Configuration cfg{size(rowMajor)};
+    for (Index site = 0_i; site < size(cfg); ++site) {
+        cfg[site] = rowMajor[lat.toRowMajor(site)];
+    }
+    return cfg;
+}
+
 #endif  // ndef ISING_CONFIGURATION_HPP
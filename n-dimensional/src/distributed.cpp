@@ -0,0 +1,627 @@
+#include "distributed.hpp"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include "ndebug.hpp"
+#include "profile.hpp"
+#include "rng.hpp"
+
+namespace {
+    /// Throw if an MPI function did not succeed.
+    void checkMPI(int const status, char const * const what)
+    {
+        if (status != MPI_SUCCESS) {
+            throw std::runtime_error(std::string{"MPI error in "} + what);
+        }
+    }
+
+    int toInt(std::size_t const n)
+    {
+        if (n > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+            throw std::overflow_error("Message is too large for MPI");
+        }
+        return static_cast<int>(n);
+    }
+
+    /// Return the number of sites of a block with given shape.
+    Index siteCount(MultiIndex const &shape)
+    {
+        return std::accumulate(std::begin(shape), std::end(shape), 1_i,
+                               [](Index const n, Index const extent) { return n*extent; });
+    }
+
+    /// Return row-major strides of a shape.
+    std::vector<std::size_t> strides(MultiIndex const &shape)
+    {
+        std::vector<std::size_t> result(std::size(shape), 1);
+        for (std::size_t d = std::size(shape); d > 1; --d) {
+            result[d-2] = result[d-1] * shape[d-1].get();
+        }
+        return result;
+    }
+
+    /// Return the displacement in one dimension with the smallest absolute value.
+    std::ptrdiff_t signedDisplacement(Index const d, Index const extent) noexcept
+    {
+        auto const x = static_cast<std::ptrdiff_t>(d.get());
+        auto const l = static_cast<std::ptrdiff_t>(extent.get());
+        return 2*x <= l ? x : x - l;
+    }
+
+    /// Call f(paddedStart, length) for every contiguous run of a box of padded coordinates.
+    template <typename F>
+    void forEachRun(MultiIndex const &lower, MultiIndex const &upper,
+                    std::vector<std::size_t> const &paddedStrides, F const &f)
+    {
+        std::size_t const ndim = std::size(lower);
+        std::size_t const length = (upper.back() - lower.back()).get();
+
+        MultiIndex outerShape;
+        for (std::size_t d = 0; d+1 < ndim; ++d) {
+            outerShape.emplace_back(upper[d] - lower[d]);
+        }
+        std::size_t const nruns = std::accumulate(
+            std::begin(outerShape), std::end(outerShape), std::size_t{1},
+            [](std::size_t const n, Index const extent) { return n*extent.get(); });
+
+        MultiIndex outer(ndim-1, 0_i);
+        for (std::size_t run = 0; run < nruns; ++run) {
+            std::size_t start = lower.back().get();
+            for (std::size_t d = 0; d+1 < ndim; ++d) {
+                start += (lower[d] + outer[d]).get() * paddedStrides[d];
+            }
+            f(start, length);
+            if (not std::empty(outer)) {
+                increment(outer, outerShape);
+            }
+        }
+    }
+
+    /// Call f(row, paddedStart, globalStart) for every row along the last dimension of the local block.
+    /**
+     * paddedStart and globalStart are the padded and global index of the site
+     * with local coordinate 0 in the last dimension.
+     */
+    template <typename F>
+    void forEachRow(Decomposition const &decomp, F const &f)
+    {
+        MultiIndex const &shape = decomp.localShape();
+        MultiIndex const rowShape(shape.begin(), shape.end()-1);
+        auto const &paddedStrides = decomp.paddedStrides();
+        auto const globalStrides = strides(decomp.globalShape());
+        std::size_t const nrows = std::accumulate(
+            std::begin(rowShape), std::end(rowShape), std::size_t{1},
+            [](std::size_t const n, Index const extent) { return n*extent.get(); });
+
+        MultiIndex row(std::size(rowShape), 0_i);
+        for (std::size_t r = 0; r < nrows; ++r) {
+            std::size_t paddedStart = decomp.halo().back().get();
+            std::uint64_t globalStart = decomp.offset().back().get();
+            for (std::size_t d = 0; d < std::size(rowShape); ++d) {
+                paddedStart += (row[d] + decomp.halo()[d]).get() * paddedStrides[d];
+                globalStart += (row[d] + decomp.offset()[d]).get() * globalStrides[d];
+            }
+            f(row, paddedStart, globalStart);
+            if (not std::empty(row)) {
+                increment(row, rowShape);
+            }
+        }
+    }
+
+    /// Sum local integers over all ranks.
+    template <std::size_t N>
+    std::array<std::int64_t, N> allreduce(std::array<std::int64_t, N> local, MPI_Comm const comm)
+    {
+        std::array<std::int64_t, N> global;
+        checkMPI(MPI_Allreduce(local.data(), global.data(), static_cast<int>(N),
+                               MPI_INT64_T, MPI_SUM, comm), "MPI_Allreduce");
+        return global;
+    }
+
+    /// Return the sum of all spins on all ranks.
+    std::int64_t totalSpin(DistributedConfiguration const &cfg, Decomposition const &decomp)
+    {
+        std::int64_t sum = 0;
+        std::size_t const length = decomp.localShape().back().get();
+        forEachRow(decomp, [&](MultiIndex const &, std::size_t const start, std::uint64_t) {
+            for (std::size_t x = 0; x < length; ++x) {
+                sum += cfg.spins[start+x];
+            }
+        });
+        return allreduce(std::array{sum}, decomp.comm())[0];
+    }
+
+    /// Which sites of a sublattice to update.
+    enum class Part
+    {
+        BOUNDARY,  ///< Sites in the outermost layer of the local block.
+        INTERIOR   ///< All other sites, they have no neighbours in the halo.
+    };
+
+    /// Local sums over accepted flips from which changes of observables are computed.
+    struct FlipSums
+    {
+        /// Sum of spin times sum of neighbours before the flip.
+        std::int64_t coupling = 0;
+        /// Sum of spins before the flip.
+        std::int64_t magnetisation = 0;
+        std::int64_t naccept = 0;
+    };
+
+    /// Metropolis updates of one part of a sublattice.
+    void updateSublattice(DistributedConfiguration &cfg, Decomposition const &decomp,
+                          BoltzmannTable const &boltzmann, SiteRng const &rng,
+                          std::size_t const colour, Part const part, FlipSums &sums)
+    {
+        MultiIndex const &shape = decomp.localShape();
+        std::vector<std::ptrdiff_t> neighbourOffsets;
+        for (std::size_t const stride : decomp.paddedStrides()) {
+            neighbourOffsets.emplace_back(static_cast<std::ptrdiff_t>(stride));
+        }
+        std::int8_t * const spins = cfg.spins.data();
+
+        auto const updateSite = [&](std::size_t const site, std::uint64_t const globalSite) {
+            int const spin = spins[site];
+            int nsum = 0;
+            for (std::ptrdiff_t const offset : neighbourOffsets) {
+                nsum += spins[static_cast<std::ptrdiff_t>(site)+offset]
+                    + spins[static_cast<std::ptrdiff_t>(site)-offset];
+            }
+            double const acceptance = boltzmann.acceptance(boltzmann.index(Spin{spin}, Spin{nsum}));
+            if (acceptance >= 1.0 or acceptance > rng.uniform(globalSite)) {
+                spins[site] = static_cast<std::int8_t>(-spin);
+                sums.coupling += spin*nsum;
+                sums.magnetisation += spin;
+                ++sums.naccept;
+            }
+        };
+
+        std::size_t const length = shape.back().get();
+        forEachRow(decomp, [&](MultiIndex const &row, std::size_t const start,
+                               std::uint64_t const globalStart) {
+            std::size_t parity = colour;
+            bool boundaryRow = false;
+            for (std::size_t d = 0; d < std::size(row); ++d) {
+                parity += row[d].get();
+                boundaryRow = boundaryRow or row[d] == 0_i or row[d] == shape[d]-1_i;
+            }
+            std::size_t const first = parity % 2;
+
+            if (part == Part::BOUNDARY) {
+                if (boundaryRow) {
+                    for (std::size_t x = first; x < length; x += 2) {
+                        updateSite(start+x, globalStart+x);
+                    }
+                }
+                else {
+                    // the length is even, so only one end of the row has the right colour
+                    std::size_t const x = first == 0 ? 0 : length-1;
+                    updateSite(start+x, globalStart+x);
+                }
+            }
+            else if (not boundaryRow) {
+                for (std::size_t x = first == 0 ? 2 : 1; x+1 < length; x += 2) {
+                    updateSite(start+x, globalStart+x);
+                }
+            }
+        });
+    }
+
+    /// Measure the correlator for all distances and record it in obs.
+    /**
+     * Halos must be fully up to date.
+     */
+    void measureCorrelator(Observables &obs, DistributedConfiguration const &cfg,
+                           Decomposition const &decomp)
+    {
+        auto const &displacements = decomp.displacements();
+        std::vector<long long> local(std::size(displacements), 0), global(std::size(displacements));
+
+        std::size_t const length = decomp.localShape().back().get();
+        std::int8_t const * const spins = cfg.spins.data();
+        forEachRow(decomp, [&](MultiIndex const &, std::size_t const start, std::uint64_t) {
+            for (std::size_t sqdi = 0; sqdi < std::size(displacements); ++sqdi) {
+                long long aux = 0;
+                for (std::size_t x = 0; x < length; ++x) {
+                    auto const site = static_cast<std::ptrdiff_t>(start+x);
+                    int siteSum = 0;
+                    for (std::ptrdiff_t const offset : displacements[sqdi]) {
+                        siteSum += spins[site+offset];
+                    }
+                    aux += spins[site]*siteSum;
+                }
+                local[sqdi] += aux;
+            }
+        });
+        checkMPI(MPI_Allreduce(local.data(), global.data(), toInt(std::size(local)),
+                               MPI_LONG_LONG, MPI_SUM, decomp.comm()), "MPI_Allreduce");
+
+        double const volume = static_cast<double>(siteCount(decomp.globalShape()).get());
+        for (std::size_t sqdi = 0; sqdi < std::size(displacements); ++sqdi) {
+            double const npairs = volume * static_cast<double>(std::size(displacements[sqdi]));
+            recordCorrelator(obs, sqdi, static_cast<double>(global[sqdi])/npairs);
+        }
+    }
+}
+
+
+Decomposition::Decomposition(Lattice const &lat, MultiIndex const &grid, MPI_Comm const comm)
+    : comm_{MPI_COMM_NULL}, rank_{0}, globalShape_{lat.shape()}, localShape_{},
+      offset_{}, halo_{}, paddedShape_{}, paddedStrides_{}, neighbourRanks_{}, displacements_{}
+{
+    std::size_t const ndim = std::size(globalShape_);
+    if (std::size(grid) != ndim) {
+        throw std::invalid_argument("Rank grid must have one entry per lattice dimension");
+    }
+    int nranks;
+    checkMPI(MPI_Comm_size(comm, &nranks), "MPI_Comm_size");
+    if (siteCount(grid).get() != static_cast<std::size_t>(nranks)) {
+        throw std::invalid_argument("Number of ranks does not match the rank grid");
+    }
+
+    std::vector<int> dims, periods(ndim, 1);
+    for (std::size_t d = 0; d < ndim; ++d) {
+        if (grid[d] == 0_i or globalShape_[d].get() % (2*grid[d].get()) != 0) {
+            throw std::invalid_argument("Lattice extents must be even multiples of the rank grid");
+        }
+        dims.emplace_back(toInt(grid[d].get()));
+    }
+    // no reordering so that ranks in comm and comm_ agree
+    checkMPI(MPI_Cart_create(comm, toInt(ndim), dims.data(), periods.data(), 0, &comm_),
+             "MPI_Cart_create");
+    checkMPI(MPI_Comm_rank(comm_, &rank_), "MPI_Comm_rank");
+    std::vector<int> coords(ndim);
+    checkMPI(MPI_Cart_coords(comm_, rank_, toInt(ndim), coords.data()), "MPI_Cart_coords");
+
+    for (std::size_t d = 0; d < ndim; ++d) {
+        localShape_.emplace_back(globalShape_[d] / grid[d]);
+        offset_.emplace_back(localShape_[d] * Index{static_cast<std::size_t>(coords[d])});
+        int low, high;
+        checkMPI(MPI_Cart_shift(comm_, toInt(d), 1, &low, &high), "MPI_Cart_shift");
+        neighbourRanks_.emplace_back(low, high);
+    }
+
+    // halos must hold the nearest neighbours and all correlator displacements
+    halo_.assign(ndim, 1_i);
+    for (int const sqd : lat.sqDistances()) {
+        for (MultiIndex const &displacement : lat.displacementsWithSqDistance(sqd)) {
+            for (std::size_t d = 0; d < ndim; ++d) {
+                auto const width = std::abs(signedDisplacement(displacement[d], globalShape_[d]));
+                halo_[d] = std::max(halo_[d], Index{static_cast<std::size_t>(width)});
+            }
+        }
+    }
+    for (std::size_t d = 0; d < ndim; ++d) {
+        if (halo_[d] > localShape_[d]) {
+            MPI_Comm_free(&comm_);
+            throw std::invalid_argument("Correlator distances are larger than the local lattice, "
+                                        "reduce max_dist or use fewer ranks");
+        }
+        paddedShape_.emplace_back(localShape_[d] + 2_i*halo_[d]);
+    }
+    paddedStrides_ = strides(paddedShape_);
+
+    for (int const sqd : lat.sqDistances()) {
+        auto &offsets = displacements_.emplace_back();
+        for (MultiIndex const &displacement : lat.displacementsWithSqDistance(sqd)) {
+            std::ptrdiff_t offset = 0;
+            for (std::size_t d = 0; d < ndim; ++d) {
+                offset += signedDisplacement(displacement[d], globalShape_[d])
+                    * static_cast<std::ptrdiff_t>(paddedStrides_[d]);
+            }
+            offsets.emplace_back(offset);
+        }
+    }
+}
+
+Decomposition::~Decomposition()
+{
+    if (comm_ != MPI_COMM_NULL) {
+        MPI_Comm_free(&comm_);
+    }
+}
+
+
+HaloExchange::HaloExchange(Decomposition const &decomp)
+    : decomp_{decomp}, transfers_(2*std::size(decomp.localShape())),
+      requests_{}, active_{}
+{ }
+
+void HaloExchange::post(DistributedConfiguration const &cfg, std::size_t const dim,
+                        std::size_t const width, bool const corners)
+{
+    MultiIndex const &shape = decomp_.localShape();
+    MultiIndex const &halo = decomp_.halo();
+    Index const w{width};
+
+    // all other dimensions cover the local block or, if corners are needed,
+    // also the halos of dimensions that have already been exchanged
+    MultiIndex lower, upper;
+    for (std::size_t d = 0; d < std::size(shape); ++d) {
+        bool const full = corners and d < dim;
+        lower.emplace_back(full ? 0_i : halo[d]);
+        upper.emplace_back(full ? shape[d] + 2_i*halo[d] : halo[d] + shape[d]);
+    }
+
+    auto const [lowRank, highRank] = decomp_.neighbourRanks(dim);
+    // direction 0 sends the lowest layers down and receives into the upper halo,
+    // direction 1 sends the highest layers up and receives into the lower halo
+    for (std::size_t direction = 0; direction < 2; ++direction) {
+        Box sendBox{lower, upper};
+        Transfer &transfer = transfers_[2*dim + direction];
+        transfer.recvBox = Box{lower, upper};
+        if (direction == 0) {
+            sendBox.lower[dim] = halo[dim];
+            transfer.recvBox.lower[dim] = halo[dim] + shape[dim];
+        }
+        else {
+            sendBox.lower[dim] = halo[dim] + shape[dim] - w;
+            transfer.recvBox.lower[dim] = halo[dim] - w;
+        }
+        sendBox.upper[dim] = sendBox.lower[dim] + w;
+        transfer.recvBox.upper[dim] = transfer.recvBox.lower[dim] + w;
+
+        transfer.sendBuffer.clear();
+        forEachRun(sendBox.lower, sendBox.upper, decomp_.paddedStrides(),
+                   [&](std::size_t const start, std::size_t const length) {
+                       auto const first = cfg.spins.begin() + static_cast<std::ptrdiff_t>(start);
+                       transfer.sendBuffer.insert(transfer.sendBuffer.end(),
+                                                  first, first + static_cast<std::ptrdiff_t>(length));
+                   });
+        transfer.recvBuffer.resize(std::size(transfer.sendBuffer));
+
+        int const tag = toInt(2*dim + direction);
+        int const count = toInt(std::size(transfer.sendBuffer));
+        int const dest = direction == 0 ? lowRank : highRank;
+        int const source = direction == 0 ? highRank : lowRank;
+        checkMPI(MPI_Irecv(transfer.recvBuffer.data(), count, MPI_INT8_T, source, tag,
+                           decomp_.comm(), &requests_.emplace_back()), "MPI_Irecv");
+        checkMPI(MPI_Isend(transfer.sendBuffer.data(), count, MPI_INT8_T, dest, tag,
+                           decomp_.comm(), &requests_.emplace_back()), "MPI_Isend");
+    }
+    active_.emplace_back(dim);
+}
+
+void HaloExchange::start(DistributedConfiguration const &cfg, std::size_t const width)
+{
+    for (std::size_t dim = 0; dim < std::size(decomp_.localShape()); ++dim) {
+        post(cfg, dim, width, false);
+    }
+}
+
+void HaloExchange::finish(DistributedConfiguration &cfg)
+{
+    checkMPI(MPI_Waitall(toInt(std::size(requests_)), requests_.data(), MPI_STATUSES_IGNORE),
+             "MPI_Waitall");
+    requests_.clear();
+
+    for (std::size_t const dim : active_) {
+        for (std::size_t direction = 0; direction < 2; ++direction) {
+            Transfer const &transfer = transfers_[2*dim + direction];
+            auto next = transfer.recvBuffer.cbegin();
+            forEachRun(transfer.recvBox.lower, transfer.recvBox.upper, decomp_.paddedStrides(),
+                       [&](std::size_t const start, std::size_t const length) {
+                           std::copy(next, next + static_cast<std::ptrdiff_t>(length),
+                                     cfg.spins.begin() + static_cast<std::ptrdiff_t>(start));
+                           next += static_cast<std::ptrdiff_t>(length);
+                       });
+        }
+    }
+    active_.clear();
+}
+
+void HaloExchange::exchangeAll(DistributedConfiguration &cfg)
+{
+    // one dimension after the other such that edges and corners are
+    // forwarded through the halos of earlier dimensions
+    for (std::size_t dim = 0; dim < std::size(decomp_.localShape()); ++dim) {
+        post(cfg, dim, decomp_.halo()[dim].get(), true);
+        finish(cfg);
+    }
+}
+
+
+DistributedConfiguration randomCfg(Decomposition const &decomp, SiteRng const &rng)
+{
+    DistributedConfiguration cfg{std::vector<std::int8_t>(decomp.paddedSize(), 0)};
+    std::size_t const length = decomp.localShape().back().get();
+    forEachRow(decomp, [&](MultiIndex const &, std::size_t const start,
+                           std::uint64_t const globalStart) {
+        for (std::size_t x = 0; x < length; ++x) {
+            cfg.spins[start+x] = rng.spin(globalStart+x);
+        }
+    });
+    return cfg;
+}
+
+DistributedConfiguration coldCfg(Decomposition const &decomp)
+{
+    return DistributedConfiguration{std::vector<std::int8_t>(decomp.paddedSize(), +1)};
+}
+
+DistributedConfiguration scatter(Configuration const &cfg, Decomposition const &decomp)
+{
+    if (size(cfg) != siteCount(decomp.globalShape())) {
+        throw std::invalid_argument("Configuration does not match the decomposed lattice");
+    }
+
+    DistributedConfiguration local{std::vector<std::int8_t>(decomp.paddedSize(), 0)};
+    std::size_t const length = decomp.localShape().back().get();
+    forEachRow(decomp, [&](MultiIndex const &, std::size_t const start,
+                           std::uint64_t const globalStart) {
+        for (std::size_t x = 0; x < length; ++x) {
+            local.spins[start+x] = static_cast<std::int8_t>(cfg[Index{globalStart+x}].get());
+        }
+    });
+    return local;
+}
+
+std::optional<Configuration> gather(DistributedConfiguration const &cfg,
+                                    Decomposition const &decomp)
+{
+    std::size_t const length = decomp.localShape().back().get();
+    std::vector<std::int8_t> block;
+    forEachRow(decomp, [&](MultiIndex const &, std::size_t const start, std::uint64_t) {
+        auto const first = cfg.spins.begin() + static_cast<std::ptrdiff_t>(start);
+        block.insert(block.end(), first, first + static_cast<std::ptrdiff_t>(length));
+    });
+
+    int nranks;
+    checkMPI(MPI_Comm_size(decomp.comm(), &nranks), "MPI_Comm_size");
+    std::vector<std::int8_t> all(decomp.rank() == 0 ? std::size(block)*static_cast<std::size_t>(nranks) : 0);
+    checkMPI(MPI_Gather(block.data(), toInt(std::size(block)), MPI_INT8_T,
+                        all.data(), toInt(std::size(block)), MPI_INT8_T, 0, decomp.comm()),
+             "MPI_Gather");
+    if (decomp.rank() != 0) {
+        return std::nullopt;
+    }
+
+    std::size_t const ndim = std::size(decomp.globalShape());
+    MultiIndex const &shape = decomp.localShape();
+    MultiIndex const rowShape(shape.begin(), shape.end()-1);
+    auto const globalStrides = strides(decomp.globalShape());
+
+    Configuration result{siteCount(decomp.globalShape())};
+    auto next = all.cbegin();
+    for (int rank = 0; rank < nranks; ++rank) {
+        std::vector<int> coords(ndim);
+        checkMPI(MPI_Cart_coords(decomp.comm(), rank, toInt(ndim), coords.data()), "MPI_Cart_coords");
+
+        // same order of rows as forEachRow on that rank
+        MultiIndex row(ndim-1, 0_i);
+        for (std::size_t r = 0; r < std::size(block)/length; ++r) {
+            std::size_t globalStart = static_cast<std::size_t>(coords.back()) * length;
+            for (std::size_t d = 0; d+1 < ndim; ++d) {
+                globalStart += (static_cast<std::size_t>(coords[d])*shape[d].get()
+                                + row[d].get()) * globalStrides[d];
+            }
+            for (std::size_t x = 0; x < length; ++x, ++next) {
+                result[Index{globalStart+x}] = Spin{*next};
+            }
+            if (not std::empty(row)) {
+                increment(row, rowShape);
+            }
+        }
+    }
+    return result;
+}
+
+namespace {
+    /// Return the coupling sum and the sum of all spins on all ranks, updates halos.
+    std::array<std::int64_t, 2> totalSums(DistributedConfiguration &cfg,
+                                          Decomposition const &decomp)
+    {
+        HaloExchange halos{decomp};
+        halos.start(cfg, 1);
+        halos.finish(cfg);
+
+        // count every link once using neighbours in positive directions
+        std::int64_t coupling = 0, magn = 0;
+        std::size_t const length = decomp.localShape().back().get();
+        auto const &paddedStrides = decomp.paddedStrides();
+        forEachRow(decomp, [&](MultiIndex const &, std::size_t const start, std::uint64_t) {
+            for (std::size_t site = start; site < start+length; ++site) {
+                int nsum = 0;
+                for (std::size_t const stride : paddedStrides) {
+                    nsum += cfg.spins[site+stride];
+                }
+                coupling += cfg.spins[site]*nsum;
+                magn += cfg.spins[site];
+            }
+        });
+
+        return allreduce(std::array{coupling, magn}, decomp.comm());
+    }
+}
+
+std::int64_t couplingSum(DistributedConfiguration &cfg, Decomposition const &decomp)
+{
+    return totalSums(cfg, decomp)[0];
+}
+
+double hamiltonian(DistributedConfiguration &cfg, Parameters const &params,
+                   Decomposition const &decomp)
+{
+    auto const [coupling, magn] = totalSums(cfg, decomp);
+    return energyFromSums(params, coupling, magn);
+}
+
+std::tuple<DistributedConfiguration, double, double, double>
+evolveDistributed(DistributedConfiguration cfg, std::int64_t &coupling, Parameters const &params,
+                  Decomposition const &decomp, SiteRng &rng,
+                  std::size_t const nsweep, Observables * const obs)
+{
+    if constexpr (not ndebug) {
+        if (coupling != couplingSum(cfg, decomp)) {
+            throw std::logic_error("Coupling sum does not match the configuration");
+        }
+    }
+
+    BoltzmannTable const boltzmann{params, Index{std::size(decomp.localShape())}};
+    double const volume = static_cast<double>(siteCount(decomp.globalShape()).get());
+    bool const correlator = obs and not std::empty(decomp.displacements());
+    HaloExchange halos{decomp};
+
+    // the first sublattice needs up to date neighbours
+    halos.start(cfg, 1);
+    halos.finish(cfg);
+    std::int64_t magn = totalSpin(cfg, decomp);
+
+    std::int64_t naccept = 0;
+    FlipSums sums;
+    // add the changes of all ranks to the tracked sums
+    auto const reduce = [&] {
+        auto const [flipCoupling, flipMagn, nacc] = allreduce(
+            std::array{sums.coupling, sums.magnetisation, sums.naccept}, decomp.comm());
+        coupling -= 2*flipCoupling;
+        magn -= 2*flipMagn;
+        naccept += nacc;
+        sums = FlipSums{};
+    };
+
+    for (std::size_t sweep = 0; sweep < nsweep; ++sweep) {
+        for (std::size_t colour = 0; colour < 2; ++colour) {
+            updateSublattice(cfg, decomp, boltzmann, rng, colour, Part::BOUNDARY, sums);
+            halos.start(cfg, 1);
+            updateSublattice(cfg, decomp, boltzmann, rng, colour, Part::INTERIOR, sums);
+            halos.finish(cfg);
+        }
+        ++rng.sweep;
+
+        if (driftCheckDue(sweep)) {
+            reduce();
+            checkDrift(energyFromSums(params, coupling, magn), magn,
+                       hamiltonian(cfg, params, decomp), totalSpin(cfg, decomp),
+                       params, Index{std::size(decomp.localShape())},
+                       siteCount(decomp.globalShape()));
+        }
+        if (obs) {
+            ScopedTimer const timer{Phase::MEASUREMENT};
+            // all ranks agree on which observables are due, so they skip reductions together
+            if (obs->due(obs->intervals.energy) or obs->due(obs->intervals.magnetisation)) {
+                reduce();
+                record(*obs, energyFromSums(params, coupling, magn),
+                       static_cast<double>(magn)/volume);
+            }
+            if (correlator and obs->due(obs->intervals.correlator)) {
+                ScopedTimer const correlatorTimer{Phase::CORRELATOR};
+                halos.exchangeAll(cfg);
+                measureCorrelator(*obs, cfg, decomp);
+            }
+            nextSweep(*obs);
+        }
+    }
+    // changes since the last measurement
+    reduce();
+
+    return std::make_tuple(std::move(cfg), energyFromSums(params, coupling, magn),
+                           static_cast<double>(magn)/volume,
+                           static_cast<double>(naccept)
+                           / static_cast<double>(nsweep)
+                           / volume);
+}
@@ -0,0 +1,259 @@
+#ifndef ISING_DISTRIBUTED_HPP
+#define ISING_DISTRIBUTED_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include <mpi.h>
+
+#include "configuration.hpp"
+#include "ising.hpp"
+#include "lattice.hpp"
+#include "montecarlo.hpp"
+#include "rng.hpp"
+
+/// Split of a periodic lattice into blocks owned by the ranks of an MPI communicator.
+/**
+ * Ranks form a periodic Cartesian grid and rank r owns the block of sites with
+ * global coordinates offset()[d] <= x[d] < offset()[d] + localShape()[d].
+ * Every block is surrounded by halo layers holding copies of the spins of neighbouring
+ * blocks (or of the block itself in dimensions with only one rank).
+ * Blocks are stored in row-major layout including the halos, see paddedShape().
+ *
+ * Halos are wide enough for all correlator displacements of the lattice,
+ * this requires a maximum distance to be set on the lattice.
+ * All local extents must be even such that the checkerboard colour of a site
+ * can be determined from its local coordinates.
+ */
+class Decomposition
+{
+public:
+    /// Create a Cartesian communicator and compute the local block of this rank.
+    /**
+     * \param lat Global lattice. Only its shape and distance map are used, so it should
+     *            use Lattice::NeighbourMode::STENCIL to avoid storage proportional to its size.
+     * \param grid Number of ranks along each dimension, its product must equal the size of comm.
+     * \param comm Communicator of all participating ranks.
+     */
+    Decomposition(Lattice const &lat, MultiIndex const &grid, MPI_Comm comm);
+
+    ~Decomposition();
+
+    Decomposition(Decomposition const &) = delete;
+    Decomposition &operator=(Decomposition const &) = delete;
+
+    /// Return the Cartesian communicator.
+    MPI_Comm comm() const noexcept
+    {
+        return comm_;
+    }
+
+    /// Return the rank of this process in comm().
+    int rank() const noexcept
+    {
+        return rank_;
+    }
+
+    /// Return the shape of the whole lattice.
+    MultiIndex const &globalShape() const noexcept
+    {
+        return globalShape_;
+    }
+
+    /// Return the shape of the block owned by this rank.
+    MultiIndex const &localShape() const noexcept
+    {
+        return localShape_;
+    }
+
+    /// Return the global coordinates of the first site of the local block.
+    MultiIndex const &offset() const noexcept
+    {
+        return offset_;
+    }
+
+    /// Return the width of the halo in every dimension.
+    MultiIndex const &halo() const noexcept
+    {
+        return halo_;
+    }
+
+    /// Return the shape of the local block including halos.
+    MultiIndex const &paddedShape() const noexcept
+    {
+        return paddedShape_;
+    }
+
+    /// Return the distance between neighbouring sites in each dimension of the padded block.
+    std::vector<std::size_t> const &paddedStrides() const noexcept
+    {
+        return paddedStrides_;
+    }
+
+    /// Return the number of sites of the padded block.
+    std::size_t paddedSize() const noexcept
+    {
+        return paddedStrides_.front() * paddedShape_.front().get();
+    }
+
+    /// Return the ranks of the lower and upper neighbour in a dimension.
+    std::pair<int, int> neighbourRanks(std::size_t const dim) const noexcept
+    {
+        return neighbourRanks_[dim];
+    }
+
+    /// Return padded index offsets of correlator displacements for every squared distance.
+    /**
+     * Has the same order as Lattice::sqDistances() of the global lattice.
+     */
+    std::vector<std::vector<std::ptrdiff_t>> const &displacements() const noexcept
+    {
+        return displacements_;
+    }
+
+private:
+    MPI_Comm comm_;
+    int rank_;
+    MultiIndex globalShape_;
+    MultiIndex localShape_;
+    MultiIndex offset_;
+    MultiIndex halo_;
+    MultiIndex paddedShape_;
+    std::vector<std::size_t> paddedStrides_;
+    std::vector<std::pair<int, int>> neighbourRanks_;
+    std::vector<std::vector<std::ptrdiff_t>> displacements_;
+};
+
+
+/// Local block of a spin configuration distributed over the ranks of a Decomposition.
+/**
+ * Stores one byte per spin including halo layers, so halos are only up to date
+ * after a HaloExchange.
+ */
+struct DistributedConfiguration
+{
+    /// Spins of the padded block in row-major layout.
+    std::vector<std::int8_t> spins;
+};
+
+
+/// Exchange of halo layers of a DistributedConfiguration with neighbouring ranks.
+/**
+ * Holds the communication buffers so they are allocated only once.
+ */
+class HaloExchange
+{
+public:
+    explicit HaloExchange(Decomposition const &decomp);
+
+    HaloExchange(HaloExchange const &) = delete;
+    HaloExchange &operator=(HaloExchange const &) = delete;
+
+    /// Start sending the outermost `width` layers of the block in all dimensions.
+    /**
+     * Only faces are exchanged, not edges or corners, which suffices for nearest neighbours.
+     * cfg must not be modified near the boundary until finish() has been called.
+     */
+    void start(DistributedConfiguration const &cfg, std::size_t width);
+
+    /// Wait for the exchange started by start() and fill the halos of cfg.
+    void finish(DistributedConfiguration &cfg);
+
+    /// Fill the halos of cfg completely, including edges and corners.
+    void exchangeAll(DistributedConfiguration &cfg);
+
+private:
+    /// Post messages for one dimension.
+    void post(DistributedConfiguration const &cfg, std::size_t dim, std::size_t width, bool corners);
+
+    /// Range of padded coordinates [lower, upper) in every dimension.
+    struct Box
+    {
+        MultiIndex lower;
+        MultiIndex upper;
+    };
+
+    /// A pair of messages in one direction.
+    struct Transfer
+    {
+        Box recvBox;
+        std::vector<std::int8_t> sendBuffer;
+        std::vector<std::int8_t> recvBuffer;
+    };
+
+    Decomposition const &decomp_;
+    /// Messages from the upper and lower neighbour in every dimension.
+    std::vector<Transfer> transfers_;
+    std::vector<MPI_Request> requests_;
+    /// Dimensions with messages in flight.
+    std::vector<std::size_t> active_;
+};
+
+
+/// Create a configuration with random spins drawn from rng.spin().
+DistributedConfiguration randomCfg(Decomposition const &decomp, SiteRng const &rng);
+
+/// Create a configuration with all spins set to +1.
+DistributedConfiguration coldCfg(Decomposition const &decomp);
+
+/// Copy the local block of a global configuration that is given on all ranks.
+DistributedConfiguration scatter(Configuration const &cfg, Decomposition const &decomp);
+
+/// Collect a distributed configuration on rank 0.
+/**
+ * Collective, returns nullopt on all other ranks.
+ * Needs memory for the whole lattice on rank 0, so is only meant for small lattices.
+ */
+std::optional<Configuration> gather(DistributedConfiguration const &cfg,
+                                    Decomposition const &decomp);
+
+/// Return the coupling sum of the whole lattice, see couplingSum() for Configuration.
+/**
+ * Collective, returns the same value on all ranks. Updates nearest neighbour halos.
+ */
+std::int64_t couplingSum(DistributedConfiguration &cfg, Decomposition const &decomp);
+
+/// Evaluate the Hamiltonian on the whole lattice.
+/**
+ * Collective, returns the same value on all ranks. Updates nearest neighbour halos.
+ */
+double hamiltonian(DistributedConfiguration &cfg, Parameters const &params,
+                   Decomposition const &decomp);
+
+/// Evolve a distributed configuration in Monte-Carlo time using checkerboard sweeps.
+/**
+ * Collective. Each sweep updates both sublattices one after the other.
+ * For each of them, sites in the outermost layer of the local block are updated first,
+ * then the exchange of those layers with neighbouring ranks is started and
+ * the remaining sites are updated while messages are in flight.
+ *
+ * Spin flips are accepted with the Metropolis probability using rng.uniform().
+ * Since those numbers and all reductions are independent of the decomposition,
+ * the chain is the same for any number of ranks.
+ *
+ * \param cfg Starting configuration, its halos need not be up to date.
+ * \param coupling Coupling sum of cfg, must be the same on all ranks.
+ *                 Updated to that of the final configuration, see evolve().
+ * \param params Physical parameters of the ensemble.
+ * \param decomp Decomposition cfg is distributed with.
+ * \param rng Random numbers, rng.sweep is incremented by nsweep.
+ * \param nsweep Number of sweeps to perform.
+ * \param obs Storage for measuring observables, must be given on all ranks or none.
+ *            Can be nullptr in which case no measurements are performed.
+ *            Measurements are reduced over all ranks and recorded on all of them.
+ *
+ * \returns Tuple of
+ *   - final configuration
+ *   - final energy
+ *   - final magnetisation per site
+ *   - acceptance rate.
+ */
+std::tuple<DistributedConfiguration, double, double, double>
+evolveDistributed(DistributedConfiguration cfg, std::int64_t &coupling, Parameters const &params,
+                  Decomposition const &decomp, SiteRng &rng,
+                  std::size_t nsweep, Observables *obs);
+
+#endif  // ndef ISING_DISTRIBUTED_HPP
@@ -0,0 +1,198 @@
+#include "fft.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    using Complex = FFT::Complex;
+
+    constexpr double pi = 3.14159265358979323846;
+
+    bool isPow2(size_t const n) noexcept
+    {
+        return n != 0 and (n & (n-1)) == 0;
+    }
+
+    /// Return smallest power of two >= n.
+    size_t nextPow2(size_t const n) noexcept
+    {
+        size_t p = 1;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+    /// Compute exp(-2 pi i j / n) for j < n/2.
+    std::vector<Complex> makeTwiddles(size_t const n)
+    {
+        std::vector<Complex> twiddles(n/2);
+        for (size_t j = 0; j < n/2; ++j) {
+            twiddles[j] = std::polar(1.0, -2.0*pi*static_cast<double>(j)/static_cast<double>(n));
+        }
+        return twiddles;
+    }
+
+    /// In place iterative radix-2 forward FFT of length std::size(twiddles)*2.
+    void fftPow2(Complex * const data, size_t const n, std::vector<Complex> const &twiddles) noexcept
+    {
+        // bit reversal permutation
+        for (size_t i = 1, j = 0; i < n; ++i) {
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) {
+                std::swap(data[i], data[j]);
+            }
+        }
+
+        // butterflies
+        for (size_t len = 2; len <= n; len <<= 1) {
+            size_t const half = len / 2;
+            size_t const step = n / len;
+            for (size_t i = 0; i < n; i += len) {
+                for (size_t k = 0; k < half; ++k) {
+                    Complex const u = data[i+k];
+                    Complex const v = data[i+k+half] * twiddles[k*step];
+                    data[i+k] = u + v;
+                    data[i+k+half] = u - v;
+                }
+            }
+        }
+    }
+
+    /// Compute conjugate of all elements in place.
+    void conjugate(std::vector<Complex> &data) noexcept
+    {
+        for (auto &x : data) {
+            x = std::conj(x);
+        }
+    }
+}
+
+FFT::Plan1D::Plan1D(size_t const n)
+    : length{n},
+      padded{isPow2(n) ? n : nextPow2(2*n-1)},
+      twiddles{makeTwiddles(padded)},
+      chirp{},
+      kernel{}
+{
+    if (isPow2(n)) {
+        return;
+    }
+
+    // chirp w_j = exp(-pi i j^2 / n), j^2 is reduced mod 2n to retain precision
+    chirp.resize(n);
+    for (size_t j = 0; j < n; ++j) {
+        size_t const jsq = (j*j) % (2*n);
+        chirp[j] = std::polar(1.0, -pi*static_cast<double>(jsq)/static_cast<double>(n));
+    }
+
+    // kernel b_j = conj(w_|j|) wrapped around to length padded
+    kernel.assign(padded, Complex{0.0, 0.0});
+    kernel[0] = std::conj(chirp[0]);
+    for (size_t j = 1; j < n; ++j) {
+        kernel[j] = std::conj(chirp[j]);
+        kernel[padded-j] = std::conj(chirp[j]);
+    }
+    fftPow2(kernel.data(), padded, twiddles);
+}
+
+FFT::FFT(MultiIndex const &shape)
+    : shape_{shape},
+      size_{std::accumulate(shape.begin(), shape.end(), Index{1},
+                            [](Index const a, Index const b) { return a*b; }).get()},
+      plans_{},
+      line_{},
+      work_{}
+{
+    size_t maxLength = 0, maxPadded = 0;
+    for (Index const extent : shape_) {
+        if (extent == 0_i) {
+            throw std::invalid_argument("FFT requires non-zero lattice extents");
+        }
+        plans_.emplace_back(extent.get());
+        maxLength = std::max(maxLength, plans_.back().length);
+        maxPadded = std::max(maxPadded, plans_.back().padded);
+    }
+    line_.resize(maxLength);
+    work_.resize(maxPadded);
+}
+
+void FFT::forward(std::vector<Complex> &data)
+{
+    transform(data);
+}
+
+void FFT::backward(std::vector<Complex> &data)
+{
+    // backward(x) = conj(forward(conj(x)))
+    conjugate(data);
+    transform(data);
+    conjugate(data);
+}
+
+void FFT::transformLine(Plan1D const &plan)
+{
+    size_t const n = plan.length;
+
+    if (plan.chirp.empty()) {
+        fftPow2(line_.data(), n, plan.twiddles);
+        return;
+    }
+
+    // Bluestein: X_k = w_k sum_x (x_x w_x) conj(w_{k-x}), a convolution of length padded
+    size_t const m = plan.padded;
+    for (size_t j = 0; j < n; ++j) {
+        work_[j] = line_[j] * plan.chirp[j];
+    }
+    std::fill(work_.begin() + static_cast<std::ptrdiff_t>(n),
+              work_.begin() + static_cast<std::ptrdiff_t>(m), Complex{0.0, 0.0});
+
+    fftPow2(work_.data(), m, plan.twiddles);
+    for (size_t j = 0; j < m; ++j) {
+        // conjugate to use the forward transform as an inverse
+        work_[j] = std::conj(work_[j] * plan.kernel[j]);
+    }
+    fftPow2(work_.data(), m, plan.twiddles);
+
+    double const norm = 1.0 / static_cast<double>(m);
+    for (size_t k = 0; k < n; ++k) {
+        line_[k] = std::conj(work_[k]) * norm * plan.chirp[k];
+    }
+}
+
+void FFT::transform(std::vector<Complex> &data)
+{
+    if constexpr (not ndebug) {
+        if (std::size(data) != size_) {
+            throw std::invalid_argument("FFT data does not match the lattice size");
+        }
+    }
+
+    size_t stride = size_;
+    for (auto const &plan : plans_) {
+        size_t const n = plan.length;
+        // distance between consecutive elements of a line in this dimension
+        stride /= n;
+        size_t const block = n*stride;
+
+        for (size_t outer = 0; outer < size_; outer += block) {
+            for (size_t inner = 0; inner < stride; ++inner) {
+                Complex * const base = data.data() + outer + inner;
+                for (size_t j = 0; j < n; ++j) {
+                    line_[j] = base[j*stride];
+                }
+                transformLine(plan);
+                for (size_t j = 0; j < n; ++j) {
+                    base[j*stride] = line_[j];
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef ISING_FFT_HPP
+#define ISING_FFT_HPP
+
+#include <complex>
+#include <vector>
+
+#include "lattice.hpp"
+#include "ndebug.hpp"
+
+/// Multi-dimensional discrete Fourier transform on a periodic lattice.
+/**
+ * Transforms data in row-major layout dimension by dimension.
+ * Extents that are powers of two use an iterative radix-2 FFT,
+ * all others are reduced to a power of two using Bluestein's algorithm.
+ * So each transform costs O(V log V) for any shape.
+ *
+ * Holds scratch buffers, so a single instance must not be used
+ * by multiple threads at the same time.
+ */
+class FFT
+{
+public:
+    using Complex = std::complex<double>;
+
+    /// Set up transforms for a given lattice shape.
+    explicit FFT(MultiIndex const &shape);
+
+    /// Compute X_k = sum_x x_x exp(-2 pi i k.x / L) in place.
+    void forward(std::vector<Complex> &data);
+
+    /// Compute x_x = sum_k X_k exp(+2 pi i k.x / L) in place.
+    /**
+     * Not normalised, backward(forward(x)) = V x.
+     */
+    void backward(std::vector<Complex> &data);
+
+private:
+    /// Precomputed data for transforms of a single length.
+    struct Plan1D
+    {
+        /// Length of the transform.
+        size_t length;
+        /// Length of the internal power of two FFT, equal to length if that is a power of two.
+        size_t padded;
+        /// exp(-2 pi i j / padded) for j < padded/2.
+        std::vector<Complex> twiddles;
+        /// Bluestein chirp exp(-pi i j^2 / length) for j < length, empty for powers of two.
+        std::vector<Complex> chirp;
+        /// Transform of the conjugate chirp kernel, empty for powers of two.
+        std::vector<Complex> kernel;
+
+        explicit Plan1D(size_t n);
+    };
+
+    /// Apply a forward transform to one line of data.
+    void transformLine(Plan1D const &plan);
+
+    /// Apply forward transforms along all dimensions.
+    void transform(std::vector<Complex> &data);
+
+    MultiIndex const shape_;
+    size_t const size_;
+    std::vector<Plan1D> plans_;
+    /// Scratch space for a single line of data.
+    std::vector<Complex> line_;
+    /// Scratch space for Bluestein's algorithm.
+    std::vector<Complex> work_;
+};
+
+#endif  // ndef ISING_FFT_HPP
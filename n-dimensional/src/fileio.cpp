@@ -1,10 +1,18 @@
 #include "fileio.hpp"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <string_view>
+#include <thread>
 
 namespace {
     /// Load parameters as individual arrays.
@@ -46,6 +54,20 @@ namespace {
         vec.resize(desired, vec.front());
     }
 
+    /// Load the number of sweeps between measurements from node[name + "_interval"], default 1.
+    /**
+     * \param enabled If false, the observable is never measured and 0 is returned.
+     */
+    size_t loadInterval(YAML::Node const &node, std::string const &name, bool const enabled)
+    {
+        auto const &intervalNode = node[name + "_interval"];
+        size_t const interval = intervalNode ? intervalNode.as<size_t>() : 1;
+        if (interval == 0) {
+            throw std::invalid_argument("Input param '" + name + "_interval' must be positive");
+        }
+        return enabled ? interval : 0;
+    }
+
     /// Return the output file name for given ensemble number.
     fs::path outFname(size_t const ensemble, char const extension[]=".dat")
     {
@@ -109,6 +131,235 @@ namespace {
             ofs << correlator.correlator[i] << '\n';
         }
     }
+
+    /// Return the smallest nonzero momentum 2 pi / shape[d] along each dimension d.
+    std::vector<double> smallestMomenta(Lattice const &lat)
+    {
+        constexpr double pi = 3.14159265358979323846;
+        std::vector<double> momenta;
+        for (Index const extent : lat.shape()) {
+            momenta.emplace_back(2.0 * pi / static_cast<double>(extent.get()));
+        }
+        return momenta;
+    }
+
+    /// Write Fourier modes to file, one line per dimension.
+    void writeFourierModes(fs::path const &fname, Observables const &obs,
+                           Parameters const &params, Lattice const &lat)
+    {
+        auto ofs = writeMetadata(fname, params, lat);
+        ofs << "# momenta=[" << smallestMomenta(lat) << "]\n";
+        for (auto const &modes : obs.fourierModes) {
+            ofs << modes << '\n';
+        }
+    }
+
+    constexpr char histogramFormatPrefix[] = "# format=histogram version=1";
+
+    /// Write a histogram to file, see readHistogram.
+    void writeHistogram(fs::path const &fname, JointHistogram const &histogram,
+                        Parameters const &params, Lattice const &lat)
+    {
+        auto ofs = writeMetadata(fname, params, lat);
+        ofs << std::setprecision(std::numeric_limits<double>::max_digits10)
+            << histogramFormatPrefix << " J=" << params.JT << " h=" << params.hT << '\n'
+            << "# columns=[coupling, spin_sum, count]\n";
+        for (auto const &[key, count] : histogram.counts()) {
+            ofs << key.first << ", " << key.second << ", " << count << '\n';
+        }
+    }
+
+    /// Write one row of running statistics.
+    void writeStatsRow(std::ostream &os, std::string const &name,
+                       BinningAccumulator const &acc)
+    {
+        os << name << ", " << acc.mean() << ", " << acc.error() << ", "
+           << acc.tauInt() << ", " << acc.count() << '\n';
+    }
+
+    /// Write running statistics of all observables to file.
+    void writeStats(fs::path const &fname, Observables const &obs,
+                    Parameters const &params, Lattice const &lat)
+    {
+        auto ofs = writeMetadata(fname, params, lat);
+        ofs << "# columns=[name, mean, error, tau_int, nmeas]\n"
+            << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+        auto const &summary = obs.summary.value();
+        writeStatsRow(ofs, "energy", summary.energy);
+        writeStatsRow(ofs, "magnetisation", summary.magnetisation);
+        for (size_t i = 0; i < std::size(obs.corr.sqDistances); ++i) {
+            std::ostringstream name;
+            name << "correlator[" << std::sqrt(static_cast<double>(obs.corr.sqDistances[i])) << ']';
+            writeStatsRow(ofs, name.str(), summary.correlator[i]);
+        }
+        if (obs.intervals.fourierModes != 0) {
+            for (size_t d = 0; d < std::size(summary.fourierModes); ++d) {
+                writeStatsRow(ofs, "fourier_mode[" + std::to_string(d) + ']',
+                              summary.fourierModes[d]);
+            }
+        }
+    }
+
+    /// Write a configuration of any storage type in row-major layout.
+    template <typename Cfg>
+    void writeCfg(fs::path const &outdir, size_t const ensemble,
+                  Cfg const &cfg,
+                  Parameters const &params, Lattice const &lat)
+    {
+        fs::path const outfile = outdir/outFname(ensemble, ".cfg");
+        std::ofstream ofs;
+        if (not fs::exists(outfile)) {
+            ofs = writeMetadata(outfile, params, lat);
+        }
+        else {
+            ofs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+            ofs.open(outfile, std::ios::app);
+        }
+
+        for (Index i = 0_i; i < size(cfg)-1_i; ++i) {
+            ofs << cfg[i].get() << ", ";
+        }
+        ofs << cfg[size(cfg)-1_i].get() << '\n';
+    }
+
+    /// Second line of binary files, identifies the format.
+    constexpr char binaryFormatLine[] = "# format=binary version=1\n";
+
+    /// Size of the header of chunks in binary files in bytes.
+    constexpr std::size_t chunkHeaderSize = 32;
+
+    /// Append an integer to a buffer in little endian byte order.
+    void appendLittleEndian(std::vector<char> &buffer, std::uint64_t value, std::size_t const nbytes)
+    {
+        for (std::size_t i = 0; i < nbytes; ++i) {
+            buffer.push_back(static_cast<char>(value & 0xff));
+            value >>= 8;
+        }
+    }
+
+    /// Append a chunk header to a buffer.
+    void appendChunkHeader(std::vector<char> &buffer, std::string_view const name,
+                           std::string_view const dtype, std::uint64_t const count)
+    {
+        std::size_t const start = std::size(buffer);
+        buffer.resize(start + chunkHeaderSize, '\0');
+        std::memcpy(buffer.data()+start, name.data(), std::min(std::size(name), std::size_t{16}));
+        std::memcpy(buffer.data()+start+16, dtype.data(), std::min(std::size(dtype), std::size_t{4}));
+        buffer.resize(start + 24);
+        appendLittleEndian(buffer, count, 8);
+    }
+
+    /// Append a chunk of doubles to a buffer.
+    void appendChunk(std::vector<char> &buffer, std::string_view const name,
+                     std::vector<double> const &data)
+    {
+        appendChunkHeader(buffer, name, "f8", std::size(data));
+        for (double const x : data) {
+            std::uint64_t bits;
+            std::memcpy(&bits, &x, sizeof bits);
+            appendLittleEndian(buffer, bits, 8);
+        }
+    }
+
+    /// Set bit i%8 of byte i/8 of out for every spin i that is +1, out must be zeroed.
+    template <typename Cfg>
+    void packSpins(char * const out, Cfg const &cfg)
+    {
+        for (Index i = 0_i; i < size(cfg); ++i) {
+            if (cfg[i] == Spin{+1}) {
+                out[i.get()/8] = static_cast<char>(
+                    static_cast<unsigned char>(out[i.get()/8]) | (1u << (i.get()%8)));
+            }
+        }
+    }
+
+    /// Append a chunk of spins of a configuration of any storage type to a buffer.
+    template <typename Cfg>
+    void appendSpinChunk(std::vector<char> &buffer, std::string_view const name,
+                         Cfg const &cfg)
+    {
+        std::size_t const nspins = size(cfg).get();
+        appendChunkHeader(buffer, name, "bits", nspins);
+
+        std::size_t const start = std::size(buffer);
+        buffer.resize(start + (nspins+7)/8, '\0');
+        packSpins(buffer.data()+start, cfg);
+    }
+
+    /// Start of the second line of record files, followed by the record size.
+    constexpr char recordsFormatPrefix[] = "# format=records version=1 record_size=";
+
+    /// The header of record files is padded to a multiple of this many bytes.
+    constexpr std::size_t recordsHeaderAlignment = 64;
+
+    /// Size in bytes of the record of one configuration with nspins spins.
+    constexpr std::size_t recordSize(std::size_t const nspins) noexcept
+    {
+        return (nspins+63)/64*8;
+    }
+
+    /// Open a new binary file and write the metadata.
+    std::ofstream openBinary(fs::path const &fname, Parameters const &params,
+                             Lattice const &lat)
+    {
+        std::ofstream ofs;
+        ofs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        ofs.open(fname, std::ios::trunc | std::ios::binary);
+        ofs = writeMetadata(std::move(ofs), params, lat);
+        ofs << binaryFormatLine;
+        return ofs;
+    }
+
+    /// Open a new record file and write the header.
+    std::ofstream openRecords(fs::path const &fname, Parameters const &params,
+                              Lattice const &lat)
+    {
+        std::ofstream ofs;
+        ofs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        ofs.open(fname, std::ios::trunc | std::ios::binary);
+        ofs = writeMetadata(std::move(ofs), params, lat);
+        ofs << recordsFormatPrefix << recordSize(size(lat).get());
+
+        // pad with spaces, so the header including the final newline ends at the alignment
+        auto const length = static_cast<std::size_t>(ofs.tellp()) + 1;
+        std::size_t const padded = (length + recordsHeaderAlignment - 1)
+            / recordsHeaderAlignment * recordsHeaderAlignment;
+        ofs << std::string(padded - length, ' ') << '\n';
+        return ofs;
+    }
+
+    /// Extract the shape from the metadata line of an output file.
+    MultiIndex parseShape(std::string const &metadata, fs::path const &fname)
+    {
+        auto const start = metadata.find("shape=[");
+        auto const end = metadata.find(']', start);
+        if (metadata.rfind("# J=", 0) != 0 or start == std::string::npos
+            or end == std::string::npos) {
+            throw std::runtime_error("Invalid metadata in file " + fname.string());
+        }
+
+        MultiIndex shape;
+        std::istringstream iss{metadata.substr(start+7, end-start-7)};
+        std::string extent;
+        while (std::getline(iss, extent, ',')) {
+            shape.emplace_back(std::stoul(extent));
+        }
+        return shape;
+    }
+
+    /// Write binary file with one chunk per vector of doubles.
+    void writeBinary(fs::path const &fname, Parameters const &params, Lattice const &lat,
+                     std::vector<std::pair<std::string_view, std::vector<double> const*>> const &chunks)
+    {
+        std::vector<char> buffer;
+        for (auto const &[name, data] : chunks) {
+            appendChunk(buffer, name, *data);
+        }
+
+        auto ofs = openBinary(fname, params, lat);
+        ofs.write(buffer.data(), static_cast<std::streamsize>(std::size(buffer)));
+    }
 }
 
 namespace YAML {
@@ -129,6 +380,21 @@ namespace YAML {
 
         // base params
         pc.rngSeed = node["RNG"]["seed"].as<unsigned long>();
+        std::string const generatorStr = node["RNG"]["generator"]
+            ? node["RNG"]["generator"].as<std::string>()
+            : std::string{"mt19937"};
+        if (generatorStr == "mt19937") {
+            pc.rngGenerator = Rng::Generator::MT19937;
+        }
+        else if (generatorStr == "xoshiro256++") {
+            pc.rngGenerator = Rng::Generator::XOSHIRO256PP;
+        }
+        else if (generatorStr == "philox4x32") {
+            pc.rngGenerator = Rng::Generator::PHILOX4X32;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'generator'");
+        }
         pc.params = loadParams(node["Parameters"]);
 
         // Lattice
@@ -143,6 +409,42 @@ namespace YAML {
                : ::Lattice::DistanceFn::EUCLIDEAN)
             : ::Lattice::DistanceFn::EUCLIDEAN;
 
+        std::string const neighbourStr = latNode["neighbours"]
+            ? latNode["neighbours"].as<std::string>()
+            : std::string{"stored"};
+        if (neighbourStr == "stored") {
+            pc.lattice.neighbourMode = ::Lattice::NeighbourMode::STORED;
+        }
+        else if (neighbourStr == "stencil") {
+            pc.lattice.neighbourMode = ::Lattice::NeighbourMode::STENCIL;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'neighbours'");
+        }
+
+        std::string const layoutStr = latNode["layout"]
+            ? latNode["layout"].as<std::string>()
+            : std::string{"row-major"};
+        if (layoutStr == "row-major") {
+            pc.lattice.layout = ::Lattice::SiteLayout::ROW_MAJOR;
+        }
+        else if (layoutStr == "blocked") {
+            pc.lattice.layout = ::Lattice::SiteLayout::BLOCKED;
+            if (pc.lattice.neighbourMode != ::Lattice::NeighbourMode::STORED) {
+                throw std::invalid_argument("Blocked layout requires 'neighbours: stored'");
+            }
+            for (Index const extent : pc.lattice.shape) {
+                if (extent.get() % ::Lattice::blockExtent != 0) {
+                    throw std::invalid_argument("Blocked layout requires lattice extents "
+                                                "that are multiples of 4");
+                }
+            }
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'layout'");
+        }
+        bool const blocked = pc.lattice.layout == ::Lattice::SiteLayout::BLOCKED;
+
         // MC
         auto const &mcNode = node["MC"];
 
@@ -153,22 +455,313 @@ namespace YAML {
         else if (startStr == "cold") {
             pc.mc.start = ProgConfig::MC::COLD;
         }
+        else if (startStr.rfind("file:", 0) == 0) {
+            // file:<path>#<n>, the path may contain '#' as well
+            auto const hash = startStr.rfind('#');
+            if (hash == std::string::npos or hash <= 5) {
+                throw std::invalid_argument("Input param 'start' must be of the form 'file:<path>#<n>'");
+            }
+            pc.mc.start = ProgConfig::MC::STORED;
+            pc.mc.startFile = startStr.substr(5, hash-5);
+            std::size_t end;
+            try {
+                pc.mc.startRecord = std::stol(startStr.substr(hash+1), &end);
+            }
+            catch (std::logic_error const &) {
+                end = 0;
+            }
+            if (end == 0 or hash+1+end != std::size(startStr)) {
+                throw std::invalid_argument("Invalid record number in input param 'start'");
+            }
+        }
         else {
             throw std::invalid_argument("Invalid argument to input param 'start'");
         }
 
+        std::string const updateStr = mcNode["update"]
+            ? mcNode["update"].as<std::string>()
+            : std::string{"random"};
+        if (updateStr == "random") {
+            pc.mc.update = ProgConfig::MC::RANDOM;
+        }
+        else if (updateStr == "sequential") {
+            pc.mc.update = ProgConfig::MC::SEQUENTIAL;
+        }
+        else if (updateStr == "checkerboard-sequential") {
+            pc.mc.update = ProgConfig::MC::CHECKERBOARD_SEQUENTIAL;
+        }
+        else if (updateStr == "checkerboard") {
+            pc.mc.update = ProgConfig::MC::CHECKERBOARD;
+        }
+        else if (updateStr == "wolff") {
+            pc.mc.update = ProgConfig::MC::WOLFF;
+        }
+        else if (updateStr == "swendsen-wang") {
+            pc.mc.update = ProgConfig::MC::SWENDSEN_WANG;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'update'");
+        }
+
+        std::string const localUpdateStr = mcNode["local_update"]
+            ? mcNode["local_update"].as<std::string>()
+            : std::string{"metropolis"};
+        if (localUpdateStr == "metropolis") {
+            pc.mc.localUpdate = ::UpdateRule::METROPOLIS;
+        }
+        else if (localUpdateStr == "heat-bath") {
+            pc.mc.localUpdate = ::UpdateRule::HEAT_BATH;
+        }
+        else if (localUpdateStr == "demon") {
+            pc.mc.localUpdate = ::UpdateRule::DEMON;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'local_update'");
+        }
+
+        pc.mc.nthreads = mcNode["nthreads"]
+            ? mcNode["nthreads"].as<size_t>()
+            : std::max(std::thread::hardware_concurrency(), 1u);
+        if (pc.mc.nthreads == 0) {
+            throw std::invalid_argument("Input param 'nthreads' must be positive");
+        }
+
+        std::string const simdStr = mcNode["simd"]
+            ? mcNode["simd"].as<std::string>()
+            : std::string{"auto"};
+        if (simdStr == "auto") {
+            // the SIMD kernel relies on the row-major layout
+            pc.mc.simd = blocked ? std::nullopt : std::optional{detectSimdLevel()};
+        }
+        else if (simdStr == "avx512") {
+            pc.mc.simd = ::SimdLevel::AVX512;
+        }
+        else if (simdStr == "avx2") {
+            pc.mc.simd = ::SimdLevel::AVX2;
+        }
+        else if (simdStr == "scalar") {
+            pc.mc.simd = ::SimdLevel::SCALAR;
+        }
+        else if (simdStr == "off") {
+            pc.mc.simd = std::nullopt;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'simd'");
+        }
+        if (pc.mc.simd and blocked) {
+            throw std::invalid_argument("Input param 'simd' requires 'layout: row-major'");
+        }
+        if (pc.mc.simd and not simdSupported(*pc.mc.simd)) {
+            throw std::invalid_argument("Instruction set requested by input param 'simd' "
+                                        "is not supported by this CPU");
+        }
+
+        std::string const storageStr = mcNode["storage"]
+            ? mcNode["storage"].as<std::string>()
+            : std::string{"plain"};
+        if (storageStr == "plain") {
+            pc.mc.storage = ProgConfig::MC::PLAIN;
+        }
+        else if (storageStr == "packed") {
+            pc.mc.storage = ProgConfig::MC::PACKED;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'storage'");
+        }
+        // packed configurations are only updated by the multi-spin coded checkerboard kernel
+        if (pc.mc.storage == ProgConfig::MC::PACKED
+            and (pc.mc.update != ProgConfig::MC::CHECKERBOARD
+                 or pc.mc.localUpdate != ::UpdateRule::METROPOLIS)) {
+            throw std::invalid_argument("Input param 'storage: packed' requires "
+                                        "'update: checkerboard' and 'local_update: metropolis'");
+        }
+
         pc.mc.nthermInit = mcNode["ntherm_init"].as<size_t>();
         pc.mc.ntherm = loadVector<size_t>(mcNode["ntherm"]);
         pc.mc.nprod = loadVector<size_t>(mcNode["nprod"]);
         checkSizeAndBroadcast(pc.mc.ntherm, std::size(pc.params));
         checkSizeAndBroadcast(pc.mc.nprod, std::size(pc.params));
 
+        pc.mc.tempering = mcNode["tempering"] ? mcNode["tempering"].as<bool>() : false;
+        pc.mc.swapInterval = mcNode["swap_interval"] ? mcNode["swap_interval"].as<size_t>() : 10;
+        if (pc.mc.tempering) {
+            if (pc.mc.swapInterval == 0) {
+                throw std::invalid_argument("Input param 'swap_interval' must be positive");
+            }
+            if (pc.mc.update != ProgConfig::MC::RANDOM or pc.mc.storage != ProgConfig::MC::PLAIN) {
+                throw std::invalid_argument("Replica exchange requires 'update: random' and 'storage: plain'");
+            }
+            if (std::adjacent_find(pc.mc.nprod.begin(), pc.mc.nprod.end(),
+                                   std::not_equal_to<>{}) != pc.mc.nprod.end()) {
+                throw std::invalid_argument("Replica exchange requires the same 'nprod' for all parameters");
+            }
+        }
+
+        if (pc.mc.localUpdate != ::UpdateRule::METROPOLIS) {
+            bool const singleSpin = pc.mc.update == ProgConfig::MC::RANDOM
+                or pc.mc.update == ProgConfig::MC::SEQUENTIAL
+                or pc.mc.update == ProgConfig::MC::CHECKERBOARD_SEQUENTIAL;
+            if (not singleSpin or pc.mc.storage != ProgConfig::MC::PLAIN or pc.mc.tempering) {
+                throw std::invalid_argument("Input param 'local_update' requires 'update: random', "
+                                            "'sequential', or 'checkerboard-sequential', "
+                                            "'storage: plain', and no replica exchange");
+            }
+        }
+
+        pc.mc.checkpointInterval = mcNode["checkpoint_interval"]
+            ? mcNode["checkpoint_interval"].as<size_t>() : 0;
+        if (pc.mc.tempering and pc.mc.checkpointInterval > 0) {
+            throw std::invalid_argument("Checkpoints are not supported with replica exchange");
+        }
+
         // meas
         auto const &measNode = node["Meas"];
         pc.meas.energy = measNode["energy"].as<bool>();
         pc.meas.magnetisation = measNode["magnetisation"].as<bool>();
         pc.meas.correlator = measNode["correlator"].as<bool>();
+        pc.meas.fourierModes = measNode["fourier_modes"]
+            ? measNode["fourier_modes"].as<bool>() : false;
+        pc.meas.histogram = measNode["histogram"] ? measNode["histogram"].as<bool>() : false;
+        pc.meas.intervals = MeasurementIntervals{
+            loadInterval(measNode, "energy", pc.meas.energy),
+            loadInterval(measNode, "magnetisation", pc.meas.magnetisation),
+            loadInterval(measNode, "correlator", pc.meas.correlator),
+            loadInterval(measNode, "fourier_modes", pc.meas.fourierModes),
+            loadInterval(measNode, "histogram", pc.meas.histogram)};
+
+        std::string const corrMethodStr = measNode["correlator_method"]
+            ? measNode["correlator_method"].as<std::string>()
+            : std::string{"pairs"};
+        if (corrMethodStr == "pairs") {
+            pc.meas.correlatorMethod = Observables::Correlator::Method::PAIR_SUM;
+        }
+        else if (corrMethodStr == "fft") {
+            pc.meas.correlatorMethod = Observables::Correlator::Method::FFT;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'correlator_method'");
+        }
+
         pc.meas.writeCfg = measNode["write_cfg"].as<bool>();
+        pc.meas.cfgInterval = loadInterval(measNode, "cfg", pc.meas.writeCfg);
+
+        std::string const formatStr = measNode["format"]
+            ? measNode["format"].as<std::string>()
+            : std::string{"text"};
+        if (formatStr == "text") {
+            pc.meas.format = ProgConfig::Meas::TEXT;
+        }
+        else if (formatStr == "binary") {
+            pc.meas.format = ProgConfig::Meas::BINARY;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'format'");
+        }
+
+        std::string const cfgFormatStr = measNode["cfg_format"]
+            ? measNode["cfg_format"].as<std::string>()
+            : formatStr;
+        if (cfgFormatStr == "text") {
+            pc.meas.cfgFormat = ProgConfig::Meas::TEXT;
+        }
+        else if (cfgFormatStr == "binary") {
+            pc.meas.cfgFormat = ProgConfig::Meas::BINARY;
+        }
+        else if (cfgFormatStr == "records") {
+            pc.meas.cfgFormat = ProgConfig::Meas::RECORDS;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'cfg_format'");
+        }
+
+        pc.meas.async = measNode["async"] ? measNode["async"].as<bool>() : false;
+        pc.meas.bufferSize = measNode["buffer_size"] ? measNode["buffer_size"].as<size_t>() : 2;
+        if (pc.meas.bufferSize == 0) {
+            throw std::invalid_argument("Input param 'buffer_size' must be positive");
+        }
+
+        std::string const backpressureStr = measNode["backpressure"]
+            ? measNode["backpressure"].as<std::string>()
+            : std::string{"block"};
+        if (backpressureStr == "block") {
+            pc.meas.backpressure = Backpressure::BLOCK;
+        }
+        else if (backpressureStr == "skip") {
+            pc.meas.backpressure = Backpressure::SKIP;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'backpressure'");
+        }
+
+        pc.meas.streaming = measNode["streaming"] ? measNode["streaming"].as<bool>() : false;
+
+        pc.mc.ranks = mcNode["ranks"] ? mcNode["ranks"].as<std::vector<Index>>() : MultiIndex{};
+        if (not std::empty(pc.mc.ranks)) {
+            if (std::size(pc.mc.ranks) != std::size(pc.lattice.shape)) {
+                throw std::invalid_argument("Input param 'ranks' must have one entry per dimension");
+            }
+            for (size_t d = 0; d < std::size(pc.mc.ranks); ++d) {
+                if (pc.mc.ranks[d] == 0_i
+                    or pc.lattice.shape[d].get() % (2*pc.mc.ranks[d].get()) != 0) {
+                    throw std::invalid_argument("Lattice extents must be even multiples of input param 'ranks'");
+                }
+            }
+            if (pc.mc.update != ProgConfig::MC::CHECKERBOARD or pc.mc.storage != ProgConfig::MC::PLAIN) {
+                throw std::invalid_argument("Distributed runs require 'update: checkerboard' and 'storage: plain'");
+            }
+            if (pc.mc.tempering or pc.mc.checkpointInterval > 0) {
+                throw std::invalid_argument("Distributed runs do not support replica exchange or checkpoints");
+            }
+            if (pc.meas.writeCfg or pc.meas.async or pc.meas.fourierModes or pc.meas.histogram
+                or (pc.meas.correlator
+                    and pc.meas.correlatorMethod != Observables::Correlator::Method::PAIR_SUM)) {
+                throw std::invalid_argument("Distributed runs do not support 'write_cfg', 'async', "
+                                            "'fourier_modes', 'histogram', "
+                                            "or 'correlator_method: fft'");
+            }
+        }
+
+        std::string const deviceStr = mcNode["device"]
+            ? mcNode["device"].as<std::string>()
+            : std::string{"cpu"};
+        if (deviceStr == "cpu") {
+            pc.mc.device = ProgConfig::MC::CPU;
+        }
+        else if (deviceStr == "gpu") {
+            pc.mc.device = ProgConfig::MC::GPU;
+        }
+        else {
+            throw std::invalid_argument("Invalid argument to input param 'device'");
+        }
+        if (pc.mc.device == ProgConfig::MC::GPU) {
+            if (pc.mc.update != ProgConfig::MC::CHECKERBOARD or pc.mc.storage != ProgConfig::MC::PLAIN) {
+                throw std::invalid_argument("GPU runs require 'update: checkerboard' and 'storage: plain'");
+            }
+            if (pc.mc.checkpointInterval > 0 or not std::empty(pc.mc.ranks)) {
+                throw std::invalid_argument("GPU runs do not support checkpoints or 'ranks'");
+            }
+            if (pc.meas.fourierModes or pc.meas.histogram) {
+                throw std::invalid_argument("GPU runs do not support 'fourier_modes' or 'histogram'");
+            }
+        }
+
+        if (blocked and (pc.mc.storage != ProgConfig::MC::PLAIN
+                         or pc.mc.device != ProgConfig::MC::CPU or not std::empty(pc.mc.ranks))) {
+            throw std::invalid_argument("Blocked layout requires 'storage: plain', "
+                                        "'device: cpu', and no 'ranks'");
+        }
+
+        pc.mc.scanChains = mcNode["scan_chains"] ? mcNode["scan_chains"].as<size_t>() : 1;
+        if (pc.mc.scanChains != 1 and std::size(pc.params) > 1) {
+            if (pc.mc.tempering or pc.mc.checkpointInterval > 0) {
+                throw std::invalid_argument("Input param 'scan_chains' does not support "
+                                            "replica exchange or checkpoints");
+            }
+            if (pc.mc.device != ProgConfig::MC::CPU or not std::empty(pc.mc.ranks)) {
+                throw std::invalid_argument("Input param 'scan_chains' requires 'device: cpu' "
+                                            "and no 'ranks'");
+            }
+        }
 
         return true;
     }
@@ -195,8 +788,44 @@ void prepareOutdir(fs::path const &outdir)
 
 void write(fs::path const &outdir, size_t const ensemble,
            Observables const &obs, Parameters const &params,
-           Lattice const &lat)
+           Lattice const &lat, ProgConfig::Meas::Format const format)
 {
+    if (obs.histogram) {
+        writeHistogram(outdir/outFname(ensemble, ".hist"), *obs.histogram, params, lat);
+    }
+
+    if (obs.summary) {
+        writeStats(outdir/outFname(ensemble, ".stats"), obs, params, lat);
+        return;
+    }
+
+    if (format == ProgConfig::Meas::BINARY) {
+        writeBinary(outdir/outFname(ensemble, ".dat.bin"), params, lat,
+                    {{"energy", &obs.energy}, {"magnetisation", &obs.magnetisation}});
+
+        std::vector<double> distances;
+        for (int const sqd : obs.corr.sqDistances) {
+            distances.emplace_back(std::sqrt(static_cast<double>(sqd)));
+        }
+        std::vector<std::pair<std::string_view, std::vector<double> const*>> chunks{
+            {"distances", &distances}};
+        for (auto const &corr : obs.corr.correlator) {
+            chunks.emplace_back("correlator", &corr);
+        }
+        writeBinary(outdir/outFname(ensemble, ".corr.bin"), params, lat, chunks);
+
+        if (obs.intervals.fourierModes != 0) {
+            std::vector<double> const momenta = smallestMomenta(lat);
+            std::vector<std::pair<std::string_view, std::vector<double> const*>> modeChunks{
+                {"momenta", &momenta}};
+            for (auto const &modes : obs.fourierModes) {
+                modeChunks.emplace_back("fourier_mode", &modes);
+            }
+            writeBinary(outdir/outFname(ensemble, ".modes.bin"), params, lat, modeChunks);
+        }
+        return;
+    }
+
     // write basic observables
     auto ofs = writeMetadata(outdir/outFname(ensemble), params, lat);
     ofs << obs.energy << '\n'
@@ -204,24 +833,199 @@ void write(fs::path const &outdir, size_t const ensemble,
     ofs.close();
 
     writeCorrelator(outdir/outFname(ensemble, ".corr"), obs.corr, params, lat);
+    if (obs.intervals.fourierModes != 0) {
+        writeFourierModes(outdir/outFname(ensemble, ".modes"), obs, params, lat);
+    }
 }
 
 void write(fs::path const &outdir, size_t const ensemble,
            Configuration const &cfg,
            Parameters const &params, Lattice const &lat)
 {
-    fs::path const outfile = outdir/outFname(ensemble, ".cfg");
-    std::ofstream ofs;
-    if (not fs::exists(outfile)) {
-        ofs = writeMetadata(outfile, params, lat);
+    writeCfg(outdir, ensemble, toRowMajor(cfg, lat), params, lat);
+}
+
+void write(fs::path const &outdir, size_t const ensemble,
+           PackedConfiguration const &cfg,
+           Parameters const &params, Lattice const &lat)
+{
+    writeCfg(outdir, ensemble, cfg, params, lat);
+}
+
+namespace {
+    /// Return the extension of configuration files with a given format.
+    char const *cfgExtension(ProgConfig::Meas::Format const format) noexcept
+    {
+        switch (format) {
+        case ProgConfig::Meas::BINARY:
+            return ".cfg.bin";
+        case ProgConfig::Meas::RECORDS:
+            return ".cfg.rec";
+        case ProgConfig::Meas::TEXT:
+            break;
+        }
+        return ".cfg";
     }
-    else {
-        ofs.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        ofs.open(outfile, std::ios::app);
+
+    /// Open a new configuration file and write its header.
+    std::ofstream openCfgFile(fs::path const &fname, Parameters const &params,
+                              Lattice const &lat, ProgConfig::Meas::Format const format)
+    {
+        switch (format) {
+        case ProgConfig::Meas::BINARY:
+            return openBinary(fname, params, lat);
+        case ProgConfig::Meas::RECORDS:
+            return openRecords(fname, params, lat);
+        case ProgConfig::Meas::TEXT:
+            break;
+        }
+        return writeMetadata(fname, params, lat);
+    }
+}
+
+CfgWriter::CfgWriter(fs::path const &outdir, size_t const ensemble,
+                     Parameters const &params, Lattice const &lat,
+                     ProgConfig::Meas::Format const format)
+    : format_{format},
+      ofs_{openCfgFile(outdir/outFname(ensemble, cfgExtension(format)), params, lat, format)},
+      buffer_{}
+{ }
+
+CfgWriter::CfgWriter(fs::path const &outdir, size_t const ensemble, std::uintmax_t const size,
+                     ProgConfig::Meas::Format const format)
+    : format_{format}, ofs_{}, buffer_{}
+{
+    bool const binary = format != ProgConfig::Meas::TEXT;
+    fs::path const fname = outdir/outFname(ensemble, cfgExtension(format));
+    fs::resize_file(fname, size);
+    ofs_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    ofs_.open(fname, binary ? std::ios::app | std::ios::binary : std::ios::app);
+}
+
+std::uintmax_t CfgWriter::flush()
+{
+    ofs_.flush();
+    return static_cast<std::uintmax_t>(ofs_.tellp());
+}
+
+void CfgWriter::write(Configuration const &cfg)
+{
+    writeCfg(cfg);
+}
+
+void CfgWriter::write(PackedConfiguration const &cfg)
+{
+    writeCfg(cfg);
+}
+
+template <typename Cfg>
+void CfgWriter::writeCfg(Cfg const &cfg)
+{
+    if (format_ == ProgConfig::Meas::BINARY) {
+        buffer_.clear();
+        appendSpinChunk(buffer_, "cfg", cfg);
+        ofs_.write(buffer_.data(), static_cast<std::streamsize>(std::size(buffer_)));
+        return;
+    }
+    if (format_ == ProgConfig::Meas::RECORDS) {
+        buffer_.assign(recordSize(size(cfg).get()), '\0');
+        packSpins(buffer_.data(), cfg);
+        ofs_.write(buffer_.data(), static_cast<std::streamsize>(std::size(buffer_)));
+        return;
     }
 
     for (Index i = 0_i; i < size(cfg)-1_i; ++i) {
-        ofs << cfg[i].get() << ", ";
+        ofs_ << cfg[i].get() << ", ";
+    }
+    ofs_ << cfg[size(cfg)-1_i].get() << '\n';
+}
+
+Configuration readCfgRecord(fs::path const &fname, long const record, MultiIndex const &shape)
+{
+    std::ifstream ifs{fname, std::ios::binary};
+    if (not ifs) {
+        throw std::runtime_error("Cannot open configuration file " + fname.string());
+    }
+
+    std::string metadata, format;
+    std::getline(ifs, metadata);
+    std::getline(ifs, format);
+    if (not ifs or format.rfind(recordsFormatPrefix, 0) != 0) {
+        throw std::runtime_error("File " + fname.string() + " is not a configuration record file");
+    }
+    if (parseShape(metadata, fname) != shape) {
+        throw std::runtime_error("Configurations in file " + fname.string()
+                                 + " were written for a different lattice shape");
+    }
+
+    Configuration cfg{std::accumulate(shape.begin(), shape.end(), 1_i,
+                                      [](Index const a, Index const b) { return a*b; })};
+    std::size_t const nbytes = recordSize(size(cfg).get());
+    if (std::stoul(format.substr(std::size(std::string_view{recordsFormatPrefix}))) != nbytes) {
+        throw std::runtime_error("Invalid record size in file " + fname.string());
+    }
+    auto const headerSize = static_cast<std::uintmax_t>(ifs.tellg());
+    auto const nrecords = static_cast<long>((fs::file_size(fname) - headerSize) / nbytes);
+    long const index = record < 0 ? nrecords + record : record;
+    if (index < 0 or index >= nrecords) {
+        throw std::runtime_error("Record " + std::to_string(record) + " out of range in file "
+                                 + fname.string() + " with " + std::to_string(nrecords)
+                                 + " configurations");
+    }
+
+    std::vector<char> buffer(nbytes);
+    ifs.seekg(static_cast<std::streamoff>(headerSize + static_cast<std::uintmax_t>(index)*nbytes));
+    ifs.read(buffer.data(), static_cast<std::streamsize>(nbytes));
+    if (not ifs) {
+        throw std::runtime_error("Cannot read record from file " + fname.string());
+    }
+    for (Index i = 0_i; i < size(cfg); ++i) {
+        unsigned const byte = static_cast<unsigned char>(buffer[i.get()/8]);
+        cfg[i] = (byte >> (i.get()%8)) & 1u ? Spin{+1} : Spin{-1};
+    }
+    return cfg;
+}
+
+HistogramFile readHistogram(fs::path const &fname)
+{
+    std::ifstream ifs{fname};
+    if (not ifs) {
+        throw std::runtime_error("Cannot open histogram file " + fname.string());
+    }
+
+    std::string metadata, format, columns;
+    std::getline(ifs, metadata);
+    std::getline(ifs, format);
+    std::getline(ifs, columns);
+    if (not ifs or format.rfind(histogramFormatPrefix, 0) != 0) {
+        throw std::runtime_error("File " + fname.string() + " is not a histogram file");
+    }
+
+    HistogramFile result{Parameters{0.0, 0.0}, parseShape(metadata, fname), JointHistogram{}};
+    std::istringstream params{format.substr(std::size(std::string_view{histogramFormatPrefix}))};
+    std::string J, h;
+    if (not (params >> J >> h) or J.rfind("J=", 0) != 0 or h.rfind("h=", 0) != 0) {
+        throw std::runtime_error("Invalid parameters in histogram file " + fname.string());
+    }
+    try {
+        result.params = Parameters{std::stod(J.substr(2)), std::stod(h.substr(2))};
+    }
+    catch (std::logic_error const &) {
+        throw std::runtime_error("Invalid parameters in histogram file " + fname.string());
+    }
+
+    std::string line;
+    while (std::getline(ifs, line)) {
+        std::istringstream row{line};
+        std::int64_t coupling, spinSum;
+        std::uint64_t count;
+        char sep1, sep2;
+        if (not (row >> coupling >> sep1 >> spinSum >> sep2 >> count)
+            or sep1 != ',' or sep2 != ',') {
+            throw std::runtime_error("Invalid line '" + line + "' in histogram file "
+                                     + fname.string());
+        }
+        result.histogram.add(coupling, spinSum, count);
     }
-    ofs << cfg[size(cfg)-1_i].get() << '\n';
+    return result;
 }
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <filesystem>
+#include <fstream>
 #include <optional>
 
 #include <yaml-cpp/yaml.h>
@@ -11,6 +12,9 @@
 #include "montecarlo.hpp"
 #include "index.hpp"
 #include "lattice.hpp"
+#include "packedconfiguration.hpp"
+#include "pipeline.hpp"
+#include "simd.hpp"
 
 namespace fs = std::filesystem;
 
@@ -19,6 +23,7 @@ namespace fs = std::filesystem;
 struct ProgConfig
 {
     unsigned long rngSeed;
+    ::Rng::Generator rngGenerator;
     std::vector<Parameters> params;
 
     struct Lattice
@@ -26,15 +31,33 @@ struct ProgConfig
         MultiIndex shape;
         std::optional<double> maxDist;
         ::Lattice::DistanceFn distfn;
+        ::Lattice::NeighbourMode neighbourMode;
+        ::Lattice::SiteLayout layout;
     } lattice;
 
     struct MC
     {
-        enum Start { HOT, COLD };
+        enum Start { HOT, COLD, STORED };
         Start start;
+        fs::path startFile;  // record file to load the initial configuration from if STORED
+        long startRecord;  // index of the configuration in startFile, negative counts from the end
+        enum Update { RANDOM, SEQUENTIAL, CHECKERBOARD_SEQUENTIAL, CHECKERBOARD, WOLFF, SWENDSEN_WANG };
+        Update update;
+        ::UpdateRule localUpdate;  // rule for single spin updates of RANDOM, SEQUENTIAL, CHECKERBOARD_SEQUENTIAL
+        size_t nthreads;  // used by parallel update schemes
+        std::optional<::SimdLevel> simd;  // kernel for plain checkerboard updates, nullopt = site by site
+        enum Storage { PLAIN, PACKED };
+        Storage storage;  // PACKED always uses multi-spin coded checkerboard updates
         size_t nthermInit;
         std::vector<size_t> ntherm;
         std::vector<size_t> nprod;
+        bool tempering;  // run all params concurrently with replica exchange
+        size_t swapInterval;  // number of sweeps between replica swaps
+        size_t checkpointInterval;  // number of production sweeps between checkpoints, 0 = never
+        MultiIndex ranks;  // MPI ranks along each dimension, empty = not distributed
+        enum Device { CPU, GPU };
+        Device device;  // GPU requires plain checkerboard updates
+        size_t scanChains;  // warm start chains of ensembles run concurrently, 0 = one per ensemble
     } mc;
 
     struct Meas
@@ -42,7 +65,19 @@ struct ProgConfig
         bool energy;
         bool magnetisation;
         bool correlator;
+        bool fourierModes;  // |m(k)|^2 at the smallest nonzero momenta
+        bool histogram;  // joint histogram of coupling and spin sums for reweighting
+        ::MeasurementIntervals intervals;  // derived from the above, 0 for disabled observables
+        Observables::Correlator::Method correlatorMethod;
         bool writeCfg;
+        size_t cfgInterval;  // sweeps between written configurations, 0 if not writeCfg
+        enum Format { TEXT, BINARY, RECORDS };
+        Format format;  // output format of observables, TEXT or BINARY
+        Format cfgFormat;  // output format of configurations, defaults to format
+        bool async;  // measure and write in a background thread
+        size_t bufferSize;  // number of configurations buffered for async measurements
+        ::Backpressure backpressure;  // behaviour when the buffer is full
+        bool streaming;  // keep only running statistics instead of the full history
     } meas;
 };
 
@@ -94,16 +129,133 @@ std::vector<Parameters> loadParams(YAML::Node const &node);
 void prepareOutdir(fs::path const &outdir);
 
 /// Write observables to a data file.
+/**
+ * Text output goes to files NNNN.dat and NNNN.corr with comma separated values.
+ * Binary output goes to files NNNN.dat.bin and NNNN.corr.bin, see CfgWriter for the format.
+ * The .dat.bin file holds chunks 'energy' and 'magnetisation', the .corr.bin file
+ * holds chunk 'distances' followed by one chunk 'correlator' per distance.
+ * If Fourier modes are measured, they go to NNNN.modes with a line '# momenta=[...]'
+ * and one row per dimension or to NNNN.modes.bin with chunk 'momenta' followed by
+ * one chunk 'fourier_mode' per dimension.
+ *
+ * If obs holds running statistics (streaming mode), they are written to NNNN.stats
+ * instead, regardless of format. After the metadata line and a line
+ * '# columns=[name, mean, error, tau_int, nmeas]', it has one comma separated row
+ * each for 'energy', 'magnetisation', 'correlator[d]' for every distance d,
+ * and 'fourier_mode[d]' for every dimension d if Fourier modes are measured.
+ *
+ * If obs holds a histogram, it is written to NNNN.hist in all modes and formats, see readHistogram.
+ */
 void write(fs::path const &outdir, size_t ensemble,
            Observables const &obs, Parameters const &params,
-           Lattice const &lat);
+           Lattice const &lat,
+           ProgConfig::Meas::Format format=ProgConfig::Meas::TEXT);
+
+/// Write configurations of one ensemble to a file that is kept open between writes.
+/**
+ * Text output goes to NNNN.cfg with one line of comma separated spins per configuration.
+ * Binary output goes to NNNN.cfg.bin with one chunk 'cfg' per configuration.
+ * Record output goes to NNNN.cfg.rec, see below.
+ *
+ * Binary files start with the same metadata line as text files ('# J=... h=... shape=[...]')
+ * followed by the line '# format=binary version=1'. The rest of the file consists
+ * of chunks, each with a 32 byte header:
+ *   - 16 bytes name, ASCII padded with zeros
+ *   - 4 bytes data type, 'f8' (double), 'i4' (int32), or 'bits', padded with zeros
+ *   - 4 bytes zeros
+ *   - 8 bytes number of elements as little endian unsigned integer
+ * followed by the elements in little endian byte order. For 'bits' elements are spins
+ * in row-major order, spin i is bit i%8 of byte i/8 with set bits meaning +1.
+ *
+ * Record files start with the same metadata line followed by
+ * '# format=records version=1 record_size=R', padded with spaces such that
+ * the header ends with a newline at a multiple of 64 bytes.
+ * Every configuration is then stored in a record of R bytes holding its spins
+ * packed as in 'bits' chunks, padded with zeros to a multiple of 8 bytes.
+ * So configuration n starts at byte header_size + n*R and can be read or
+ * memory mapped without scanning the file, see readCfgRecord.
+ */
+class CfgWriter
+{
+public:
+    /// Open the output file, overwriting it if it exists.
+    CfgWriter(fs::path const &outdir, size_t ensemble,
+              Parameters const &params, Lattice const &lat,
+              ProgConfig::Meas::Format format=ProgConfig::Meas::TEXT);
+
+    /// Re-open an existing output file to continue writing, e.g. after restarting from a checkpoint.
+    /**
+     * Truncates the file to a given number of bytes to discard configurations
+     * written after that point.
+     */
+    CfgWriter(fs::path const &outdir, size_t ensemble, std::uintmax_t size,
+              ProgConfig::Meas::Format format=ProgConfig::Meas::TEXT);
+
+    /// Write all buffered output to the file and return its size in bytes.
+    std::uintmax_t flush();
+
+    /// Append a configuration in row-major order to the file, see toRowMajor().
+    void write(Configuration const &cfg);
+
+    /// Append a packed configuration to the file using the same format as for Configuration.
+    void write(PackedConfiguration const &cfg);
+
+private:
+    template <typename Cfg>
+    void writeCfg(Cfg const &cfg);
+
+    ProgConfig::Meas::Format format_;
+    std::ofstream ofs_;
+    /// Buffer for formatting binary data.
+    std::vector<char> buffer_;
+};
+
+/// Read configuration number record from a record file written by CfgWriter.
+/**
+ * \param fname File with format ProgConfig::Meas::RECORDS.
+ * \param record Index of the configuration in the file, negative values count from the end.
+ * \param shape Expected shape of the lattice.
+ * \returns The configuration in row-major order.
+ * \throws std::runtime_error if the file is not a record file, was written for
+ *         a different shape, or does not contain the requested record.
+ */
+Configuration readCfgRecord(fs::path const &fname, long record, MultiIndex const &shape);
+
+/// Contents of a histogram file.
+struct HistogramFile
+{
+    Parameters params;
+    MultiIndex shape;
+    JointHistogram histogram;
+};
+
+/// Read a histogram written by write().
+/**
+ * Histogram files start with the metadata line followed by
+ * '# format=histogram version=1 J=... h=...' with the parameters at full precision and
+ * '# columns=[coupling, spin_sum, count]'. Every further line holds the comma separated
+ * coupling sum, spin sum, and number of measurements of one pair, see JointHistogram.
+ * \throws std::runtime_error if the file cannot be read or is not a histogram file.
+ */
+HistogramFile readHistogram(fs::path const &fname);
 
 /// Write a configuration to a file.
 /**
+ * Spins are written in row-major order regardless of the layout of lat.
  * Appends the config if the file already exists.
+ * Re-opens the file on every call, use CfgWriter to write many configurations.
  */
 void write(fs::path const &outdir, size_t ensemble,
            Configuration const &cfg,
            Parameters const &params, Lattice const &lat);
 
+/// Write a packed configuration to a file.
+/**
+ * Uses the same format as for Configuration.
+ * Appends the config if the file already exists.
+ */
+void write(fs::path const &outdir, size_t ensemble,
+           PackedConfiguration const &cfg,
+           Parameters const &params, Lattice const &lat);
+
 #endif  // nde ISLE_FILEIO_HPP
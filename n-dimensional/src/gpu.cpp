@@ -0,0 +1,224 @@
+#include "gpu.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "gpubackend.hpp"
+
+namespace {
+    /// Checkerboard updates site by site on the host, used if no device is available.
+    /**
+     * Visits the sites of a colour in increasing order.
+     * The order does not matter since sites of one colour do not interact.
+     */
+    class HostBackend final : public GpuBackend
+    {
+    public:
+        explicit HostBackend(Lattice const &lat)
+            : lat_{lat}, cfg_{size(lat)}, colours_(size(lat).get()),
+              boltzmann_{Parameters{0.0, 0.0}, lat.ndim()}, sums_{}
+        {
+            MultiIndex index(lat.ndim().get(), 0_i);
+            for (Index site = 0_i; site < size(lat); ++site) {
+                Index parity = 0_i;
+                for (Index const x : index) {
+                    parity = parity + x;
+                }
+                colours_[site.get()] = static_cast<unsigned char>(parity.get() % 2);
+                increment(index, lat.shape());
+            }
+        }
+
+        void upload(Configuration const &cfg) override
+        {
+            cfg_ = cfg;
+        }
+
+        Configuration download() const override
+        {
+            return cfg_;
+        }
+
+        void setParameters(BoltzmannTable const &boltzmann) override
+        {
+            boltzmann_ = boltzmann;
+        }
+
+        void sweep(SiteRng const &rng) override
+        {
+            for (unsigned char colour = 0; colour < 2; ++colour) {
+                for (Index site = 0_i; site < size(lat_); ++site) {
+                    if (colours_[site.get()] != colour) {
+                        continue;
+                    }
+                    Spin const spin = cfg_[site];
+                    Spin const nsum = sumOfNeighbours(cfg_, site, lat_);
+                    double const acceptance = boltzmann_.acceptance(boltzmann_.index(spin, nsum));
+                    if (acceptance >= 1.0 or acceptance > rng.uniform(site.get())) {
+                        cfg_[site] = spin*Spin{-1};
+                        sums_.coupling += spin.get()*nsum.get();
+                        sums_.magnetisation += spin.get();
+                        ++sums_.naccept;
+                    }
+                }
+            }
+        }
+
+        GpuCheckerboard::FlipSums takeFlipSums() override
+        {
+            auto const sums = sums_;
+            sums_ = GpuCheckerboard::FlipSums{};
+            return sums;
+        }
+
+        std::int64_t couplingSum() const override
+        {
+            return ::couplingSum(cfg_, lat_);
+        }
+
+        std::int64_t spinSum() const override
+        {
+            std::int64_t sum = 0;
+            for (Spin const spin : cfg_) {
+                sum += spin.get();
+            }
+            return sum;
+        }
+
+        std::vector<double> correlator() const override
+        {
+            MultiIndex const &shape = lat_.shape();
+            std::vector<double> result;
+            for (int const sqd : lat_.sqDistances()) {
+                auto const &displacements = lat_.displacementsWithSqDistance(sqd);
+                long long aux = 0;
+                MultiIndex index(std::size(shape), 0_i);
+                for (Index site = 0_i; site < size(lat_); ++site) {
+                    Spin siteSum = Spin{0};
+                    for (auto const &displacement : displacements) {
+                        siteSum = siteSum + cfg_[displacedIndex(index, displacement, shape)];
+                    }
+                    aux += static_cast<long long>(cfg_[site]*siteSum);
+                    increment(index, shape);
+                }
+                double const npairs = static_cast<double>(size(lat_).get())
+                    * static_cast<double>(std::size(displacements));
+                result.emplace_back(static_cast<double>(aux) / npairs);
+            }
+            return result;
+        }
+
+    private:
+        Lattice const &lat_;
+        Configuration cfg_;
+        /// Checkerboard colour of every site.
+        std::vector<unsigned char> colours_;
+        BoltzmannTable boltzmann_;
+        GpuCheckerboard::FlipSums sums_;
+    };
+}
+
+
+bool gpuAvailable() noexcept
+{
+    return false;
+}
+
+
+GpuCheckerboard::GpuCheckerboard(Lattice const &lat, std::uint64_t const seed)
+    : lat_{lat}, rng_{seed, 0}, onDevice_{false}, backend_{}
+{
+    MultiIndex const &shape = lat.shape();
+    if (std::size(shape) > maxDim) {
+        throw std::invalid_argument("GPU backend supports at most "
+                                    + std::to_string(maxDim) + " dimensions");
+    }
+    for (Index const extent : shape) {
+        if (extent.get() % 2 != 0) {
+            throw std::invalid_argument("GPU checkerboard updates require even lattice extents");
+        }
+    }
+    if (lat.layout() != Lattice::SiteLayout::ROW_MAJOR) {
+        throw std::invalid_argument("GPU checkerboard updates require the row-major layout");
+    }
+
+    backend_ = std::make_unique<HostBackend>(lat);
+}
+
+GpuCheckerboard::~GpuCheckerboard() = default;
+
+bool GpuCheckerboard::onDevice() const noexcept
+{
+    return onDevice_;
+}
+
+void GpuCheckerboard::upload(Configuration const &cfg)
+{
+    backend_->upload(cfg);
+}
+
+Configuration GpuCheckerboard::download() const
+{
+    return backend_->download();
+}
+
+void GpuCheckerboard::setParameters(Parameters const &params)
+{
+    backend_->setParameters(BoltzmannTable{params, lat_.ndim()});
+}
+
+void GpuCheckerboard::sweep()
+{
+    backend_->sweep(rng_);
+    ++rng_.sweep;
+}
+
+GpuCheckerboard::FlipSums GpuCheckerboard::takeFlipSums()
+{
+    return backend_->takeFlipSums();
+}
+
+std::int64_t GpuCheckerboard::couplingSum() const
+{
+    return backend_->couplingSum();
+}
+
+double GpuCheckerboard::hamiltonian(Parameters const &params) const
+{
+    return energyFromSums(params, backend_->couplingSum(), backend_->spinSum());
+}
+
+std::int64_t GpuCheckerboard::spinSum() const
+{
+    return backend_->spinSum();
+}
+
+std::vector<double> GpuCheckerboard::correlator() const
+{
+    return backend_->correlator();
+}
+
+std::uint64_t GpuCheckerboard::nsweep() const noexcept
+{
+    return rng_.sweep;
+}
+
+Index GpuCheckerboard::ndim() const noexcept
+{
+    return lat_.ndim();
+}
+
+Lattice const &GpuCheckerboard::lattice() const noexcept
+{
+    return lat_;
+}
+
+
+std::tuple<Configuration, double, double, double>
+evolveGpu(Configuration cfg, std::int64_t &coupling, Parameters const &params,
+          GpuCheckerboard &gpu, std::size_t const nsweep, Observables * const obs,
+          std::vector<Measurement> const &extraMeas)
+{
+    auto meas = asMeasurementSet(extraMeas);
+    return evolveGpu(std::move(cfg), coupling, params, gpu, nsweep, obs, meas);
+}
@@ -0,0 +1,228 @@
+#ifndef ISING_GPU_HPP
+#define ISING_GPU_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "configuration.hpp"
+#include "ising.hpp"
+#include "lattice.hpp"
+#include "measurements.hpp"
+#include "montecarlo.hpp"
+#include "profile.hpp"
+#include "rng.hpp"
+
+/// Return true if a CUDA or HIP device can be used by this program.
+/**
+ * Always false since there is no device backend yet, see GpuBackend.
+ */
+bool gpuAvailable() noexcept;
+
+
+/// Implementation of GpuCheckerboard on a device or on the host, see gpubackend.hpp.
+class GpuBackend;
+
+/// Spin configuration and checkerboard Metropolis updates on a GPU.
+/**
+ * The configuration stays in the memory of the backend between calls, see GpuBackend.
+ * Each sweep updates one checkerboard colour after the other and accepts every flip
+ * with the Metropolis probability using SiteRng::uniform() for the global site index.
+ * So the Markov chain does not depend on how sites are distributed over device threads
+ * and is the same as that of evolveDistributed().
+ *
+ * Changes of the coupling sum and magnetisation as well as the correlator are reduced
+ * by the backend, only their sums are copied to the host.
+ *
+ * There is no device backend yet (see gpuAvailable()), so the updates are performed site by site
+ * on the host with the same random numbers. A device backend must produce the same chain.
+ *
+ * Requires all lattice extents to be even and at most GpuCheckerboard::maxDim dimensions.
+ * Keeps a reference to the lattice, so it must outlive the GpuCheckerboard.
+ */
+class GpuCheckerboard
+{
+public:
+    static constexpr std::size_t maxDim = 8;
+
+    /// Sums over accepted flips from which changes of observables are computed.
+    struct FlipSums
+    {
+        /// Sum of spin times sum of neighbours before the flip.
+        std::int64_t coupling;
+        /// Sum of spins before the flip.
+        std::int64_t magnetisation;
+        std::int64_t naccept;
+    };
+
+    /// Allocate device memory for a lattice and copy its geometry and distance map.
+    /**
+     * Falls back to the host if no device is available.
+     * \param lat Lattice to simulate, must use the row-major layout and outlive this object.
+     * \param seed Seed of the SiteRng, its sweep counter starts at 0.
+     * \throws std::invalid_argument if the lattice is not supported.
+     */
+    GpuCheckerboard(Lattice const &lat, std::uint64_t seed);
+
+    ~GpuCheckerboard();
+
+    GpuCheckerboard(GpuCheckerboard const &) = delete;
+    GpuCheckerboard &operator=(GpuCheckerboard const &) = delete;
+
+    /// Return true if updates run on a device, false if on the host.
+    bool onDevice() const noexcept;
+
+    /// Copy a configuration to the device.
+    void upload(Configuration const &cfg);
+
+    /// Copy the configuration from the device.
+    Configuration download() const;
+
+    /// Set the parameters used by sweep().
+    void setParameters(Parameters const &params);
+
+    /// Update both sublattices once and add to the flip sums kept on the device.
+    void sweep();
+
+    /// Return the flip sums since the last call and reset them.
+    FlipSums takeFlipSums();
+
+    /// Compute the coupling sum of the configuration on the device, see couplingSum().
+    std::int64_t couplingSum() const;
+
+    /// Evaluate the Hamiltonian of the configuration on the device.
+    double hamiltonian(Parameters const &params) const;
+
+    /// Return the sum of all spins of the configuration on the device.
+    std::int64_t spinSum() const;
+
+    /// Measure the correlator for all squared distances of the lattice.
+    /**
+     * \returns Correlator normalised as by measure(), in the order of Lattice::sqDistances().
+     */
+    std::vector<double> correlator() const;
+
+    /// Return the number of sweeps performed so far.
+    std::uint64_t nsweep() const noexcept;
+
+    /// Return the number of dimensions of the lattice.
+    Index ndim() const noexcept;
+
+    /// Return the lattice this was created for.
+    Lattice const &lattice() const noexcept;
+
+private:
+    Lattice const &lat_;
+    SiteRng rng_;
+    bool onDevice_;
+    std::unique_ptr<GpuBackend> backend_;
+};
+
+
+/// Evolve a configuration in Monte-Carlo time using checkerboard sweeps on a GPU.
+/**
+ * The configuration is copied to the device once per call and back at the end.
+ * Observables are measured on the device after every sweep, the configuration is
+ * only copied back in sweeps in which a measurement of meas is due.
+ *
+ * \param cfg Starting configuration.
+ * \param coupling Coupling sum of cfg, updated to that of the final configuration,
+ *                 see evolve().
+ * \param params Physical parameters of the ensemble.
+ * \param gpu Device state, must have been created for the lattice of cfg.
+ * \param nsweep Number of sweeps to perform.
+ * \param obs Storage for measuring observables. Can be nullptr in which case no
+ *            measurements are performed.
+ * \param meas Measurements to perform after every sweep, keeps its state like in evolveLocal().
+ *
+ * \returns Tuple of
+ *   - final configuration
+ *   - final energy
+ *   - final magnetisation per site
+ *   - acceptance rate.
+ */
+template <typename... Ms>
+std::tuple<Configuration, double, double, double>
+evolveGpu(Configuration cfg, std::int64_t &coupling, Parameters const &params,
+          GpuCheckerboard &gpu, std::size_t const nsweep, Observables * const obs,
+          MeasurementSet<Ms...> &meas)
+{
+    double const volume = static_cast<double>(size(cfg).get());
+
+    gpu.upload(cfg);
+    gpu.setParameters(params);
+    if constexpr (not ndebug) {
+        if (coupling != gpu.couplingSum()) {
+            throw std::logic_error("Coupling sum does not match the configuration");
+        }
+    }
+    std::int64_t magn = gpu.spinSum();
+
+    std::int64_t naccept = 0;
+    // add the changes of all accepted flips to the tracked sums
+    auto const takeSums = [&] {
+        auto const sums = gpu.takeFlipSums();
+        coupling -= 2*sums.coupling;
+        magn -= 2*sums.magnetisation;
+        naccept += sums.naccept;
+    };
+
+    for (std::size_t sweep = 0; sweep < nsweep; ++sweep) {
+        gpu.sweep();
+        if (driftCheckDue(sweep)) {
+            takeSums();
+            checkDrift(energyFromSums(params, coupling, magn), magn,
+                       gpu.hamiltonian(params), gpu.spinSum(),
+                       params, gpu.ndim(), size(cfg));
+        }
+        bool const due = meas.due();
+        if (not obs and not due) {
+            meas.skip();
+            continue;
+        }
+
+        takeSums();
+        double const energy = energyFromSums(params, coupling, magn);
+        if (obs) {
+            ScopedTimer const timer{Phase::MEASUREMENT};
+            record(*obs, energy, static_cast<double>(magn)/volume);
+            if (not std::empty(obs->corr.sqDistances) and obs->due(obs->intervals.correlator)) {
+                ScopedTimer const correlatorTimer{Phase::CORRELATOR};
+                auto const corr = gpu.correlator();
+                for (std::size_t sqdi = 0; sqdi < std::size(corr); ++sqdi) {
+                    recordCorrelator(*obs, sqdi, corr[sqdi]);
+                }
+            }
+            nextSweep(*obs);
+        }
+        if (due) {
+            Configuration const current = gpu.download();
+            meas(ChainState<Configuration>{current, energy, static_cast<double>(magn)/volume,
+                                           gpu.lattice()});
+        }
+        else {
+            meas.skip();
+        }
+    }
+    takeSums();
+
+    return std::make_tuple(gpu.download(), energyFromSums(params, coupling, magn),
+                           static_cast<double>(magn)/volume,
+                           static_cast<double>(naccept)
+                           / static_cast<double>(nsweep)
+                           / volume);
+}
+
+/// Evolve a configuration using checkerboard sweeps on a GPU with run time measurements.
+/**
+ * Same as the overload above but calls every element of extraMeas after every sweep.
+ */
+std::tuple<Configuration, double, double, double>
+evolveGpu(Configuration cfg, std::int64_t &coupling, Parameters const &params,
+          GpuCheckerboard &gpu, std::size_t nsweep, Observables *obs,
+          std::vector<Measurement> const &extraMeas={});
+
+#endif  // ndef ISING_GPU_HPP
@@ -0,0 +1,32 @@
+#ifndef ISING_GPUBACKEND_HPP
+#define ISING_GPUBACKEND_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "gpu.hpp"
+
+/// Storage and updates of the configuration of a GpuCheckerboard.
+/**
+ * Only implemented on the host in gpu.cpp so far, device implementations
+ * (CUDA or HIP kernels) plug in here and are selected in the constructor of GpuCheckerboard.
+ * GpuCheckerboard checks the lattice and keeps the random number generator,
+ * see there for the meaning of the functions.
+ */
+class GpuBackend
+{
+public:
+    virtual ~GpuBackend() = default;
+
+    virtual void upload(Configuration const &cfg) = 0;
+    virtual Configuration download() const = 0;
+    virtual void setParameters(BoltzmannTable const &boltzmann) = 0;
+    /// Update both sublattices with the random numbers of rng in its current sweep.
+    virtual void sweep(SiteRng const &rng) = 0;
+    virtual GpuCheckerboard::FlipSums takeFlipSums() = 0;
+    virtual std::int64_t couplingSum() const = 0;
+    virtual std::int64_t spinSum() const = 0;
+    virtual std::vector<double> correlator() const = 0;
+};
+
+#endif  // ndef ISING_GPUBACKEND_HPP
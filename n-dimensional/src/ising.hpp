@@ -1,7 +1,10 @@
 #ifndef ISING_ISING_HPP
 #define ISING_ISING_HPP
 
+#include <cmath>
+#include <cstdint>
 #include <numeric>
+#include <vector>
 
 #include "configuration.hpp"
 #include "lattice.hpp"
@@ -23,9 +26,10 @@ struct Parameters
 };
 
 /// Sum spins of all neighbours of a given site.
-inline Spin sumOfNeighbours(Configuration const &cfg,
-                            Index const site,
-                            Lattice const &lat) noexcept(ndebug)
+template <typename Lat>
+Spin sumOfNeighbours(Configuration const &cfg,
+                     Index const site,
+                     Lat const &lat) noexcept(ndebug)
 {
     Spin neighbourSum{0};
     for (auto [it, end] = lat.neighbours(site);
@@ -37,32 +41,133 @@ inline Spin sumOfNeighbours(Configuration const &cfg,
     return neighbourSum;
 }
 
-/// Evaluate the Hamiltonian on a configuration.
-inline double hamiltonian(Configuration const &cfg,
-                          Parameters const &params,
-                          Lattice const &lat) noexcept(ndebug)
+/// Sum spins of all neighbours of a given site.
+/**
+ * Overload for lattices with a fixed number of dimensions, the loop
+ * over neighbours has a fixed number of iterations.
+ */
+template <std::size_t N>
+Spin sumOfNeighbours(Configuration const &cfg,
+                     Index const site,
+                     FixedLattice<N> const &lat) noexcept(ndebug)
 {
-    Spin coupling{0};  // the nearest-neighbour coupling
-    Spin magn{0};  // the sum over all sites
+    Spin neighbourSum{0};
+    for (Index n = 0_i; n < 2_i*lat.ndim(); ++n) {
+        neighbourSum = neighbourSum + cfg[lat.neighbour(site, n)];
+    }
+    return neighbourSum;
+}
 
+/// Return the sum of s_x s_y over all links <x,y>, counting each link once.
+/**
+ * The energy is -params.JT times this minus params.hT times the sum of all spins.
+ */
+template <typename Lat>
+std::int64_t couplingSum(Configuration const &cfg, Lat const &lat) noexcept(ndebug)
+{
+    std::int64_t coupling = 0;
     for (Index i = 0_i; i < size(lat); ++i) {
-        coupling = coupling + cfg[i]*sumOfNeighbours(cfg, i, lat);
-        magn = magn + cfg[i];
+        coupling += cfg[i].get()*sumOfNeighbours(cfg, i, lat).get();
     }
-
     // divide by 2 so each link is counted only once
-    return -params.JT*coupling.get()/2.0 - params.hT*magn.get();
+    return coupling / 2;
+}
+
+/// Return the energy of a configuration with given coupling sum and sum of all spins.
+/**
+ * Evolve functions track both sums as exact integers and only scale them
+ * by the parameters when the energy is needed.
+ */
+inline double energyFromSums(Parameters const &params, std::int64_t const coupling,
+                             std::int64_t const magn) noexcept
+{
+    return -params.JT*static_cast<double>(coupling) - params.hT*static_cast<double>(magn);
+}
+
+/// Evaluate the Hamiltonian on a configuration.
+template <typename Lat>
+double hamiltonian(Configuration const &cfg,
+                   Parameters const &params,
+                   Lat const &lat) noexcept(ndebug)
+{
+    std::int64_t const magn = std::accumulate(
+        begin(cfg), end(cfg), std::int64_t{0},
+        [](std::int64_t const acc, Spin const s) { return acc + s.get(); });
+    return energyFromSums(params, couplingSum(cfg, lat), magn);
 }
 
 /// Compute the change in energy if the spin at site idx were flipped.
-inline double deltaE(Configuration const &cfg, Index const site,
-                     Parameters const &params,
-                     Lattice const &lat) noexcept(ndebug)
+template <typename Lat>
+double deltaE(Configuration const &cfg, Index const site,
+              Parameters const &params,
+              Lat const &lat) noexcept(ndebug)
 {
     return 2.0*cfg[site].get()*(params.JT*sumOfNeighbours(cfg, site, lat).get()
                                 + params.hT);
 }
 
+/// Precomputed energy differences and acceptance probabilities of single spin flips.
+/**
+ * On a hypercubic lattice with ndim dimensions, the sum of neighbours of a site can
+ * only take the 2*ndim+1 values -2*ndim, -2*ndim+2, ..., 2*ndim.
+ * Together with the two possible spins, there are only 2*(2*ndim+1) different
+ * values of deltaE() which are stored here along with the Metropolis acceptance
+ * probabilities min(1, exp(-deltaE)).
+ */
+struct BoltzmannTable
+{
+    /// Compute all possible values for given parameters and number of dimensions.
+    BoltzmannTable(Parameters const &params, Index const ndim)
+        : ndim_{static_cast<int>(ndim.get())},
+          delta_(static_cast<size_t>(2*(2*ndim_+1))),
+          acceptance_(std::size(delta_))
+    {
+        for (int neighbourSum = -2*ndim_; neighbourSum <= 2*ndim_; neighbourSum += 2) {
+            for (int spin : {-1, +1}) {
+                size_t const idx = index(Spin{spin}, Spin{neighbourSum});
+                delta_[idx] = 2.0*spin*(params.JT*neighbourSum + params.hT);
+                acceptance_[idx] = delta_[idx] <= 0 ? 1.0 : std::exp(-delta_[idx]);
+            }
+        }
+    }
+
+    /// Return the index into the table for a spin with a given sum of neighbours.
+    size_t index(Spin const spin, Spin const neighbourSum) const noexcept
+    {
+        // maps neighbourSum to 0, 2, ..., 4*ndim and spin to 0, 1
+        return static_cast<size_t>((neighbourSum.get()+2*ndim_) + (spin.get()+1)/2);
+    }
+
+    /// Return the change in energy if the spin with given index were flipped.
+    double deltaE(size_t const idx) const noexcept(ndebug)
+    {
+        return delta_[idx];
+    }
+
+    /// Return the change in the coupling sum if the spin with given index were flipped.
+    /**
+     * This is -2 spin neighbourSum, the change in energy is deltaE(idx)
+     * = -params.JT deltaCoupling(idx) + 2 params.hT spin.
+     */
+    std::int64_t deltaCoupling(size_t const idx) const noexcept
+    {
+        auto const spin = 2*static_cast<std::int64_t>(idx % 2) - 1;
+        auto const neighbourSum = static_cast<std::int64_t>(idx - idx % 2) - 2*ndim_;
+        return -2*spin*neighbourSum;
+    }
+
+    /// Return the probability to accept flipping the spin with given index.
+    double acceptance(size_t const idx) const noexcept(ndebug)
+    {
+        return acceptance_[idx];
+    }
+
+private:
+    int ndim_;
+    std::vector<double> delta_;
+    std::vector<double> acceptance_;
+};
+
 /// Compute the magnetisation on a configuration.
 inline double magnetisation(Configuration const &cfg) noexcept(ndebug)
 {
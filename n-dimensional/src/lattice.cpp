@@ -1,6 +1,10 @@
 #include "lattice.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
 
 #include "ndebug.hpp"
 
@@ -15,30 +19,6 @@ namespace
         return size;
     }
 
-    /// Increment multi dimensional index.
-    void increment(MultiIndex &index,
-                   MultiIndex const &shape)
-    {
-        Index const ndim = Index{std::size(index)};
-
-        for (Index i = 0_i; i < ndim; ++i) {
-            // go through in inverse order to get row-major layout
-            Index const j = ndim-1_i-i;
-
-            // try to increment at position i
-            if (++index[j.get()] == shape[j.get()]) {
-                // back off, increment was too much
-                index[j.get()] = 0_i;
-            }
-            else {
-                // it is fine, keep the index
-                return;
-            }
-        }
-        // wrap around and start from 0 again
-        index[0] = 0_i;
-    }
-
     /// Increment the index at a given position taking PBCs into account.
     MultiIndex incrementedAt(MultiIndex const &index,
                              Index const pos,
@@ -82,7 +62,13 @@ namespace
     }
 
     /// Build list of nearest neighbours.
-    std::vector<Index> makeNeighbourList(MultiIndex const &shape)
+    /**
+     * \param rowMajorIndices Row-major index of every site, empty for row-major layout.
+     * \param sites Site of every row-major index, empty for row-major layout.
+     */
+    std::vector<Index> makeNeighbourList(MultiIndex const &shape,
+                                         std::vector<Index> const &rowMajorIndices,
+                                         std::vector<Index> const &sites)
     {
         Index const latsize = latticeSize(shape);
         Index const ndim = Index{std::size(shape)};
@@ -99,28 +85,107 @@ namespace
             increment(index, shape);
         }
 
-        return neighbours;
+        if (std::empty(sites)) {
+            return neighbours;
+        }
+
+        // renumber sites and their neighbours
+        std::vector<Index> reordered(std::size(neighbours));
+        for (Index site = 0_i; site < latsize; ++site) {
+            Index const i = rowMajorIndices[site.get()];
+            for (Index n = 0_i; n < 2_i*ndim; ++n) {
+                reordered[(2_i*ndim*site + n).get()] = sites[neighbours[(2_i*ndim*i + n).get()].get()];
+            }
+        }
+        return reordered;
     }
 
-    /// Return the minimum distance between two sites in a specific dimension.
-    /// Parameters are passed as indices / number of sites for this one dimension.
-    constexpr int mindist1d(Index const x0, Index const x1, Index const nx) noexcept
+    /// Return the row-major index of every site in a given layout, empty for row-major layout.
+    /**
+     * \throws std::invalid_argument if the layout does not support the shape or neighbourMode.
+     */
+    std::vector<Index> makeRowMajorIndices(MultiIndex const &shape,
+                                           Lattice::NeighbourMode const neighbourMode,
+                                           Lattice::SiteLayout const layout)
     {
-        int const forward = static_cast<int>(((nx + x1 - x0) % nx).get());
-        int const backward = static_cast<int>(nx.get()) - forward;
-        return std::min(forward, backward);
+        if (layout == Lattice::SiteLayout::ROW_MAJOR) {
+            return {};
+        }
+
+        if (neighbourMode != Lattice::NeighbourMode::STORED) {
+            throw std::invalid_argument("Blocked site layout requires stored neighbours");
+        }
+        constexpr Index blockExtent{Lattice::blockExtent};
+        MultiIndex blocksShape;
+        for (Index const extent : shape) {
+            if (extent.get() % blockExtent.get() != 0) {
+                throw std::invalid_argument("Blocked site layout requires all lattice extents "
+                                            "to be multiples of "
+                                            + std::to_string(Lattice::blockExtent));
+            }
+            blocksShape.push_back(extent / blockExtent);
+        }
+        MultiIndex const blockShape(std::size(shape), blockExtent);
+        Index const blockSize = latticeSize(blockShape);
+
+        // iterate over blocks and sites within blocks in row-major order
+        std::vector<Index> rowMajorIndices;
+        rowMajorIndices.reserve(latticeSize(shape).get());
+        MultiIndex block(std::size(shape), 0_i);
+        MultiIndex offset(std::size(shape), 0_i);
+        MultiIndex coords(std::size(shape));
+        for (Index b = 0_i; b < latticeSize(blocksShape); ++b) {
+            for (Index o = 0_i; o < blockSize; ++o) {
+                for (size_t d = 0; d < std::size(shape); ++d) {
+                    coords[d] = block[d]*blockExtent + offset[d];
+                }
+                rowMajorIndices.push_back(totalIndex(coords, shape));
+                increment(offset, blockShape);
+            }
+            increment(block, blocksShape);
+        }
+        return rowMajorIndices;
     }
 
-    int sqMindist(MultiIndex const &site0, MultiIndex const &site1,
-                  MultiIndex const &shape,
-                  int (*sqdist)(std::vector<int> const &))
+    /// Invert a permutation of sites.
+    std::vector<Index> inversePermutation(std::vector<Index> const &permutation)
     {
-        std::vector<int> individual;
-        individual.reserve(std::size(shape));
-        for (size_t dim = 0; dim < std::size(shape); ++dim) {
-            individual.emplace_back(mindist1d(site0[dim], site1[dim], shape[dim]));
+        std::vector<Index> inverse(std::size(permutation));
+        for (size_t i = 0; i < std::size(permutation); ++i) {
+            inverse[permutation[i].get()] = Index{i};
+        }
+        return inverse;
+    }
+
+    /// Return true if x is a power of two.
+    bool isPow2(Index const x) noexcept
+    {
+        return x.get() != 0 and (x.get() & (x.get()-1)) == 0;
+    }
+
+    /// Compute strides of all dimensions.
+    std::vector<Lattice::Stencil> makeStencil(MultiIndex const &shape)
+    {
+        std::vector<Lattice::Stencil> stencil(std::size(shape));
+        Index stride = 1_i;
+        for (size_t d = std::size(shape); d-- > 0;) {  // row-major => last dim has stride 1
+            unsigned shift = 0;
+            while ((1ul << shift) < stride.get()) {
+                ++shift;
+            }
+            stencil[d] = Lattice::Stencil{shape[d], stride, shift};
+            stride = stride*shape[d];
         }
-        return sqdist(individual);
+        return stencil;
+    }
+
+    /// Return the minimum distance of a displacement in a specific dimension.
+    /// Parameters are passed as offset / number of sites for this one dimension.
+    constexpr int mindist1d(Index const offset, Index const nx) noexcept
+    {
+        int const forward = static_cast<int>(offset.get());
+        int const backward = static_cast<int>(nx.get()) - forward;
+        return std::min(forward, backward);
     }
 
     /// Return square of Euclidean distance given individual differences per dimension.
@@ -143,54 +208,126 @@ namespace
         return distance * distance;
     }
 
-    /// Cosntruct a map of all distances on a lattice to pairs of indices of sites with that distance.
+    /// Construct a map of squared distances to all displacements on a lattice with that distance.
+    /**
+     * Each displacement is stored once with offsets in [0, extent) in every dimension.
+     * The distance of a displacement is computed from the minimum image in every dimension.
+     * Runs in O(V) time and memory where V is the number of displacements up to maxDist.
+     */
     DistMap buildDistMap(MultiIndex const &shape,
                          std::optional<double> const maxDist,
                          int (*sqdist)(std::vector<int> const &))
     {
         size_t const ndim = std::size(shape);
-        Index const latsize = latticeSize(shape);
 
         DistMap distmap;
 
-        if (maxDist == 0.0) {  // short cut to avoid expensive loops for large lattices
+        if (maxDist == 0.0) {  // short cut, no displacement has distance < 0
             return distmap;
         }
 
-        MultiIndex site0(ndim, 0_i);  // first index
+        // the allowed offsets in every dimension, their minimum distance must be below maxDist
+        std::vector<std::vector<Index>> offsets(ndim);
+        for (size_t dim = 0; dim < ndim; ++dim) {
+            for (Index x = 0_i; x < shape[dim]; ++x) {
+                if (not maxDist or mindist1d(x, shape[dim]) < maxDist.value()) {
+                    offsets[dim].emplace_back(x);
+                }
+            }
+        }
 
-        for (Index i = 0_i; i < latsize-1_i; ++i) {  // move site0 through the lattice
-            MultiIndex site1 = site0;  // compute distances between this and site0
-            for (Index j = i; j < latsize; ++j) {  // move site1 through the lattice
-                int const dist = sqMindist(site0, site1, shape, sqdist);
+        MultiIndex offsetShape;
+        for (auto const &offs : offsets) {
+            offsetShape.emplace_back(std::size(offs));
+        }
 
-                if (not maxDist or std::sqrt(static_cast<double>(dist)) < maxDist.value()) {
-                    if (distmap.find(dist) != std::end(distmap)) {
-                        // had this distance before => append new pair
-                        distmap.at(dist).emplace_back(i, j);
-                    }
-                    else {
-                        // new distance => insert new vector
-                        distmap.emplace(dist, std::vector(1, std::make_pair(i, j)));
-                    }
-                }
+        // move through all combinations of allowed offsets
+        MultiIndex offsetIndex(ndim, 0_i);
+        MultiIndex displacement(ndim);
+        std::vector<int> individual(ndim);
+        for (Index i = 0_i; i < latticeSize(offsetShape); ++i) {
+            for (size_t dim = 0; dim < ndim; ++dim) {
+                displacement[dim] = offsets[dim][offsetIndex[dim].get()];
+                individual[dim] = mindist1d(displacement[dim], shape[dim]);
+            }
+            int const dist = sqdist(individual);
 
-                increment(site1, shape);
+            if (not maxDist or std::sqrt(static_cast<double>(dist)) < maxDist.value()) {
+                distmap[dist].emplace_back(displacement);
             }
 
-            increment(site0, shape);
+            increment(offsetIndex, offsetShape);
         }
 
         return distmap;
     }
 }
 
+void increment(MultiIndex &index,
+               MultiIndex const &shape)
+{
+    Index const ndim = Index{std::size(index)};
+
+    for (Index i = 0_i; i < ndim; ++i) {
+        // go through in inverse order to get row-major layout
+        Index const j = ndim-1_i-i;
+
+        // try to increment at position i
+        if (++index[j.get()] == shape[j.get()]) {
+            // back off, increment was too much
+            index[j.get()] = 0_i;
+        }
+        else {
+            // it is fine, keep the index
+            return;
+        }
+    }
+    // wrap around and start from 0 again
+    index[0] = 0_i;
+}
+
 Lattice::Lattice(std::vector<Index> const &shape,
                  std::optional<double> const maxDist,
-                 DistanceFn const distfn)
-    : neighbourList_{makeNeighbourList(shape)},
+                 DistanceFn const distfn,
+                 NeighbourMode const neighbourMode,
+                 SiteLayout const layout)
+    : neighbourMode_{neighbourMode},
+      layout_{layout},
+      rowMajorIndices_{makeRowMajorIndices(shape, neighbourMode, layout)},
+      sites_{inversePermutation(rowMajorIndices_)},
+      neighbourList_{neighbourMode == NeighbourMode::STORED
+                     ? makeNeighbourList(shape, rowMajorIndices_, sites_)
+                     : std::vector<Index>{}},
       shape_{shape},
       size_{latticeSize(shape)},
+      stencil_{makeStencil(shape)},
+      pow2_{std::all_of(std::begin(shape), std::end(shape), isPow2)},
       distMap_{buildDistMap(shape, maxDist,
                             distfn == DistanceFn::EUCLIDEAN ? sqEuclidean : sqManhattan)}
 { }
+
+std::array<std::vector<Index>, 2> checkerboard(Lattice const &lat)
+{
+    for (Index const extent : lat.shape()) {
+        if (extent.get() % 2 != 0) {
+            throw std::invalid_argument("Checkerboard decomposition requires even lattice extents");
+        }
+    }
+
+    std::array<std::vector<Index>, 2> sublattices;
+    sublattices[0].reserve(size(lat).get()/2);
+    sublattices[1].reserve(size(lat).get()/2);
+
+    MultiIndex index(lat.ndim().get(), 0_i);
+    for (Index i = 0_i; i < size(lat); ++i) {
+        Index const coordSum = std::accumulate(std::begin(index), std::end(index), 0_i);
+        sublattices[coordSum.get() % 2].emplace_back(lat.fromRowMajor(i));
+        increment(index, lat.shape());
+    }
+
+    if (lat.layout() != Lattice::SiteLayout::ROW_MAJOR) {
+        std::sort(std::begin(sublattices[0]), std::end(sublattices[0]));
+        std::sort(std::begin(sublattices[1]), std::end(sublattices[1]));
+    }
+    return sublattices;
+}
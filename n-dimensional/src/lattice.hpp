@@ -1,12 +1,14 @@
 #ifndef ISING_LATTICE_HPP
 #define ISING_LATTICE_HPP
 
+#include <array>
 #include <vector>
 #include <tuple>
 #include <unordered_map>
 #include <utility>
 #include <optional>
 #include <algorithm>
+#include <stdexcept>
 
 #include "index.hpp"
 #include "ndebug.hpp"
@@ -15,8 +17,87 @@
 /// N-dimensional index of a lattice site.
 using MultiIndex = std::vector<Index>;
 
-/// Map of squared distances to vectors of pairs of lattice sites with that separation.
-using DistMap = std::unordered_map<int, std::vector<std::pair<Index, Index>>>;
+/// Map of squared distances to vectors of displacements with that length.
+/**
+ * A displacement is a MultiIndex of offsets in [0, extent) in every dimension.
+ * The site at displacement d from x is (x + d) mod shape, see displacedIndex().
+ */
+using DistMap = std::unordered_map<int, std::vector<MultiIndex>>;
+
+/// Increment multi dimensional index in row-major order.
+/**
+ * Wraps around to all zeros after the last index.
+ */
+void increment(MultiIndex &index, MultiIndex const &shape);
+
+/// Iterate over the neighbours of a site of a lattice of type Lat.
+/**
+ * Dereferencing returns the index of the neighbour by value, computed
+ * through Lat::neighbour().
+ */
+template <typename Lat>
+class NeighbourIterator
+{
+public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = Index;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = Index;
+
+    NeighbourIterator(Lat const &lat, Index const site, difference_type const neigh) noexcept
+        : lat_{&lat}, site_{site}, neigh_{neigh}
+    { }
+
+    Index operator*() const noexcept(ndebug)
+    {
+        return lat_->neighbour(site_, Index{static_cast<Index::Underlying>(neigh_)});
+    }
+
+    Index operator[](difference_type const n) const noexcept(ndebug)
+    {
+        return *(*this + n);
+    }
+
+    NeighbourIterator &operator++() noexcept
+    {
+        ++neigh_;
+        return *this;
+    }
+
+    NeighbourIterator operator++(int) noexcept
+    {
+        NeighbourIterator old{*this};
+        ++neigh_;
+        return old;
+    }
+
+    friend NeighbourIterator operator+(NeighbourIterator it, difference_type const n) noexcept
+    {
+        it.neigh_ += n;
+        return it;
+    }
+
+    friend difference_type operator-(NeighbourIterator const &a, NeighbourIterator const &b) noexcept
+    {
+        return a.neigh_ - b.neigh_;
+    }
+
+    friend bool operator==(NeighbourIterator const &a, NeighbourIterator const &b) noexcept
+    {
+        return a.neigh_ == b.neigh_ and a.site_ == b.site_ and a.lat_ == b.lat_;
+    }
+
+    friend bool operator!=(NeighbourIterator const &a, NeighbourIterator const &b) noexcept
+    {
+        return not (a == b);
+    }
+
+private:
+    Lat const *lat_;
+    Index site_;
+    difference_type neigh_;
+};
 
 /// Represent an n-dimensional lattice with an arbitrary (but hyperrectangular) shape.
 struct Lattice
@@ -24,15 +105,47 @@ struct Lattice
     /// Identify a function to calculate distances on a lattice.
     enum class DistanceFn { EUCLIDEAN, MANHATTAN };
 
+    /// Identify how nearest neighbours are looked up.
+    /**
+     * - STORED: Neighbours of all sites are precomputed and stored in neighbourList().
+     *           Costs 2*ndim indices of memory per site.
+     * - STENCIL: Neighbours are computed on the fly from strides and periodic wrapping,
+     *            neighbourList() is empty. Uses shifts and masks if all extents are
+     *            powers of two.
+     */
+    enum class NeighbourMode { STORED, STENCIL };
+
+    /// Identify how sites are numbered, i.e. the memory layout of configurations.
+    /**
+     * - ROW_MAJOR: Sites are numbered in row-major order of their coordinates,
+     *              see totalIndex(). Neighbours along dimension d are
+     *              shape[d+1]*...*shape[ndim-1] sites apart.
+     * - BLOCKED: The lattice is tiled into blocks of blockExtent sites in every dimension.
+     *            Blocks are numbered in row-major order and sites within a block as well,
+     *            so most neighbours are in the same block of blockExtent^ndim sites.
+     *            Requires stored neighbours and all extents to be multiples of blockExtent.
+     *
+     * Input and output always use row-major order, see toRowMajor() and fromRowMajor().
+     */
+    enum class SiteLayout { ROW_MAJOR, BLOCKED };
+
+    /// Number of sites per dimension of blocks in SiteLayout::BLOCKED.
+    static constexpr std::size_t blockExtent = 4;
+
     /// Construct from a shape and configure distance map.
     /**
      * \param shape N-dimensional shape of the lattice to construct.
      * \param maxDist Construct distance map only up to this maximum (non squared) distance.
      * \param distfn Function to use to compute distances on the lattice.
+     * \param neighbourMode How to look up nearest neighbours.
+     * \param layout How to number sites.
+     * \throws std::invalid_argument if the layout is not supported for the shape or neighbourMode.
      */
     explicit Lattice(MultiIndex const &shape,
                      std::optional<double> maxDist = std::optional<double>{},
-                     DistanceFn distfn = DistanceFn::EUCLIDEAN);
+                     DistanceFn distfn = DistanceFn::EUCLIDEAN,
+                     NeighbourMode neighbourMode = NeighbourMode::STORED,
+                     SiteLayout layout = SiteLayout::ROW_MAJOR);
 
     /// Return total lattice size.
     Index size() const noexcept
@@ -64,13 +177,49 @@ struct Lattice
         return Index{std::size(shape_)};
     }
 
+    /// Return how neighbours are looked up.
+    NeighbourMode neighbourMode() const noexcept
+    {
+        return neighbourMode_;
+    }
+
+    /// Return how sites are numbered.
+    SiteLayout layout() const noexcept
+    {
+        return layout_;
+    }
+
+    /// Return the row-major index of a site.
+    Index toRowMajor(Index const site) const noexcept
+    {
+        if (layout_ == SiteLayout::ROW_MAJOR) {
+            return site;
+        }
+        return rowMajorIndices_[site.get()];
+    }
+
+    /// Return the site with a given row-major index.
+    Index fromRowMajor(Index const rowMajorIndex) const noexcept
+    {
+        if (layout_ == SiteLayout::ROW_MAJOR) {
+            return rowMajorIndex;
+        }
+        return sites_[rowMajorIndex.get()];
+    }
+
     /// Return the list of nearest neighbour indices.
+    /**
+     * Is empty if neighbourMode() is NeighbourMode::STENCIL.
+     */
     auto const &neighbourList() const noexcept
     {
         return neighbourList_;
     }
 
     /// Return the index of neighbour number `neigh` of site `site`.
+    /**
+     * Neighbour 2*d is in positive, neighbour 2*d+1 in negative direction of dimension d.
+     */
     Index neighbour(Index const site, Index const neigh) const noexcept(ndebug)
     {
         if constexpr (not ndebug) {
@@ -82,46 +231,96 @@ struct Lattice
             }
         }
 
+        if (neighbourMode_ == NeighbourMode::STENCIL) {
+            return stencilNeighbour(site, neigh);
+        }
         return neighbourList_[(2_i*ndim()*site+neigh).get()];
     }
 
     /// Return a tuple of iterators to the beginning and one past end of neighbours of a site.
     auto neighbours(Index const site) const
     {
-        // type to add onto interators
-        using diff = decltype(std::cbegin(neighbourList_))::difference_type;
+        using diff = NeighbourIterator<Lattice>::difference_type;
+        return std::make_tuple(NeighbourIterator<Lattice>{*this, site, 0},
+                               NeighbourIterator<Lattice>{*this, site,
+                                                          static_cast<diff>((2_i*ndim()).get())});
+    }
 
-        Index const NDIM = ndim();
-        auto begin = std::cbegin(neighbourList_)+static_cast<diff>((2_i*NDIM*site).get());
-        auto end = begin + static_cast<diff>((2_i*NDIM).get());
-        return std::make_tuple(std::move(begin), std::move(end));
+    /// Compute the index of neighbour number `neigh` of site `site` without using the neighbour list.
+    Index stencilNeighbour(Index const site, Index const neigh) const noexcept
+    {
+        auto const &dim = stencil_[neigh.get()/2];
+        // +1 for even neigh (forward), -1 for odd neigh (backward), relies on unsigned wrap around
+        std::size_t const step = 1 - 2*(neigh.get() % 2);
+
+        if (pow2_) {
+            // branch free wrapping
+            auto const mask = dim.extent.get() - 1;
+            auto const x = (site.get() >> dim.shift) & mask;
+            auto const shifted = (x + step) & mask;
+            return Index{site.get() + (shifted << dim.shift) - (x << dim.shift)};
+        }
+
+        auto const x = site.get() / dim.stride.get() % dim.extent.get();
+        if (step == 1) {
+            return x == dim.extent.get()-1
+                ? site - Index{x}*dim.stride
+                : site + dim.stride;
+        }
+        return x == 0
+            ? site + (dim.extent-1_i)*dim.stride
+            : site - dim.stride;
     }
 
     /// Return sorted vector of all squared distances stored in the map.
     auto sqDistances() const
     {
         std::vector<int> distances;
-        for (auto const [key, _] : distMap_) {
+        for (auto const &[key, _] : distMap_) {
             distances.emplace_back(key);
         }
         std::sort(std::begin(distances), std::end(distances));
         return distances;
     }
 
-    /// Return vector of pairs of all sites with given squared distance.
-    auto const &pairsWithSqDistance(int const sqDistance) const
+    /// Return vector of all displacements with given squared distance.
+    /**
+     * Each pair of sites (x, y) with that distance appears once as (x, d) with
+     * y = displacedIndex(x, d) and once as (y, d') with x = displacedIndex(y, d').
+     */
+    auto const &displacementsWithSqDistance(int const sqDistance) const
     {
         return distMap_.at(sqDistance);
     }
 
+    /// Data needed to step through one dimension of the lattice.
+    struct Stencil
+    {
+        Index extent;  ///< Extent of the dimension.
+        Index stride;  ///< Distance between neighbouring sites in row-major layout.
+        unsigned shift;  ///< log2(stride), only valid if all extents are powers of two.
+    };
+
 private:
+    /// How to look up neighbours.
+    NeighbourMode const neighbourMode_;
+    /// How sites are numbered.
+    SiteLayout const layout_;
+    /// Row-major index of every site, empty for SiteLayout::ROW_MAJOR.
+    std::vector<Index> const rowMajorIndices_;
+    /// Site of every row-major index, empty for SiteLayout::ROW_MAJOR.
+    std::vector<Index> const sites_;
     /// Indices of nearest neighbours.
     std::vector<Index> const neighbourList_;
     /// Shape of the lattice.
     MultiIndex const shape_;
     /// Total size of the lattice.
     Index const size_;
-    /// Squared distances with all pairs of lattice sites witht hat separation up to some max distance.
+    /// Strides for all dimensions.
+    std::vector<Stencil> const stencil_;
+    /// True if all extents are powers of two.
+    bool const pow2_;
+    /// Squared distances with all displacements with that length up to some max distance.
     DistMap const distMap_;
 };
 
@@ -131,7 +330,142 @@ inline Index size(Lattice const &lat) noexcept
     return lat.size();
 }
 
-/// Compute the flat index from a set of Ndim indices.
+/// Lattice with a number of dimensions that is fixed at compile time.
+/**
+ * Stores the same data as Lattice but exposes the number of dimensions as a
+ * compile time constant. Neighbours are always stored and looked up with a fixed
+ * stride of 2*N in the neighbour list without checking the neighbour mode,
+ * which allows loops over neighbours to be fully unrolled.
+ * Use Lattice for NeighbourMode::STENCIL.
+ * The shape and row-major strides are additionally stored in arrays of size N,
+ * see extents() and strides().
+ *
+ * neighbour() and neighbours() hide the functions of Lattice, they are not virtual.
+ * The Monte-Carlo kernels are templates over the lattice type and call them
+ * through FixedLattice. Functions which only need generic lattice features
+ * take a Lattice and can be passed a FixedLattice.
+ */
+template <std::size_t N>
+struct FixedLattice : Lattice
+{
+    static_assert(N > 0, "Lattice must have at least one dimension");
+
+    /// Construct from a shape and configure distance map.
+    /**
+     * \param shape N-dimensional shape of the lattice to construct, must have N elements.
+     * \param maxDist Construct distance map only up to this maximum (non squared) distance.
+     * \param distfn Function to use to compute distances on the lattice.
+     * \param neighbourMode How to look up nearest neighbours, must be NeighbourMode::STORED.
+     * \param layout How to number sites.
+     * \throws std::invalid_argument if shape does not have N elements or
+     *         neighbourMode is not NeighbourMode::STORED.
+     */
+    explicit FixedLattice(MultiIndex const &shape,
+                          std::optional<double> maxDist = std::optional<double>{},
+                          DistanceFn distfn = DistanceFn::EUCLIDEAN,
+                          NeighbourMode neighbourMode = NeighbourMode::STORED,
+                          SiteLayout layout = SiteLayout::ROW_MAJOR)
+        : Lattice{checkedShape(shape), maxDist, distfn, checkedMode(neighbourMode), layout},
+          extents_{toArray(shape)}, strides_{rowMajorStrides(extents_)}
+    { }
+
+    /// Return the number of dimensions.
+    static constexpr Index ndim() noexcept
+    {
+        return Index{N};
+    }
+
+    /// Return the lattice extend in dimention dim.
+    Index extend(Index const dim) const noexcept(ndebug)
+    {
+        if constexpr (not ndebug) {
+            if (dim.get() >= N) {
+                throw std::out_of_range("Dimension for FixedLattice::extend is out of range.");
+            }
+        }
+
+        return extents_[dim.get()];
+    }
+
+    /// Return the shape of the lattice, the same as shape() but with a fixed size.
+    std::array<Index, N> const &extents() const noexcept
+    {
+        return extents_;
+    }
+
+    /// Return the distances between neighbouring sites along each dimension in row-major layout.
+    std::array<Index, N> const &strides() const noexcept
+    {
+        return strides_;
+    }
+
+    /// Return the index of neighbour number `neigh` of site `site`.
+    Index neighbour(Index const site, Index const neigh) const noexcept(ndebug)
+    {
+        if constexpr (not ndebug) {
+            if (site >= size()) {
+                throw std::out_of_range("Index site out of range in FixedLattice::neighbour().");
+            }
+            if (neigh >= 2_i*ndim()) {
+                throw std::out_of_range("Neihbour number out of range in FixedLattice::neighbour().");
+            }
+        }
+
+        return neighbourList()[2*N*site.get()+neigh.get()];
+    }
+
+    /// Return a tuple of iterators to the beginning and one past end of neighbours of a site.
+    auto neighbours(Index const site) const
+    {
+        return std::make_tuple(NeighbourIterator<FixedLattice>{*this, site, 0},
+                               NeighbourIterator<FixedLattice>{*this, site, 2*N});
+    }
+
+private:
+    /// Make sure shape has N dimensions.
+    static MultiIndex const &checkedShape(MultiIndex const &shape)
+    {
+        if (std::size(shape) != N) {
+            throw std::invalid_argument("Shape does not match number of dimensions of FixedLattice");
+        }
+        return shape;
+    }
+
+    /// Make sure neighbours are stored.
+    static NeighbourMode checkedMode(NeighbourMode const neighbourMode)
+    {
+        if (neighbourMode != NeighbourMode::STORED) {
+            throw std::invalid_argument("FixedLattice requires stored neighbours");
+        }
+        return neighbourMode;
+    }
+
+    /// Copy a shape with N elements into an array.
+    static std::array<Index, N> toArray(MultiIndex const &shape) noexcept
+    {
+        std::array<Index, N> extents;
+        std::copy(std::begin(shape), std::end(shape), std::begin(extents));
+        return extents;
+    }
+
+    /// Compute the strides of the row-major layout.
+    static std::array<Index, N> rowMajorStrides(std::array<Index, N> const &extents) noexcept
+    {
+        std::array<Index, N> strides;
+        strides[N-1] = 1_i;
+        for (std::size_t d = N-1; d > 0; --d) {
+            strides[d-1] = strides[d]*extents[d];
+        }
+        return strides;
+    }
+
+    /// Shape of the lattice.
+    std::array<Index, N> const extents_;
+    /// Strides for all dimensions in row-major layout.
+    std::array<Index, N> const strides_;
+};
+
+/// Compute the flat row-major index from a set of Ndim indices.
 inline Index totalIndex(std::vector<Index> const &index,
                         std::vector<Index> const &shape) noexcept(ndebug)
 {
@@ -148,11 +482,52 @@ inline Index totalIndex(std::vector<Index> const &index,
     return total;
 }
 
-/// Compute the flat index from a set of Ndim indices.
+/// Compute the flat row-major index from a set of Ndim indices.
+/**
+ * Use lat.fromRowMajor() on the result to get the site in the layout of lat.
+ */
 inline Index totalIndex(std::vector<Index> const &index,
                         Lattice const &lat) noexcept(ndebug)
 {
     return totalIndex(index, lat.shape());
 }
 
+/// Compute the flat index of the site at a displacement from a given site.
+/**
+ * \param index N-dimensional index of the starting site.
+ * \param displacement Offsets in [0, extent) in every dimension.
+ * \param shape Shape of the lattice.
+ */
+inline Index displacedIndex(MultiIndex const &index,
+                            MultiIndex const &displacement,
+                            MultiIndex const &shape) noexcept(ndebug)
+{
+    if constexpr (not ndebug) {
+        if (std::size(index) != std::size(shape) or std::size(displacement) != std::size(shape)) {
+            throw std::runtime_error("Invalid number of indices");
+        }
+    }
+
+    Index total{0};
+    for (size_t dim = 0; dim < std::size(shape); ++dim) {
+        Index x = index[dim] + displacement[dim];
+        if (x >= shape[dim]) {
+            x = x - shape[dim];
+        }
+        total = total*shape[dim] + x;
+    }
+    return total;
+}
+
+/// Split a lattice into two interleaved sublattices.
+/**
+ * Sublattice 0 contains all sites whose sum of coordinates is even,
+ * sublattice 1 those with an odd sum. Nearest neighbours are always
+ * on different sublattices which requires all extents to be even.
+ * Sites are stored in increasing order of their index in the layout of lat.
+ *
+ * \throws std::invalid_argument if any extent is odd.
+ */
+std::array<std::vector<Index>, 2> checkerboard(Lattice const &lat);
+
 #endif  // ndef ISING_LATTICE_HPP
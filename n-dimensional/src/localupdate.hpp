@@ -0,0 +1,459 @@
+#ifndef ISING_LOCALUPDATE_HPP
+#define ISING_LOCALUPDATE_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#include "configuration.hpp"
+#include "ising.hpp"
+#include "lattice.hpp"
+#include "measurements.hpp"
+#include "montecarlo.hpp"
+#include "ndebug.hpp"
+#include "packedconfiguration.hpp"
+#include "rng.hpp"
+
+/// Return the sum of all spins of a configuration.
+inline std::int64_t spinSum(Configuration const &cfg) noexcept(ndebug)
+{
+    return std::accumulate(begin(cfg), end(cfg), std::int64_t{0},
+                           [](std::int64_t const acc, Spin const s) { return acc + s.get(); });
+}
+
+/// Return the sum of all spins of a packed configuration.
+inline std::int64_t spinSum(PackedConfiguration const &cfg) noexcept
+{
+    return 2*static_cast<std::int64_t>(countUp(cfg)) - static_cast<std::int64_t>(size(cfg).get());
+}
+
+/// Measure observables if an instance of Observables is given.
+/**
+ * \param magn Sum of all spins of cfg.
+ * \param fourierSums Tracked Fourier sums of cfg or nullptr.
+ * \param coupling Tracked coupling sum of cfg if known.
+ */
+template <typename Cfg>
+void measure(Observables * const obs, Lattice const &lat,
+             Cfg const &cfg, double const energy, std::int64_t const magn,
+             FourierSums const * const fourierSums=nullptr,
+             std::optional<std::int64_t> const coupling=std::nullopt)
+{
+    if (obs) {
+        measure(*obs, lat, cfg, energy,
+                static_cast<double>(magn) / static_cast<double>(size(lat).get()),
+                fourierSums, coupling);
+    }
+}
+
+/// Return Fourier sums of cfg if they shall be tracked during sweeps that measure obs.
+/**
+ * Updating the sums costs O(ndim) per accepted flip and computing them from scratch
+ * O(V ndim) per measurement. So they are only tracked if the Fourier modes are measured
+ * every sweep, otherwise measure() computes them when they are due.
+ */
+inline std::optional<FourierSums> trackedFourierSums(Observables const * const obs,
+                                                     Lattice const &lat,
+                                                     Configuration const &cfg)
+{
+    if (not obs or obs->intervals.fourierModes != 1) {
+        return std::nullopt;
+    }
+    std::optional<FourierSums> sums{std::in_place, lat};
+    if (lat.layout() == Lattice::SiteLayout::ROW_MAJOR) {
+        sums->reset(cfg);
+    }
+    else {
+        sums->reset(toRowMajor(cfg, lat));
+    }
+    return sums;
+}
+
+/// Check tracked observables against the configuration if driftCheckDue(sweep).
+template <typename Cfg, typename Lat>
+void checkDrift(size_t const sweep, Cfg const &cfg, double const energy,
+                std::int64_t const magn, Parameters const &params, Lat const &lat)
+{
+    if (driftCheckDue(sweep)) {
+        checkDrift(energy, magn, hamiltonian(cfg, params, lat), spinSum(cfg),
+                   params, lat.ndim(), size(lat));
+    }
+}
+
+/// Check the coupling sum passed to an evolve function against the configuration.
+/**
+ * Only checks in debug builds, it costs a pass over the lattice.
+ * \throws std::logic_error if coupling is not the coupling sum of cfg.
+ */
+template <typename Cfg, typename Lat>
+void checkCoupling(Cfg const &cfg, std::int64_t const coupling, Lat const &lat)
+{
+    if constexpr (not ndebug) {
+        if (coupling != couplingSum(cfg, lat)) {
+            throw std::logic_error("Coupling sum does not match the configuration");
+        }
+    }
+}
+
+/// Check tracked Fourier sums against the configuration if driftCheckDue(sweep).
+/**
+ * \throws std::logic_error if they drifted by more than rounding errors.
+ */
+inline void checkDrift(size_t const sweep, std::optional<FourierSums> const &fourierSums,
+                       Configuration const &cfg, Lattice const &lat)
+{
+    if (fourierSums and driftCheckDue(sweep)) {
+        FourierSums exact = *fourierSums;
+        exact.reset(toRowMajor(cfg, lat));
+        double const tolerance = 1e-8 * static_cast<double>(size(cfg).get());
+        for (size_t d = 0; d < exact.nmodes(); ++d) {
+            if (std::abs(exact.sum(d) - fourierSums->sum(d)) > tolerance) {
+                throw std::logic_error("Tracked Fourier sums drifted from the configuration");
+            }
+        }
+    }
+}
+
+/// Perform a Metropolis-Hastings update of the spin at a given site.
+/**
+ * Flips the spin if the update is accepted and adds the change in
+ * the sum of all spins to magn.
+ * The decision only depends on the spin and the integer sum of its neighbours.
+ * \returns The change in the coupling sum if the flip was accepted or 0 otherwise.
+ */
+template <typename Lat>
+std::int64_t metropolis(Configuration &cfg, Index const site,
+                        BoltzmannTable const &boltzmann, Lat const &lat,
+                        Rng &rng, size_t &naccept, std::int64_t &magn) noexcept(ndebug)
+{
+    size_t const idx = boltzmann.index(cfg[site], sumOfNeighbours(cfg, site, lat));
+    double const acceptance = boltzmann.acceptance(idx);
+
+    // Metropolis-Hastings accept-reject
+    // The first check is not necessary for this to be correct but avoids
+    // drawing a random number for downhill moves.
+    if (acceptance >= 1.0 or acceptance > rng.genReal()) {
+        // accept change
+        cfg.flip(site);
+        ++naccept;
+        magn += 2*cfg[site].get();
+        return boltzmann.deltaCoupling(idx);
+    }
+    // else: discard
+    return 0;
+}
+
+/// Call a function for all sites with a given parity of the sum of coordinates.
+/**
+ * Sites are visited in increasing order of their index, i.e. every other
+ * site along the last (contiguous) dimension, so memory is accessed with stride 2.
+ * In the blocked layout, this holds within each block.
+ */
+template <typename F>
+void forEachSiteWithParity(Lattice const &lat, size_t const parity, F const &f)
+{
+    if (lat.layout() == Lattice::SiteLayout::BLOCKED) {
+        // blocks start at even coordinates, so all of them have the same pattern of parities
+        MultiIndex const blockShape(lat.ndim().get(), Index{Lattice::blockExtent});
+        Index blockSize = 1_i;
+        for (Index const extent : blockShape) {
+            blockSize = blockSize*extent;
+        }
+        std::vector<Index> offsets;
+        MultiIndex offset(std::size(blockShape), 0_i);
+        for (Index o = 0_i; o < blockSize; ++o) {
+            if (std::accumulate(begin(offset), end(offset), 0_i).get() % 2 == parity) {
+                offsets.push_back(o);
+            }
+            increment(offset, blockShape);
+        }
+
+        for (Index blockStart = 0_i; blockStart < size(lat); blockStart = blockStart + blockSize) {
+            for (Index const o : offsets) {
+                f(blockStart + o);
+            }
+        }
+        return;
+    }
+
+    MultiIndex const &shape = lat.shape();
+    Index const rowLength = shape.back();
+    // coordinates in all but the last dimension
+    MultiIndex const rowShape(shape.begin(), shape.end()-1);
+    MultiIndex row(std::size(rowShape), 0_i);
+    size_t rowParity = 0;
+
+    for (Index rowStart = 0_i; rowStart < size(lat); rowStart = rowStart + rowLength) {
+        for (Index x = Index{(parity + rowParity) % 2}; x < rowLength; x = x + 2_i) {
+            f(rowStart + x);
+        }
+
+        if (not std::empty(row)) {
+            increment(row, rowShape);
+            rowParity = 0;
+            for (Index const coord : row) {
+                rowParity += coord.get();
+            }
+            rowParity %= 2;
+        }
+    }
+}
+
+/// Update rule for localSweeps(): Metropolis-Hastings accept-reject.
+/**
+ * Update rules are constructed from parameters and lattice once per call of
+ * evolveLocal() and provide
+ *   - beginSweep(rng), called before every sweep,
+ *   - operator()(cfg, site, lat, rng, naccept, magn) which updates a single site
+ *     like metropolis() and returns the change in the coupling sum.
+ */
+class MetropolisRule
+{
+public:
+    MetropolisRule(Parameters const &params, Lattice const &lat)
+        : boltzmann_{params, lat.ndim()}
+    { }
+
+    void beginSweep(Rng &) const noexcept
+    { }
+
+    template <typename Lat>
+    std::int64_t operator()(Configuration &cfg, Index const site, Lat const &lat,
+                            Rng &rng, size_t &naccept, std::int64_t &magn) const noexcept(ndebug)
+    {
+        return metropolis(cfg, site, boltzmann_, lat, rng, naccept, magn);
+    }
+
+private:
+    BoltzmannTable boltzmann_;
+};
+
+/// Update rule for localSweeps(): draw the spin from its distribution given its neighbours.
+/**
+ * The new spin does not depend on the old one, so the spin is flipped with
+ * probability 1/(1 + exp(dE)) where dE is the change in energy of the flip.
+ * Unlike Metropolis updates, this always draws a random number.
+ */
+class HeatBathRule
+{
+public:
+    HeatBathRule(Parameters const &params, Lattice const &lat)
+        : boltzmann_{params, lat.ndim()}, flipProbability_(4*lat.ndim().get() + 2)
+    {
+        for (size_t idx = 0; idx < std::size(flipProbability_); ++idx) {
+            flipProbability_[idx] = 1.0 / (1.0 + std::exp(boltzmann_.deltaE(idx)));
+        }
+    }
+
+    void beginSweep(Rng &) const noexcept
+    { }
+
+    template <typename Lat>
+    std::int64_t operator()(Configuration &cfg, Index const site, Lat const &lat,
+                            Rng &rng, size_t &naccept, std::int64_t &magn) const noexcept(ndebug)
+    {
+        size_t const idx = boltzmann_.index(cfg[site], sumOfNeighbours(cfg, site, lat));
+        if (rng.genReal() < flipProbability_[idx]) {
+            cfg.flip(site);
+            ++naccept;
+            magn += 2*cfg[site].get();
+            return boltzmann_.deltaCoupling(idx);
+        }
+        return 0;
+    }
+
+private:
+    BoltzmannTable boltzmann_;
+    std::vector<double> flipProbability_;
+};
+
+/// Update rule for localSweeps(): microcanonical flips exchanging energy with demons.
+/**
+ * Every block of demonBlockSize consecutive sites shares a demon. A flip is accepted
+ * if the demon of the site can supply the change in energy dE, i.e. if dE is at most
+ * the energy of the demon, which then absorbs -dE. These moves conserve the sum of the
+ * energies of configuration and demons and need no random numbers.
+ * All demons are reset to energies drawn from exp(-E_d) at the start of every sweep,
+ * so the joint distribution is exp(-H - sum E_d) and configurations follow the
+ * Boltzmann distribution as with the other rules.
+ * A single demon would only let the energy change by O(1) per sweep.
+ */
+class DemonRule
+{
+public:
+    /// Number of sites per demon.
+    static constexpr size_t demonBlockSize = 16;
+
+    DemonRule(Parameters const &params, Lattice const &lat)
+        : boltzmann_{params, lat.ndim()},
+          demons_((size(lat).get() + demonBlockSize - 1) / demonBlockSize, 0.0)
+    { }
+
+    void beginSweep(Rng &rng) noexcept
+    {
+        for (double &demon : demons_) {
+            demon = -std::log(1.0 - rng.genReal());
+        }
+    }
+
+    template <typename Lat>
+    std::int64_t operator()(Configuration &cfg, Index const site, Lat const &lat,
+                            Rng &, size_t &naccept, std::int64_t &magn) noexcept(ndebug)
+    {
+        size_t const idx = boltzmann_.index(cfg[site], sumOfNeighbours(cfg, site, lat));
+        double const delta = boltzmann_.deltaE(idx);
+        double &demon = demons_[site.get() / demonBlockSize];
+        if (delta <= demon) {
+            demon -= delta;
+            cfg.flip(site);
+            ++naccept;
+            magn += 2*cfg[site].get();
+            return boltzmann_.deltaCoupling(idx);
+        }
+        return 0;
+    }
+
+private:
+    BoltzmannTable boltzmann_;
+    std::vector<double> demons_;  ///< Energies of the demons, never negative.
+};
+
+/// Site order for localSweeps(): size(lat) sites drawn at random with replacement.
+struct RandomSites
+{
+    template <typename Lat, typename F>
+    static void sweep(Lat const &lat, Rng &rng, F const &f)
+    {
+        for (size_t step = 0; step < size(lat).get(); ++step) {
+            f(rng.genIndex());
+        }
+    }
+};
+
+/// Site order for localSweeps(): all sites in increasing order of their total index.
+struct TypewriterSites
+{
+    template <typename Lat, typename F>
+    static void sweep(Lat const &lat, Rng &, F const &f)
+    {
+        for (Index site = 0_i; site < size(lat); ++site) {
+            f(site);
+        }
+    }
+};
+
+/// Site order for localSweeps(): even sites first, then odd sites, see forEachSiteWithParity().
+struct CheckerboardSites
+{
+    template <typename Lat, typename F>
+    static void sweep(Lat const &lat, Rng &, F const &f)
+    {
+        forEachSiteWithParity(lat, 0, f);
+        forEachSiteWithParity(lat, 1, f);
+    }
+};
+
+/// Evolve a configuration with single spin updates.
+/**
+ * Both update rule and site order are template parameters, so every combination
+ * gets its own inner loop with the update inlined.
+ * The coupling sum and the sum of all spins are tracked as integers
+ * and the energy is only computed from them when measuring and on return.
+ * So it does not accumulate rounding errors.
+ * Parameters and return value are the same as for evolve() except that
+ * meas is called with the ChainState after every sweep, e.g. a MeasurementSet.
+ */
+template <typename Rule, typename Order, typename Lat, typename Meas>
+std::tuple<Configuration, double, double, double>
+localSweeps(Configuration cfg, std::int64_t &coupling, Parameters const &params,
+            Lat const &lat, Rng &rng, size_t const nsweep,
+            Observables * const obs, Meas &meas)
+{
+    checkCoupling(cfg, coupling, lat);
+    size_t naccept = 0;  // running number of accepted spin flips
+    std::int64_t magn = spinSum(cfg);
+    double const volume = static_cast<double>(size(lat).get());
+    Rule rule{params, lat};
+    std::optional<FourierSums> fourierSums = trackedFourierSums(obs, lat, cfg);
+
+    auto const updateSite = [&](Index const site) {
+        std::int64_t const oldMagn = magn;
+        coupling += rule(cfg, site, lat, rng, naccept, magn);
+        if (fourierSums and magn != oldMagn) {
+            fourierSums->flip(lat.toRowMajor(site), cfg[site]);
+        }
+    };
+
+    for (size_t sweep = 0; sweep < nsweep; ++sweep) {
+        rule.beginSweep(rng);
+        Order::sweep(lat, rng, updateSite);
+
+        double const currentEnergy = energyFromSums(params, coupling, magn);
+        checkDrift(sweep, cfg, currentEnergy, magn, params, lat);
+        checkDrift(sweep, fourierSums, cfg, lat);
+        measure(obs, lat, cfg, currentEnergy, magn, fourierSums ? &*fourierSums : nullptr,
+                coupling);
+        meas(ChainState<Configuration>{cfg, currentEnergy, static_cast<double>(magn) / volume,
+                                       lat});
+    }
+
+    return std::make_tuple(std::move(cfg), energyFromSums(params, coupling, magn),
+                           static_cast<double>(magn) / volume,
+                           static_cast<double>(naccept) / static_cast<double>(nsweep) / volume);
+}
+
+/// Call localSweeps() with a site order selected at runtime.
+template <typename Rule, typename Lat, typename Meas>
+std::tuple<Configuration, double, double, double>
+localSweepsInOrder(Configuration cfg, std::int64_t &coupling, Parameters const &params,
+                   Lat const &lat, Rng &rng, size_t const nsweep,
+                   Observables * const obs, Meas &meas, SiteOrder const order)
+{
+    switch (order) {
+    case SiteOrder::TYPEWRITER:
+        return localSweeps<Rule, TypewriterSites>(std::move(cfg), coupling, params, lat, rng,
+                                                  nsweep, obs, meas);
+    case SiteOrder::CHECKERBOARD:
+        return localSweeps<Rule, CheckerboardSites>(std::move(cfg), coupling, params, lat, rng,
+                                                    nsweep, obs, meas);
+    case SiteOrder::RANDOM:
+        break;
+    }
+    return localSweeps<Rule, RandomSites>(std::move(cfg), coupling, params, lat, rng,
+                                          nsweep, obs, meas);
+}
+
+/// Evolve a configuration with single spin updates and a compile time set of measurements.
+/**
+ * Same as evolveLocal() in montecarlo.hpp but calls meas after every sweep instead
+ * of a std::vector<Measurement>. Since the types of all measurements are known,
+ * they are inlined into the sweep loop.
+ * meas keeps its state, so it can be passed to several calls and read out afterwards.
+ */
+template <typename Lat, typename... Ms>
+std::tuple<Configuration, double, double, double>
+evolveLocal(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+            Lat const &lat, Rng &rng, size_t const nsweep,
+            Observables * const obs, MeasurementSet<Ms...> &meas,
+            UpdateRule const rule=UpdateRule::METROPOLIS,
+            SiteOrder const order=SiteOrder::RANDOM)
+{
+    switch (rule) {
+    case UpdateRule::HEAT_BATH:
+        return localSweepsInOrder<HeatBathRule>(std::move(cfg), coupling, params, lat, rng,
+                                                nsweep, obs, meas, order);
+    case UpdateRule::DEMON:
+        return localSweepsInOrder<DemonRule>(std::move(cfg), coupling, params, lat, rng,
+                                             nsweep, obs, meas, order);
+    case UpdateRule::METROPOLIS:
+        break;
+    }
+    return localSweepsInOrder<MetropolisRule>(std::move(cfg), coupling, params, lat, rng,
+                                              nsweep, obs, meas, order);
+}
+
+#endif  // ndef ISING_LOCALUPDATE_HPP
@@ -3,95 +3,809 @@
  */
 
 #include <chrono>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
+#include <optional>
+#include <string>
+#include <type_traits>
 
 #include <yaml-cpp/yaml.h>
 
 #include "lattice.hpp"
+#include "checkpoint.hpp"
+#include "checkerboardupdate.hpp"
+#include "clusterupdate.hpp"
 #include "configuration.hpp"
 #include "rng.hpp"
 #include "ising.hpp"
+#include "localupdate.hpp"
+#include "measurements.hpp"
 #include "montecarlo.hpp"
+#include "pipeline.hpp"
+#include "profile.hpp"
+#include "scan.hpp"
+#include "tempering.hpp"
 #include "fileio.hpp"
+#include "gpu.hpp"
+
+#ifdef ISING_MPI
+#include <mpi.h>
+#include "distributed.hpp"
+#endif
 
 using Clock = std::chrono::steady_clock;
 using Milliseconds = std::chrono::milliseconds;
 
+/// Name of the checkpoint file in the output directory.
+constexpr char const checkpointFname[] = "checkpoint.bin";
+
+/// Name of the profiling report in the output directory.
+constexpr char const profileFname[] = "profile.yml";
+
+
+/// Construct a lattice as described by the input.
+template <typename Lat>
+Lat makeLattice(ProgConfig::Lattice const &latIn, Lattice::NeighbourMode const neighbourMode)
+{
+    ScopedTimer const timer{Phase::LATTICE};
+    return Lat{latIn.shape, latIn.maxDist, latIn.distfn, neighbourMode, latIn.layout};
+}
+
 
 /// Parse command line arguments.
+/**
+ * \returns Tuple of input file, output directory, and whether '--restart' was given.
+ */
 auto parseArgs(int const argc, char const * const argv[])
 {
-    if (argc != 3) {
-        throw std::runtime_error("Need two parameters, in order: input file, output directory!");
+    bool const restart = argc == 4 and std::string{argv[3]} == "--restart";
+    if (argc != 3 and not restart) {
+        throw std::runtime_error("Need two parameters, in order: input file, output directory!"
+                                 " Optionally followed by '--restart'.");
     }
 
-    return std::make_tuple(fs::path{argv[1]}, fs::path{argv[2]});
+    return std::make_tuple(fs::path{argv[1]}, fs::path{argv[2]}, restart);
 }
 
 
-int main(int const argc, char const * const argv[])
+/// Select how observables are stored based on the input.
+Observables::Mode observablesMode(ProgConfig const &input) noexcept
 {
-    // load / prepare files
-    auto const [infile, outdir] = parseArgs(argc, argv);
-    auto const input = YAML::LoadFile(infile).as<ProgConfig>();
-    prepareOutdir(outdir);
+    return input.meas.streaming ? Observables::Mode::STREAMING : Observables::Mode::HISTORY;
+}
 
-    Lattice const lat{input.lattice.shape, input.lattice.maxDist, input.lattice.distfn};
-    Rng rng{size(lat), input.rngSeed};
 
-    // initial state
-    Configuration cfg = (input.mc.start==ProgConfig::MC::HOT) ?
-        randomCfg(size(lat), rng) : Configuration{size(lat), Spin{+1}};
-    double energy = 0.0;  // it doesn't matter for the initial thermalisation
+/// Construct empty observables with storage mode and measurement intervals selected by the input.
+Observables makeObservables(Lattice const &lat, ProgConfig const &input)
+{
+    return Observables(lat, input.meas.correlatorMethod, observablesMode(input),
+                       input.meas.intervals);
+}
+
+
+/// Create the initial configuration selected by input.mc.start, hot starts draw spins from rng.
+/**
+ * Spins are drawn in row-major order, so the start does not depend on the site layout.
+ */
+Configuration initialCfg(Lattice const &lat, ProgConfig const &input, Rng &rng)
+{
+    switch (input.mc.start) {
+    case ProgConfig::MC::HOT:
+        return fromRowMajor(randomCfg(size(lat), rng), lat);
+    case ProgConfig::MC::STORED:
+        return fromRowMajor(readCfgRecord(input.mc.startFile, input.mc.startRecord, lat.shape()),
+                            lat);
+    case ProgConfig::MC::COLD:
+        break;
+    }
+    return Configuration{size(lat), Spin{+1}};
+}
+
+
+/// Print running statistics of energy and magnetisation if available.
+void printSummary(Observables const &obs, std::ostream &os=std::cout)
+{
+    if (not obs.summary) {
+        return;
+    }
+    for (auto const &[name, acc] : {std::pair{"Energy", &obs.summary->energy},
+                                    std::pair{"Magnetisation", &obs.summary->magnetisation}}) {
+        os << "  " << name << ": " << std::setprecision(6) << acc->mean()
+                  << " +- " << std::setprecision(2) << acc->error()
+                  << " (tau_int = " << std::setprecision(3) << acc->tauInt() << ")\n";
+    }
+}
+
+
+/// Measurement for a MeasurementSet that writes configurations.
+/**
+ * Configurations are written in row-major order regardless of the layout of the lattice.
+ */
+template <typename Cfg>
+struct CfgOutput
+{
+    /// Writer to use, must outlive the measurement. interval must be 0 if nullptr.
+    CfgWriter *writer = nullptr;
+    size_t interval = 0;
+
+    void operator()(ChainState<Cfg> const &state) const
+    {
+        ScopedTimer const timer{Phase::CFG_OUTPUT};
+        if constexpr (std::is_same_v<Cfg, Configuration>) {
+            if (state.lat.layout() != Lattice::SiteLayout::ROW_MAJOR) {
+                writer->write(toRowMajor(state.cfg, state.lat));
+                return;
+            }
+        }
+        writer->write(state.cfg);
+    }
+};
+
+/// Measurements of a chain besides its Observables.
+/**
+ * Fixed at compile time so the update schemes inline them.
+ */
+template <typename Cfg>
+using ChainMeasurements = MeasurementSet<CfgOutput<Cfg>, DynamicMeasurements<Cfg>>;
+
+/// Return measurements that perform nothing.
+template <typename Cfg>
+ChainMeasurements<Cfg> noMeasurements()
+{
+    return ChainMeasurements<Cfg>{CfgOutput<Cfg>{}, DynamicMeasurements<Cfg>{nullptr, 0}};
+}
+
+
+/// Return a configuration in row-major layout with one int per spin.
+Configuration unpacked(Configuration const &cfg, Lattice const &lat)
+{
+    return toRowMajor(cfg, lat);
+}
+
+/// Return a configuration in row-major layout with one int per spin.
+Configuration unpacked(PackedConfiguration const &cfg, Lattice const &)
+{
+    return cfg.unpack();
+}
+
+
+/// Thermalise and run production for all ensembles of a warm start chain.
+/**
+ * \param cfg Initial configuration.
+ * \param update Function with the same signature as evolve() except for
+ *               lattice and rng which selects the update scheme.
+ *               Takes a ChainMeasurements<Cfg> instead of a vector of measurements.
+ * \param rng Main random number generator, only used to save and restore checkpoints.
+ * \param threadRngs Generators of parallel update schemes,
+ *                   only used to save and restore checkpoints.
+ * \param nclustersPerSweep Number of clusters per sweep used by Wolff updates.
+ *                          Reset to 0 before each ensemble such that update calibrates it once,
+ *                          otherwise only used to save and restore checkpoints.
+ * \param restart If true, continue from the checkpoint in outdir instead
+ *                of starting with thermalisation of the first ensemble.
+ *                Requires chain to hold all ensembles.
+ * \param chain Indices of the ensembles to run in order.
+ * \param log Stream to print progress to.
+ * \returns Profiles of all ensembles that were run.
+ */
+template <typename Cfg, typename Lat, typename Update>
+std::vector<EnsembleProfile> run(Cfg cfg, ProgConfig const &input, fs::path const &outdir,
+         Lat const &lat, Update const &update,
+         Rng &rng, std::vector<Rng> &threadRngs, size_t &nclustersPerSweep,
+         bool const restart, Chain const &chain, std::ostream &log)
+{
+    std::int64_t coupling;  // see couplingSum(), kept up to date by update
     double accRate;
 
-    // initial thermalisation
-    auto startTime = Clock::now();
-    std::tie(cfg, energy, accRate) = evolve(cfg, energy, input.params.at(0), lat,
-                                            rng, input.mc.nthermInit, nullptr);
-    auto endTime = Clock::now();
-    std::cout << "Initial thermalisation acceptance rate: " << std::setprecision(4)
-              << accRate << '\n'
-              << "Run time: " << std::chrono::duration_cast<Milliseconds>(endTime-startTime).count()
-              << "ms\n";
+    // cluster updates always flip clusters, report their size instead
+    bool const clusterUpdate = input.mc.update == ProgConfig::MC::WOLFF
+        or input.mc.update == ProgConfig::MC::SWENDSEN_WANG;
+    std::string const rateName = clusterUpdate ? "mean cluster size" : "acceptance rate";
 
-    for (size_t i = 0; i < std::size(input.params); ++i) {
+    std::vector<EnsembleProfile> profiles;
+    std::optional<Checkpoint> checkpoint;
+    std::optional<Observables> restartObs;
+    if (restart) {
+        restartObs.emplace(makeObservables(lat, input));
+        checkpoint = loadCheckpoint(outdir/checkpointFname, *restartObs);
+        restartObs->nsweep = checkpoint->sweep;
+        if (checkpoint->rngSeed != input.rngSeed or checkpoint->shape != lat.shape()
+            or checkpoint->ensemble >= std::size(input.params)
+            or std::size(checkpoint->threadRngs) != std::size(threadRngs)
+            or checkpoint->rng.generator() != input.rngGenerator) {
+            throw std::runtime_error("Checkpoint does not match the input file");
+        }
+        if constexpr (std::is_same_v<Cfg, PackedConfiguration>) {
+            cfg = PackedConfiguration{checkpoint->cfg, lat};
+        }
+        else {
+            cfg = fromRowMajor(checkpoint->cfg, lat);
+        }
+        rng = checkpoint->rng;
+        threadRngs = checkpoint->threadRngs;
+        nclustersPerSweep = checkpoint->nclustersPerSweep;
+        coupling = checkpoint->coupling;
+        log << "Restarting from checkpoint in ensemble " << checkpoint->ensemble
+            << " after " << checkpoint->sweep << " production sweeps\n";
+    }
+    else {
+        // initial thermalisation
+        auto const startTime = Clock::now();
+        coupling = couplingSum(cfg, lat);
+        {
+            ScopedTimer const timer{Phase::UPDATE};
+            auto noMeas = noMeasurements<Cfg>();
+            std::tie(cfg, std::ignore, std::ignore, accRate) = update(
+                cfg, coupling, input.params.at(chain.front()), input.mc.nthermInit, nullptr,
+                noMeas);
+        }
+        auto const endTime = Clock::now();
+        log << "Initial thermalisation " << rateName << ": " << std::setprecision(4)
+            << accRate << '\n'
+            << "Run time: " << std::chrono::duration_cast<Milliseconds>(endTime-startTime).count()
+            << "ms\n";
+    }
+
+    for (size_t k = checkpoint ? checkpoint->ensemble : 0; k < std::size(chain); ++k) {
+        size_t const i = chain[k];
         auto const params = input.params.at(i);
         auto const ntherm = input.mc.ntherm.at(i);
         auto const nprod = input.mc.nprod.at(i);
+        // continue this ensemble from the checkpoint
+        bool const resume = checkpoint and checkpoint->ensemble == i;
+        Profiler profiler;
+        ProfileScope const profileScope{&profiler};
 
-        // (re-)compute energy with this set of parameters
-        energy = hamiltonian(cfg, params, lat);
+        if (not resume) {
+            nclustersPerSweep = 0;
+        }
 
-        std::vector<Measurement> meas;
+        std::optional<CfgWriter> cfgWriter;
         if (input.meas.writeCfg) {
-            meas.emplace_back([&dir=outdir, i,  &params, &lat](Configuration const &c, double const)
-                              {
-                                  write(dir, i, c, params, lat);
-                              });
+            if (resume) {
+                cfgWriter.emplace(outdir, i, checkpoint->cfgFileSize, input.meas.cfgFormat);
+            }
+            else {
+                cfgWriter.emplace(outdir, i, params, lat, input.meas.cfgFormat);
+            }
         }
 
-        std::cout << "Running with {J/kT = " << params.JT
-                  << ", h/kT = " << params.hT << "}\n";
+        log << "Running with {J/kT = " << params.JT
+            << ", h/kT = " << params.hT << "}\n";
 
         // (re-)thermalise
-        startTime = Clock::now();
-        std::tie(cfg, energy, accRate) = evolve(cfg, energy, params,
-                                                lat, rng, ntherm, nullptr);
-        std::cout << "  Thermalisation acceptance rate: " << std::setprecision(4)
-                  << accRate << '\n';
+        auto const startTime = Clock::now();
+        if (not resume) {
+            ScopedTimer const timer{Phase::UPDATE};
+            auto noMeas = noMeasurements<Cfg>();
+            std::tie(cfg, std::ignore, std::ignore, accRate) = update(cfg, coupling, params,
+                                                                      ntherm, nullptr, noMeas);
+            log << "  Thermalisation " << rateName << ": " << std::setprecision(4)
+                << accRate << '\n';
+        }
 
         // measure
-        Observables obs(lat);
-        std::tie(cfg, energy, accRate) = evolve(cfg, energy, params,
-                                                lat, rng, nprod, &obs, meas);
-        endTime = Clock::now();
-        std::cout << "  Production acceptance rate: " << std::setprecision(4)
+        Observables obs = resume
+            ? std::move(*restartObs)
+            : makeObservables(lat, input);
+        size_t sweep = resume ? checkpoint->sweep : 0;
+        size_t const nsweepRun = (resume ? 0 : ntherm) + nprod - sweep;  // in this invocation
+        double rateSum = resume ? checkpoint->rateSum : 0.0;
+
+        // writes configurations of production sweeps 0, cfgInterval, 2*cfgInterval, ...
+        CfgOutput<Cfg> const cfgOutput{cfgWriter ? &*cfgWriter : nullptr,
+                                       cfgWriter ? input.meas.cfgInterval : 0};
+
+        MeasurementSet asyncCfgOutput{CfgOutput<Cfg>{}};
+        std::vector<MeasurementFor<Cfg>> pushToPipeline;
+        std::optional<AsyncMeasurements<Cfg>> pipeline;
+        if (input.meas.async) {
+            // measure observables and write configurations in the background
+            // configurations may be dropped by the pipeline, so both follow the sweep of the chain
+            asyncCfgOutput = MeasurementSet{cfgOutput};
+            std::vector<typename AsyncMeasurements<Cfg>::Measurement> asyncMeas{
+                [&obs, &lat](Cfg const &c, double const e, size_t const s)
+                {
+                    obs.nsweep = s;
+                    measure(obs, lat, c, e);
+                },
+                [&asyncCfgOutput, m=asMeasurement<Cfg>(asyncCfgOutput, lat)]
+                (Cfg const &c, double const e, size_t const s)
+                {
+                    asyncCfgOutput.setSweep(s);
+                    m(c, e);
+                }};
+            if constexpr (profiling) {
+                // the pipeline thread shall count towards this ensemble as well
+                for (auto &m : asyncMeas) {
+                    m = [&profiler, m=std::move(m)](Cfg const &c, double const e, size_t const s)
+                        {
+                            ProfileScope const scope{&profiler};
+                            m(c, e, s);
+                        };
+                }
+            }
+            pipeline.emplace(std::move(asyncMeas), input.meas.bufferSize,
+                             input.meas.backpressure);
+            pipeline->setSweep(sweep);
+            pushToPipeline = {pipeline->measurement()};
+        }
+        ChainMeasurements<Cfg> meas = pipeline
+            ? ChainMeasurements<Cfg>{CfgOutput<Cfg>{},
+                                     DynamicMeasurements<Cfg>{&pushToPipeline, 1}}
+            : ChainMeasurements<Cfg>{cfgOutput, DynamicMeasurements<Cfg>{nullptr, 0}};
+        meas.setSweep(sweep);
+        Observables * const syncObs = pipeline ? nullptr : &obs;
+
+        auto const saveState = [&] {
+            ScopedTimer const timer{Phase::CHECKPOINT};
+            if (pipeline) {
+                pipeline->flush();
+            }
+            saveCheckpoint(outdir/checkpointFname,
+                           Checkpoint{input.rngSeed, lat.shape(), i, sweep, rateSum,
+                                      nclustersPerSweep, unpacked(cfg, lat),
+                                      coupling, rng, threadRngs,
+                                      cfgWriter ? cfgWriter->flush() : 0},
+                           obs);
+        };
+
+        // run in chunks of checkpointInterval sweeps or all at once if checkpoints are disabled
+        size_t const chunk = input.mc.checkpointInterval > 0 ? input.mc.checkpointInterval : nprod;
+        if (input.mc.checkpointInterval > 0 and not resume) {
+            saveState();  // no need to thermalise again after a restart
+        }
+        while (sweep < nprod) {
+            size_t const nsweep = std::min(chunk, nprod-sweep);
+            {
+                ScopedTimer const timer{Phase::UPDATE};
+                std::tie(cfg, std::ignore, std::ignore, accRate) = update(cfg, coupling, params,
+                                                                          nsweep, syncObs, meas);
+            }
+            sweep += nsweep;
+            rateSum += accRate*static_cast<double>(nsweep);
+            if (input.mc.checkpointInterval > 0) {
+                saveState();
+            }
+        }
+        accRate = nprod > 0 ? rateSum/static_cast<double>(nprod) : 0.0;
+
+        if (pipeline) {
+            pipeline->flush();
+            if (pipeline->nskipped() > 0) {
+                log << "  Skipped measurements: " << pipeline->nskipped() << '\n';
+            }
+        }
+        auto const endTime = Clock::now();
+        log << "  Production " << rateName << ": " << std::setprecision(4)
+            << accRate << '\n'
+            << "  Run time: " << std::chrono::duration_cast<Milliseconds>(endTime-startTime).count()
+            << "ms\n";
+        printSummary(obs, log);
+
+        {
+            ScopedTimer const timer{Phase::OUTPUT};
+            write(outdir, i, obs, params, lat, input.meas.format);
+        }
+        profiles.push_back(EnsembleProfile{
+                i, params, nsweepRun, size(lat).get(),
+                std::chrono::duration<double>(Clock::now()-startTime).count(),
+                profiler.totals(), peakRss()});
+    }
+    return profiles;
+}
+
+
+/// Print acceptance rates of replica swaps.
+void printSwapRates(std::vector<double> const &swapRates, std::vector<Parameters> const &params)
+{
+    for (size_t i = 0; i < std::size(swapRates); ++i) {
+        std::cout << "  Swap acceptance rate {J/kT = " << params[i].JT
+                  << ", h/kT = " << params[i].hT << "} <-> {J/kT = " << params[i+1].JT
+                  << ", h/kT = " << params[i+1].hT << "}: " << std::setprecision(4)
+                  << swapRates[i] << '\n';
+    }
+}
+
+
+/// Thermalise and run production for all ensembles concurrently using replica exchange.
+/**
+ * All replicas start from cfg and are thermalised for input.mc.nthermInit sweeps
+ * with swaps, input.mc.ntherm is not used.
+ */
+template <typename Lat>
+void runReplicaExchange(Configuration const &cfg, ProgConfig const &input,
+                        fs::path const &outdir, Lat const &lat, Rng &rng)
+{
+    auto const &params = input.params;
+    size_t const nreplicas = std::size(params);
+
+    std::vector<Replica> replicas;
+    for (size_t i = 0; i < nreplicas; ++i) {
+        replicas.push_back(Replica{cfg, couplingSum(cfg, lat),
+                                   Rng{size(lat), input.rngSeed, i+1, input.rngGenerator}});
+    }
+    ThreadPool pool{std::min(input.mc.nthreads, nreplicas)};
+    std::vector<double> accRates, swapRates;
+
+    // thermalisation
+    auto startTime = Clock::now();
+    std::tie(replicas, accRates, swapRates) = replicaExchange(
+        std::move(replicas), params, lat, rng, input.mc.nthermInit,
+        input.mc.swapInterval, pool, nullptr);
+    auto endTime = Clock::now();
+    std::cout << "Thermalisation of " << nreplicas << " replicas on "
+              << pool.size() << " threads\n";
+    for (size_t i = 0; i < nreplicas; ++i) {
+        std::cout << "  Thermalisation acceptance rate {J/kT = " << params[i].JT
+                  << ", h/kT = " << params[i].hT << "}: " << std::setprecision(4)
+                  << accRates[i] << '\n';
+    }
+    printSwapRates(swapRates, params);
+    std::cout << "Run time: " << std::chrono::duration_cast<Milliseconds>(endTime-startTime).count()
+              << "ms\n";
+
+    // measure
+    std::vector<Observables> obs;
+    std::vector<CfgWriter> cfgWriters;
+    std::vector<MeasurementSet<CfgOutput<Configuration>>> cfgOutputs;
+    // writers and outputs must not move once measurements refer to them
+    cfgWriters.reserve(nreplicas);
+    cfgOutputs.reserve(nreplicas);
+    std::vector<std::vector<Measurement>> meas(nreplicas);
+    for (size_t i = 0; i < nreplicas; ++i) {
+        obs.push_back(makeObservables(lat, input));
+        if (input.meas.writeCfg) {
+            auto &writer = cfgWriters.emplace_back(outdir, i, params[i], lat, input.meas.cfgFormat);
+            auto &output = cfgOutputs.emplace_back(
+                CfgOutput<Configuration>{&writer, input.meas.cfgInterval});
+            meas[i].push_back(asMeasurement<Configuration>(output, lat));
+        }
+    }
+
+    startTime = Clock::now();
+    std::tie(replicas, accRates, swapRates) = replicaExchange(
+        std::move(replicas), params, lat, rng, input.mc.nprod.at(0),
+        input.mc.swapInterval, pool, &obs, meas);
+    endTime = Clock::now();
+    for (size_t i = 0; i < nreplicas; ++i) {
+        std::cout << "Running with {J/kT = " << params[i].JT
+                  << ", h/kT = " << params[i].hT << "}\n"
+                  << "  Production acceptance rate: " << std::setprecision(4)
+                  << accRates[i] << '\n';
+        printSummary(obs[i]);
+        write(outdir, i, obs[i], params[i], lat, input.meas.format);
+    }
+    printSwapRates(swapRates, params);
+    std::cout << "Run time: " << std::chrono::duration_cast<Milliseconds>(endTime-startTime).count()
+              << "ms\n";
+}
+
+
+/// Set up rngs and initial state and run one warm start chain on a given lattice.
+/**
+ * \param chainIndex Index of the chain in the scan, selects independent rng streams.
+ *                   Chain 0 uses the same streams as a run without concurrent chains.
+ * \param nthreads Number of threads for parallel update schemes.
+ * \returns Profiles of all ensembles that were run.
+ */
+template <typename Lat>
+std::vector<EnsembleProfile> runChain(Lat const &lat, ProgConfig const &input, fs::path const &outdir,
+              Chain const &chain, size_t const chainIndex, size_t const nthreads,
+              bool const restart, std::ostream &log)
+{
+    // leave room for the thread rngs of all previous chains
+    unsigned long const firstStream = chainIndex*(input.mc.nthreads+1);
+    Rng rng = chainIndex == 0
+        ? Rng{size(lat), input.rngSeed, input.rngGenerator}
+        : Rng{size(lat), input.rngSeed, firstStream, input.rngGenerator};
+
+    // independent streams for parallel update schemes
+    std::vector<Rng> threadRngs;
+    if (input.mc.update == ProgConfig::MC::CHECKERBOARD
+        or input.mc.storage == ProgConfig::MC::PACKED) {
+        for (size_t thread = 0; thread < nthreads; ++thread) {
+            threadRngs.emplace_back(size(lat), input.rngSeed, firstStream+thread+1,
+                                    input.rngGenerator);
+        }
+    }
+
+    // initial state
+    Configuration cfg = initialCfg(lat, input, rng);
+    size_t nclustersPerSweep = 0;
+
+    std::optional<GpuCheckerboard> gpu;
+    if (input.mc.device == ProgConfig::MC::GPU) {
+        gpu.emplace(lat, input.rngSeed);
+    }
+
+    if (input.mc.storage == ProgConfig::MC::PACKED) {
+        return run(PackedConfiguration{cfg, lat}, input, outdir, lat,
+            [&](PackedConfiguration c, std::int64_t &k, Parameters const &params,
+                size_t const nsweep, Observables * const obs,
+                ChainMeasurements<PackedConfiguration> &meas) {
+                return evolveCheckerboard(std::move(c), k, params, lat, threadRngs, nsweep, obs,
+                                          meas);
+            }, rng, threadRngs, nclustersPerSweep, restart, chain, log);
+    }
+    else {
+        return run(std::move(cfg), input, outdir, lat,
+            [&](Configuration c, std::int64_t &k, Parameters const &params,
+                size_t const nsweep, Observables * const obs,
+                ChainMeasurements<Configuration> &meas) {
+                switch (input.mc.update) {
+                case ProgConfig::MC::SEQUENTIAL:
+                    return evolveLocal(std::move(c), k, params, lat, rng, nsweep, obs, meas,
+                                       input.mc.localUpdate, SiteOrder::TYPEWRITER);
+                case ProgConfig::MC::CHECKERBOARD_SEQUENTIAL:
+                    return evolveLocal(std::move(c), k, params, lat, rng, nsweep, obs, meas,
+                                       input.mc.localUpdate, SiteOrder::CHECKERBOARD);
+                case ProgConfig::MC::CHECKERBOARD:
+                    if (gpu) {
+                        return evolveGpu(std::move(c), k, params, *gpu, nsweep, obs, meas);
+                    }
+                    return evolveCheckerboard(std::move(c), k, params, lat, threadRngs,
+                                              nsweep, obs, meas, input.mc.simd);
+                case ProgConfig::MC::WOLFF:
+                    return evolveWolff(std::move(c), k, params, lat, rng, nsweep, obs, meas,
+                                       &nclustersPerSweep);
+                case ProgConfig::MC::SWENDSEN_WANG:
+                    return evolveSwendsenWang(std::move(c), k, params, lat, rng, nsweep, obs,
+                                              meas);
+                case ProgConfig::MC::RANDOM:
+                    break;
+                }
+                return evolveLocal(std::move(c), k, params, lat, rng, nsweep, obs, meas,
+                                   input.mc.localUpdate, SiteOrder::RANDOM);
+            }, rng, threadRngs, nclustersPerSweep, restart, chain, log);
+    }
+}
+
+
+/// Run all ensembles on a given lattice.
+/**
+ * Without replica exchange, ensembles are split into input.mc.scanChains warm start chains
+ * which run concurrently and share the threads given by input.mc.nthreads.
+ *
+ * \param restart Continue from the checkpoint in outdir, see run().
+ *                Must be false for replica exchange and several chains.
+ * \returns Profiles of all ensembles that were run, sorted by index.
+ *          Empty for replica exchange where replicas share threads
+ *          and their phases cannot be told apart.
+ */
+template <typename Lat>
+std::vector<EnsembleProfile> simulate(Lat const &lat, ProgConfig const &input,
+                                      fs::path const &outdir, bool const restart)
+{
+    if (input.mc.tempering) {
+        Rng rng{size(lat), input.rngSeed, input.rngGenerator};
+        Configuration const cfg = initialCfg(lat, input, rng);
+        runReplicaExchange(cfg, input, outdir, lat, rng);
+        return {};
+    }
+
+    auto const chains = warmStartChains(std::size(input.params), input.mc.scanChains);
+    if (std::size(chains) == 1) {
+        return runChain(lat, input, outdir, chains[0], 0, input.mc.nthreads, restart, std::cout);
+    }
+
+    ThreadPool pool{std::min(input.mc.nthreads, std::size(chains))};
+    size_t const threadsPerChain = input.mc.nthreads / pool.size();
+    std::cout << "Running " << std::size(chains) << " warm start chains on "
+              << pool.size() << " threads\n";
+    // initial thermalisation of each chain counts towards the setup of the caller
+    Profiler * const setupProfiler = Profiler::active();
+    std::vector<std::vector<EnsembleProfile>> chainProfiles(std::size(chains));
+    auto const startTime = Clock::now();
+    runChains(chains, pool, std::cout,
+              [&](size_t const c, Chain const &chain, std::ostream &log) {
+                  ProfileScope const scope{setupProfiler};
+                  log << "Chain " << c << '\n';
+                  chainProfiles[c] = runChain(lat, input, outdir, chain, c, threadsPerChain,
+                                              false, log);
+              });
+    auto const endTime = Clock::now();
+    std::cout << "Total run time: "
+              << std::chrono::duration_cast<Milliseconds>(endTime-startTime).count() << "ms\n";
+
+    // chains are contiguous and in order, so ensembles are sorted
+    std::vector<EnsembleProfile> profiles;
+    for (auto &chainProfile : chainProfiles) {
+        profiles.insert(profiles.end(), chainProfile.begin(), chainProfile.end());
+    }
+    return profiles;
+}
+
+
+#ifdef ISING_MPI
+/// Thermalise and run production for all ensembles with the lattice distributed over MPI ranks.
+/**
+ * Must be called on all ranks of MPI_COMM_WORLD. Only rank 0 prints and writes output.
+ */
+void runDistributed(ProgConfig const &input, fs::path const &outdir)
+{
+    // phases outside of ensembles
+    Profiler setup;
+    ProfileScope const profileScope{&setup};
+    std::vector<EnsembleProfile> profiles;
+
+    // the distance map is all that is needed of the global lattice
+    Lattice const lat = makeLattice<Lattice>(input.lattice, Lattice::NeighbourMode::STENCIL);
+    Decomposition const decomp{lat, input.mc.ranks, MPI_COMM_WORLD};
+    bool const root = decomp.rank() == 0;
+
+    SiteRng rng{input.rngSeed, 0};
+    DistributedConfiguration cfg = input.mc.start == ProgConfig::MC::STORED
+        ? scatter(readCfgRecord(input.mc.startFile, input.mc.startRecord, lat.shape()), decomp)
+        : input.mc.start == ProgConfig::MC::HOT ? randomCfg(decomp, rng) : coldCfg(decomp);
+    std::int64_t coupling = couplingSum(cfg, decomp);
+    double accRate;
+
+    auto const startTime = Clock::now();
+    {
+        ScopedTimer const timer{Phase::UPDATE};
+        std::tie(cfg, std::ignore, std::ignore, accRate) = evolveDistributed(
+            std::move(cfg), coupling, input.params.at(0), decomp, rng, input.mc.nthermInit, nullptr);
+    }
+    auto const endTime = Clock::now();
+    if (root) {
+        std::cout << "Initial thermalisation acceptance rate: " << std::setprecision(4)
                   << accRate << '\n'
-                  << "  Run time: " << std::chrono::duration_cast<Milliseconds>(endTime-startTime).count()
+                  << "Run time: " << std::chrono::duration_cast<Milliseconds>(endTime-startTime).count()
                   << "ms\n";
+    }
+
+    for (size_t i = 0; i < std::size(input.params); ++i) {
+        auto const params = input.params.at(i);
+        Profiler profiler;
+        ProfileScope const ensembleScope{&profiler};
+        if (root) {
+            std::cout << "Running with {J/kT = " << params.JT
+                      << ", h/kT = " << params.hT << "}\n";
+        }
+
+        auto const ensembleStart = Clock::now();
+        {
+            ScopedTimer const timer{Phase::UPDATE};
+            std::tie(cfg, std::ignore, std::ignore, accRate) = evolveDistributed(
+                std::move(cfg), coupling, params, decomp, rng, input.mc.ntherm.at(i), nullptr);
+        }
+        if (root) {
+            std::cout << "  Thermalisation acceptance rate: " << std::setprecision(4)
+                      << accRate << '\n';
+        }
+
+        // measurements are reduced onto all ranks
+        Observables obs = makeObservables(lat, input);
+        {
+            ScopedTimer const timer{Phase::UPDATE};
+            std::tie(cfg, std::ignore, std::ignore, accRate) = evolveDistributed(
+                std::move(cfg), coupling, params, decomp, rng, input.mc.nprod.at(i), &obs);
+        }
+        auto const ensembleEnd = Clock::now();
+        if (root) {
+            std::cout << "  Production acceptance rate: " << std::setprecision(4)
+                      << accRate << '\n'
+                      << "  Run time: "
+                      << std::chrono::duration_cast<Milliseconds>(ensembleEnd-ensembleStart).count()
+                      << "ms\n";
+            printSummary(obs);
+            ScopedTimer const timer{Phase::OUTPUT};
+            write(outdir, i, obs, params, lat, input.meas.format);
+        }
+        profiles.push_back(EnsembleProfile{
+                i, params, input.mc.ntherm.at(i) + input.mc.nprod.at(i), size(lat).get(),
+                std::chrono::duration<double>(Clock::now()-ensembleStart).count(),
+                profiler.totals(), peakRss()});
+    }
+
+    if constexpr (profiling) {
+        if (root) {
+            writeProfile(outdir/profileFname, setup.totals(), profiles);
+        }
+    }
+}
+#endif
+
+
+/// Run the simulation described by the command line arguments.
+void runMain(int const argc, char const * const argv[])
+{
+    // load / prepare files
+    auto const [infile, outdir, restart] = parseArgs(argc, argv);
+    auto const input = YAML::LoadFile(infile).as<ProgConfig>();
+    // check before anything is written to outdir
+    if (restart and input.mc.tempering) {
+        throw std::runtime_error("Restarting is not supported with replica exchange");
+    }
+    if (restart and input.mc.scanChains != 1 and std::size(input.params) > 1) {
+        throw std::runtime_error("Restarting is not supported with concurrent chains");
+    }
+
+#ifdef ISING_MPI
+    int nranks, rank;
+    MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (not std::empty(input.mc.ranks)) {
+        if (restart) {
+            throw std::runtime_error("Restarting is not supported for distributed runs");
+        }
+        if (rank == 0) {
+            prepareOutdir(outdir);
+        }
+        runDistributed(input, outdir);
+        return;
+    }
+    if (nranks > 1) {
+        throw std::runtime_error("Running on several MPI ranks requires input param 'ranks'");
+    }
+#else
+    if (not std::empty(input.mc.ranks)) {
+        throw std::runtime_error("Input param 'ranks' requires a build with ISING_MPI");
+    }
+#endif
 
-        write(outdir, i, obs, params, lat);
+    if (input.mc.device == ProgConfig::MC::GPU and not gpuAvailable()) {
+        std::cerr << "Warning: No GPU backend available, running checkerboard updates "
+                     "for 'device: gpu' on the host\n";
+    }
+
+    if (not restart) {
+        prepareOutdir(outdir);
+    }
+
+    // phases outside of ensembles
+    Profiler setup;
+    ProfileScope const profileScope{&setup};
+    std::vector<EnsembleProfile> profiles;
+
+    // use a lattice with compile time number of dimensions if possible,
+    // those always store their neighbours
+    auto const &latIn = input.lattice;
+    bool const stored = latIn.neighbourMode == Lattice::NeighbourMode::STORED;
+    switch (stored ? std::size(latIn.shape) : 0) {
+    case 1:
+        profiles = simulate(makeLattice<FixedLattice<1>>(latIn, latIn.neighbourMode),
+                            input, outdir, restart);
+        break;
+    case 2:
+        profiles = simulate(makeLattice<FixedLattice<2>>(latIn, latIn.neighbourMode),
+                            input, outdir, restart);
+        break;
+    case 3:
+        profiles = simulate(makeLattice<FixedLattice<3>>(latIn, latIn.neighbourMode),
+                            input, outdir, restart);
+        break;
+    case 4:
+        profiles = simulate(makeLattice<FixedLattice<4>>(latIn, latIn.neighbourMode),
+                            input, outdir, restart);
+        break;
+    default:
+        profiles = simulate(makeLattice<Lattice>(latIn, latIn.neighbourMode),
+                            input, outdir, restart);
+    }
+
+    if constexpr (profiling) {
+        writeProfile(outdir/profileFname, setup.totals(), profiles);
+    }
+}
+
+
+int main(int const argc, char const * const argv[])
+{
+#ifdef ISING_MPI
+    MPI_Init(nullptr, nullptr);
+    try {
+        runMain(argc, argv);
+    }
+    catch (std::exception const &e) {
+        // other ranks might be blocked in collective operations
+        std::cerr << "Error: " << e.what() << '\n';
+        MPI_Abort(MPI_COMM_WORLD, 1);
     }
+    MPI_Finalize();
+#else
+    runMain(argc, argv);
+#endif
 }
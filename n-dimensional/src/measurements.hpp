@@ -0,0 +1,215 @@
+#ifndef ISING_MEASUREMENTS_HPP
+#define ISING_MEASUREMENTS_HPP
+
+#include <cmath>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "configuration.hpp"
+#include "lattice.hpp"
+#include "montecarlo.hpp"
+#include "packedconfiguration.hpp"
+
+/// State of a Markov chain after a sweep that is passed to measurements.
+/**
+ * Energy and magnetisation are tracked by the sweeps,
+ * so measurements never need to recompute them from cfg.
+ */
+template <typename Cfg>
+struct ChainState
+{
+    Cfg const &cfg;
+    double energy;         ///< Energy of cfg.
+    double magnetisation;  ///< Magnetisation per site of cfg.
+    Lattice const &lat;
+};
+
+/// Set of measurements that is fixed at compile time.
+/**
+ * Every measurement type M must provide
+ *   - a member `size_t interval`, the number of sweeps between measurements, 0 means never,
+ *   - `void operator()(ChainState<Cfg> const &)` which performs the measurement.
+ * The set is passed to the overloads of evolveLocal(), evolveCheckerboard(), evolveWolff(),
+ * and evolveSwendsenWang() in localupdate.hpp, checkerboardupdate.hpp, and clusterupdate.hpp
+ * which call it after every sweep,
+ * and it calls each measurement in sweeps 0, interval, 2*interval, ...
+ * counted from the construction of the set or the last call to setSweep().
+ * Since the types are known, measurements are inlined into the sweep loop.
+ * Other evolve functions take the set through asMeasurement().
+ * Custom observables only need a type like MagnetisationMoments, no changes to evolve functions.
+ */
+template <typename... Ms>
+class MeasurementSet
+{
+public:
+    explicit MeasurementSet(Ms... measurements)
+        : measurements_{std::move(measurements)...}
+    { }
+
+    /// Perform all measurements that are due in the current sweep and advance to the next.
+    template <typename Cfg>
+    void operator()(ChainState<Cfg> const &state)
+    {
+        std::apply([this, &state](auto &... m) { (measureIfDue(m, state), ...); },
+                   measurements_);
+        ++sweep_;
+    }
+
+    /// Return true if any measurement is due in the current sweep.
+    bool due() const noexcept
+    {
+        return std::apply([this](auto const &... m) { return (isDue(m) or ...); },
+                          measurements_);
+    }
+
+    /// Return true if no measurement is ever performed, i.e. all intervals are 0.
+    bool empty() const noexcept
+    {
+        return std::apply([](auto const &... m) { return ((m.interval == 0) and ...); },
+                          measurements_);
+    }
+
+    /// Advance to the next sweep without measuring, only valid if not due().
+    void skip() noexcept
+    {
+        ++sweep_;
+    }
+
+    /// Set the number of the current sweep, e.g. to continue a chain from a checkpoint.
+    void setSweep(std::size_t const sweep) noexcept
+    {
+        sweep_ = sweep;
+    }
+
+    /// Access measurement number I.
+    template <std::size_t I>
+    auto &get() noexcept
+    {
+        return std::get<I>(measurements_);
+    }
+
+    /// Access measurement number I.
+    template <std::size_t I>
+    auto const &get() const noexcept
+    {
+        return std::get<I>(measurements_);
+    }
+
+private:
+    template <typename M>
+    bool isDue(M const &measurement) const noexcept
+    {
+        return measurement.interval != 0 and sweep_ % measurement.interval == 0;
+    }
+
+    template <typename M, typename Cfg>
+    void measureIfDue(M &measurement, ChainState<Cfg> const &state)
+    {
+        if (isDue(measurement)) {
+            measurement(state);
+        }
+    }
+
+    std::tuple<Ms...> measurements_;
+    std::size_t sweep_ = 0;
+};
+
+/// Return a run time measurement that passes every configuration on to a measurement set.
+/**
+ * For evolve functions that take a std::vector<MeasurementFor<Cfg>>.
+ * The magnetisation is not tracked there, so it is recomputed from the configuration,
+ * but only in sweeps in which a measurement of the set is due.
+ * \param set Set to call, must outlive the returned measurement.
+ * \param lat Lattice of the configurations, must outlive the returned measurement.
+ */
+template <typename Cfg, typename... Ms>
+MeasurementFor<Cfg> asMeasurement(MeasurementSet<Ms...> &set, Lattice const &lat)
+{
+    return [&set, &lat](Cfg const &cfg, double const energy) {
+               if (set.due()) {
+                   set(ChainState<Cfg>{cfg, energy, magnetisation(cfg), lat});
+               }
+               else {
+                   set.skip();
+               }
+           };
+}
+
+/// Measurement that calls run time measurements of type MeasurementFor<Cfg>.
+/**
+ * Used by the evolve functions that take a std::vector<Measurement>
+ * and to combine run time measurements with compile time ones in a MeasurementSet.
+ */
+template <typename Cfg>
+struct DynamicMeasurements
+{
+    std::vector<MeasurementFor<Cfg>> const *measurements = nullptr;
+    std::size_t interval = 1;
+
+    void operator()(ChainState<Cfg> const &state) const
+    {
+        if (measurements) {
+            for (auto const &meas : *measurements) {
+                meas(state.cfg, state.energy);
+            }
+        }
+    }
+};
+
+/// Return a set that calls run time measurements after every sweep.
+/**
+ * For the vector overloads of the evolve functions which forward to those taking a set.
+ * The set is empty() if there are no measurements, so threaded updates need not
+ * synchronise for it.
+ * \param measurements Must outlive the returned set.
+ */
+template <typename Cfg>
+MeasurementSet<DynamicMeasurements<Cfg>>
+asMeasurementSet(std::vector<MeasurementFor<Cfg>> const &measurements)
+{
+    return MeasurementSet{DynamicMeasurements<Cfg>{&measurements,
+                                                   std::empty(measurements) ? 0u : 1u}};
+}
+
+/// Accumulate moments of the magnetisation for the susceptibility and the Binder cumulant.
+struct MagnetisationMoments
+{
+    std::size_t interval = 1;
+    std::size_t count = 0;
+    double volume = 0.0;
+    double sumAbs = 0.0;  ///< Sum of |m|.
+    double sum2 = 0.0;    ///< Sum of m^2.
+    double sum4 = 0.0;    ///< Sum of m^4.
+
+    template <typename Cfg>
+    void operator()(ChainState<Cfg> const &state) noexcept
+    {
+        double const m2 = state.magnetisation * state.magnetisation;
+        volume = static_cast<double>(size(state.lat).get());
+        ++count;
+        sumAbs += std::abs(state.magnetisation);
+        sum2 += m2;
+        sum4 += m2*m2;
+    }
+
+    /// Return the susceptibility with respect to h/kT, V (<m^2> - <|m|>^2).
+    /**
+     * Uses |m| since <m> vanishes on finite lattices without field.
+     */
+    double susceptibility() const noexcept
+    {
+        double const n = static_cast<double>(count);
+        return volume * (sum2/n - (sumAbs/n)*(sumAbs/n));
+    }
+
+    /// Return the Binder cumulant 1 - <m^4> / (3 <m^2>^2).
+    double binderCumulant() const noexcept
+    {
+        double const n = static_cast<double>(count);
+        return 1.0 - (sum4/n) / (3.0 * (sum2/n)*(sum2/n));
+    }
+};
+
+#endif  // ndef ISING_MEASUREMENTS_HPP
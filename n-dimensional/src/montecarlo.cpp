@@ -1,82 +1,397 @@
 #include "montecarlo.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
 
-using std::exp;
+#include "checkerboardupdate.hpp"
+#include "clusterupdate.hpp"
+#include "localupdate.hpp"
+#include "profile.hpp"
 
-Observables::Observables(Lattice const &lat)
-    : energy(), magnetisation(), corr(lat.sqDistances())
-{ }
+Observables::Observables(Lattice const &lat, Correlator::Method const corrMethod,
+                         Mode const mode, MeasurementIntervals const measIntervals)
+    : energy(), magnetisation(), fourierModes(lat.ndim().get()), corr(lat.sqDistances()),
+      summary(), histogram(), fourierSums(), intervals(measIntervals)
+{
+    if (corrMethod == Correlator::Method::FFT and intervals.correlator != 0) {
+        corr.fourier.emplace(lat, corr.sqDistances);
+    }
+    if (intervals.fourierModes != 0) {
+        fourierSums.emplace(lat);
+    }
+    if (intervals.histogram != 0) {
+        histogram.emplace();
+    }
+    if (mode == Mode::STREAMING) {
+        summary.emplace();
+        summary->correlator.resize(std::size(corr.sqDistances));
+        summary->fourierModes.resize(lat.ndim().get());
+    }
+}
+
+FourierSums::FourierSums(Lattice const &lat)
+    : shape_(lat.shape()), volume_(static_cast<double>(size(lat).get())),
+      phases_(), sums_(std::size(shape_))
+{
+    constexpr double pi = 3.14159265358979323846;
+    for (Index const extent : shape_) {
+        auto &phases = phases_.emplace_back();
+        double const k = 2.0 * pi / static_cast<double>(extent.get());
+        for (size_t x = 0; x < extent.get(); ++x) {
+            phases.emplace_back(std::polar(1.0, k * static_cast<double>(x)));
+        }
+    }
+}
 
 Observables::Correlator::Correlator(std::vector<int> &&sqd)
-    : sqDistances(std::move(sqd)), correlator()
+    : sqDistances(std::move(sqd)), correlator(), fourier()
 {
     correlator.resize(std::size(sqDistances));
 }
 
+Observables::Correlator::Fourier::Fourier(Lattice const &lat, std::vector<int> const &sqd)
+    : fft(lat.shape()), spins(lat.size().get()), displacements()
+{
+    for (int const sqDistance : sqd) {
+        auto &indices = displacements.emplace_back();
+        for (auto const &displacement : lat.displacementsWithSqDistance(sqDistance)) {
+            indices.emplace_back(totalIndex(displacement, lat.shape()));
+        }
+    }
+}
+
 
 namespace {
-    void measureCorrelator(Observables::Correlator &corr, Lattice const &lat, Configuration const &cfg)
+    /// Measure the spin-spin correlator using fast Fourier transforms.
+    /**
+     * Computes C(r) = 1/V sum_x s_x s_{x+r} for all displacements r as
+     * the inverse transform of |S(k)|^2 / V^2 and averages over displacements
+     * with the same distance.
+     * Passes the index of each distance in corr.sqDistances and the result to record.
+     */
+    template <typename Cfg, typename Record>
+    void measureCorrelatorFFT(Observables::Correlator &corr, Lattice const &lat, Cfg const &cfg,
+                              Record &&record)
     {
+        if (std::empty(corr.sqDistances)) {
+            return;
+        }
+
+        auto &[fft, spins, displacements] = corr.fourier.value();
+
+        for (Index i = 0_i; i < lat.size(); ++i) {
+            spins[i.get()] = FFT::Complex{static_cast<double>(cfg[i]), 0.0};
+        }
+        fft.forward(spins);
+        for (auto &s : spins) {
+            s = FFT::Complex{std::norm(s), 0.0};
+        }
+        fft.backward(spins);
+
+        double const volume = static_cast<double>(lat.size().get());
         for (size_t sqdi = 0; sqdi < std::size(corr.sqDistances); ++sqdi) {
-            Spin aux = Spin{0};
-            size_t n = 0;
-            for (auto const [i, j] : lat.pairsWithSqDistance(corr.sqDistances[sqdi])) {
-                aux = aux + cfg[i]*cfg[j];
-                ++n;
+            double aux = 0.0;
+            for (Index const r : displacements[sqdi]) {
+                aux += spins[r.get()].real();
             }
-            corr.correlator[sqdi].emplace_back(static_cast<double>(aux)/static_cast<double>(n));
+            record(sqdi, aux / (volume*volume*static_cast<double>(std::size(displacements[sqdi]))));
         }
     }
 
-    /// Measure observables if an instance of Observables is given.
-    void measure(Observables * const obs, Lattice const &lat,
-                 Configuration const &cfg, double const energy)
+    /// Measure the spin-spin correlator averaged over all pairs of sites with given distances.
+    /**
+     * Loops over all sites and all displacements with each distance,
+     * so costs O(V * number of displacements).
+     * Passes the index of each distance in corr.sqDistances and the result to record.
+     */
+    template <typename Cfg, typename Record>
+    void measureCorrelator(Observables::Correlator const &corr, Lattice const &lat, Cfg const &cfg,
+                           Record &&record)
     {
-        if (obs) {
-            obs->energy.emplace_back(energy);
-            obs->magnetisation.emplace_back(magnetisation(cfg));
-            measureCorrelator(obs->corr, lat, cfg);
+        MultiIndex const &shape = lat.shape();
+
+        for (size_t sqdi = 0; sqdi < std::size(corr.sqDistances); ++sqdi) {
+            auto const &displacements = lat.displacementsWithSqDistance(corr.sqDistances[sqdi]);
+
+            long long aux = 0;
+            MultiIndex index(std::size(shape), 0_i);
+            for (Index i = 0_i; i < lat.size(); ++i) {
+                Spin siteSum = Spin{0};
+                for (auto const &displacement : displacements) {
+                    siteSum = siteSum + cfg[displacedIndex(index, displacement, shape)];
+                }
+                aux += static_cast<long long>(cfg[i]*siteSum);
+                increment(index, shape);
+            }
+
+            double const npairs = static_cast<double>(lat.size().get())
+                * static_cast<double>(std::size(displacements));
+            record(sqdi, static_cast<double>(aux)/npairs);
         }
     }
+
+    /// Call f with a configuration in row-major order.
+    /**
+     * Copies cfg if the lattice uses the blocked layout.
+     * Packed configurations always use the row-major layout.
+     */
+    template <typename Cfg, typename F>
+    void withRowMajor(Cfg const &cfg, Lattice const &lat, F &&f)
+    {
+        if constexpr (std::is_same_v<Cfg, Configuration>) {
+            if (lat.layout() != Lattice::SiteLayout::ROW_MAJOR) {
+                f(toRowMajor(cfg, lat));
+                return;
+            }
+        }
+        f(cfg);
+    }
 }
 
 
-std::tuple<Configuration, double, double>
-evolve(Configuration cfg, double energy, Parameters const& params,
-       Lattice const &lat, Rng &rng, size_t const nsweep,
-       Observables * const obs, std::vector<Measurement> const & extraMeas)
+void record(Observables &obs, double const energy, double const magnetisation)
+{
+    if (obs.due(obs.intervals.energy)) {
+        if (obs.summary) {
+            obs.summary->energy.push(energy);
+        }
+        else {
+            obs.energy.emplace_back(energy);
+        }
+    }
+    if (obs.due(obs.intervals.magnetisation)) {
+        if (obs.summary) {
+            obs.summary->magnetisation.push(magnetisation);
+        }
+        else {
+            obs.magnetisation.emplace_back(magnetisation);
+        }
+    }
+}
+
+void recordCorrelator(Observables &obs, size_t const sqdi, double const value)
+{
+    if (obs.summary) {
+        obs.summary->correlator[sqdi].push(value);
+    }
+    else {
+        obs.corr.correlator[sqdi].emplace_back(value);
+    }
+}
+
+void recordFourierModes(Observables &obs, FourierSums const &fourierSums)
+{
+    for (size_t d = 0; d < fourierSums.nmodes(); ++d) {
+        double const value = fourierSums.squaredMagnitude(d);
+        if (obs.summary) {
+            obs.summary->fourierModes[d].push(value);
+        }
+        else {
+            obs.fourierModes[d].emplace_back(value);
+        }
+    }
+}
+
+void checkDrift(double const energy, std::int64_t const magn,
+                double const exactEnergy, std::int64_t const exactMagn,
+                Parameters const &params, Index const ndim, Index const volume)
 {
-    size_t naccept = 0;  // running number of accepted spin flips
+    if (magn != exactMagn) {
+        throw std::logic_error("Tracked magnetisation drifted from the configuration");
+    }
 
-    for (size_t sweep = 0; sweep < nsweep; ++sweep) {
-        for (size_t step = 0; step < size(lat).get(); ++step) {
-            Index const site = rng.genIndex();  // flip spin at this site
+    double const scale = 1.0 + std::abs(params.JT)*static_cast<double>(ndim.get())
+        + std::abs(params.hT);
+    if (std::abs(energy - exactEnergy) > 1e-8*scale*static_cast<double>(volume.get())) {
+        throw std::logic_error("Tracked energy drifted from the configuration");
+    }
+}
 
-            double const delta = deltaE(cfg, site, params, lat);  // proposed change in energy
+template <typename Cfg>
+void measure(Observables &obs, Lattice const &lat, Cfg const &cfg,
+             double const energy, double const magnetisation,
+             FourierSums const *fourierSums, std::optional<std::int64_t> const coupling)
+{
+    auto const recordCorr = [&obs](size_t const sqdi, double const value) {
+        recordCorrelator(obs, sqdi, value);
+    };
 
-            // Metropolis-Hastings accept-reject
-            // The first check is not necessary for this to be correct but avoids
-            // evaluating the costly exponential and RNG.
-            if (delta <= 0 or exp(-delta) > rng.genReal()) {
-                // accept change
-                cfg.flip(site);
-                energy += delta;
-                ++naccept;
+    ScopedTimer const timer{Phase::MEASUREMENT};
+    record(obs, energy, magnetisation);
+
+    if (obs.due(obs.intervals.correlator)) {
+        ScopedTimer const correlatorTimer{Phase::CORRELATOR};
+        withRowMajor(cfg, lat, [&](auto const &rowMajor) {
+            if (obs.corr.fourier) {
+                measureCorrelatorFFT(obs.corr, lat, rowMajor, recordCorr);
+            }
+            else {
+                measureCorrelator(obs.corr, lat, rowMajor, recordCorr);
             }
-            // else: discard
+        });
+    }
+    if (obs.due(obs.intervals.fourierModes)) {
+        if (not fourierSums) {
+            withRowMajor(cfg, lat, [&obs](auto const &rowMajor) {
+                obs.fourierSums->reset(rowMajor);
+            });
+            fourierSums = &*obs.fourierSums;
         }
+        recordFourierModes(obs, *fourierSums);
+    }
+    if (obs.due(obs.intervals.histogram)) {
+        double const volume = static_cast<double>(size(lat).get());
+        obs.histogram->add(coupling ? *coupling : couplingSum(cfg, lat),
+                           std::llround(magnetisation * volume));
+    }
+    nextSweep(obs);
+}
 
-        measure(obs, lat, cfg, energy);
+template <typename Cfg>
+void measure(Observables &obs, Lattice const &lat, Cfg const &cfg, double const energy)
+{
+    measure(obs, lat, cfg, energy, magnetisation(cfg));
+}
 
-        // perform extra measurements
-        for (auto const &meas : extraMeas) {
-            meas(cfg, energy);
-        }
+template void measure(Observables &obs, Lattice const &lat,
+                      Configuration const &cfg, double energy, double magnetisation,
+                      FourierSums const *fourierSums, std::optional<std::int64_t> coupling);
+template void measure(Observables &obs, Lattice const &lat,
+                      PackedConfiguration const &cfg, double energy, double magnetisation,
+                      FourierSums const *fourierSums, std::optional<std::int64_t> coupling);
+template void measure(Observables &obs, Lattice const &lat,
+                      Configuration const &cfg, double energy);
+template void measure(Observables &obs, Lattice const &lat,
+                      PackedConfiguration const &cfg, double energy);
+
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolve(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+       Lat const &lat, Rng &rng, size_t const nsweep,
+       Observables * const obs, std::vector<Measurement> const & extraMeas)
+{
+    DynamicMeasurements<Configuration> meas{&extraMeas};
+    return localSweeps<MetropolisRule, RandomSites>(std::move(cfg), coupling, params, lat, rng,
+                                                    nsweep, obs, meas);
+}
+
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveSequential(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+                 Lat const &lat, Rng &rng, size_t const nsweep,
+                 Observables * const obs, std::vector<Measurement> const & extraMeas,
+                 SiteOrder const order)
+{
+    DynamicMeasurements<Configuration> meas{&extraMeas};
+    return localSweepsInOrder<MetropolisRule>(std::move(cfg), coupling, params, lat, rng,
+                                              nsweep, obs, meas, order);
+}
+
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveLocal(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+            Lat const &lat, Rng &rng, size_t const nsweep,
+            Observables * const obs, std::vector<Measurement> const & extraMeas,
+            UpdateRule const rule, SiteOrder const order)
+{
+    DynamicMeasurements<Configuration> meas{&extraMeas};
+    switch (rule) {
+    case UpdateRule::HEAT_BATH:
+        return localSweepsInOrder<HeatBathRule>(std::move(cfg), coupling, params, lat, rng,
+                                                nsweep, obs, meas, order);
+    case UpdateRule::DEMON:
+        return localSweepsInOrder<DemonRule>(std::move(cfg), coupling, params, lat, rng,
+                                             nsweep, obs, meas, order);
+    case UpdateRule::METROPOLIS:
+        break;
     }
+    return localSweepsInOrder<MetropolisRule>(std::move(cfg), coupling, params, lat, rng,
+                                              nsweep, obs, meas, order);
+}
+
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveWolff(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+            Lat const &lat, Rng &rng, size_t const nsweep,
+            Observables * const obs, std::vector<Measurement> const & extraMeas,
+            size_t * const nclustersPerSweep)
+{
+    auto meas = asMeasurementSet(extraMeas);
+    return evolveWolff(std::move(cfg), coupling, params, lat, rng, nsweep, obs, meas,
+                       nclustersPerSweep);
+}
 
-    return std::make_tuple(std::move(cfg), energy,
-                           static_cast<double>(naccept)
-                           / static_cast<double>(nsweep)
-                           / static_cast<double>(size(lat).get()));
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveSwendsenWang(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+                   Lat const &lat, Rng &rng, size_t const nsweep,
+                   Observables * const obs, std::vector<Measurement> const & extraMeas)
+{
+    auto meas = asMeasurementSet(extraMeas);
+    return evolveSwendsenWang(std::move(cfg), coupling, params, lat, rng, nsweep, obs, meas);
+}
+
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveCheckerboard(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+                   Lat const &lat, std::vector<Rng> &rngs, size_t const nsweep,
+                   Observables * const obs, std::vector<Measurement> const & extraMeas,
+                   std::optional<SimdLevel> const simd)
+{
+    auto meas = asMeasurementSet(extraMeas);
+    return evolveCheckerboard(std::move(cfg), coupling, params, lat, rngs, nsweep, obs, meas,
+                              simd);
 }
+
+std::tuple<PackedConfiguration, double, double, double>
+evolveCheckerboard(PackedConfiguration cfg, std::int64_t &coupling, Parameters const& params,
+                   Lattice const &lat, std::vector<Rng> &rngs, size_t const nsweep,
+                   Observables * const obs, std::vector<PackedMeasurement> const & extraMeas)
+{
+    auto meas = asMeasurementSet(extraMeas);
+    return evolveCheckerboard(std::move(cfg), coupling, params, lat, rngs, nsweep, obs, meas);
+}
+
+
+// instantiate for all supported lattice types
+#define INSTANTIATE_EVOLVE(LAT)                                                 \
+    template std::tuple<Configuration, double, double, double>                  \
+    evolve(Configuration cfg, std::int64_t &coupling, Parameters const& params, \
+           LAT const &lat, Rng &rng, size_t const nsweep,                       \
+           Observables * const obs, std::vector<Measurement> const & extraMeas); \
+    template std::tuple<Configuration, double, double, double>                  \
+    evolveWolff(Configuration cfg, std::int64_t &coupling, Parameters const& params, \
+                LAT const &lat, Rng &rng, size_t const nsweep,                  \
+                Observables * const obs, std::vector<Measurement> const & extraMeas, \
+                size_t * const nclustersPerSweep);                              \
+    template std::tuple<Configuration, double, double, double>                  \
+    evolveSequential(Configuration cfg, std::int64_t &coupling, Parameters const& params, \
+                     LAT const &lat, Rng &rng, size_t const nsweep,             \
+                     Observables * const obs, std::vector<Measurement> const & extraMeas, \
+                     SiteOrder const order);                                    \
+    template std::tuple<Configuration, double, double, double>                  \
+    evolveLocal(Configuration cfg, std::int64_t &coupling, Parameters const& params, \
+                LAT const &lat, Rng &rng, size_t const nsweep,                  \
+                Observables * const obs, std::vector<Measurement> const & extraMeas, \
+                UpdateRule const rule, SiteOrder const order);                  \
+    template std::tuple<Configuration, double, double, double>                  \
+    evolveSwendsenWang(Configuration cfg, std::int64_t &coupling, Parameters const& params, \
+                       LAT const &lat, Rng &rng, size_t const nsweep,           \
+                       Observables * const obs, std::vector<Measurement> const & extraMeas); \
+    template std::tuple<Configuration, double, double, double>                  \
+    evolveCheckerboard(Configuration cfg, std::int64_t &coupling, Parameters const& params, \
+                       LAT const &lat, std::vector<Rng> &rngs, size_t const nsweep, \
+                       Observables * const obs, std::vector<Measurement> const & extraMeas, \
+                       std::optional<SimdLevel> const simd)
+
+INSTANTIATE_EVOLVE(Lattice);
+INSTANTIATE_EVOLVE(FixedLattice<1>);
+INSTANTIATE_EVOLVE(FixedLattice<2>);
+INSTANTIATE_EVOLVE(FixedLattice<3>);
+INSTANTIATE_EVOLVE(FixedLattice<4>);
+
+#undef INSTANTIATE_EVOLVE
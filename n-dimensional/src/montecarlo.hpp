@@ -1,39 +1,286 @@
 #ifndef ISING_MONTECARLO_HPP
 #define ISING_MONTECARLO_HPP
 
+#include <algorithm>
+#include <complex>
+#include <cstdint>
 #include <vector>
 #include <tuple>
 #include <functional>
+#include <optional>
 
 #include "configuration.hpp"
+#include "fft.hpp"
+#include "packedconfiguration.hpp"
 #include "ising.hpp"
 #include "rng.hpp"
+#include "simd.hpp"
+#include "statistics.hpp"
 
-using Measurement = std::function<void(Configuration const&, double)>;
+/// Measurement to perform on a configuration of given type and its energy.
+template <typename Cfg>
+using MeasurementFor = std::function<void(Cfg const&, double)>;
+using Measurement = MeasurementFor<Configuration>;
+using PackedMeasurement = MeasurementFor<PackedConfiguration>;
 
-/// Store Monte-Carlo history of observables.
+/// Number of sweeps between measurements of each observable, 0 means never.
+/**
+ * An observable is measured in sweeps 0, interval, 2*interval, ...
+ * counting the sweeps that were passed to measure().
+ */
+struct MeasurementIntervals
+{
+    size_t energy = 1;
+    size_t magnetisation = 1;
+    size_t correlator = 1;
+    size_t fourierModes = 0;
+    size_t histogram = 0;
+};
+
+/// Fourier sums of the spins at the smallest nonzero momentum along each dimension.
+/**
+ * Holds S_d = sum_x s_x exp(i k_d x_d) with k_d = 2 pi / shape[d].
+ * The sums can be computed from a configuration in O(V ndim) or updated
+ * in O(ndim) when a single spin is flipped.
+ */
+class FourierSums
+{
+public:
+    explicit FourierSums(Lattice const &lat);
+
+    /// Compute the sums from scratch.
+    template <typename Cfg>
+    void reset(Cfg const &cfg) noexcept(ndebug)
+    {
+        std::fill(begin(sums_), end(sums_), std::complex<double>{0.0, 0.0});
+        MultiIndex coords(std::size(shape_), 0_i);
+        for (Index site = 0_i; site < size(cfg); ++site) {
+            double const spin = static_cast<double>(cfg[site].get());
+            for (size_t d = 0; d < std::size(shape_); ++d) {
+                sums_[d] += spin * phases_[d][coords[d].get()];
+            }
+            increment(coords, shape_);
+        }
+    }
+
+    /// Update the sums after the spin at a site has been flipped to newSpin.
+    void flip(Index const site, Spin const newSpin) noexcept
+    {
+        double const delta = 2.0 * static_cast<double>(newSpin.get());
+        // row-major layout, the last dimension is contiguous
+        size_t rest = site.get();
+        for (size_t d = std::size(shape_); d-- > 0;) {
+            size_t const extent = shape_[d].get();
+            sums_[d] += delta * phases_[d][rest % extent];
+            rest /= extent;
+        }
+    }
+
+    /// Return S_d.
+    std::complex<double> sum(size_t const d) const noexcept
+    {
+        return sums_[d];
+    }
+
+    /// Return |m(k_d)|^2 = |S_d|^2 / V^2.
+    double squaredMagnitude(size_t const d) const noexcept
+    {
+        return std::norm(sums_[d]) / (volume_*volume_);
+    }
+
+    /// Return the number of modes, one per dimension.
+    size_t nmodes() const noexcept
+    {
+        return std::size(sums_);
+    }
+
+private:
+    MultiIndex shape_;
+    double volume_;
+    /// exp(i k_d x) for all coordinates x along each dimension d.
+    std::vector<std::vector<std::complex<double>>> phases_;
+    std::vector<std::complex<double>> sums_;
+};
+
+/// Store Monte-Carlo history or running statistics of observables.
 struct Observables
 {
+    /// What to keep of measurements.
+    /**
+     * HISTORY stores every measurement in energy, magnetisation, and corr.correlator.
+     * STREAMING only feeds them into the accumulators in summary and leaves
+     * the histories empty, so memory does not grow with the number of sweeps.
+     */
+    enum class Mode { HISTORY, STREAMING };
+
     std::vector<double> energy;
     std::vector<double> magnetisation;
+    /// |m(k_d)|^2 at the smallest nonzero momentum along each dimension d, see FourierSums.
+    std::vector<std::vector<double>> fourierModes;
 
     struct Correlator
     {
+        /// Algorithm used to measure the correlator.
+        /**
+         * PAIR_SUM sums over all sites and displacements, costs O(V * number of displacements).
+         * FFT computes the correlator for all displacements from the structure factor
+         * |S(k)|^2 and bins them afterwards, costs O(V log V).
+         * Both give the same results up to rounding errors.
+         */
+        enum class Method { PAIR_SUM, FFT };
+
         std::vector<int> const sqDistances;
         std::vector<std::vector<double>> correlator;
 
+        /// Work space for the FFT method.
+        struct Fourier
+        {
+            FFT fft;
+            std::vector<FFT::Complex> spins;
+            /// Total indices of all displacements for each squared distance.
+            std::vector<std::vector<Index>> displacements;
+
+            Fourier(Lattice const &lat, std::vector<int> const &sqd);
+        };
+        /// Only set when using the FFT method.
+        std::optional<Fourier> fourier;
+
         explicit Correlator(std::vector<int> &&sqd);
     } corr;
 
-    explicit Observables(Lattice const &lat);
+    /// Running statistics of all observables.
+    struct Summary
+    {
+        BinningAccumulator energy;
+        BinningAccumulator magnetisation;
+        /// One accumulator per element of corr.sqDistances.
+        std::vector<BinningAccumulator> correlator;
+        /// One accumulator per dimension.
+        std::vector<BinningAccumulator> fourierModes;
+    };
+    /// Only set in streaming mode.
+    std::optional<Summary> summary;
+
+    /// Histogram of coupling sum and spin sum for reweighting, only set if it is measured at all.
+    /**
+     * Kept in both modes since its size does not grow with the number of measurements
+     * but only with the number of distinct pairs.
+     */
+    std::optional<JointHistogram> histogram;
+
+    /// Work space to compute Fourier modes from scratch, only set if they are measured at all.
+    std::optional<FourierSums> fourierSums;
+
+    MeasurementIntervals intervals;
+    /// Number of sweeps measured so far, the current sweep selects which observables are due.
+    size_t nsweep = 0;
+
+    /// Return true if an observable with given interval is measured in the current sweep.
+    bool due(size_t const interval) const noexcept
+    {
+        return interval != 0 and nsweep % interval == 0;
+    }
+
+    /// Set up storage, the FFT work space is only allocated if the correlator is measured at all.
+    explicit Observables(Lattice const &lat,
+                         Correlator::Method corrMethod=Correlator::Method::PAIR_SUM,
+                         Mode mode=Mode::HISTORY,
+                         MeasurementIntervals intervals=MeasurementIntervals{});
 };
 
+/// Measure energy, magnetisation, correlator, Fourier modes, and the histogram and append them to obs.
+/**
+ * In streaming mode, the results are pushed into obs.summary instead.
+ * Only observables that are due according to obs.intervals are recorded,
+ * the correlator and Fourier modes are not even computed otherwise. Advances obs to the next sweep.
+ * This is what all evolve functions do after every sweep when given observables,
+ * passing the magnetisation they track alongside the energy.
+ * Instantiated for Configuration and PackedConfiguration.
+ *
+ * \param magnetisation Magnetisation per site of cfg.
+ * \param fourierSums Fourier sums of cfg tracked by the caller.
+ *                    If nullptr, they are computed from cfg when the modes are due.
+ * \param coupling Coupling sum of cfg tracked by the caller, see couplingSum().
+ *                 If not given, it is computed from cfg when the histogram is due.
+ */
+template <typename Cfg>
+void measure(Observables &obs, Lattice const &lat, Cfg const &cfg,
+             double energy, double magnetisation, FourierSums const *fourierSums=nullptr,
+             std::optional<std::int64_t> coupling=std::nullopt);
+
+/// Measure observables like the above but compute the magnetisation from cfg.
+template <typename Cfg>
+void measure(Observables &obs, Lattice const &lat, Cfg const &cfg, double energy);
+
+/// Append energy and magnetisation measured elsewhere to obs or push them into obs.summary.
+/**
+ * Only records those that are due in the current sweep of obs.
+ */
+void record(Observables &obs, double energy, double magnetisation);
+
+/// Append the correlator at distance obs.corr.sqDistances[sqdi] to obs or push it into obs.summary.
+/**
+ * Callers must only measure the correlator `if (obs.due(obs.intervals.correlator))`.
+ */
+void recordCorrelator(Observables &obs, size_t sqdi, double value);
+
+/// Append |m(k_d)|^2 for all dimensions d to obs or push them into obs.summary.
+/**
+ * Callers must only measure the modes `if (obs.due(obs.intervals.fourierModes))`.
+ */
+void recordFourierModes(Observables &obs, FourierSums const &fourierSums);
+
+/// Finish measurements of the current sweep of obs, must be called once per sweep after record().
+inline void nextSweep(Observables &obs) noexcept
+{
+    ++obs.nsweep;
+}
+
+/// Number of sweeps between checks of tracked energy and magnetisation in debug builds.
+constexpr size_t driftCheckInterval = 64;
+
+/// Return true if tracked observables shall be checked after a given sweep.
+/**
+ * This is the case every driftCheckInterval sweeps in debug builds and never otherwise.
+ */
+constexpr bool driftCheckDue(size_t const sweep) noexcept
+{
+    return not ndebug and (sweep+1) % driftCheckInterval == 0;
+}
+
+/// Compare tracked energy and magnetisation with a full recomputation.
+/**
+ * The energy is compared with a tolerance for rounding errors accumulated
+ * over many updates, the sum of spins must match exactly.
+ *
+ * \param energy Tracked energy.
+ * \param magn Tracked sum of all spins.
+ * \param exactEnergy Energy computed from the configuration.
+ * \param exactMagn Sum of all spins computed from the configuration.
+ * \param params Physical parameters the energy was computed with.
+ * \param ndim Number of dimensions of the lattice.
+ * \param volume Number of sites of the lattice.
+ * \throws std::logic_error if either observable drifted.
+ */
+void checkDrift(double energy, std::int64_t magn, double exactEnergy, std::int64_t exactMagn,
+                Parameters const &params, Index ndim, Index volume);
+
 /// Evolve a configuration in Monte-Carlo time.
 /**
+ * The caller keeps the coupling sum of cfg (see couplingSum()), the sum of spins is
+ * computed once on entry. Both are updated as exact integers with every accepted flip.
+ * The energy is only computed from them with energyFromSums() when measuring and on return,
+ * so it does not drift in long runs. This holds for all evolve functions.
+ * In debug builds, all evolve functions check the coupling sum on entry,
+ * recompute the observables from the configuration every driftCheckInterval sweeps,
+ * and throw std::logic_error if the tracked values are wrong.
+ *
  * \param cfg Starting configuration.
- * \param energy Starting energy.
+ * \param coupling Coupling sum of cfg. Updated to that of the final configuration,
+ *                 so it can be passed on to the next call.
  * \param params Physical parameters of the ensemble.
  * \param lat Lattice to run on, must be consistent with cfg.
+ *            Instantiated for Lattice and FixedLattice<N> with N = 1, ..., 4.
  * \param rng Random number generator to use. Its internal
  *            state is advanced by this function.
  * \param nsweed Number of sweeps to perform. A sweep is a set of size(lat) updates.
@@ -45,11 +292,184 @@ struct Observables
  * \returns Tuple of
  *   - final configuration
  *   - final energy
+ *   - final magnetisation per site
  *   - acceptance rate.
  */
-std::tuple<Configuration, double, double>
-evolve(Configuration cfg, double energy, Parameters const& params,
-       Lattice const &lat, Rng &rng, size_t const nsweep,
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolve(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+       Lat const &lat, Rng &rng, size_t const nsweep,
        Observables *obs, std::vector<Measurement> const & extraMeas={});
 
+/// Order in which evolveSequential() and evolveLocal() visit sites.
+enum class SiteOrder
+{
+    TYPEWRITER,    ///< All sites in increasing order of their total index.
+    CHECKERBOARD,  ///< Sites with even sum of coordinates first, then odd, each in memory order.
+    RANDOM         ///< size(lat) sites drawn at random, as in evolve().
+};
+
+/// Evolve a configuration in Monte-Carlo time using sequential Metropolis sweeps.
+/**
+ * Like evolve() but each sweep visits every site exactly once in a fixed order
+ * instead of drawing sites at random. Neighbours are then accessed in memory order
+ * which avoids cache misses on large lattices and saves drawing random indices.
+ *
+ * Each single site update satisfies detailed balance, so the Boltzmann distribution is
+ * stationary under a full sweep as well. But the sweep as a whole does not satisfy detailed
+ * balance since the reverse order is not used (only global balance holds).
+ * This is fine for measurements after every sweep as long as the acceptance rate
+ * is noticeably below 1. At very high temperatures and small fields, almost all
+ * flips are accepted and consecutive sweeps become strongly anti-correlated,
+ * at J=h=0 the chain is periodic and no longer samples the distribution.
+ *
+ * Parameters and return value are the same as for evolve().
+ * \param order Order in which to update sites.
+ */
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveSequential(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+                 Lat const &lat, Rng &rng, size_t nsweep,
+                 Observables *obs, std::vector<Measurement> const & extraMeas={},
+                 SiteOrder order=SiteOrder::TYPEWRITER);
+
+/// Single spin update rules of evolveLocal().
+enum class UpdateRule
+{
+    METROPOLIS,  ///< Flip with probability min(1, exp(-dE)), as in evolve().
+    HEAT_BATH,   ///< Draw the spin given its neighbours, i.e. flip with probability 1/(1+exp(dE)).
+    DEMON        ///< Flip if a demon refreshed every sweep from exp(-E_d) can supply dE,
+                 ///< one demon per 16 sites.
+};
+
+/// Evolve a configuration in Monte-Carlo time using single spin updates.
+/**
+ * Generalises evolve() and evolveSequential() to other update rules.
+ * Rule and order are only dispatched on once per call, every combination
+ * has its own inner loop.
+ * All rules leave the Boltzmann distribution invariant. Heat-bath updates flip
+ * less often than Metropolis updates but draw a random number for every site.
+ * Demon updates draw one random number per 16 sites and sweep
+ * (plus site indices for SiteOrder::RANDOM).
+ * The returned acceptance rate is the fraction of flipped spins.
+ *
+ * Parameters and return value are the same as for evolve().
+ * \param rule How to update a single spin.
+ * \param order Order in which to update sites.
+ */
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveLocal(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+            Lat const &lat, Rng &rng, size_t nsweep,
+            Observables *obs, std::vector<Measurement> const & extraMeas,
+            UpdateRule rule, SiteOrder order);
+
+/// Evolve a configuration in Monte-Carlo time using Wolff single cluster updates.
+/**
+ * Clusters are grown from random sites by bonding neighbours with satisfied links
+ * (aligned spins for J > 0, anti-aligned for J < 0) with probability 1 - exp(-2|J/kT|).
+ * The cluster is then flipped with probability min(1, exp(-2 h/kT M_C)) where
+ * M_C is its magnetisation. A sweep consists of a fixed number of clusters
+ * which is determined by flipping clusters until their total size reaches size(lat).
+ * These calibration clusters are flipped in addition to the nsweep sweeps, so they act as
+ * extra thermalisation. They are neither measured nor counted in the mean cluster size.
+ *
+ * \param cfg Starting configuration.
+ * \param coupling Coupling sum of cfg, updated to that of the final configuration,
+ *                 see evolve().
+ * \param params Physical parameters of the ensemble.
+ * \param lat Lattice to run on, must be consistent with cfg.
+ *            Instantiated for Lattice and FixedLattice<N> with N = 1, ..., 4.
+ * \param rng Random number generator to use. Its internal
+ *            state is advanced by this function.
+ * \param nsweep Number of sweeps to perform.
+ * \param obs Storage for measuring observables.
+ *            Can be nullptr in which case no measurements are performed.
+ * \param extraMeas Additional measurements to perform.
+ *                  Each vector element is called after every sweep.
+ * \param nclustersPerSweep Number of clusters per sweep. If it points to 0,
+ *                          the number is calibrated before the first sweep and stored,
+ *                          such that calling repeatedly with the same pointer runs the
+ *                          same chain as a single call. If nullptr, the number is
+ *                          calibrated on every call.
+ *
+ * \returns Tuple of
+ *   - final configuration
+ *   - final energy
+ *   - final magnetisation per site
+ *   - mean cluster size.
+ *
+ * See clusterupdate.hpp for an overload that takes a MeasurementSet instead of extraMeas.
+ */
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveWolff(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+            Lat const &lat, Rng &rng, size_t nsweep,
+            Observables *obs, std::vector<Measurement> const & extraMeas={},
+            size_t *nclustersPerSweep=nullptr);
+
+/// Evolve a configuration in Monte-Carlo time using Swendsen-Wang multi cluster updates.
+/**
+ * Each sweep decomposes the whole lattice into clusters using the same bonds as
+ * evolveWolff() and flips each cluster with probability 1/(1 + exp(2 h/kT M_C)).
+ * Parameters and return value are the same as for evolveWolff().
+ * See clusterupdate.hpp for an overload that takes a MeasurementSet instead of extraMeas.
+ */
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveSwendsenWang(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+                   Lat const &lat, Rng &rng, size_t nsweep,
+                   Observables *obs, std::vector<Measurement> const & extraMeas={});
+
+/// Evolve a configuration in Monte-Carlo time using checkerboard sweeps.
+/**
+ * Each sweep first updates all sites of sublattice 0 and then all of sublattice 1
+ * (see checkerboard()). Since sites of one sublattice do not interact with each other,
+ * they are updated in parallel by `std::size(rngs)` threads, each drawing from its own rng.
+ * All lattice extents must be even.
+ *
+ * \param cfg Starting configuration.
+ * \param coupling Coupling sum of cfg, updated to that of the final configuration,
+ *                 see evolve().
+ * \param params Physical parameters of the ensemble.
+ * \param lat Lattice to run on, must be consistent with cfg.
+ *            Instantiated for Lattice and FixedLattice<N> with N = 1, ..., 4.
+ * \param rngs One random number generator per thread. Their internal
+ *             states are advanced by this function.
+ * \param nsweed Number of sweeps to perform. A sweep is a set of size(lat) updates.
+ * \param obs Storage for measuring observables.
+ *            Can be nullptr in which case no measurements are performed.
+ * \param extraMeas Additional measurements to perform.
+ *                  Each vector element is called after every sweep.
+ * \param simd If set, update rows of sites with the vectorised CheckerboardKernel
+ *             using the given instruction set. Otherwise, update sites one by one.
+ *             The kernel seeds a LaneRng from each of rngs in every call.
+ *             Also requires fewer than 2^31 sites.
+ *
+ * \returns Tuple of
+ *   - final configuration
+ *   - final energy
+ *   - final magnetisation per site
+ *   - acceptance rate.
+ *
+ * See checkerboardupdate.hpp for overloads that take a MeasurementSet instead of extraMeas.
+ */
+template <typename Lat>
+std::tuple<Configuration, double, double, double>
+evolveCheckerboard(Configuration cfg, std::int64_t &coupling, Parameters const& params,
+                   Lat const &lat, std::vector<Rng> &rngs, size_t const nsweep,
+                   Observables *obs, std::vector<Measurement> const & extraMeas={},
+                   std::optional<SimdLevel> simd=std::nullopt);
+
+/// Evolve a packed configuration in Monte-Carlo time using checkerboard sweeps.
+/**
+ * Uses multi-spin coding to update all 64 spins of a word at once.
+ * The checkerboard decomposition is done on the word lattice, see PackedConfiguration.
+ * Parameters and return value are the same as for the overload for Configuration.
+ */
+std::tuple<PackedConfiguration, double, double, double>
+evolveCheckerboard(PackedConfiguration cfg, std::int64_t &coupling, Parameters const& params,
+                   Lattice const &lat, std::vector<Rng> &rngs, size_t const nsweep,
+                   Observables *obs, std::vector<PackedMeasurement> const & extraMeas={});
+
 #endif  // ndef ISING_MONTECARLO_HPP
@@ -0,0 +1,62 @@
+#include "packedconfiguration.hpp"
+
+#include <stdexcept>
+
+namespace {
+    /// Make sure that a lattice can be used with a PackedConfiguration.
+    Lattice const &checkShape(Lattice const &lat)
+    {
+        if (lat.layout() != Lattice::SiteLayout::ROW_MAJOR) {
+            throw std::invalid_argument("Packed configurations require the row-major site layout");
+        }
+        auto const &shape = lat.shape();
+        if (shape[0].get() % (2*PackedConfiguration::spinsPerWord.get()) != 0) {
+            throw std::invalid_argument("Packed configurations require the first lattice extent to be a multiple of 128");
+        }
+        for (Index const extent : shape) {
+            if (extent.get() % 2 != 0) {
+                throw std::invalid_argument("Packed configurations require even lattice extents");
+            }
+        }
+        return lat;
+    }
+}
+
+PackedConfiguration::PackedConfiguration(Lattice const &lat,
+                                         Spin const &initial)
+    : slabExtent_{checkShape(lat).extend(0_i) / spinsPerWord},
+      stride_{lat.size() / lat.extend(0_i)},
+      words_((lat.size() / spinsPerWord).get(), initial == Spin{+1} ? ~Word{0} : Word{0}),
+      wordLattice_{std::make_shared<Lattice const>(::wordLattice(lat))}
+{
+    if constexpr (not ndebug) {
+        if (initial != Spin{+1} and initial != Spin{-1})
+            throw std::runtime_error("Invlaid initial spin. Must be +1 or -1");
+    }
+}
+
+PackedConfiguration::PackedConfiguration(Configuration const &cfg, Lattice const &lat)
+    : PackedConfiguration(lat, Spin{-1})
+{
+    for (Index site = 0_i; site < lat.size(); ++site) {
+        if (cfg[site] == Spin{+1}) {
+            flip(site);
+        }
+    }
+}
+
+Configuration PackedConfiguration::unpack() const
+{
+    Configuration cfg(size());
+    for (Index site = 0_i; site < size(); ++site) {
+        cfg[site] = (*this)[site];
+    }
+    return cfg;
+}
+
+Lattice wordLattice(Lattice const &lat)
+{
+    MultiIndex shape = checkShape(lat).shape();
+    shape[0] = shape[0] / PackedConfiguration::spinsPerWord;
+    return Lattice{shape, 0.0};
+}
@@ -0,0 +1,226 @@
+#ifndef ISING_PACKEDCONFIGURATION_HPP
+#define ISING_PACKEDCONFIGURATION_HPP
+
+#include <vector>
+#include <cstdint>
+#include <bitset>
+#include <memory>
+
+#include "configuration.hpp"
+#include "ising.hpp"
+#include "lattice.hpp"
+#include "ndebug.hpp"
+
+
+/// Hold a spin configuration on the lattice using one bit per spin.
+/**
+ * Spins are stored using multi-spin coding:
+ * Dimension 0 of the lattice is split into 64 slabs of extent m = shape[0]/64.
+ * Bit b of word w holds the spin at site (b*m + y0, x1, ..., x_{n-1}) where
+ * w = totalIndex({y0, x1, ..., x_{n-1}}, {m, shape[1], ..., shape[n-1]}).
+ * So the 64 spins of a word are in different slabs but at the same position within
+ * their slab. Words thus form a lattice of their own, see wordLattice(), and the
+ * neighbours of all spins in a word are found at the same bit in the neighbouring words.
+ * The only exception are neighbours across slab boundaries in dimension 0 which are
+ * shifted by one bit.
+ *
+ * A set bit represents spin +1 and an unset one -1.
+ *
+ * Requires shape[0] to be a multiple of 128 and all other extents to be even such
+ * that words can be updated using a checkerboard decomposition of the word lattice.
+ * The word lattice is built once on construction and shared by all copies.
+ */
+struct PackedConfiguration
+{
+    using Word = std::uint64_t;
+
+    /// Number of spins stored in one word.
+    static constexpr Index spinsPerWord = 64_i;
+
+    /// Initialise with a given initial spin.
+    explicit PackedConfiguration(Lattice const &lat,
+                                 Spin const &initial=Spin{+1});
+
+    /// Pack a given configuration.
+    PackedConfiguration(Configuration const &cfg, Lattice const &lat);
+
+    /// Return spin at a site given by its (row-major) total index.
+    Spin operator[](Index const site) const noexcept(ndebug)
+    {
+        auto const [word, bit] = location(site);
+        return (words_[word.get()] >> bit.get()) & Word{1} ? Spin{+1} : Spin{-1};
+    }
+
+    /// Flip the sign at a site given by its (row-major) total index.
+    void flip(Index const site) noexcept(ndebug)
+    {
+        auto const [word, bit] = location(site);
+        words_[word.get()] ^= Word{1} << bit.get();
+    }
+
+    /// Access a word by its index on the word lattice.
+    Word &word(Index const idx) noexcept(ndebug)
+    {
+        if constexpr (not ndebug) {
+            if (idx.get() >= std::size(words_))  // Index is unsigned => this checks for 'idx < 0' too.
+                throw std::out_of_range("PackedConfiguration word index is out of range.");
+        }
+        return words_[idx.get()];
+    }
+
+    /// Access a word by its index on the word lattice.
+    Word word(Index const idx) const noexcept(ndebug)
+    {
+        if constexpr (not ndebug) {
+            if (idx.get() >= std::size(words_))  // Index is unsigned => this checks for 'idx < 0' too.
+                throw std::out_of_range("PackedConfiguration word index is out of range.");
+        }
+        return words_[idx.get()];
+    }
+
+    /// Return the number of spins in this configuration.
+    Index size() const noexcept
+    {
+        return Index{std::size(words_)}*spinsPerWord;
+    }
+
+    /// Return the number of words in this configuration.
+    Index nwords() const noexcept
+    {
+        return Index{std::size(words_)};
+    }
+
+    /// Return true if the word with given index is in the first layer of its slabs.
+    bool atLowerSlabBoundary(Index const idx) const noexcept
+    {
+        return idx < stride_;
+    }
+
+    /// Return true if the word with given index is in the last layer of its slabs.
+    bool atUpperSlabBoundary(Index const idx) const noexcept
+    {
+        return idx >= (slabExtent_-1_i)*stride_;
+    }
+
+    /// Return a configuration with one int per spin in row-major layout.
+    Configuration unpack() const;
+
+    /// Return the lattice of words, see wordLattice().
+    /**
+     * Is shared by all copies of this configuration and stays valid if it is moved from.
+     */
+    Lattice const &wordLattice() const noexcept
+    {
+        return *wordLattice_;
+    }
+
+    /// Return iterator to beginning of words.
+    friend auto begin(PackedConfiguration const &cfg)
+    {
+        return cfg.words_.begin();
+    }
+
+    /// Return iterator to end of words.
+    friend auto end(PackedConfiguration const &cfg)
+    {
+        return cfg.words_.end();
+    }
+
+private:
+    /// Return word and bit index of a site.
+    std::pair<Index, Index> location(Index const site) const noexcept(ndebug)
+    {
+        if constexpr (not ndebug) {
+            if (site >= size())
+                throw std::out_of_range("PackedConfiguration index is out of range.");
+        }
+        Index const x0 = site / stride_;
+        return {(x0 % slabExtent_)*stride_ + site % stride_, x0 / slabExtent_};
+    }
+
+    /// Extent of each slab in dimension 0.
+    Index slabExtent_;
+    /// Distance between sites with neighbouring x0 in row-major layout.
+    Index stride_;
+    /// The actual configuration.
+    std::vector<Word> words_;
+    /// Lattice of words, only depends on the shape.
+    std::shared_ptr<Lattice const> wordLattice_;
+};
+
+
+/// Return the size of a configuration.
+inline Index size(PackedConfiguration const &cfg) noexcept
+{
+    return cfg.size();
+}
+
+/// Construct the lattice of words of a PackedConfiguration for a given lattice.
+/**
+ * Has shape {shape[0]/64, shape[1], ..., shape[n-1]} and no distance map.
+ */
+Lattice wordLattice(Lattice const &lat);
+
+/// Return the word at a neighbour aligned such that bit b is the neighbour of bit b of word.
+inline PackedConfiguration::Word
+alignedNeighbour(PackedConfiguration const &cfg, Index const word,
+                 Index const neigh, Lattice const &wordLat) noexcept(ndebug)
+{
+    auto const neighbour = cfg.word(wordLat.neighbour(word, neigh));
+    // Neighbours 0 and 1 are in positive and negative direction of dimension 0,
+    // going there can cross into a different slab.
+    if (neigh == 0_i and cfg.atUpperSlabBoundary(word)) {
+        return (neighbour >> 1) | (neighbour << 63);
+    }
+    if (neigh == 1_i and cfg.atLowerSlabBoundary(word)) {
+        return (neighbour << 1) | (neighbour >> 63);
+    }
+    return neighbour;
+}
+
+/// Return the number of spins +1 in a configuration.
+inline std::size_t countUp(PackedConfiguration const &cfg) noexcept
+{
+    std::size_t up = 0;
+    for (auto const word : cfg) {
+        up += std::bitset<64>(word).count();
+    }
+    return up;
+}
+
+/// Return the sum of s_x s_y over all links <x,y>, counting each link once.
+inline std::int64_t couplingSum(PackedConfiguration const &cfg, Lattice const &lat)
+{
+    Lattice const &wordLat = cfg.wordLattice();
+
+    // number of anti-aligned pairs, using only links in positive directions
+    std::size_t antialigned = 0;
+    for (Index w = 0_i; w < cfg.nwords(); ++w) {
+        auto const spins = cfg.word(w);
+        for (Index d = 0_i; d < wordLat.ndim(); ++d) {
+            auto const neighbours = alignedNeighbour(cfg, w, 2_i*d, wordLat);
+            antialigned += std::bitset<64>(spins ^ neighbours).count();
+        }
+    }
+
+    std::size_t const nlinks = lat.ndim().get() * size(lat).get();
+    return static_cast<std::int64_t>(nlinks) - 2*static_cast<std::int64_t>(antialigned);
+}
+
+/// Evaluate the Hamiltonian on a configuration.
+inline double hamiltonian(PackedConfiguration const &cfg,
+                          Parameters const &params,
+                          Lattice const &lat)
+{
+    std::int64_t const magn = 2*static_cast<std::int64_t>(countUp(cfg))
+        - static_cast<std::int64_t>(size(cfg).get());
+    return energyFromSums(params, couplingSum(cfg, lat), magn);
+}
+
+/// Compute the magnetisation on a configuration.
+inline double magnetisation(PackedConfiguration const &cfg) noexcept
+{
+    return 2.0*static_cast<double>(countUp(cfg)) / static_cast<double>(size(cfg).get()) - 1.0;
+}
+
+#endif  // ndef ISING_PACKEDCONFIGURATION_HPP
@@ -0,0 +1,226 @@
+#ifndef ISING_PIPELINE_HPP
+#define ISING_PIPELINE_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "montecarlo.hpp"
+
+/// What to do when the buffer of an AsyncMeasurements pipeline is full.
+enum class Backpressure
+{
+    BLOCK,  ///< Wait until the background thread has processed a configuration.
+    SKIP    ///< Drop the new configuration and do not measure it.
+};
+
+/// Perform measurements on copies of configurations in a background thread.
+/**
+ * The Markov chain pushes configurations into a bounded ring buffer via push()
+ * or the callable returned by measurement(). A background thread takes them out
+ * in order and calls all measurements on them.
+ * Buffer slots are allocated on the first push and reused afterwards.
+ *
+ * Every push counts as one sweep of the chain, including pushes that are dropped
+ * with Backpressure::SKIP. Measurements get the sweep of their configuration
+ * so they can decide which observables are due even if earlier configurations were dropped.
+ *
+ * There must be only a single producer thread.
+ * Measurements run on the background thread so they must not access
+ * data that is modified by the producer until flush() has returned.
+ */
+template <typename Cfg>
+class AsyncMeasurements
+{
+public:
+    /// Function called with a configuration, its energy, and the sweep it was pushed in.
+    using Measurement = std::function<void(Cfg const &cfg, double energy, std::size_t sweep)>;
+
+    /// Start the background thread.
+    /**
+     * \param measurements Measurements to perform on every configuration.
+     * \param capacity Maximum number of configurations in the buffer
+     *                 including the one currently being processed.
+     * \param backpressure Behaviour of push() when the buffer is full.
+     */
+    AsyncMeasurements(std::vector<Measurement> measurements,
+                      std::size_t const capacity, Backpressure const backpressure)
+        : measurements_{std::move(measurements)},
+          backpressure_{backpressure}, sweep_{0},
+          slots_(capacity), head_{0}, count_{0}, nskipped_{0},
+          stop_{false}, exception_{}
+    {
+        if (capacity == 0) {
+            throw std::invalid_argument("AsyncMeasurements needs a capacity of at least 1");
+        }
+        worker_ = std::thread{[this]{ work(); }};
+    }
+
+    /// Process all remaining configurations and stop the background thread.
+    /**
+     * Exceptions from measurements are discarded, call flush() to get them.
+     */
+    ~AsyncMeasurements()
+    {
+        {
+            std::lock_guard lock{mutex_};
+            stop_ = true;
+        }
+        notEmpty_.notify_all();
+        worker_.join();
+    }
+
+    AsyncMeasurements(AsyncMeasurements const &) = delete;
+    AsyncMeasurements &operator=(AsyncMeasurements const &) = delete;
+
+    /// Hand a copy of a configuration to the background thread and advance to the next sweep.
+    /**
+     * Rethrows exceptions from measurements of previous configurations.
+     */
+    void push(Cfg const &cfg, double const energy)
+    {
+        std::size_t const sweep = sweep_++;
+        std::unique_lock lock{mutex_};
+        rethrowIfFailed();
+        if (count_ == std::size(slots_)) {
+            if (backpressure_ == Backpressure::SKIP) {
+                ++nskipped_;
+                return;
+            }
+            notFull_.wait(lock, [this]{ return count_ < std::size(slots_) or exception_; });
+            rethrowIfFailed();
+        }
+
+        // The consumer does not touch this slot before count_ is incremented
+        // and there is only one producer, so it can be filled without holding the lock.
+        Slot &slot = slots_[(head_+count_) % std::size(slots_)];
+        lock.unlock();
+        if (slot.cfg) {
+            *slot.cfg = cfg;
+        }
+        else {
+            slot.cfg.emplace(cfg);
+        }
+        slot.energy = energy;
+        slot.sweep = sweep;
+
+        lock.lock();
+        ++count_;
+        notEmpty_.notify_one();
+    }
+
+    /// Return a measurement that pushes into this pipeline for use with evolve().
+    MeasurementFor<Cfg> measurement()
+    {
+        return [this](Cfg const &cfg, double const energy) { push(cfg, energy); };
+    }
+
+    /// Set the sweep of the next push, e.g. to continue a chain from a checkpoint.
+    /**
+     * Must only be called by the producer thread.
+     */
+    void setSweep(std::size_t const sweep) noexcept
+    {
+        sweep_ = sweep;
+    }
+
+    /// Wait until all configurations have been processed.
+    /**
+     * Rethrows the first exception thrown by any measurement.
+     */
+    void flush()
+    {
+        std::unique_lock lock{mutex_};
+        idle_.wait(lock, [this]{ return count_ == 0 or exception_; });
+        rethrowIfFailed();
+    }
+
+    /// Return the number of configurations that were dropped because the buffer was full.
+    std::size_t nskipped() const
+    {
+        std::lock_guard lock{mutex_};
+        return nskipped_;
+    }
+
+private:
+    /// Buffer entry.
+    struct Slot
+    {
+        std::optional<Cfg> cfg;
+        double energy;
+        std::size_t sweep;
+    };
+
+    /// Must be called with mutex_ locked.
+    void rethrowIfFailed() const
+    {
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+    }
+
+    /// Main loop of the background thread.
+    void work()
+    {
+        std::unique_lock lock{mutex_};
+        while (true) {
+            notEmpty_.wait(lock, [this]{ return count_ > 0 or stop_; });
+            if (count_ == 0) {
+                return;  // stopped and everything is processed
+            }
+
+            Slot const &slot = slots_[head_];
+            lock.unlock();
+            try {
+                for (auto const &meas : measurements_) {
+                    meas(*slot.cfg, slot.energy, slot.sweep);
+                }
+            }
+            catch (...) {
+                lock.lock();
+                exception_ = std::current_exception();
+                notFull_.notify_all();
+                idle_.notify_all();
+                return;
+            }
+            lock.lock();
+
+            head_ = (head_+1) % std::size(slots_);
+            --count_;
+            notFull_.notify_one();
+            if (count_ == 0) {
+                idle_.notify_all();
+            }
+        }
+    }
+
+    std::vector<Measurement> const measurements_;
+    Backpressure const backpressure_;
+    /// Sweep of the next push, only accessed by the producer.
+    std::size_t sweep_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    std::condition_variable idle_;
+
+    std::vector<Slot> slots_;
+    /// Index of the oldest unprocessed configuration.
+    std::size_t head_;
+    /// Number of unprocessed configurations.
+    std::size_t count_;
+    std::size_t nskipped_;
+    bool stop_;
+    std::exception_ptr exception_;
+
+    /// Started last so all other members are initialised.
+    std::thread worker_;
+};
+
+#endif  // ndef ISING_PIPELINE_HPP
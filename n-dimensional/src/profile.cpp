@@ -0,0 +1,121 @@
+#include "profile.hpp"
+
+#include <fstream>
+
+#include <sys/resource.h>
+#include <yaml-cpp/yaml.h>
+
+namespace {
+    /// Sum of the time of all phases.
+    double totalSeconds(PhaseTimes const &times) noexcept
+    {
+        double total = 0.0;
+        for (double const seconds : times.seconds) {
+            total += seconds;
+        }
+        return total;
+    }
+
+    /// Emit time, calls, and fraction of a wall time of all phases that were entered.
+    void emitPhases(YAML::Emitter &out, PhaseTimes const &times, double const wallTime)
+    {
+        out << YAML::Key << "phases" << YAML::Value << YAML::BeginMap;
+        for (std::size_t p = 0; p < nphases; ++p) {
+            if (times.calls[p] == 0) {
+                continue;
+            }
+            out << YAML::Key << phaseName(static_cast<Phase>(p)) << YAML::Value
+                << YAML::Flow << YAML::BeginMap
+                << YAML::Key << "seconds" << YAML::Value << times.seconds[p]
+                << YAML::Key << "calls" << YAML::Value << times.calls[p]
+                << YAML::Key << "fraction" << YAML::Value
+                << (wallTime > 0.0 ? times.seconds[p] / wallTime : 0.0)
+                << YAML::EndMap;
+        }
+        out << YAML::EndMap;
+    }
+}
+
+char const *phaseName(Phase const phase) noexcept
+{
+    switch (phase) {
+    case Phase::LATTICE:
+        return "lattice";
+    case Phase::UPDATE:
+        return "update";
+    case Phase::MEASUREMENT:
+        return "measurement";
+    case Phase::CORRELATOR:
+        return "correlator";
+    case Phase::CFG_OUTPUT:
+        return "cfg_output";
+    case Phase::CHECKPOINT:
+        return "checkpoint";
+    case Phase::OUTPUT:
+        return "output";
+    }
+    return "unknown";
+}
+
+PhaseTimes Profiler::totals() const noexcept
+{
+    PhaseTimes times;
+    for (std::size_t p = 0; p < nphases; ++p) {
+        times.seconds[p] = std::chrono::duration<double>(std::chrono::nanoseconds{
+                nanoseconds_[p].load(std::memory_order_relaxed)}).count();
+        times.calls[p] = calls_[p].load(std::memory_order_relaxed);
+    }
+    return times;
+}
+
+std::size_t peakRss() noexcept
+{
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0 or usage.ru_maxrss < 0) {
+        return 0;
+    }
+    // in kiB on Linux
+    return static_cast<std::size_t>(usage.ru_maxrss);
+}
+
+void writeProfile(std::filesystem::path const &fname, PhaseTimes const &setup,
+                  std::vector<EnsembleProfile> const &ensembles)
+{
+    YAML::Emitter out;
+    out << YAML::BeginMap;
+
+    out << YAML::Key << "setup" << YAML::Value << YAML::BeginMap;
+    double const setupTime = totalSeconds(setup);
+    out << YAML::Key << "seconds" << YAML::Value << setupTime;
+    emitPhases(out, setup, setupTime);
+    out << YAML::EndMap;
+
+    out << YAML::Key << "ensembles" << YAML::Value << YAML::BeginSeq;
+    for (auto const &ensemble : ensembles) {
+        std::size_t const update = static_cast<std::size_t>(Phase::UPDATE);
+        double const nupdates = static_cast<double>(ensemble.nsweep)
+            * static_cast<double>(ensemble.volume);
+        double const updateTime = ensemble.phases.seconds[update];
+
+        out << YAML::BeginMap
+            << YAML::Key << "ensemble" << YAML::Value << ensemble.ensemble
+            << YAML::Key << "J" << YAML::Value << ensemble.params.JT
+            << YAML::Key << "h" << YAML::Value << ensemble.params.hT
+            << YAML::Key << "sweeps" << YAML::Value << ensemble.nsweep
+            << YAML::Key << "wall_time" << YAML::Value << ensemble.wallTime
+            << YAML::Key << "updates_per_second" << YAML::Value
+            << (updateTime > 0.0 ? nupdates / updateTime : 0.0)
+            << YAML::Key << "peak_rss_kib" << YAML::Value << ensemble.peakRss;
+        emitPhases(out, ensemble.phases, ensemble.wallTime);
+        out << YAML::EndMap;
+    }
+    out << YAML::EndSeq;
+
+    out << YAML::Key << "peak_rss_kib" << YAML::Value << peakRss();
+    out << YAML::EndMap;
+
+    std::ofstream ofs;
+    ofs.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+    ofs.open(fname, std::ios::trunc);
+    ofs << out.c_str() << '\n';
+}
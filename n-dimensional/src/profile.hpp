@@ -0,0 +1,189 @@
+#ifndef ISING_PROFILE_HPP
+#define ISING_PROFILE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "ising.hpp"
+
+/// Indicate whether ISING_PROFILE macro was set, otherwise all timers compile to nothing.
+#ifdef ISING_PROFILE
+    constexpr bool profiling = true;
+#else
+    constexpr bool profiling = false;
+#endif
+
+/// Parts of a run that are timed separately.
+enum class Phase : std::size_t
+{
+    LATTICE,      ///< Construction of Lattice including neighbours and distances.
+    UPDATE,       ///< Update sweeps, excluding measurements and output performed in between.
+    MEASUREMENT,  ///< measure() except for the correlator.
+    CORRELATOR,   ///< Measurement of the correlator.
+    CFG_OUTPUT,   ///< Writing configurations to file.
+    CHECKPOINT,   ///< Saving checkpoints.
+    OUTPUT        ///< Writing observables to file.
+};
+
+/// Number of elements of Phase.
+constexpr std::size_t nphases = 7;
+
+/// Return a name for a phase for use in reports.
+char const *phaseName(Phase phase) noexcept;
+
+/// Total time and number of calls of every phase.
+struct PhaseTimes
+{
+    std::array<double, nphases> seconds{};
+    std::array<std::uint64_t, nphases> calls{};
+};
+
+/// Accumulate time spent in each phase from any number of threads.
+/**
+ * Threads add to a profiler through ScopedTimer while it is installed
+ * on them as their active profiler by a ProfileScope.
+ */
+class Profiler
+{
+public:
+    /// Add time spent in one call of a phase.
+    void add(Phase const phase, std::chrono::nanoseconds const time) noexcept
+    {
+        auto const p = static_cast<std::size_t>(phase);
+        nanoseconds_[p].fetch_add(time.count(), std::memory_order_relaxed);
+        calls_[p].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// Return times and calls accumulated so far.
+    PhaseTimes totals() const noexcept;
+
+    /// Return the active profiler of the calling thread, nullptr if there is none.
+    static Profiler *active() noexcept
+    {
+        return active_;
+    }
+
+private:
+    std::array<std::atomic<std::int64_t>, nphases> nanoseconds_{};
+    std::array<std::atomic<std::uint64_t>, nphases> calls_{};
+
+    static inline thread_local Profiler *active_ = nullptr;
+
+    friend class ProfileScope;
+};
+
+/// Make a profiler the active profiler of the calling thread while in scope.
+/**
+ * Restores the previously active profiler on destruction, so scopes can be nested.
+ * Passing nullptr disables profiling in the scope.
+ */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(Profiler * const profiler) noexcept
+        : previous_{Profiler::active_}
+    {
+        Profiler::active_ = profiler;
+    }
+
+    ~ProfileScope()
+    {
+        Profiler::active_ = previous_;
+    }
+
+    ProfileScope(ProfileScope const &) = delete;
+    ProfileScope &operator=(ProfileScope const &) = delete;
+
+private:
+    Profiler * const previous_;
+};
+
+/// Time a scope and add it to the active profiler of the calling thread.
+/**
+ * Timers on the same thread nest, time spent in an inner timer is only
+ * added to the phase of the inner timer. So the phases of one thread add up
+ * to its wall time.
+ * Does nothing if there is no active profiler or if profiling is disabled.
+ * Only meant for coarse scopes like sweeps or measurements, not single site updates,
+ * so the cost of reading the clock is negligible.
+ */
+class ScopedTimer
+{
+    using Clock = std::chrono::steady_clock;
+
+public:
+    explicit ScopedTimer(Phase const phase) noexcept
+        : phase_{phase}
+    {
+        if constexpr (profiling) {
+            profiler_ = Profiler::active();
+            if (profiler_) {
+                parent_ = innermost_;
+                innermost_ = this;
+                start_ = Clock::now();
+            }
+        }
+    }
+
+    ~ScopedTimer()
+    {
+        if constexpr (profiling) {
+            if (profiler_) {
+                auto const elapsed = Clock::now() - start_;
+                profiler_->add(phase_, elapsed - nested_);
+                if (parent_) {
+                    parent_->nested_ += elapsed;
+                }
+                innermost_ = parent_;
+            }
+        }
+    }
+
+    ScopedTimer(ScopedTimer const &) = delete;
+    ScopedTimer &operator=(ScopedTimer const &) = delete;
+
+private:
+    Phase const phase_;
+    Profiler *profiler_ = nullptr;
+    ScopedTimer *parent_ = nullptr;
+    Clock::time_point start_{};
+    std::chrono::nanoseconds nested_{0};  ///< Time spent in inner timers.
+
+    static inline thread_local ScopedTimer *innermost_ = nullptr;
+};
+
+/// Profile of one ensemble.
+struct EnsembleProfile
+{
+    std::size_t ensemble;
+    Parameters params;
+    std::size_t nsweep;  ///< Thermalisation and production sweeps.
+    std::size_t volume;  ///< Number of sites.
+    double wallTime;     ///< In seconds, from the start of thermalisation to the end of output.
+    PhaseTimes phases;
+    std::size_t peakRss;  ///< Peak resident set size of the process in kiB at the end.
+};
+
+/// Return the peak resident set size of the process so far in kiB, 0 if unknown.
+std::size_t peakRss() noexcept;
+
+/// Write a summary of a run in YAML format.
+/**
+ * For each ensemble, reports time and fraction of the wall time of every phase,
+ * site updates per second of the UPDATE phase, and the peak memory use.
+ * Phases of measurements run in the background overlap with updates,
+ * so their fractions can add up to more than 1.
+ *
+ * \param fname File to write to, is overwritten.
+ * \param setup Phases outside of ensembles like lattice construction and initial thermalisation.
+ * \param ensembles Profiles of all ensembles, sorted by index.
+ */
+void writeProfile(std::filesystem::path const &fname, PhaseTimes const &setup,
+                  std::vector<EnsembleProfile> const &ensembles);
+
+#endif  // ndef ISING_PROFILE_HPP
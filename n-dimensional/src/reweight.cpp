@@ -0,0 +1,95 @@
+/**
+ * Reweight histograms written with 'histogram: true' to other parameters.
+ *
+ * Usage: ising-reweight <J-first> <J-last> <nJ> <h-first> <h-last> <nh> <histogram files>...
+ *
+ * Prints observables on an nJ x nh grid of parameters as comma separated values.
+ * A single file is reweighted with the single histogram method, several files are
+ * combined with the multi-histogram method. All files must belong to the same lattice.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "fileio.hpp"
+#include "reweighting.hpp"
+
+namespace {
+    /// Return n equally spaced values from first to last inclusive.
+    std::vector<double> grid(double const first, double const last, std::size_t const n)
+    {
+        if (n == 0) {
+            throw std::invalid_argument("Number of grid points must be positive");
+        }
+        std::vector<double> values;
+        for (std::size_t i = 0; i < n; ++i) {
+            values.push_back(n == 1 ? first
+                             : first + (last - first)*static_cast<double>(i)
+                                       / static_cast<double>(n - 1));
+        }
+        return values;
+    }
+
+    void run(int const argc, char const * const argv[])
+    {
+        if (argc < 8) {
+            throw std::runtime_error("Need parameters, in order: J-first, J-last, nJ, "
+                                     "h-first, h-last, nh, histogram files...");
+        }
+        auto const Js = grid(std::stod(argv[1]), std::stod(argv[2]), std::stoul(argv[3]));
+        auto const hs = grid(std::stod(argv[4]), std::stod(argv[5]), std::stoul(argv[6]));
+
+        std::vector<HistogramFile> files;
+        for (int i = 7; i < argc; ++i) {
+            files.push_back(readHistogram(argv[i]));
+            if (files.back().shape != files.front().shape) {
+                throw std::runtime_error(std::string{"Histogram file "} + argv[i]
+                                         + " was written for a different lattice shape");
+            }
+        }
+
+        DensityOfStates density;
+        if (std::size(files) == 1) {
+            density = singleHistogram(files[0].histogram, files[0].params);
+        }
+        else {
+            std::vector<HistogramRun> runs;
+            for (auto const &file : files) {
+                runs.push_back(HistogramRun{file.params, file.histogram});
+            }
+            density = multiHistogram(runs);
+        }
+
+        Index volume = 1_i;
+        for (Index const extent : files.front().shape) {
+            volume = volume*extent;
+        }
+
+        std::cout << "# J, h, energy, specific_heat, magnetisation, abs_magnetisation, "
+                     "susceptibility, binder_cumulant\n"
+                  << std::setprecision(std::numeric_limits<double>::max_digits10);
+        for (double const J : Js) {
+            for (double const h : hs) {
+                auto const obs = reweight(density, Parameters{J, h}, volume);
+                std::cout << J << ", " << h << ", " << obs.energy << ", " << obs.specificHeat
+                          << ", " << obs.magnetisation << ", " << obs.absMagnetisation << ", "
+                          << obs.susceptibility << ", " << obs.binderCumulant << '\n';
+            }
+        }
+    }
+}
+
+int main(int const argc, char const * const argv[])
+{
+    try {
+        run(argc, argv);
+    }
+    catch (std::exception const &e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+}
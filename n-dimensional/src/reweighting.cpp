@@ -0,0 +1,147 @@
+#include "reweighting.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <stdexcept>
+
+namespace {
+    /// Return ln sum_i exp(x_i) without overflow.
+    double logSumExp(std::vector<double> const &x)
+    {
+        double const max = *std::max_element(begin(x), end(x));
+        double sum = 0.0;
+        for (double const xi : x) {
+            sum += std::exp(xi - max);
+        }
+        return max + std::log(sum);
+    }
+
+    /// Return J C + h M, the logarithm of the Boltzmann weight.
+    double logWeight(Parameters const &params, std::int64_t const coupling,
+                     std::int64_t const spinSum) noexcept
+    {
+        return params.JT*static_cast<double>(coupling) + params.hT*static_cast<double>(spinSum);
+    }
+}
+
+DensityOfStates singleHistogram(JointHistogram const &histogram, Parameters const &params)
+{
+    DensityOfStates density;
+    for (auto const &[key, count] : histogram.counts()) {
+        density.coupling.push_back(key.first);
+        density.spinSum.push_back(key.second);
+        density.logDensity.push_back(std::log(static_cast<double>(count))
+                                     - logWeight(params, key.first, key.second));
+    }
+    return density;
+}
+
+DensityOfStates multiHistogram(std::vector<HistogramRun> const &runs, double const tolerance,
+                               std::size_t const maxIterations)
+{
+    if (std::empty(runs)) {
+        throw std::invalid_argument("Need at least one histogram to reweight");
+    }
+
+    // sum of histograms of all runs
+    std::map<JointHistogram::Key, std::uint64_t> total;
+    for (auto const &run : runs) {
+        if (run.histogram.total() == 0) {
+            throw std::invalid_argument("Cannot reweight an empty histogram");
+        }
+        for (auto const &[key, count] : run.histogram.counts()) {
+            total[key] += count;
+        }
+    }
+
+    DensityOfStates density;
+    std::vector<double> logCount;
+    for (auto const &[key, count] : total) {
+        density.coupling.push_back(key.first);
+        density.spinSum.push_back(key.second);
+        logCount.push_back(std::log(static_cast<double>(count)));
+    }
+    std::size_t const nstates = std::size(logCount);
+    std::size_t const nruns = std::size(runs);
+
+    // logWeights[k][s]: ln Boltzmann weight of state s in run k
+    std::vector<std::vector<double>> logWeights(nruns, std::vector<double>(nstates));
+    std::vector<double> logMeasurements(nruns);
+    for (std::size_t k = 0; k < nruns; ++k) {
+        for (std::size_t s = 0; s < nstates; ++s) {
+            logWeights[k][s] = logWeight(runs[k].params, density.coupling[s], density.spinSum[s]);
+        }
+        logMeasurements[k] = std::log(static_cast<double>(runs[k].histogram.total()));
+    }
+
+    density.logDensity.resize(nstates);
+    std::vector<double> logZ(nruns, 0.0);
+    std::vector<double> runTerms(nruns), stateTerms(nstates);
+    for (std::size_t iteration = 0; iteration < maxIterations; ++iteration) {
+        for (std::size_t s = 0; s < nstates; ++s) {
+            for (std::size_t k = 0; k < nruns; ++k) {
+                runTerms[k] = logMeasurements[k] + logWeights[k][s] - logZ[k];
+            }
+            density.logDensity[s] = logCount[s] - logSumExp(runTerms);
+        }
+
+        double change = 0.0;
+        double offset = 0.0;
+        for (std::size_t k = 0; k < nruns; ++k) {
+            for (std::size_t s = 0; s < nstates; ++s) {
+                stateTerms[s] = density.logDensity[s] + logWeights[k][s];
+            }
+            double const newLogZ = logSumExp(stateTerms);
+            // fix the free normalisation by ln Z_0 = 0
+            if (k == 0) {
+                offset = newLogZ;
+            }
+            change = std::max(change, std::abs(newLogZ - offset - logZ[k]));
+            logZ[k] = newLogZ - offset;
+        }
+        if (change <= tolerance) {
+            return density;
+        }
+    }
+    throw std::runtime_error("Multi-histogram iteration did not converge");
+}
+
+ReweightedObservables reweight(DensityOfStates const &density, Parameters const &params,
+                               Index const volume)
+{
+    std::size_t const nstates = std::size(density.logDensity);
+    if (nstates == 0) {
+        throw std::invalid_argument("Cannot reweight an empty density of states");
+    }
+
+    std::vector<double> logP(nstates);
+    for (std::size_t s = 0; s < nstates; ++s) {
+        logP[s] = density.logDensity[s] + logWeight(params, density.coupling[s], density.spinSum[s]);
+    }
+    double const logNorm = logSumExp(logP);
+
+    double const V = static_cast<double>(volume.get());
+    std::vector<double> prob(nstates), energy(nstates);
+    double e = 0.0, m = 0.0, absm = 0.0, m2 = 0.0, m4 = 0.0;
+    for (std::size_t s = 0; s < nstates; ++s) {
+        double const p = std::exp(logP[s] - logNorm);
+        double const E = -logWeight(params, density.coupling[s], density.spinSum[s]);
+        double const mag = static_cast<double>(density.spinSum[s]) / V;
+        prob[s] = p;
+        energy[s] = E;
+        e += p*E;
+        m += p*mag;
+        absm += p*std::abs(mag);
+        m2 += p*mag*mag;
+        m4 += p*mag*mag*mag*mag;
+    }
+    // second pass for the variance to avoid cancellations of large energies
+    double varE = 0.0;
+    for (std::size_t s = 0; s < nstates; ++s) {
+        varE += prob[s]*(energy[s] - e)*(energy[s] - e);
+    }
+
+    return ReweightedObservables{e / V, varE / V, m, absm, V*(m2 - absm*absm),
+                                 1.0 - m4 / (3.0*m2*m2)};
+}
@@ -0,0 +1,72 @@
+#ifndef ISING_REWEIGHTING_HPP
+#define ISING_REWEIGHTING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "index.hpp"
+#include "ising.hpp"
+#include "statistics.hpp"
+
+/*
+ * The Boltzmann weight of a configuration with coupling sum C and spin sum M
+ * is exp(J C + h M). So the density of states g(C, M) determines observables
+ * at all parameters, and it can be estimated from histograms of (C, M).
+ */
+
+/// Logarithm of the density of states of all pairs that occurred, up to a constant.
+struct DensityOfStates
+{
+    std::vector<std::int64_t> coupling;
+    std::vector<std::int64_t> spinSum;
+    std::vector<double> logDensity;
+};
+
+/// Histogram measured in a run with given parameters.
+struct HistogramRun
+{
+    Parameters params;
+    JointHistogram const &histogram;
+};
+
+/// Estimate the density of states from a single histogram, ln g = ln H - J C - h M.
+DensityOfStates singleHistogram(JointHistogram const &histogram, Parameters const &params);
+
+/// Estimate the density of states from histograms of several runs.
+/**
+ * Uses the multi-histogram method of Ferrenberg and Swendsen (WHAM) which combines all runs
+ * weighted by their number of measurements. It iterates
+ *   g(C, M) = H(C, M) / sum_k n_k exp(J_k C + h_k M - ln Z_k),
+ *   ln Z_k = ln sum_{C, M} g(C, M) exp(J_k C + h_k M)
+ * until no ln Z_k changes by more than tolerance.
+ * For a single run, this reduces to singleHistogram().
+ * Measurements are treated as independent, so runs should use the same measurement interval
+ * relative to their autocorrelation time.
+ *
+ * \throws std::invalid_argument if runs is empty or a histogram is empty.
+ * \throws std::runtime_error if the iteration does not converge within maxIterations.
+ */
+DensityOfStates multiHistogram(std::vector<HistogramRun> const &runs,
+                               double tolerance=1e-10, std::size_t maxIterations=10000);
+
+/// Observables computed from a density of states.
+struct ReweightedObservables
+{
+    double energy;            ///< <E> / V
+    double specificHeat;      ///< (<E^2> - <E>^2) / V
+    double magnetisation;     ///< <m> with m = M / V
+    double absMagnetisation;  ///< <|m|>
+    double susceptibility;    ///< V (<m^2> - <|m|>^2)
+    double binderCumulant;    ///< 1 - <m^4> / (3 <m^2>^2)
+};
+
+/// Compute observables at given parameters from a density of states.
+/**
+ * Results are only reliable for parameters close to those of the runs
+ * the density was estimated from, where the histograms have enough entries.
+ */
+ReweightedObservables reweight(DensityOfStates const &density, Parameters const &params,
+                               Index volume);
+
+#endif  // ndef ISING_REWEIGHTING_HPP
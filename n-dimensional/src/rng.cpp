@@ -0,0 +1,231 @@
+#include "rng.hpp"
+
+#include <stdexcept>
+
+namespace {
+    /// Output function of splitmix64, a bijection that maps 0 to 0.
+    std::uint64_t mix64(std::uint64_t z) noexcept
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    /// splitmix64 generator, used to expand seeds into xoshiro states.
+    std::uint64_t splitmix64(std::uint64_t &x) noexcept
+    {
+        return mix64(x += 0x9e3779b97f4a7c15);
+    }
+
+    /// Return the high and low 32 bits of the product of a and b.
+    std::pair<std::uint32_t, std::uint32_t> mulhilo(std::uint32_t const a,
+                                                    std::uint32_t const b) noexcept
+    {
+        std::uint64_t const product = static_cast<std::uint64_t>(a) * b;
+        return {static_cast<std::uint32_t>(product >> 32), static_cast<std::uint32_t>(product)};
+    }
+
+    std::mt19937 seededMT(unsigned long const seed, unsigned long const stream)
+    {
+        std::seed_seq seq{seed, stream};
+        return std::mt19937{seq};
+    }
+}
+
+
+Xoshiro256pp::Xoshiro256pp(std::uint64_t const seed, std::uint64_t const stream)
+    : state{}
+{
+    // stream 0 starts at the seed itself
+    std::uint64_t x = seed ^ mix64(stream);
+    for (auto &s : state) {
+        s = splitmix64(x);
+    }
+}
+
+
+Philox4x32::Philox4x32(std::uint64_t const seed, std::uint64_t const stream) noexcept
+    : counter{0, 0, static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)},
+      key{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)}
+{ }
+
+std::array<std::uint64_t, 2> Philox4x32::nextBlock() noexcept
+{
+    auto const out = block(counter, key);
+    // the stream in the upper half of the counter is never touched
+    if (++counter[0] == 0) {
+        ++counter[1];
+    }
+    return {(static_cast<std::uint64_t>(out[1]) << 32) | out[0],
+            (static_cast<std::uint64_t>(out[3]) << 32) | out[2]};
+}
+
+std::array<std::uint32_t, 4> Philox4x32::block(std::array<std::uint32_t, 4> ctr,
+                                               std::array<std::uint32_t, 2> k) noexcept
+{
+    constexpr std::uint32_t multiplier0 = 0xD2511F53, multiplier1 = 0xCD9E8D57;
+    constexpr std::uint32_t weyl0 = 0x9E3779B9, weyl1 = 0xBB67AE85;
+
+    for (int round = 0; round < 10; ++round) {
+        if (round > 0) {
+            k[0] += weyl0;
+            k[1] += weyl1;
+        }
+        auto const [hi0, lo0] = mulhilo(multiplier0, ctr[0]);
+        auto const [hi1, lo1] = mulhilo(multiplier1, ctr[2]);
+        ctr = {hi1 ^ ctr[1] ^ k[0], lo1, hi0 ^ ctr[3] ^ k[1], lo0};
+    }
+    return ctr;
+}
+
+
+double SiteRng::uniform(std::uint64_t const site) const noexcept
+{
+    auto const block = Philox4x32::block(
+        {static_cast<std::uint32_t>(site), static_cast<std::uint32_t>(site >> 32),
+         static_cast<std::uint32_t>(sweep), static_cast<std::uint32_t>(sweep >> 32)},
+        {static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)});
+    std::uint64_t const bits = (std::uint64_t{block[0]} << 32) | block[1];
+    return static_cast<double>(bits >> 11) * 0x1.0p-53;
+}
+
+std::int8_t SiteRng::spin(std::uint64_t const site) const noexcept
+{
+    // the largest sweep number is reserved for initial configurations
+    auto const block = Philox4x32::block(
+        {static_cast<std::uint32_t>(site), static_cast<std::uint32_t>(site >> 32),
+         ~std::uint32_t{0}, ~std::uint32_t{0}},
+        {static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)});
+    return block[0] >> 31 ? std::int8_t{+1} : std::int8_t{-1};
+}
+
+
+Rng::Rng(Index const latsize, unsigned long const seed, Generator const generator)
+    : generator_{generator},
+      // result_type differs between implementations, make sure it always compiles
+      rng{static_cast<decltype(rng)::result_type>(seed)},
+      indexDist{0, latsize.get()-1},
+      realDist{0, 1},
+      spinDist{0, 1},
+      xoshiro_{seed, 0},
+      philox_{seed, 0},
+      buffer_(generator == Generator::MT19937 ? 0 : bufferSize),
+      pos_{std::size(buffer_)},
+      latsize_{latsize.get()}
+{ }
+
+Rng::Rng(Index const latsize, unsigned long const seed, unsigned long const stream,
+         Generator const generator)
+    : generator_{generator},
+      rng{generator == Generator::MT19937 ? seededMT(seed, stream) : std::mt19937{}},
+      indexDist{0, latsize.get()-1},
+      realDist{0, 1},
+      spinDist{0, 1},
+      xoshiro_{seed, generator == Generator::XOSHIRO256PP ? stream : 0},
+      philox_{seed, stream},
+      buffer_(generator == Generator::MT19937 ? 0 : bufferSize),
+      pos_{std::size(buffer_)},
+      latsize_{latsize.get()}
+{ }
+
+void Rng::generate(std::uint64_t *first, std::uint64_t * const last)
+{
+    for (; first != last; ++first) {
+        if (generator_ == Generator::MT19937) {
+            *first = (std::uint64_t{rng()} << 32) | rng();
+        }
+        else {
+            *first = nextRaw();
+        }
+    }
+}
+
+void Rng::refill()
+{
+    switch (generator_) {
+    case Generator::XOSHIRO256PP:
+        for (auto &x : buffer_) {
+            x = xoshiro_();
+        }
+        break;
+    case Generator::PHILOX4X32:
+        for (std::size_t i = 0; i < std::size(buffer_); i += 2) {
+            auto const block = philox_.nextBlock();
+            buffer_[i] = block[0];
+            buffer_[i+1] = block[1];
+        }
+        break;
+    case Generator::MT19937:
+        throw std::logic_error("MT19937 does not use a buffer");
+    }
+    pos_ = 0;
+}
+
+std::ostream &operator<<(std::ostream &os, Rng const &rng)
+{
+    os << static_cast<int>(rng.generator_) << ' ';
+    switch (rng.generator_) {
+    case Rng::Generator::MT19937:
+        return os << rng.rng;
+    case Rng::Generator::XOSHIRO256PP:
+        for (auto const s : rng.xoshiro_.state) {
+            os << s << ' ';
+        }
+        break;
+    case Rng::Generator::PHILOX4X32:
+        for (auto const c : rng.philox_.counter) {
+            os << c << ' ';
+        }
+        os << rng.philox_.key[0] << ' ' << rng.philox_.key[1] << ' ';
+        break;
+    }
+
+    // unused part of the buffer
+    os << std::size(rng.buffer_) - rng.pos_;
+    for (std::size_t i = rng.pos_; i < std::size(rng.buffer_); ++i) {
+        os << ' ' << rng.buffer_[i];
+    }
+    return os;
+}
+
+std::istream &operator>>(std::istream &is, Rng &rng)
+{
+    int generator;
+    is >> generator;
+    if (generator < 0 or generator > static_cast<int>(Rng::Generator::PHILOX4X32)) {
+        is.setstate(std::ios::failbit);
+        return is;
+    }
+    rng.generator_ = static_cast<Rng::Generator>(generator);
+
+    switch (rng.generator_) {
+    case Rng::Generator::MT19937:
+        rng.buffer_.clear();
+        rng.pos_ = 0;
+        return is >> rng.rng;
+    case Rng::Generator::XOSHIRO256PP:
+        for (auto &s : rng.xoshiro_.state) {
+            is >> s;
+        }
+        break;
+    case Rng::Generator::PHILOX4X32:
+        for (auto &c : rng.philox_.counter) {
+            is >> c;
+        }
+        is >> rng.philox_.key[0] >> rng.philox_.key[1];
+        break;
+    }
+
+    std::size_t nbuffered;
+    is >> nbuffered;
+    if (not is or nbuffered > Rng::bufferSize) {
+        is.setstate(std::ios::failbit);
+        return is;
+    }
+    rng.buffer_.resize(Rng::bufferSize);
+    rng.pos_ = Rng::bufferSize - nbuffered;
+    for (std::size_t i = rng.pos_; i < Rng::bufferSize; ++i) {
+        is >> rng.buffer_[i];
+    }
+    return is;
+}
@@ -1,50 +1,221 @@
 #ifndef ISING_RNG_HPP
 #define ISING_RNG_HPP
 
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
 #include <random>
+#include <vector>
 
 #include "lattice.hpp"
 #include "configuration.hpp"
 
+/// xoshiro256++ generator by Blackman and Vigna.
+/**
+ * Has a period of 2^256-1 and passes all common statistical tests.
+ * Streams are seeded independently through splitmix64 instead of jumping ahead,
+ * so constructing any stream takes constant time. Their sequences start at unrelated
+ * points of the period and overlap with negligible probability.
+ */
+struct Xoshiro256pp
+{
+    using result_type = std::uint64_t;
+
+    /// Seed using splitmix64 started from seed combined with stream.
+    Xoshiro256pp(std::uint64_t seed, std::uint64_t stream);
+
+    /// Generate the next number.
+    result_type operator()() noexcept
+    {
+        result_type const result = rotl(state[0] + state[3], 23) + state[0];
+        result_type const t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    std::array<std::uint64_t, 4> state;
+
+private:
+    static constexpr result_type rotl(result_type const x, int const k) noexcept
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+/// Philox4x32-10 counter based generator by Salmon et al.
+/**
+ * Encrypts a 128 bit counter with a 64 bit key. The key is the seed and
+ * the upper 64 bits of the counter are the stream, so streams are independent
+ * by construction and each has a period of 2^64 blocks of 128 bits.
+ */
+struct Philox4x32
+{
+    using result_type = std::uint64_t;
+
+    Philox4x32(std::uint64_t seed, std::uint64_t stream) noexcept;
+
+    /// Return the 128 bit random block for the current counter and increment the counter.
+    std::array<result_type, 2> nextBlock() noexcept;
+
+    /// Compute the random block for a given counter and key.
+    static std::array<std::uint32_t, 4> block(std::array<std::uint32_t, 4> counter,
+                                              std::array<std::uint32_t, 2> key) noexcept;
+
+    std::array<std::uint32_t, 4> counter;
+    std::array<std::uint32_t, 2> key;
+};
+
+
+/// Counter based random numbers for every site of the global lattice and sweep.
+/**
+ * Uses Philox4x32-10 with the seed as key and the global site index and
+ * sweep number as counter. So the same numbers are used for a given site
+ * regardless of how or on which device the lattice is updated.
+ */
+struct SiteRng
+{
+    std::uint64_t seed;
+    /// Number of the current sweep, incremented once per checkerboard sweep.
+    std::uint64_t sweep;
+
+    /// Return a uniform random number in [0, 1) for a global site in the current sweep.
+    double uniform(std::uint64_t site) const noexcept;
+
+    /// Return a random spin for a site that does not depend on sweep.
+    std::int8_t spin(std::uint64_t site) const noexcept;
+};
+
+
 /// Helper class to handle a random number generator.
+/**
+ * Supports several generators, see Generator.
+ * MT19937 uses the standard library distributions and reproduces
+ * the random numbers of earlier versions of the program.
+ * All others generate raw 64 bit numbers in bulk into a buffer and derive indices,
+ * reals, and spins from them without rejection loops in the common case.
+ */
 struct Rng
 {
+    /// Available generators.
+    enum class Generator { MT19937, XOSHIRO256PP, PHILOX4X32 };
+
+    /// Number of raw numbers generated at once by buffered generators.
+    static constexpr std::size_t bufferSize = 1024;
+
     /// Seed the rng and set up distributions.
-    explicit Rng(Index const latsize,
-                 unsigned long const seed)
-        // result_type differs between implementations, make sure it always compiles
-        : rng{static_cast<decltype(rng)::result_type>(seed)},
-          indexDist{0, latsize.get()-1},
-          realDist{0, 1},
-          spinDist{0, 1}
-    { }
+    explicit Rng(Index latsize, unsigned long seed,
+                 Generator generator=Generator::MT19937);
+
+    /// Seed the rng for one of several independent streams.
+    /**
+     * Generators with the same seed but different stream numbers
+     * produce independent sequences of random numbers.
+     * Stream 0 of XOSHIRO256PP and PHILOX4X32 is the same as the sequence
+     * produced by the constructor without stream.
+     */
+    Rng(Index latsize, unsigned long seed, unsigned long stream,
+        Generator generator=Generator::MT19937);
 
     /// Generate a random index into a configuration.
     Index genIndex()
     {
-        return Index{indexDist(rng)};
+        if (generator_ == Generator::MT19937) {
+            return Index{indexDist(rng)};
+        }
+        return Index{bounded(nextRaw(), latsize_)};
     }
 
     /// Generate a random double in [0, 1).
     double genReal()
     {
-        return realDist(rng);
+        if (generator_ == Generator::MT19937) {
+            return realDist(rng);
+        }
+        // use the upper 53 bits as mantissa
+        return static_cast<double>(nextRaw() >> 11) * 0x1.0p-53;
     }
 
     /// Generate a random spin, one of {-1, +1}.
     Spin genSpin()
     {
-        return spinDist(rng)==0 ? Spin{-1} : Spin{1};
+        if (generator_ == Generator::MT19937) {
+            return spinDist(rng)==0 ? Spin{-1} : Spin{1};
+        }
+        return (nextRaw() >> 63) == 0 ? Spin{-1} : Spin{1};
     }
 
+    /// Fill a range with raw uniformly distributed 64 bit numbers.
+    void generate(std::uint64_t *first, std::uint64_t *last);
+
     /// Change the lattice size used to generate indices.
     void setLatsize(Index const latsize)
     {
         indexDist = std::uniform_int_distribution<typename Index::Underlying>{0, latsize.get()-1};
+        latsize_ = latsize.get();
+    }
+
+    /// Return the kind of generator in use.
+    Generator generator() const noexcept
+    {
+        return generator_;
     }
 
+    /// Write the state of the generator in text form.
+    /**
+     * The distributions do not carry state between draws, so reading
+     * the state back into an Rng for the same lattice size
+     * continues the exact same sequence of random numbers.
+     */
+    friend std::ostream &operator<<(std::ostream &os, Rng const &rng);
+
+    /// Read the state of the generator written by operator<<.
+    /**
+     * Also restores the kind of generator.
+     */
+    friend std::istream &operator>>(std::istream &is, Rng &rng);
+
 private:
-    /// The generator.
+    /// Return a raw number from the buffer, refilling it if needed.
+    std::uint64_t nextRaw()
+    {
+        if (pos_ == std::size(buffer_)) {
+            refill();
+        }
+        return buffer_[pos_++];
+    }
+
+    /// Generate a new buffer of raw numbers.
+    void refill();
+
+    /// Unsigned 128 bit integer, supported by GCC and Clang.
+    __extension__ using Uint128 = unsigned __int128;
+
+    /// Map a raw number to [0, range) without bias using Lemire's method.
+    std::uint64_t bounded(std::uint64_t x, std::uint64_t const range)
+    {
+        auto m = static_cast<Uint128>(x) * range;
+        auto low = static_cast<std::uint64_t>(m);
+        if (low < range) {
+            // only reject in the rare case that x is in the truncated range
+            std::uint64_t const threshold = -range % range;
+            while (low < threshold) {
+                x = nextRaw();
+                m = static_cast<Uint128>(x) * range;
+                low = static_cast<std::uint64_t>(m);
+            }
+        }
+        return static_cast<std::uint64_t>(m >> 64);
+    }
+
+    Generator generator_;
+
+    /// The standard generator, only used with Generator::MT19937.
     std::mt19937 rng;
 
     /// Distribution to generator lattice indices.
@@ -55,6 +226,16 @@ private:
 
     /// Distribution to generate spins, i.e. values 0 or 1.
     std::uniform_int_distribution<typename Spin::Underlying> spinDist;
+
+    Xoshiro256pp xoshiro_;
+    Philox4x32 philox_;
+
+    /// Raw numbers for buffered generators, empty for MT19937.
+    std::vector<std::uint64_t> buffer_;
+    /// Index of the next unused element of buffer_.
+    std::size_t pos_;
+    /// Upper bound for indices of buffered generators.
+    std::uint64_t latsize_;
 };
 
 
@@ -0,0 +1,60 @@
+#include "scan.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+
+std::vector<Chain> warmStartChains(std::size_t const nensembles, std::size_t nchains)
+{
+    if (nensembles == 0) {
+        return {};
+    }
+    if (nchains == 0 or nchains > nensembles) {
+        nchains = nensembles;
+    }
+
+    std::vector<Chain> chains(nchains);
+    std::size_t const length = nensembles / nchains;
+    std::size_t const remainder = nensembles % nchains;
+    std::size_t next = 0;
+    for (std::size_t c = 0; c < nchains; ++c) {
+        // the first `remainder` chains get one extra ensemble
+        std::size_t const n = length + (c < remainder ? 1 : 0);
+        for (std::size_t i = 0; i < n; ++i) {
+            chains[c].push_back(next++);
+        }
+    }
+    return chains;
+}
+
+void runChains(std::vector<Chain> const &chains, ThreadPool &pool, std::ostream &os,
+               std::function<void(std::size_t, Chain const &, std::ostream &)> const &runChain)
+{
+    // stable, so chains of equal length keep their order
+    std::vector<std::size_t> order(std::size(chains));
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&chains](std::size_t const a, std::size_t const b) {
+        return std::size(chains[a]) > std::size(chains[b]);
+    });
+
+    std::mutex osMutex;
+    pool.run(std::size(chains), [&](std::size_t const task) {
+        std::size_t const c = order[task];
+        std::ostringstream log;
+        auto const flush = [&] {
+            std::lock_guard lock{osMutex};
+            os << log.str() << std::flush;
+        };
+
+        try {
+            runChain(c, chains[c], log);
+        }
+        catch (...) {
+            // keep what the chain reported before failing
+            flush();
+            throw;
+        }
+        flush();
+    });
+}
@@ -0,0 +1,45 @@
+#ifndef ISING_SCAN_HPP
+#define ISING_SCAN_HPP
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <vector>
+
+#include "threadpool.hpp"
+
+/// Indices of ensembles that are run one after the other.
+/**
+ * Each ensemble starts from the final configuration of the previous one
+ * (warm start), only the first is thermalised from the initial configuration.
+ */
+using Chain = std::vector<std::size_t>;
+
+/// Split a scan over ensembles into warm start chains of consecutive ensembles.
+/**
+ * \param nensembles Total number of ensembles.
+ * \param nchains Number of chains, 0 means one chain per ensemble.
+ *                At most nensembles chains are returned.
+ * \returns Chains whose lengths differ by at most one.
+ *          Together, they cover all ensembles in increasing order.
+ */
+std::vector<Chain> warmStartChains(std::size_t nensembles, std::size_t nchains);
+
+/// Run independent chains concurrently.
+/**
+ * Chains are handed to the threads of pool as they become idle, longest chains first,
+ * so that the wall time is close to that of the longest chain if there are more chains
+ * than threads. Each chain writes its messages into its own buffer which is copied
+ * to os in one piece when the chain has finished.
+ *
+ * \param chains Chains to run.
+ * \param pool Threads to run chains on.
+ * \param os Stream to write messages of all chains to.
+ * \param runChain Function `(std::size_t chainIndex, Chain const &chain, std::ostream &log)`
+ *                 that runs all ensembles of chains[chainIndex] and writes messages to log.
+ *                 Called concurrently for different chains.
+ */
+void runChains(std::vector<Chain> const &chains, ThreadPool &pool, std::ostream &os,
+               std::function<void(std::size_t, Chain const &, std::ostream &)> const &runChain);
+
+#endif  // ndef ISING_SCAN_HPP
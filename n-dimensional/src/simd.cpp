@@ -0,0 +1,477 @@
+#include "simd.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#include <immintrin.h>
+
+namespace {
+    constexpr std::size_t nlanes = LaneRng::nlanes;
+
+    /// Raw data of a CheckerboardKernel and the range to update, shared by all instruction sets.
+    struct Rows
+    {
+        std::int32_t *spins;
+        std::int32_t const *neighbourRows;
+        std::uint8_t const *parity;
+        std::int32_t const *limits;
+        std::int32_t rowLength;
+        std::int32_t nneighbourRows;
+        std::int32_t neighbourOffset;
+        std::size_t colour;
+        std::size_t first;
+        std::size_t last;
+    };
+
+    /// Sums over accepted flips from which the change in energy is computed.
+    struct FlipSums
+    {
+        /// Sum of spin times sum of neighbours before the flip.
+        std::int64_t coupling = 0;
+        /// Sum of spins before the flip.
+        std::int64_t magnetisation = 0;
+        std::size_t naccept = 0;
+    };
+
+    constexpr std::uint32_t rotl(std::uint32_t const x, int const k) noexcept
+    {
+        return (x << k) | (x >> (32 - k));
+    }
+
+    /// Return the first site of a row and the position of its first site of the colour.
+    std::pair<std::int32_t, std::int32_t> rowStart(Rows const &rows, std::size_t const row) noexcept
+    {
+        return {static_cast<std::int32_t>(row)*rows.rowLength,
+                static_cast<std::int32_t>((rows.colour + rows.parity[row]) % 2)};
+    }
+
+    FlipSums updateRowsScalar(Rows const &rows, LaneRng &rng) noexcept
+    {
+        FlipSums sums;
+        std::int32_t const length = rows.rowLength;
+        std::int32_t const nsites = length / 2;
+
+        for (std::size_t row = rows.first; row < rows.last; ++row) {
+            auto const [start, first] = rowStart(rows, row);
+            std::int32_t const *neighbourRows = rows.neighbourRows
+                + row*static_cast<std::size_t>(rows.nneighbourRows);
+
+            for (std::int32_t group = 0; group < nsites; group += static_cast<std::int32_t>(nlanes)) {
+                auto const random = rng();
+                std::int32_t const nactive = std::min(static_cast<std::int32_t>(nlanes), nsites-group);
+                for (std::int32_t lane = 0; lane < nactive; ++lane) {
+                    std::int32_t const x = first + 2*(group+lane);
+                    std::int32_t const right = x+1 == length ? 0 : x+1;
+                    std::int32_t const left = x == 0 ? length-1 : x-1;
+
+                    std::int32_t const spin = rows.spins[start+x];
+                    std::int32_t nsum = rows.spins[start+right] + rows.spins[start+left];
+                    for (std::int32_t n = 0; n < rows.nneighbourRows; ++n) {
+                        nsum += rows.spins[neighbourRows[n]+x];
+                    }
+
+                    std::int32_t const limit = rows.limits[nsum + rows.neighbourOffset + (spin+1)/2];
+                    if (static_cast<std::int32_t>(random[static_cast<std::size_t>(lane)] >> 1) <= limit) {
+                        rows.spins[start+x] = -spin;
+                        sums.coupling += spin*nsum;
+                        sums.magnetisation += spin;
+                        ++sums.naccept;
+                    }
+                }
+            }
+        }
+        return sums;
+    }
+
+    __attribute__((target("avx2")))
+    __m256i rotlAVX2(__m256i const x, int const k) noexcept
+    {
+        return _mm256_or_si256(_mm256_slli_epi32(x, k), _mm256_srli_epi32(x, 32-k));
+    }
+
+    /// Advance 8 lanes of xoshiro128++ and return their outputs.
+    __attribute__((target("avx2")))
+    __m256i nextAVX2(__m256i (&s)[4]) noexcept
+    {
+        __m256i const result = _mm256_add_epi32(rotlAVX2(_mm256_add_epi32(s[0], s[3]), 7), s[0]);
+        __m256i const t = _mm256_slli_epi32(s[1], 9);
+        s[2] = _mm256_xor_si256(s[2], s[0]);
+        s[3] = _mm256_xor_si256(s[3], s[1]);
+        s[1] = _mm256_xor_si256(s[1], s[2]);
+        s[0] = _mm256_xor_si256(s[0], s[3]);
+        s[2] = _mm256_xor_si256(s[2], t);
+        s[3] = rotlAVX2(s[3], 11);
+        return result;
+    }
+
+    __attribute__((target("avx2")))
+    std::int64_t horizontalSumAVX2(__m256i const x) noexcept
+    {
+        alignas(32) std::array<std::int32_t, 8> values;
+        _mm256_store_si256(reinterpret_cast<__m256i *>(values.data()), x);
+        std::int64_t sum = 0;
+        for (std::int32_t const v : values) {
+            sum += v;
+        }
+        return sum;
+    }
+
+    __attribute__((target("avx2")))
+    FlipSums updateRowsAVX2(Rows const &rows, LaneRng &rng) noexcept
+    {
+        constexpr std::size_t width = 8;
+        FlipSums sums;
+        std::int32_t const length = rows.rowLength;
+        std::int32_t const nsites = length / 2;
+
+        // lanes 0-7 and 8-15 of the rng are stored in separate registers
+        __m256i state[2][4];
+        for (std::size_t half = 0; half < 2; ++half) {
+            for (std::size_t w = 0; w < 4; ++w) {
+                state[half][w] = _mm256_loadu_si256(
+                    reinterpret_cast<__m256i const *>(rng.state[w].data() + half*width));
+            }
+        }
+
+        __m256i const zero = _mm256_setzero_si256();
+        __m256i const one = _mm256_set1_epi32(1);
+        __m256i const lengthV = _mm256_set1_epi32(length);
+        __m256i const lastX = _mm256_set1_epi32(length-1);
+        __m256i const offsetV = _mm256_set1_epi32(rows.neighbourOffset);
+        __m256i const laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i const laneOffset = _mm256_add_epi32(laneIndex, laneIndex);
+
+        for (std::size_t row = rows.first; row < rows.last; ++row) {
+            auto const [start, first] = rowStart(rows, row);
+            std::int32_t const *neighbourRows = rows.neighbourRows
+                + row*static_cast<std::size_t>(rows.nneighbourRows);
+            __m256i const startV = _mm256_set1_epi32(start);
+            __m256i coupling = zero;
+            __m256i magn = zero;
+
+            for (std::int32_t group = 0; group < nsites; group += static_cast<std::int32_t>(nlanes)) {
+                for (std::size_t half = 0; half < 2; ++half) {
+                    // advance all lanes even if they are not needed to stay in sync with the scalar version
+                    __m256i const random = nextAVX2(state[half]);
+                    std::int32_t const base = group + static_cast<std::int32_t>(half*width);
+                    if (base >= nsites) {
+                        continue;
+                    }
+
+                    __m256i const active = _mm256_cmpgt_epi32(_mm256_set1_epi32(nsites-base), laneIndex);
+                    // inactive lanes are clamped into the row and masked out below
+                    __m256i const x = _mm256_min_epi32(
+                        _mm256_add_epi32(_mm256_set1_epi32(first + 2*base), laneOffset), lastX);
+                    __m256i const xp1 = _mm256_add_epi32(x, one);
+                    __m256i const right = _mm256_andnot_si256(_mm256_cmpeq_epi32(xp1, lengthV), xp1);
+                    __m256i const left = _mm256_add_epi32(_mm256_sub_epi32(x, one),
+                                                          _mm256_and_si256(_mm256_cmpeq_epi32(x, zero), lengthV));
+
+                    __m256i const spin = _mm256_i32gather_epi32(rows.spins, _mm256_add_epi32(startV, x), 4);
+                    __m256i nsum = _mm256_add_epi32(
+                        _mm256_i32gather_epi32(rows.spins, _mm256_add_epi32(startV, right), 4),
+                        _mm256_i32gather_epi32(rows.spins, _mm256_add_epi32(startV, left), 4));
+                    for (std::int32_t n = 0; n < rows.nneighbourRows; ++n) {
+                        nsum = _mm256_add_epi32(nsum, _mm256_i32gather_epi32(
+                            rows.spins, _mm256_add_epi32(_mm256_set1_epi32(neighbourRows[n]), x), 4));
+                    }
+
+                    __m256i const tableIndex = _mm256_add_epi32(_mm256_add_epi32(nsum, offsetV),
+                                                                _mm256_srli_epi32(_mm256_add_epi32(spin, one), 1));
+                    __m256i const limit = _mm256_i32gather_epi32(rows.limits, tableIndex, 4);
+                    __m256i const accept = _mm256_andnot_si256(
+                        _mm256_cmpgt_epi32(_mm256_srli_epi32(random, 1), limit), active);
+
+                    coupling = _mm256_add_epi32(coupling,
+                                                _mm256_and_si256(accept, _mm256_mullo_epi32(spin, nsum)));
+                    magn = _mm256_add_epi32(magn, _mm256_and_si256(accept, spin));
+
+                    // AVX2 has no scatter, flip accepted sites one by one
+                    auto mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(accept)));
+                    sums.naccept += static_cast<std::size_t>(__builtin_popcount(mask));
+                    std::int32_t * const spins = rows.spins + start + first + 2*base;
+                    while (mask) {
+                        std::int32_t const lane = __builtin_ctz(mask);
+                        spins[2*lane] = -spins[2*lane];
+                        mask &= mask-1;
+                    }
+                }
+            }
+
+            sums.coupling += horizontalSumAVX2(coupling);
+            sums.magnetisation += horizontalSumAVX2(magn);
+        }
+
+        for (std::size_t half = 0; half < 2; ++half) {
+            for (std::size_t w = 0; w < 4; ++w) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(rng.state[w].data() + half*width),
+                                    state[half][w]);
+            }
+        }
+        return sums;
+    }
+
+    // GCC's AVX-512 intrinsics initialise undefined vectors with themselves and,
+    // in unoptimised builds, expand gathers to macros which convert masks to short
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+
+    /// Advance all 16 lanes of xoshiro128++ and return their outputs.
+    __attribute__((target("avx512f")))
+    __m512i nextAVX512(__m512i (&s)[4]) noexcept
+    {
+        __m512i const result = _mm512_add_epi32(_mm512_rol_epi32(_mm512_add_epi32(s[0], s[3]), 7), s[0]);
+        __m512i const t = _mm512_slli_epi32(s[1], 9);
+        s[2] = _mm512_xor_si512(s[2], s[0]);
+        s[3] = _mm512_xor_si512(s[3], s[1]);
+        s[1] = _mm512_xor_si512(s[1], s[2]);
+        s[0] = _mm512_xor_si512(s[0], s[3]);
+        s[2] = _mm512_xor_si512(s[2], t);
+        s[3] = _mm512_rol_epi32(s[3], 11);
+        return result;
+    }
+
+    __attribute__((target("avx512f")))
+    FlipSums updateRowsAVX512(Rows const &rows, LaneRng &rng) noexcept
+    {
+        FlipSums sums;
+        std::int32_t const length = rows.rowLength;
+        std::int32_t const nsites = length / 2;
+
+        __m512i state[4];
+        for (std::size_t w = 0; w < 4; ++w) {
+            state[w] = _mm512_loadu_si512(rng.state[w].data());
+        }
+
+        __m512i const zero = _mm512_setzero_si512();
+        __m512i const one = _mm512_set1_epi32(1);
+        __m512i const lengthV = _mm512_set1_epi32(length);
+        __m512i const lastX = _mm512_set1_epi32(length-1);
+        __m512i const offsetV = _mm512_set1_epi32(rows.neighbourOffset);
+        __m512i const laneIndex = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7,
+                                                    8, 9, 10, 11, 12, 13, 14, 15);
+        __m512i const laneOffset = _mm512_add_epi32(laneIndex, laneIndex);
+
+        for (std::size_t row = rows.first; row < rows.last; ++row) {
+            auto const [start, first] = rowStart(rows, row);
+            std::int32_t const *neighbourRows = rows.neighbourRows
+                + row*static_cast<std::size_t>(rows.nneighbourRows);
+            __m512i const startV = _mm512_set1_epi32(start);
+            __m512i coupling = zero;
+            __m512i magn = zero;
+
+            for (std::int32_t group = 0; group < nsites; group += static_cast<std::int32_t>(nlanes)) {
+                __m512i const random = nextAVX512(state);
+
+                __mmask16 const active = _mm512_cmpgt_epi32_mask(_mm512_set1_epi32(nsites-group), laneIndex);
+                __m512i const x = _mm512_min_epi32(
+                    _mm512_add_epi32(_mm512_set1_epi32(first + 2*group), laneOffset), lastX);
+                __m512i const xp1 = _mm512_add_epi32(x, one);
+                __m512i const right = _mm512_mask_mov_epi32(xp1, _mm512_cmpeq_epi32_mask(xp1, lengthV), zero);
+                __m512i const left = _mm512_mask_mov_epi32(_mm512_sub_epi32(x, one),
+                                                           _mm512_cmpeq_epi32_mask(x, zero), lastX);
+
+                __m512i const site = _mm512_add_epi32(startV, x);
+                __m512i const spin = _mm512_i32gather_epi32(site, rows.spins, 4);
+                __m512i nsum = _mm512_add_epi32(
+                    _mm512_i32gather_epi32(_mm512_add_epi32(startV, right), rows.spins, 4),
+                    _mm512_i32gather_epi32(_mm512_add_epi32(startV, left), rows.spins, 4));
+                for (std::int32_t n = 0; n < rows.nneighbourRows; ++n) {
+                    nsum = _mm512_add_epi32(nsum, _mm512_i32gather_epi32(
+                        _mm512_add_epi32(_mm512_set1_epi32(neighbourRows[n]), x), rows.spins, 4));
+                }
+
+                __m512i const tableIndex = _mm512_add_epi32(_mm512_add_epi32(nsum, offsetV),
+                                                            _mm512_srli_epi32(_mm512_add_epi32(spin, one), 1));
+                __m512i const limit = _mm512_i32gather_epi32(tableIndex, rows.limits, 4);
+                __mmask16 const accept = _mm512_mask_cmple_epi32_mask(
+                    active, _mm512_srli_epi32(random, 1), limit);
+
+                coupling = _mm512_mask_add_epi32(coupling, accept, coupling, _mm512_mullo_epi32(spin, nsum));
+                magn = _mm512_mask_add_epi32(magn, accept, magn, spin);
+                sums.naccept += static_cast<std::size_t>(__builtin_popcount(accept));
+                _mm512_mask_i32scatter_epi32(rows.spins, accept, site, _mm512_sub_epi32(zero, spin), 4);
+            }
+
+            sums.coupling += _mm512_reduce_add_epi32(coupling);
+            sums.magnetisation += _mm512_reduce_add_epi32(magn);
+        }
+
+        for (std::size_t w = 0; w < 4; ++w) {
+            _mm512_storeu_si512(rng.state[w].data(), state[w]);
+        }
+        return sums;
+    }
+
+#pragma GCC diagnostic pop
+}
+
+bool simdSupported(SimdLevel const level) noexcept
+{
+    switch (level) {
+    case SimdLevel::AVX512:
+        return __builtin_cpu_supports("avx512f");
+    case SimdLevel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SimdLevel::SCALAR:
+        break;
+    }
+    return true;
+}
+
+SimdLevel detectSimdLevel() noexcept
+{
+    for (SimdLevel const level : {SimdLevel::AVX512, SimdLevel::AVX2}) {
+        if (simdSupported(level)) {
+            return level;
+        }
+    }
+    return SimdLevel::SCALAR;
+}
+
+
+LaneRng::LaneRng(Rng &rng)
+    : state{}
+{
+    std::array<std::uint64_t, 2*nlanes> seeds;
+    rng.generate(seeds.data(), seeds.data() + std::size(seeds));
+
+    for (std::size_t lane = 0; lane < nlanes; ++lane) {
+        for (std::size_t w = 0; w < 4; ++w) {
+            std::uint64_t const seed = seeds[2*lane + w/2];
+            state[w][lane] = static_cast<std::uint32_t>(w % 2 == 0 ? seed : seed >> 32);
+        }
+        // xoshiro must not be seeded with all zeros
+        if (state[0][lane] == 0 and state[1][lane] == 0
+            and state[2][lane] == 0 and state[3][lane] == 0) {
+            state[0][lane] = 1;
+        }
+    }
+}
+
+std::array<std::uint32_t, LaneRng::nlanes> LaneRng::operator()() noexcept
+{
+    std::array<std::uint32_t, nlanes> result;
+    for (std::size_t lane = 0; lane < nlanes; ++lane) {
+        auto &s0 = state[0][lane], &s1 = state[1][lane], &s2 = state[2][lane], &s3 = state[3][lane];
+        result[lane] = rotl(s0 + s3, 7) + s0;
+        std::uint32_t const t = s1 << 9;
+        s2 ^= s0;
+        s3 ^= s1;
+        s1 ^= s2;
+        s0 ^= s3;
+        s2 ^= t;
+        s3 = rotl(s3, 11);
+    }
+    return result;
+}
+
+
+CheckerboardKernel::CheckerboardKernel(Lattice const &lat, Parameters const &params,
+                                       SimdLevel const level)
+    : level_{level}
+{
+    if (not simdSupported(level)) {
+        throw std::invalid_argument("Requested SIMD instruction set is not supported by this CPU");
+    }
+    if (lat.layout() != Lattice::SiteLayout::ROW_MAJOR) {
+        throw std::invalid_argument("The SIMD checkerboard kernel requires the row-major site layout");
+    }
+    for (Index const extent : lat.shape()) {
+        if (extent.get() % 2 != 0) {
+            throw std::invalid_argument("Checkerboard decomposition requires even lattice extents");
+        }
+    }
+    if (size(lat).get() > static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())) {
+        throw std::invalid_argument("Lattice is too large for the SIMD checkerboard kernel");
+    }
+
+    MultiIndex const &shape = lat.shape();
+    rowLength_ = static_cast<std::int32_t>(shape.back().get());
+    nneighbourRows_ = static_cast<std::int32_t>(2*(std::size(shape)-1));
+    neighbourOffset_ = static_cast<std::int32_t>(2*std::size(shape));
+
+    // coordinates in all but the last dimension
+    MultiIndex const rowShape(shape.begin(), shape.end()-1);
+    std::size_t const nrows = size(lat).get() / shape.back().get();
+    // distance between rows with neighbouring coordinates in each dimension
+    std::vector<std::size_t> rowStrides(std::size(rowShape), 1);
+    for (std::size_t d = std::size(rowShape); d > 1; --d) {
+        rowStrides[d-2] = rowStrides[d-1] * rowShape[d-1].get();
+    }
+
+    rowParity_.reserve(nrows);
+    neighbourRows_.reserve(nrows * static_cast<std::size_t>(nneighbourRows_));
+    MultiIndex row(std::size(rowShape), 0_i);
+    for (std::size_t r = 0; r < nrows; ++r) {
+        std::size_t parity = 0;
+        for (std::size_t d = 0; d < std::size(rowShape); ++d) {
+            std::size_t const coord = row[d].get();
+            std::size_t const extent = rowShape[d].get();
+            std::size_t const base = r - coord*rowStrides[d];
+            for (std::size_t const neighbour : {(coord+1) % extent, (coord+extent-1) % extent}) {
+                neighbourRows_.emplace_back(static_cast<std::int32_t>(
+                    (base + neighbour*rowStrides[d]) * shape.back().get()));
+            }
+            parity += coord;
+        }
+        rowParity_.emplace_back(static_cast<std::uint8_t>(parity % 2));
+
+        if (not std::empty(row)) {
+            increment(row, rowShape);
+        }
+    }
+
+    BoltzmannTable const boltzmann{params, lat.ndim()};
+    constexpr double scale = 2147483648.0;  // 2^31
+    limits_.resize(static_cast<std::size_t>(2*neighbourOffset_ + 2));
+    for (std::size_t idx = 0; idx < std::size(limits_); ++idx) {
+        double const acceptance = boltzmann.acceptance(idx);
+        limits_[idx] = acceptance >= 1.0
+            ? std::numeric_limits<std::int32_t>::max()
+            : static_cast<std::int32_t>(std::floor(acceptance*scale)) - 1;
+    }
+}
+
+std::int64_t CheckerboardKernel::update(Configuration &cfg, std::size_t const colour,
+                                        std::size_t const firstRow, std::size_t const lastRow,
+                                        LaneRng &rng, std::size_t &naccept,
+                                        std::int64_t &magn) const
+{
+    static_assert(sizeof(Spin) == sizeof(std::int32_t), "Kernel operates on spins as int32");
+
+    if constexpr (not ndebug) {
+        if (size(cfg).get() != nrows()*static_cast<std::size_t>(rowLength_)) {
+            throw std::invalid_argument("Configuration does not match the lattice of the kernel");
+        }
+        if (firstRow > lastRow or lastRow > nrows()) {
+            throw std::out_of_range("Invalid range of rows");
+        }
+    }
+
+    Rows const rows{reinterpret_cast<std::int32_t *>(&*begin(cfg)),
+                    neighbourRows_.data(), rowParity_.data(), limits_.data(),
+                    rowLength_, nneighbourRows_, neighbourOffset_,
+                    colour % 2, firstRow, lastRow};
+
+    FlipSums sums;
+    switch (level_) {
+    case SimdLevel::AVX512:
+        sums = updateRowsAVX512(rows, rng);
+        break;
+    case SimdLevel::AVX2:
+        sums = updateRowsAVX2(rows, rng);
+        break;
+    case SimdLevel::SCALAR:
+        sums = updateRowsScalar(rows, rng);
+        break;
+    }
+
+    naccept += sums.naccept;
+    magn -= 2*sums.magnetisation;
+    // every flip changes the coupling sum by -2 spin neighbourSum
+    return -2*sums.coupling;
+}
@@ -0,0 +1,108 @@
+#ifndef ISING_SIMD_HPP
+#define ISING_SIMD_HPP
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "configuration.hpp"
+#include "ising.hpp"
+#include "lattice.hpp"
+#include "rng.hpp"
+
+/// Instruction sets for which the vectorised checkerboard kernel is implemented.
+enum class SimdLevel
+{
+    SCALAR,  ///< Portable fallback, processes one site at a time.
+    AVX2,    ///< 8 sites at a time.
+    AVX512   ///< 16 sites at a time, requires AVX-512F.
+};
+
+/// Return true if the CPU this program runs on supports an instruction set.
+bool simdSupported(SimdLevel level) noexcept;
+
+/// Return the widest instruction set supported by the CPU this program runs on.
+SimdLevel detectSimdLevel() noexcept;
+
+
+/// 16 independent xoshiro128++ generators advanced in lockstep.
+/**
+ * Every call produces one 32 bit number per lane. The state is stored lane by lane
+ * so that vector kernels can load all lanes of a state word at once.
+ * All instruction sets in SimdLevel produce the same sequence of numbers.
+ */
+struct alignas(64) LaneRng
+{
+    static constexpr std::size_t nlanes = 16;
+
+    /// Seed all lanes from numbers drawn from rng.
+    explicit LaneRng(Rng &rng);
+
+    /// Advance all lanes and return their outputs.
+    std::array<std::uint32_t, nlanes> operator()() noexcept;
+
+    /// state[w][lane] is word w of the state of a lane.
+    std::array<std::array<std::uint32_t, nlanes>, 4> state;
+};
+
+
+/// Metropolis updates of one checkerboard sublattice using SIMD instructions.
+/**
+ * Sites are processed row by row where a row is a line along the last (contiguous)
+ * dimension. The sites of one colour in a row are at every other position, they are
+ * split into groups of LaneRng::nlanes and site i of a group accepts or rejects its
+ * flip using the number from lane i of the rng.
+ * Neighbours are loaded with gather instructions and accepted flips are applied with
+ * masked stores.
+ *
+ * Acceptance probabilities are quantised to multiples of 2^-31 (rounded down) so that
+ * the decision can be made with integer comparisons. Flips with probability 1 are
+ * always accepted. Since every instruction set performs the same integer operations in
+ * the same grouping, all of them produce identical Markov chains.
+ *
+ * Requires all lattice extents to be even and fewer than 2^31 sites.
+ */
+class CheckerboardKernel
+{
+public:
+    /// Precompute the row structure of a lattice and acceptance thresholds.
+    CheckerboardKernel(Lattice const &lat, Parameters const &params, SimdLevel level);
+
+    /// Return the number of rows along the last dimension.
+    std::size_t nrows() const noexcept
+    {
+        return std::size(rowParity_);
+    }
+
+    /// Update all sites of one colour in a range of rows.
+    /**
+     * \param cfg Configuration to update.
+     * \param colour Parity of the sum of coordinates of the sites to update.
+     * \param firstRow Index of the first row to update.
+     * \param lastRow Index one past the last row to update.
+     * \param rng Random number generator, advanced once per group of sites.
+     * \param naccept Incremented by the number of accepted flips.
+     * \param magn Incremented by the change in the sum of all spins.
+     *
+     * \returns The change in the coupling sum.
+     */
+    std::int64_t update(Configuration &cfg, std::size_t colour,
+                        std::size_t firstRow, std::size_t lastRow,
+                        LaneRng &rng, std::size_t &naccept, std::int64_t &magn) const;
+
+private:
+    SimdLevel level_;
+    std::int32_t rowLength_;
+    /// Number of neighbouring rows of each row, 2*(ndim-1).
+    std::int32_t nneighbourRows_;
+    /// Offset of the neighbour sum in acceptance table indices, 2*ndim.
+    std::int32_t neighbourOffset_;
+    /// Total index of the first site of every neighbouring row, nneighbourRows_ per row.
+    std::vector<std::int32_t> neighbourRows_;
+    /// Parity of the sum of coordinates of the first site of every row.
+    std::vector<std::uint8_t> rowParity_;
+    /// Flips are accepted if (random >> 1) <= limits_[BoltzmannTable::index(spin, nsum)].
+    std::vector<std::int32_t> limits_;
+};
+
+#endif  // ndef ISING_SIMD_HPP
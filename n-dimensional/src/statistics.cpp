@@ -0,0 +1,84 @@
+#include "statistics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+void BinningAccumulator::push(double x)
+{
+    for (std::size_t l = 0; ; ++l) {
+        if (l == std::size(levels_)) {
+            levels_.emplace_back();
+        }
+        Level &level = levels_[l];
+
+        ++level.count;
+        double const delta = x - level.mean;
+        level.mean += delta / static_cast<double>(level.count);
+        level.m2 += delta * (x - level.mean);
+
+        if (not level.hasPending) {
+            level.pending = x;
+            level.hasPending = true;
+            return;
+        }
+        // completed a block at the next level
+        x = 0.5*(level.pending + x);
+        level.hasPending = false;
+    }
+}
+
+std::size_t BinningAccumulator::count() const noexcept
+{
+    return std::empty(levels_) ? 0 : levels_.front().count;
+}
+
+double BinningAccumulator::mean() const noexcept
+{
+    return std::empty(levels_) ? 0.0 : levels_.front().mean;
+}
+
+double BinningAccumulator::variance() const noexcept
+{
+    if (count() < 2) {
+        return 0.0;
+    }
+    return levels_.front().m2 / static_cast<double>(count()-1);
+}
+
+std::size_t BinningAccumulator::nblocks(std::size_t const level) const
+{
+    return levels_.at(level).count;
+}
+
+double BinningAccumulator::binnedError(std::size_t const level) const
+{
+    Level const &lev = levels_.at(level);
+    if (lev.count < 2) {
+        return 0.0;
+    }
+    double const n = static_cast<double>(lev.count);
+    return std::sqrt(lev.m2 / (n-1.0) / n);
+}
+
+double BinningAccumulator::error() const noexcept
+{
+    double err = 0.0;
+    for (std::size_t l = 0; l < std::size(levels_); ++l) {
+        if (levels_[l].count < minBlocks and l > 0) {
+            break;
+        }
+        err = std::max(err, binnedError(l));
+    }
+    return err;
+}
+
+double BinningAccumulator::tauInt() const noexcept
+{
+    double const naive = std::empty(levels_) ? 0.0 : binnedError(0);
+    if (naive == 0.0) {
+        return 0.5;
+    }
+    double const ratio = error() / naive;
+    return 0.5 * ratio*ratio;
+}
@@ -0,0 +1,131 @@
+#ifndef ISING_STATISTICS_HPP
+#define ISING_STATISTICS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+/// Accumulate a Markov chain time series without storing it.
+/**
+ * Uses logarithmic binning: Level l holds the running mean and variance
+ * (Welford's algorithm) of the means of consecutive, non-overlapping
+ * blocks of 2^l measurements. This takes O(log n) memory for n measurements.
+ *
+ * For correlated data, the naive error estimate at level 0 is too small.
+ * It grows with l until blocks are longer than the autocorrelation time
+ * and plateaus there. error() and tauInt() are derived from this plateau.
+ */
+class BinningAccumulator
+{
+public:
+    /// Statistics of blocks of one size.
+    struct Level
+    {
+        std::size_t count = 0;
+        double mean = 0.0;
+        /// Sum of squared deviations from the mean.
+        double m2 = 0.0;
+        /// First half of the next block at the level above.
+        double pending = 0.0;
+        bool hasPending = false;
+    };
+
+    /// Minimum number of blocks at a level for it to be used in error estimates.
+    static constexpr std::size_t minBlocks = 32;
+
+    /// Start without any measurements.
+    BinningAccumulator() = default;
+
+    /// Resume from the levels of another accumulator, see levels().
+    explicit BinningAccumulator(std::vector<Level> levels)
+        : levels_{std::move(levels)}
+    { }
+
+    /// Add a measurement.
+    void push(double x);
+
+    /// Return the number of measurements.
+    std::size_t count() const noexcept;
+
+    /// Return the mean of all measurements.
+    double mean() const noexcept;
+
+    /// Return the variance of individual measurements.
+    double variance() const noexcept;
+
+    /// Return the number of binning levels.
+    std::size_t nlevels() const noexcept
+    {
+        return std::size(levels_);
+    }
+
+    /// Return the internal state of all levels, e.g. to save it in a checkpoint.
+    std::vector<Level> const &levels() const noexcept
+    {
+        return levels_;
+    }
+
+    /// Return the number of complete blocks at a binning level.
+    std::size_t nblocks(std::size_t level) const;
+
+    /// Return the error of the mean estimated from blocks of size 2^level.
+    double binnedError(std::size_t level) const;
+
+    /// Return the error of the mean taking autocorrelations into account.
+    /**
+     * This is the largest binned error over all levels with at least minBlocks blocks.
+     */
+    double error() const noexcept;
+
+    /// Return the integrated autocorrelation time in units of measurements.
+    /**
+     * Estimated as tau_int = 1/2 (error() / binnedError(0))^2,
+     * i.e. tau_int = 1/2 for uncorrelated data.
+     */
+    double tauInt() const noexcept;
+
+private:
+    std::vector<Level> levels_;
+};
+
+/// Joint histogram of the coupling sum and the sum of all spins.
+/**
+ * The energy is -J C - h M with the integer coupling sum C = sum_<x,y> s_x s_y
+ * over all links and the spin sum M = sum_x s_x. So the histogram of (C, M) holds all
+ * information needed to reweight to other J and h, see reweighting.hpp.
+ * Only pairs that occurred are stored.
+ */
+class JointHistogram
+{
+public:
+    /// Coupling sum and spin sum.
+    using Key = std::pair<std::int64_t, std::int64_t>;
+
+    /// Add count measurements of a given coupling sum and spin sum.
+    void add(std::int64_t const coupling, std::int64_t const spinSum,
+             std::uint64_t const count=1)
+    {
+        counts_[Key{coupling, spinSum}] += count;
+        total_ += count;
+    }
+
+    /// Return the number of measurements of all pairs, sorted by coupling sum first.
+    std::map<Key, std::uint64_t> const &counts() const noexcept
+    {
+        return counts_;
+    }
+
+    /// Return the total number of measurements.
+    std::uint64_t total() const noexcept
+    {
+        return total_;
+    }
+
+private:
+    std::map<Key, std::uint64_t> counts_;
+    std::uint64_t total_ = 0;
+};
+
+#endif  // ndef ISING_STATISTICS_HPP
@@ -0,0 +1,113 @@
+#include "tempering.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+
+#include "lattice.hpp"
+#include "localupdate.hpp"
+
+namespace {
+    /// Propose a swap of configurations between replicas i and i+1.
+    /**
+     * \returns true if the swap was accepted.
+     */
+    bool attemptSwap(std::vector<Replica> &replicas, std::vector<Parameters> const &params,
+                     size_t const i, Rng &swapRng)
+    {
+        Replica &lower = replicas[i];
+        Replica &upper = replicas[i+1];
+
+        // the coupling sums move with the configurations, only the parameters change
+        std::int64_t const lowerMagn = spinSum(lower.cfg);
+        std::int64_t const upperMagn = spinSum(upper.cfg);
+        double const delta = energyFromSums(params[i], upper.coupling, upperMagn)
+            + energyFromSums(params[i+1], lower.coupling, lowerMagn)
+            - energyFromSums(params[i], lower.coupling, lowerMagn)
+            - energyFromSums(params[i+1], upper.coupling, upperMagn);
+
+        if (delta <= 0.0 or std::exp(-delta) > swapRng.genReal()) {
+            std::swap(lower.cfg, upper.cfg);
+            std::swap(lower.coupling, upper.coupling);
+            return true;
+        }
+        return false;
+    }
+}
+
+template <typename Lat>
+std::tuple<std::vector<Replica>, std::vector<double>, std::vector<double>>
+replicaExchange(std::vector<Replica> replicas, std::vector<Parameters> const &params,
+                Lat const &lat, Rng &swapRng, size_t const nsweep, size_t const swapInterval,
+                ThreadPool &pool, std::vector<Observables> * const obs,
+                std::vector<std::vector<Measurement>> const &extraMeas)
+{
+    size_t const nreplicas = std::size(replicas);
+    if (std::size(params) != nreplicas
+        or (obs and std::size(*obs) != nreplicas)
+        or (not std::empty(extraMeas) and std::size(extraMeas) != nreplicas)) {
+        throw std::invalid_argument("Need one set of parameters, observables, and measurements per replica");
+    }
+    if (swapInterval == 0) {
+        throw std::invalid_argument("Swap interval must be positive");
+    }
+
+    std::vector<double> accRates(nreplicas, 0.0);
+    std::vector<size_t> nswapAttempt(nreplicas > 0 ? nreplicas-1 : 0, 0);
+    std::vector<size_t> nswapAccept(std::size(nswapAttempt), 0);
+
+    std::vector<Measurement> const noMeas;
+    for (size_t done = 0, round = 0; done < nsweep; ++round) {
+        size_t const nsweepRound = std::min(swapInterval, nsweep-done);
+
+        pool.run(nreplicas, [&](size_t const i) {
+            Replica &replica = replicas[i];
+            double accRate;
+            std::tie(replica.cfg, std::ignore, std::ignore, accRate) = evolve(
+                std::move(replica.cfg), replica.coupling, params[i], lat, replica.rng,
+                nsweepRound, obs ? &(*obs)[i] : nullptr,
+                std::empty(extraMeas) ? noMeas : extraMeas[i]);
+            accRates[i] += accRate * static_cast<double>(nsweepRound);
+        });
+        done += nsweepRound;
+
+        // alternate between even and odd pairs
+        for (size_t i = round % 2; i+1 < nreplicas; i += 2) {
+            ++nswapAttempt[i];
+            if (attemptSwap(replicas, params, i, swapRng)) {
+                ++nswapAccept[i];
+            }
+        }
+    }
+
+    for (auto &rate : accRates) {
+        rate /= static_cast<double>(std::max(nsweep, size_t{1}));
+    }
+    std::vector<double> swapRates(std::size(nswapAttempt), 0.0);
+    for (size_t i = 0; i < std::size(swapRates); ++i) {
+        if (nswapAttempt[i] > 0) {
+            swapRates[i] = static_cast<double>(nswapAccept[i])
+                / static_cast<double>(nswapAttempt[i]);
+        }
+    }
+
+    return {std::move(replicas), std::move(accRates), std::move(swapRates)};
+}
+
+// instantiate for all supported lattice types
+#define INSTANTIATE_REPLICA_EXCHANGE(LAT)                                        \
+    template std::tuple<std::vector<Replica>, std::vector<double>, std::vector<double>> \
+    replicaExchange(std::vector<Replica> replicas, std::vector<Parameters> const &params, \
+                    LAT const &lat, Rng &swapRng, size_t const nsweep,           \
+                    size_t const swapInterval, ThreadPool &pool,                 \
+                    std::vector<Observables> * const obs,                        \
+                    std::vector<std::vector<Measurement>> const &extraMeas)
+
+INSTANTIATE_REPLICA_EXCHANGE(Lattice);
+INSTANTIATE_REPLICA_EXCHANGE(FixedLattice<1>);
+INSTANTIATE_REPLICA_EXCHANGE(FixedLattice<2>);
+INSTANTIATE_REPLICA_EXCHANGE(FixedLattice<3>);
+INSTANTIATE_REPLICA_EXCHANGE(FixedLattice<4>);
+
+#undef INSTANTIATE_REPLICA_EXCHANGE
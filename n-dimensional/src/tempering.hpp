@@ -0,0 +1,58 @@
+#ifndef ISING_TEMPERING_HPP
+#define ISING_TEMPERING_HPP
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include "configuration.hpp"
+#include "ising.hpp"
+#include "montecarlo.hpp"
+#include "rng.hpp"
+#include "threadpool.hpp"
+
+/// State of a single replica in replica exchange.
+struct Replica
+{
+    /// Current configuration, moves between replicas when swapping.
+    Configuration cfg;
+    /// Coupling sum of cfg, see couplingSum(), moves with cfg when swapping.
+    std::int64_t coupling;
+    /// Random number generator for updates of this replica, is never swapped.
+    Rng rng;
+};
+
+/// Evolve replicas at different parameters concurrently and swap their configurations.
+/**
+ * Replica i evolves under params[i] using evolve(). After every swapInterval sweeps,
+ * swaps are proposed between replicas at neighbouring parameters, alternating between
+ * pairs (0, 1), (2, 3), ... and (1, 2), (3, 4), ...
+ * A swap of configurations c_i and c_j is accepted with probability
+ * min(1, exp(H_i(c_i) + H_j(c_j) - H_i(c_j) - H_j(c_i))).
+ *
+ * \param replicas One replica per element of params.
+ * \param params Physical parameters, should be sorted such that neighbours are close.
+ * \param lat Lattice to run on, must be consistent with all configurations.
+ *            Instantiated for Lattice and FixedLattice<N> with N = 1, ..., 4.
+ * \param swapRng Random number generator for swap decisions.
+ * \param nsweep Number of sweeps to perform per replica.
+ * \param swapInterval Number of sweeps between swap proposals.
+ * \param pool Threads to evolve replicas on.
+ * \param obs One storage for measuring observables per replica.
+ *            Can be nullptr in which case no measurements are performed.
+ * \param extraMeas Additional measurements per replica, either empty or one vector per replica.
+ *                  Each vector element is called after every sweep.
+ *
+ * \returns Tuple of
+ *   - final replicas
+ *   - acceptance rate of each replica
+ *   - swap acceptance rate between replicas i and i+1 for each i.
+ */
+template <typename Lat>
+std::tuple<std::vector<Replica>, std::vector<double>, std::vector<double>>
+replicaExchange(std::vector<Replica> replicas, std::vector<Parameters> const &params,
+                Lat const &lat, Rng &swapRng, size_t nsweep, size_t swapInterval,
+                ThreadPool &pool, std::vector<Observables> *obs,
+                std::vector<std::vector<Measurement>> const &extraMeas={});
+
+#endif  // ndef ISING_TEMPERING_HPP
@@ -0,0 +1,85 @@
+#include "threadpool.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+ThreadPool::ThreadPool(std::size_t const nthreads)
+    : threads_{}, mutex_{}, wakeup_{}, done_{},
+      task_{nullptr}, ntasks_{0}, next_{0}, nfinished_{0},
+      stop_{false}, exception_{}
+{
+    if (nthreads == 0) {
+        throw std::invalid_argument("ThreadPool needs at least one thread");
+    }
+
+    for (std::size_t i = 0; i < nthreads; ++i) {
+        threads_.emplace_back([this]{ work(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stop_ = true;
+    }
+    wakeup_.notify_all();
+    for (auto &thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(std::size_t const ntasks, std::function<void(std::size_t)> const &task)
+{
+    if (ntasks == 0) {
+        return;
+    }
+
+    std::unique_lock lock{mutex_};
+    task_ = &task;
+    ntasks_ = ntasks;
+    next_ = 0;
+    nfinished_ = 0;
+    exception_ = nullptr;
+    wakeup_.notify_all();
+
+    done_.wait(lock, [this]{ return nfinished_ == ntasks_; });
+    task_ = nullptr;
+    ntasks_ = 0;
+    next_ = 0;
+
+    if (exception_) {
+        std::rethrow_exception(std::exchange(exception_, nullptr));
+    }
+}
+
+void ThreadPool::work()
+{
+    std::unique_lock lock{mutex_};
+    while (true) {
+        wakeup_.wait(lock, [this]{ return stop_ or next_ < ntasks_; });
+        if (stop_) {
+            return;
+        }
+
+        std::size_t const i = next_++;
+        auto const &task = *task_;
+        lock.unlock();
+
+        std::exception_ptr exception;
+        try {
+            task(i);
+        }
+        catch (...) {
+            exception = std::current_exception();
+        }
+
+        lock.lock();
+        if (exception and not exception_) {
+            exception_ = exception;
+        }
+        if (++nfinished_ == ntasks_) {
+            done_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef ISING_THREADPOOL_HPP
+#define ISING_THREADPOOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Fixed set of worker threads that execute batches of independent tasks.
+/**
+ * Threads are started once on construction and reused for every call to run()
+ * to avoid the cost of spawning threads for every batch.
+ */
+class ThreadPool
+{
+public:
+    /// Start a given number of worker threads.
+    explicit ThreadPool(std::size_t nthreads);
+
+    /// Stop and join all worker threads.
+    ~ThreadPool();
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool &operator=(ThreadPool const &) = delete;
+
+    /// Return the number of worker threads.
+    std::size_t size() const noexcept
+    {
+        return std::size(threads_);
+    }
+
+    /// Call task(i) for all i in [0, ntasks) on the worker threads.
+    /**
+     * Blocks until all tasks have finished.
+     * If any task throws, the first exception is rethrown after all tasks have finished.
+     * Not reentrant, tasks must not call run() of the same pool.
+     */
+    void run(std::size_t ntasks, std::function<void(std::size_t)> const &task);
+
+private:
+    /// Main loop of worker threads.
+    void work();
+
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    /// Signals workers that tasks are available or that they shall stop.
+    std::condition_variable wakeup_;
+    /// Signals run() that all tasks are finished.
+    std::condition_variable done_;
+
+    std::function<void(std::size_t)> const *task_;
+    std::size_t ntasks_;
+    std::size_t next_;
+    std::size_t nfinished_;
+    bool stop_;
+    std::exception_ptr exception_;
+};
+
+#endif  // ndef ISING_THREADPOOL_HPP
@@ -0,0 +1,165 @@
+#include "checkpoint.hpp"
+
+#include <filesystem>
+#include <fstream>
+
+#include "catch.hpp"
+#include "fileio.hpp"
+
+namespace fs = std::filesystem;
+
+TEST_CASE("Rng state round trip", "[Checkpoint]")
+{
+    Rng rng{100_i, 9};
+    for (int i = 0; i < 1000; ++i) {
+        rng.genReal();
+    }
+
+    std::stringstream ss;
+    ss << rng;
+    Rng copy{100_i, 1};
+    ss >> copy;
+
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(copy.genIndex() == rng.genIndex());
+        REQUIRE(copy.genReal() == rng.genReal());
+        REQUIRE(copy.genSpin() == rng.genSpin());
+    }
+}
+
+TEST_CASE("Checkpoints", "[Checkpoint]")
+{
+    fs::path const outdir = fs::temp_directory_path() / "ising-test-checkpoint";
+    prepareOutdir(outdir);
+    fs::path const fname = outdir/"checkpoint.bin";
+
+    Lattice const lat{{6_i, 4_i}, 2.5};
+    Parameters const params{0.4, 0.1};
+
+    for (auto const mode : {Observables::Mode::HISTORY, Observables::Mode::STREAMING}) {
+        Rng rng{size(lat), 33};
+        std::vector<Rng> threadRngs{Rng{size(lat), 33, 1}, Rng{size(lat), 33, 2}};
+        Configuration cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+
+        MeasurementIntervals const intervals{1, 1, 1, 1, 1};
+        Observables obs(lat, Observables::Correlator::Method::PAIR_SUM, mode, intervals);
+        std::tie(cfg, std::ignore, std::ignore, std::ignore) = evolve(cfg, coupling, params, lat,
+                                                                      rng, 50, &obs);
+        saveCheckpoint(fname, Checkpoint{33, lat.shape(), 2, 50, 12.5, 7, cfg, coupling,
+                                         rng, threadRngs, 123},
+                       obs);
+        REQUIRE_FALSE(fs::exists(outdir/"checkpoint.bin.tmp"));
+
+        Observables loadedObs(lat, Observables::Correlator::Method::PAIR_SUM, mode, intervals);
+        Checkpoint loaded = loadCheckpoint(fname, loadedObs);
+
+        // metadata is preserved
+        REQUIRE(loaded.rngSeed == 33);
+        REQUIRE(loaded.shape == lat.shape());
+        REQUIRE(loaded.ensemble == 2);
+        REQUIRE(loaded.sweep == 50);
+        REQUIRE(loaded.rateSum == 12.5);
+        REQUIRE(loaded.nclustersPerSweep == 7);
+        REQUIRE(loaded.coupling == couplingSum(cfg, lat));
+        REQUIRE(loaded.cfgFileSize == 123);
+        REQUIRE(std::size(loaded.threadRngs) == 2);
+        REQUIRE(loaded.threadRngs[1].genReal() == threadRngs[1].genReal());
+
+        // observables are preserved
+        REQUIRE(loadedObs.energy == obs.energy);
+        REQUIRE(loadedObs.magnetisation == obs.magnetisation);
+        REQUIRE(loadedObs.corr.correlator == obs.corr.correlator);
+        REQUIRE(loadedObs.fourierModes == obs.fourierModes);
+        REQUIRE(loadedObs.histogram->counts() == obs.histogram->counts());
+        REQUIRE(loadedObs.summary.has_value() == obs.summary.has_value());
+        if (obs.summary) {
+            REQUIRE(loadedObs.summary->energy.count() == obs.summary->energy.count());
+            REQUIRE(loadedObs.summary->energy.mean() == obs.summary->energy.mean());
+            REQUIRE(loadedObs.summary->magnetisation.error()
+                    == obs.summary->magnetisation.error());
+            for (size_t i = 0; i < std::size(obs.summary->correlator); ++i) {
+                REQUIRE(loadedObs.summary->correlator[i].tauInt()
+                        == obs.summary->correlator[i].tauInt());
+            }
+            REQUIRE(loadedObs.summary->fourierModes[1].mean()
+                    == obs.summary->fourierModes[1].mean());
+        }
+
+        // mismatching observables are rejected
+        auto const otherMode = mode == Observables::Mode::HISTORY
+            ? Observables::Mode::STREAMING : Observables::Mode::HISTORY;
+        Observables otherObs(lat, Observables::Correlator::Method::PAIR_SUM, otherMode);
+        REQUIRE_THROWS_AS(loadCheckpoint(fname, otherObs), std::runtime_error);
+
+        Observables noCorrObs(Lattice{lat.shape(), 0.0}, Observables::Correlator::Method::PAIR_SUM,
+                              mode);
+        REQUIRE_THROWS_AS(loadCheckpoint(fname, noCorrObs), std::runtime_error);
+
+        // continuing from the checkpoint reproduces the chain exactly
+        std::tie(cfg, std::ignore, std::ignore, std::ignore) = evolve(cfg, coupling, params, lat,
+                                                                      rng, 30, &obs);
+        std::tie(loaded.cfg, std::ignore, std::ignore, std::ignore) = evolve(
+            loaded.cfg, loaded.coupling, params, lat, loaded.rng, 30, &loadedObs);
+
+        REQUIRE(loaded.coupling == coupling);
+        REQUIRE(std::equal(begin(loaded.cfg), end(loaded.cfg), begin(cfg)));
+        if (obs.summary) {
+            REQUIRE(loadedObs.summary->energy.mean() == obs.summary->energy.mean());
+            REQUIRE(loadedObs.summary->energy.error() == obs.summary->energy.error());
+        }
+        else {
+            REQUIRE(loadedObs.energy == obs.energy);
+        }
+    }
+
+    SECTION("Invalid files are rejected")
+    {
+        Observables obs(lat);
+        REQUIRE_THROWS_AS(loadCheckpoint(outdir/"does-not-exist", obs), std::runtime_error);
+        std::ofstream{outdir/"garbage"} << "not a checkpoint";
+        REQUIRE_THROWS_AS(loadCheckpoint(outdir/"garbage", obs), std::runtime_error);
+    }
+}
+
+TEST_CASE("Resuming configuration output", "[Checkpoint]")
+{
+    fs::path const outdir = fs::temp_directory_path() / "ising-test-checkpoint-cfg";
+    prepareOutdir(outdir);
+
+    Lattice const lat{{4_i, 2_i}, 0.0};
+    Parameters const params{0.4, -0.1};
+    Configuration const up{size(lat), Spin{+1}};
+    Configuration const down{size(lat), Spin{-1}};
+
+    for (auto const format : {ProgConfig::Meas::TEXT, ProgConfig::Meas::BINARY}) {
+        fs::path const fname = outdir / (format == ProgConfig::Meas::TEXT
+                                         ? "0000.cfg" : "0000.cfg.bin");
+        std::uintmax_t size;
+        {
+            CfgWriter writer{outdir, 0, params, lat, format};
+            writer.write(up);
+            size = writer.flush();
+            writer.write(down);
+        }
+        REQUIRE(fs::file_size(fname) > size);
+
+        {
+            CfgWriter reference{outdir, 1, params, lat, format};
+            reference.write(up);
+            reference.write(up);
+        }
+        {
+            CfgWriter writer{outdir, 0, size, format};
+            writer.write(up);
+        }
+
+        fs::path referenceName = fname;
+        referenceName.replace_filename(format == ProgConfig::Meas::TEXT
+                                       ? "0001.cfg" : "0001.cfg.bin");
+        std::ifstream ifs{fname, std::ios::binary}, refIfs{referenceName, std::ios::binary};
+        std::string const content{std::istreambuf_iterator<char>{ifs}, {}};
+        std::string const refContent{std::istreambuf_iterator<char>{refIfs}, {}};
+        REQUIRE(content == refContent);
+    }
+}
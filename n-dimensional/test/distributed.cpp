@@ -0,0 +1,213 @@
+#include "distributed.hpp"
+
+#include "catch.hpp"
+
+namespace {
+    /// Communicator which holds only the calling rank.
+    struct SelfComm
+    {
+        MPI_Comm comm;
+
+        SelfComm()
+        {
+            int rank;
+            MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+            MPI_Comm_split(MPI_COMM_WORLD, rank, 0, &comm);
+        }
+
+        ~SelfComm()
+        {
+            MPI_Comm_free(&comm);
+        }
+    };
+
+    int worldSize()
+    {
+        int nranks;
+        MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+        return nranks;
+    }
+
+    /// Return all grids that distribute a lattice over all ranks along one dimension.
+    std::vector<MultiIndex> worldGrids(MultiIndex const &shape)
+    {
+        auto const nranks = Index{static_cast<size_t>(worldSize())};
+        std::vector<MultiIndex> grids;
+        for (size_t d = 0; d < std::size(shape); ++d) {
+            MultiIndex grid(std::size(shape), 1_i);
+            grid[d] = nranks;
+            if (shape[d].get() % (2*nranks.get()) == 0) {
+                grids.emplace_back(std::move(grid));
+            }
+        }
+        return grids;
+    }
+}
+
+TEST_CASE("Decomposition splits the lattice", "[Distributed]")
+{
+    Lattice const lat{{16_i, 24_i}, 3.5, Lattice::DistanceFn::EUCLIDEAN,
+                      Lattice::NeighbourMode::STENCIL};
+
+    for (auto const &grid : worldGrids(lat.shape())) {
+        Decomposition const decomp{lat, grid, MPI_COMM_WORLD};
+        for (size_t d = 0; d < 2; ++d) {
+            REQUIRE(decomp.localShape()[d] == lat.shape()[d] / grid[d]);
+            REQUIRE(decomp.offset()[d].get() % decomp.localShape()[d].get() == 0);
+            // wide enough for displacements shorter than 3.5
+            REQUIRE(decomp.halo()[d] == 3_i);
+            REQUIRE(decomp.paddedShape()[d] == decomp.localShape()[d] + 6_i);
+        }
+        REQUIRE(std::size(decomp.displacements()) == std::size(lat.sqDistances()));
+    }
+
+    SelfComm const self;
+    REQUIRE_THROWS_AS(Decomposition(lat, {1_i}, self.comm), std::invalid_argument);
+    REQUIRE_THROWS_AS(Decomposition(lat, {1_i, 2_i}, self.comm), std::invalid_argument);
+}
+
+TEST_CASE("Distributed configurations round trip", "[Distributed]")
+{
+    Lattice const lat{{8_i, 4_i, 12_i}, 0.0};
+    Parameters const params{0.4, -0.3};
+    Rng rng(size(lat), 8);
+    Configuration const cfg = randomCfg(size(lat), rng);
+
+    for (auto const &grid : worldGrids(lat.shape())) {
+        Decomposition const decomp{lat, grid, MPI_COMM_WORLD};
+        DistributedConfiguration local = scatter(cfg, decomp);
+        REQUIRE(hamiltonian(local, params, decomp) == Approx(hamiltonian(cfg, params, lat)));
+        REQUIRE(couplingSum(local, decomp) == couplingSum(cfg, lat));
+
+        auto const gathered = gather(local, decomp);
+        REQUIRE(gathered.has_value() == (decomp.rank() == 0));
+        if (gathered) {
+            REQUIRE(std::equal(begin(*gathered), end(*gathered), begin(cfg)));
+        }
+    }
+}
+
+TEST_CASE("Halo exchange fills all halo sites", "[Distributed]")
+{
+    Lattice const lat{{8_i, 12_i}, 2.0, Lattice::DistanceFn::EUCLIDEAN,
+                      Lattice::NeighbourMode::STENCIL};
+    Rng rng(size(lat), 5);
+    Configuration const cfg = randomCfg(size(lat), rng);
+
+    for (auto const &grid : worldGrids(lat.shape())) {
+        Decomposition const decomp{lat, grid, MPI_COMM_WORLD};
+        DistributedConfiguration local = scatter(cfg, decomp);
+        HaloExchange halos{decomp};
+        halos.exchangeAll(local);
+
+        // every padded site holds the spin of the global site it is a periodic image of
+        MultiIndex const &padded = decomp.paddedShape();
+        MultiIndex const &shape = lat.shape();
+        MultiIndex index(2, 0_i);
+        for (size_t i = 0; i < decomp.paddedSize(); ++i) {
+            size_t global = 0;
+            for (size_t d = 0; d < 2; ++d) {
+                global = global*shape[d].get()
+                    + (index[d] + decomp.offset()[d] + shape[d] - decomp.halo()[d]).get() % shape[d].get();
+            }
+            REQUIRE(local.spins[i] == cfg[Index{global}].get());
+            increment(index, padded);
+        }
+    }
+}
+
+TEST_CASE("Distributed chain does not depend on the decomposition", "[Distributed]")
+{
+    Lattice const lat{{16_i, 24_i}, 3.5, Lattice::DistanceFn::EUCLIDEAN,
+                      Lattice::NeighbourMode::STENCIL};
+    std::vector<Parameters> const params{
+        {0.3, 0.0},
+        {0.6, -0.2},
+        {-0.4, 0.5}
+    };
+    constexpr size_t nsweep = 10;
+
+    for (auto const &p : params) {
+        // reference on a single rank
+        SelfComm const self;
+        Decomposition const single{lat, {1_i, 1_i}, self.comm};
+        SiteRng referenceRng{92, 0};
+        DistributedConfiguration reference = randomCfg(single, referenceRng);
+        double const startEnergy = hamiltonian(reference, p, single);
+        std::int64_t const startCoupling = couplingSum(reference, single);
+        std::int64_t referenceCoupling = startCoupling;
+        Observables referenceObs(lat);
+        double referenceRate;
+        double referenceEnergy;
+        double referenceMagn;
+        std::tie(reference, referenceEnergy, referenceMagn, referenceRate) = evolveDistributed(
+            std::move(reference), referenceCoupling, p, single, referenceRng, nsweep, &referenceObs);
+        REQUIRE(referenceObs.magnetisation.back() == referenceMagn);
+        REQUIRE(referenceRng.sweep == nsweep);
+        REQUIRE(referenceRate > 0.0);
+        REQUIRE(referenceRate <= 1.0);
+
+        // compare with measurements on the gathered configuration
+        Configuration const referenceCfg = *gather(reference, single);
+        REQUIRE(referenceEnergy == Approx(hamiltonian(referenceCfg, p, lat)));
+        REQUIRE(referenceCoupling == couplingSum(referenceCfg, lat));
+        Observables serialObs(lat);
+        measure(serialObs, lat, referenceCfg, referenceEnergy);
+        REQUIRE(referenceObs.magnetisation.back() == Approx(serialObs.magnetisation.back()));
+        for (size_t sqdi = 0; sqdi < std::size(lat.sqDistances()); ++sqdi) {
+            REQUIRE(referenceObs.corr.correlator[sqdi].back()
+                    == Approx(serialObs.corr.correlator[sqdi].back()));
+        }
+
+        for (auto const &grid : worldGrids(lat.shape())) {
+            Decomposition const decomp{lat, grid, MPI_COMM_WORLD};
+            SiteRng rng{92, 0};
+            DistributedConfiguration cfg = randomCfg(decomp, rng);
+            REQUIRE(hamiltonian(cfg, p, decomp) == startEnergy);
+
+            Observables obs(lat);
+            std::int64_t coupling = couplingSum(cfg, decomp);
+            REQUIRE(coupling == startCoupling);
+            auto const [result, energy, magn, accRate] = evolveDistributed(
+                std::move(cfg), coupling, p, decomp, rng, nsweep, &obs);
+            REQUIRE(energy == referenceEnergy);
+            REQUIRE(coupling == referenceCoupling);
+            REQUIRE(magn == referenceMagn);
+            REQUIRE(accRate == referenceRate);
+            REQUIRE(obs.energy == referenceObs.energy);
+            REQUIRE(obs.magnetisation == referenceObs.magnetisation);
+            REQUIRE(obs.corr.correlator == referenceObs.corr.correlator);
+
+            auto const gathered = gather(result, decomp);
+            if (gathered) {
+                REQUIRE(std::equal(begin(*gathered), end(*gathered), begin(referenceCfg)));
+            }
+        }
+    }
+}
+
+TEST_CASE("Distributed sweeps visit every site once", "[Distributed]")
+{
+    // without interactions every flip is accepted, so a sweep inverts all spins
+    Lattice const lat{{4_i, 8_i, 6_i}, 0.0};
+    Rng rng(size(lat), 3);
+    Configuration const start = randomCfg(size(lat), rng);
+
+    for (auto const &grid : worldGrids(lat.shape())) {
+        Decomposition const decomp{lat, grid, MPI_COMM_WORLD};
+        SiteRng siteRng{1, 0};
+        DistributedConfiguration scattered = scatter(start, decomp);
+        std::int64_t coupling = couplingSum(scattered, decomp);
+        auto const [cfg, energy, magn, accRate] = evolveDistributed(
+            std::move(scattered), coupling, Parameters{0.0, 0.0}, decomp, siteRng, 1, nullptr);
+        REQUIRE(accRate == 1.0);
+        REQUIRE(magn == -magnetisation(start));
+
+        auto const gathered = gather(cfg, decomp);
+        if (gathered) {
+            for (Index i = 0_i; i < size(lat); ++i) {
+                REQUIRE((*gathered)[i] == start[i]*Spin{-1});
+            }
+        }
+    }
+}
@@ -0,0 +1,93 @@
+#include "fft.hpp"
+
+#include <cmath>
+
+#include "catch.hpp"
+
+namespace {
+    using Complex = FFT::Complex;
+
+    /// Naive O(V^2) forward DFT for comparison.
+    std::vector<Complex> naiveDFT(std::vector<Complex> const &data, MultiIndex const &shape)
+    {
+        constexpr double pi = 3.14159265358979323846;
+        std::vector<Complex> result(std::size(data));
+
+        MultiIndex k(std::size(shape), 0_i);
+        for (size_t ik = 0; ik < std::size(data); ++ik) {
+            MultiIndex x(std::size(shape), 0_i);
+            for (size_t ix = 0; ix < std::size(data); ++ix) {
+                double phase = 0.0;
+                for (size_t d = 0; d < std::size(shape); ++d) {
+                    phase += static_cast<double>((k[d]*x[d]).get())
+                        / static_cast<double>(shape[d].get());
+                }
+                result[ik] += data[ix] * std::polar(1.0, -2.0*pi*phase);
+                increment(x, shape);
+            }
+            increment(k, shape);
+        }
+        return result;
+    }
+
+    std::vector<Complex> testData(size_t const n)
+    {
+        std::vector<Complex> data(n);
+        for (size_t i = 0; i < n; ++i) {
+            double const x = static_cast<double>(i);
+            data[i] = Complex{std::sin(0.7*x) + 0.1*x, std::cos(1.3*x*x)};
+        }
+        return data;
+    }
+}
+
+TEST_CASE("Fast Fourier transform", "[FFT]")
+{
+    std::vector<MultiIndex> const shapes{
+        {1_i},
+        {8_i},
+        {5_i},
+        {12_i},
+        {4_i, 6_i},
+        {3_i, 2_i, 7_i}
+    };
+
+    SECTION("Forward transform matches naive DFT")
+    {
+        for (auto const &shape : shapes) {
+            FFT fft{shape};
+            size_t n = 1;
+            for (Index const extent : shape) {
+                n *= extent.get();
+            }
+            auto data = testData(n);
+            auto const expected = naiveDFT(data, shape);
+
+            fft.forward(data);
+            for (size_t i = 0; i < n; ++i) {
+                REQUIRE(data[i].real() == Approx(expected[i].real()).margin(1e-9));
+                REQUIRE(data[i].imag() == Approx(expected[i].imag()).margin(1e-9));
+            }
+        }
+    }
+
+    SECTION("Backward transform inverts forward transform up to normalisation")
+    {
+        for (auto const &shape : shapes) {
+            FFT fft{shape};
+            size_t n = 1;
+            for (Index const extent : shape) {
+                n *= extent.get();
+            }
+            auto const original = testData(n);
+            auto data = original;
+
+            fft.forward(data);
+            fft.backward(data);
+            for (size_t i = 0; i < n; ++i) {
+                REQUIRE(data[i].real() / static_cast<double>(n) == Approx(original[i].real()).margin(1e-9));
+                REQUIRE(data[i].imag() / static_cast<double>(n) == Approx(original[i].imag()).margin(1e-9));
+            }
+        }
+    }
+}
@@ -1,8 +1,13 @@
 #include "fileio.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <random>
 #include <string>
-#include <filesystem>
 
 #include "catch.hpp"
 #include "util.hpp"
@@ -194,6 +199,7 @@ TEST_CASE("Loading ProgConfig from YAML", "[YAML]")
         ProgConfig const pc = node.as<ProgConfig>();
 
         REQUIRE(pc.rngSeed == 537);
+        REQUIRE(pc.rngGenerator == Rng::Generator::MT19937);
         REQUIRE(pc.params[0] == Parameters{1.0, 0.5});
         REQUIRE(pc.params[1] == Parameters{1.0, 0.7});
         REQUIRE(pc.params[2] == Parameters{1.0, 0.1});
@@ -201,16 +207,163 @@ TEST_CASE("Loading ProgConfig from YAML", "[YAML]")
         REQUIRE(pc.lattice.shape == std::vector<Index>{3_i, 3_i});
         REQUIRE(not pc.lattice.maxDist);
         REQUIRE(pc.lattice.distfn == Lattice::DistanceFn::EUCLIDEAN);
+        REQUIRE(pc.lattice.neighbourMode == Lattice::NeighbourMode::STORED);
 
         REQUIRE(pc.mc.nthermInit == 100);
         REQUIRE(pc.mc.ntherm == std::vector<size_t>{100, 100, 100});
         REQUIRE(pc.mc.nprod == std::vector<size_t>{1000, 1000, 1000});
         REQUIRE(pc.mc.start == ProgConfig::MC::Start::HOT);
+        REQUIRE(pc.mc.update == ProgConfig::MC::Update::RANDOM);
+        REQUIRE(pc.mc.localUpdate == UpdateRule::METROPOLIS);
+        REQUIRE(pc.mc.nthreads > 0);
+        REQUIRE(pc.mc.simd == detectSimdLevel());
+        REQUIRE(pc.mc.storage == ProgConfig::MC::Storage::PLAIN);
+        REQUIRE(pc.mc.tempering == false);
+        REQUIRE(pc.mc.swapInterval == 10);
+        REQUIRE(pc.mc.checkpointInterval == 0);
+        REQUIRE(std::empty(pc.mc.ranks));
+        REQUIRE(pc.mc.device == ProgConfig::MC::CPU);
+        REQUIRE(pc.mc.scanChains == 1);
 
         REQUIRE(pc.meas.energy == true);
         REQUIRE(pc.meas.magnetisation == true);
         REQUIRE(pc.meas.correlator == true);
+        REQUIRE(pc.meas.intervals.energy == 1);
+        REQUIRE(pc.meas.intervals.magnetisation == 1);
+        REQUIRE(pc.meas.intervals.correlator == 1);
+        REQUIRE(pc.meas.correlatorMethod == Observables::Correlator::Method::PAIR_SUM);
         REQUIRE(pc.meas.writeCfg == false);
+        REQUIRE(pc.meas.cfgInterval == 0);
+        REQUIRE(pc.meas.format == ProgConfig::Meas::TEXT);
+        REQUIRE(pc.meas.cfgFormat == ProgConfig::Meas::TEXT);
+        REQUIRE(pc.meas.async == false);
+        REQUIRE(pc.meas.bufferSize == 2);
+        REQUIRE(pc.meas.backpressure == Backpressure::BLOCK);
+        REQUIRE(pc.meas.streaming == false);
+
+        node["Meas"]["correlator_interval"] = 10;
+        node["Meas"]["write_cfg"] = true;
+        node["Meas"]["cfg_interval"] = 1000;
+        ProgConfig const thinned = node.as<ProgConfig>();
+        REQUIRE(thinned.meas.intervals.energy == 1);
+        REQUIRE(thinned.meas.intervals.correlator == 10);
+        REQUIRE(thinned.meas.cfgInterval == 1000);
+        REQUIRE(thinned.meas.fourierModes == false);
+        REQUIRE(thinned.meas.intervals.fourierModes == 0);
+        REQUIRE(thinned.meas.histogram == false);
+        REQUIRE(thinned.meas.intervals.histogram == 0);
+        node["Meas"]["energy_interval"] = 0;
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["Meas"].remove("energy_interval");
+        node["Meas"]["write_cfg"] = false;
+
+        node["Meas"]["cfg_format"] = "records";
+        REQUIRE(node.as<ProgConfig>().meas.cfgFormat == ProgConfig::Meas::RECORDS);
+        node["Meas"]["format"] = "records";  // only for configurations
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["Meas"]["format"] = "text";
+        node["Meas"].remove("cfg_format");
+
+        node["MC"]["start"] = "file:data/run#1/0002.cfg.rec#-3";
+        ProgConfig const stored = node.as<ProgConfig>();
+        REQUIRE(stored.mc.start == ProgConfig::MC::STORED);
+        REQUIRE(stored.mc.startFile == fs::path{"data/run#1/0002.cfg.rec"});
+        REQUIRE(stored.mc.startRecord == -3);
+        for (auto const *invalid : {"file:0002.cfg.rec", "file:#2", "file:0002.cfg.rec#",
+                                    "file:0002.cfg.rec#1x"}) {
+            node["MC"]["start"] = invalid;
+            REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        }
+        node["MC"]["start"] = "hot";
+
+        node["MC"]["local_update"] = "heat-bath";
+        REQUIRE(node.as<ProgConfig>().mc.localUpdate == UpdateRule::HEAT_BATH);
+        node["MC"]["local_update"] = "demon";
+        node["MC"]["update"] = "checkerboard-sequential";
+        REQUIRE(node.as<ProgConfig>().mc.localUpdate == UpdateRule::DEMON);
+        node["MC"]["update"] = "checkerboard";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["MC"]["update"] = "random";
+        node["MC"]["local_update"] = "glauber";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["MC"].remove("local_update");
+
+        // packed storage only supports checkerboard Metropolis updates
+        node["MC"]["storage"] = "packed";
+        for (auto const *update : {"random", "sequential", "checkerboard-sequential", "wolff"}) {
+            node["MC"]["update"] = update;
+            REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        }
+        node["MC"]["update"] = "checkerboard";
+        REQUIRE(node.as<ProgConfig>().mc.storage == ProgConfig::MC::PACKED);
+        node["MC"]["local_update"] = "heat-bath";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["MC"].remove("local_update");
+        node["MC"]["update"] = "random";
+        node["MC"].remove("storage");
+
+        node["Meas"]["fourier_modes"] = true;
+        node["Meas"]["fourier_modes_interval"] = 5;
+        ProgConfig const modes = node.as<ProgConfig>();
+        REQUIRE(modes.meas.fourierModes);
+        REQUIRE(modes.meas.intervals.fourierModes == 5);
+        node["MC"]["device"] = "gpu";
+        node["MC"]["update"] = "checkerboard";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["MC"]["device"] = "cpu";
+        node["MC"]["update"] = "random";
+        node["Meas"].remove("fourier_modes");
+        node["Meas"].remove("fourier_modes_interval");
+
+        node["Meas"]["histogram"] = true;
+        REQUIRE(node.as<ProgConfig>().meas.intervals.histogram == 1);
+        node["Meas"].remove("histogram");
+
+        node["Lattice"]["shape"] = std::vector<size_t>{4, 8};
+        node["MC"]["ranks"] = std::vector<size_t>{2, 1};
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);  // needs checkerboard
+        node["MC"]["update"] = "checkerboard";
+        REQUIRE(node.as<ProgConfig>().mc.ranks == MultiIndex{2_i, 1_i});
+        node["MC"]["ranks"] = std::vector<size_t>{3, 1};
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["MC"]["ranks"] = std::vector<size_t>{2};
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+
+        node["MC"].remove("ranks");
+        node["MC"]["device"] = "gpu";
+        REQUIRE(node.as<ProgConfig>().mc.device == ProgConfig::MC::GPU);
+        node["MC"]["device"] = "tpu";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+
+        node["MC"]["device"] = "cpu";
+        node["MC"]["scan_chains"] = 0;
+        REQUIRE(node.as<ProgConfig>().mc.scanChains == 0);
+        node["MC"]["device"] = "gpu";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["MC"]["device"] = "cpu";
+        node["MC"]["checkpoint_interval"] = 10;
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["MC"].remove("scan_chains");
+        node["MC"].remove("checkpoint_interval");
+
+        REQUIRE(node.as<ProgConfig>().lattice.layout == Lattice::SiteLayout::ROW_MAJOR);
+        node["Lattice"]["layout"] = "blocked";
+        ProgConfig const blocked = node.as<ProgConfig>();
+        REQUIRE(blocked.lattice.layout == Lattice::SiteLayout::BLOCKED);
+        REQUIRE(not blocked.mc.simd);  // 'auto' falls back to site by site updates
+        node["MC"]["simd"] = "scalar";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["MC"].remove("simd");
+        node["MC"]["storage"] = "packed";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["MC"].remove("storage");
+        node["Lattice"]["neighbours"] = "stencil";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["Lattice"].remove("neighbours");
+        node["Lattice"]["shape"] = std::vector<size_t>{4, 6};
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+        node["Lattice"]["layout"] = "tiled";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
     }
 
     SECTION("File validInput1.yml") {
@@ -218,6 +371,7 @@ TEST_CASE("Loading ProgConfig from YAML", "[YAML]")
         ProgConfig const pc = node.as<ProgConfig>();
 
         REQUIRE(pc.rngSeed == 123);
+        REQUIRE(pc.rngGenerator == Rng::Generator::PHILOX4X32);
         REQUIRE(pc.params[0] == Parameters{1.0, 0.1});
         REQUIRE(pc.params[1] == Parameters{2.0, 0.1});
         REQUIRE(pc.params[2] == Parameters{3.0, 0.1});
@@ -225,16 +379,38 @@ TEST_CASE("Loading ProgConfig from YAML", "[YAML]")
         REQUIRE(pc.lattice.shape == std::vector<Index>{5_i, 3_i, 7_i});
         REQUIRE(pc.lattice.maxDist == 5);
         REQUIRE(pc.lattice.distfn == Lattice::DistanceFn::MANHATTAN);
+        REQUIRE(pc.lattice.neighbourMode == Lattice::NeighbourMode::STENCIL);
 
         REQUIRE(pc.mc.nthermInit == 100);
         REQUIRE(pc.mc.ntherm == std::vector<size_t>{100, 200, 300});
         REQUIRE(pc.mc.nprod == std::vector<size_t>{1000, 2000, 3000});
         REQUIRE(pc.mc.start == ProgConfig::MC::Start::COLD);
+        REQUIRE(pc.mc.update == ProgConfig::MC::Update::CHECKERBOARD);
+        REQUIRE(pc.mc.nthreads == 3);
+        REQUIRE(pc.mc.simd == SimdLevel::SCALAR);
+        REQUIRE(pc.mc.storage == ProgConfig::MC::Storage::PACKED);
+        REQUIRE(pc.mc.checkpointInterval == 500);
 
         REQUIRE(pc.meas.energy == false);
         REQUIRE(pc.meas.magnetisation == true);
         REQUIRE(pc.meas.correlator == false);
+        REQUIRE(pc.meas.intervals.energy == 0);
+        REQUIRE(pc.meas.intervals.magnetisation == 1);
+        REQUIRE(pc.meas.intervals.correlator == 0);
+        REQUIRE(pc.meas.correlatorMethod == Observables::Correlator::Method::FFT);
         REQUIRE(pc.meas.writeCfg == true);
+        REQUIRE(pc.meas.cfgInterval == 1);
+        REQUIRE(pc.meas.format == ProgConfig::Meas::BINARY);
+        REQUIRE(pc.meas.cfgFormat == ProgConfig::Meas::BINARY);
+        REQUIRE(pc.meas.async == true);
+        REQUIRE(pc.meas.bufferSize == 4);
+        REQUIRE(pc.meas.backpressure == Backpressure::SKIP);
+        REQUIRE(pc.meas.streaming == true);
+
+        node["MC"]["simd"] = "off";
+        REQUIRE(not node.as<ProgConfig>().mc.simd);
+        node["MC"]["simd"] = "sse";
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
     }
 
     SECTION("File invalidInput0.yml") {
@@ -246,4 +422,224 @@ TEST_CASE("Loading ProgConfig from YAML", "[YAML]")
         YAML::Node node = YAML::LoadFile(inputDir/"invalidInput1.yml");
         REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
     }
+
+    SECTION("File invalidInput2.yml") {
+        YAML::Node node = YAML::LoadFile(inputDir/"invalidInput2.yml");
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+
+        node["MC"]["nprod"] = 1000;
+        ProgConfig const pc = node.as<ProgConfig>();
+        REQUIRE(pc.mc.tempering == true);
+
+        node["MC"]["checkpoint_interval"] = 100;
+        REQUIRE_THROWS_AS(node.as<ProgConfig>(), std::invalid_argument);
+    }
+}
+
+namespace {
+    /// Chunk of a binary output file.
+    struct Chunk
+    {
+        std::string name;
+        std::string dtype;
+        std::uint64_t count;
+        std::vector<unsigned char> data;
+    };
+
+    /// Read metadata lines and all chunks of a binary output file.
+    std::tuple<std::string, std::string, std::vector<Chunk>> readBinary(fs::path const &fname)
+    {
+        std::ifstream ifs{fname, std::ios::binary};
+        std::string meta, format;
+        std::getline(ifs, meta);
+        std::getline(ifs, format);
+
+        auto const littleEndian = [](unsigned char const *bytes) {
+            std::uint64_t value = 0;
+            for (int i = 7; i >= 0; --i) {
+                value = (value << 8) | bytes[i];
+            }
+            return value;
+        };
+
+        std::vector<Chunk> chunks;
+        unsigned char header[32];
+        while (ifs.read(reinterpret_cast<char*>(header), 32)) {
+            Chunk chunk;
+            chunk.name = std::string(reinterpret_cast<char*>(header), strnlen(reinterpret_cast<char*>(header), 16));
+            chunk.dtype = std::string(reinterpret_cast<char*>(header+16), strnlen(reinterpret_cast<char*>(header+16), 4));
+            chunk.count = littleEndian(header+24);
+            std::size_t const nbytes = chunk.dtype == "bits" ? (chunk.count+7)/8 : 8*chunk.count;
+            chunk.data.resize(nbytes);
+            ifs.read(reinterpret_cast<char*>(chunk.data.data()), static_cast<std::streamsize>(nbytes));
+            chunks.push_back(std::move(chunk));
+        }
+        return {meta, format, chunks};
+    }
+
+    /// Check whether two configurations have the same size and spins.
+    bool sameSpins(Configuration const &a, Configuration const &b)
+    {
+        return size(a) == size(b) and std::equal(begin(a), end(a), begin(b));
+    }
+
+    /// Decode a chunk of doubles.
+    std::vector<double> decodeDoubles(Chunk const &chunk)
+    {
+        std::vector<double> result;
+        for (std::size_t i = 0; i < chunk.count; ++i) {
+            std::uint64_t bits = 0;
+            for (int b = 7; b >= 0; --b) {
+                bits = (bits << 8) | chunk.data[8*i + static_cast<std::size_t>(b)];
+            }
+            double x;
+            std::memcpy(&x, &bits, sizeof x);
+            result.push_back(x);
+        }
+        return result;
+    }
+}
+
+TEST_CASE("Binary output", "[fileio]")
+{
+    fs::path const outdir = fs::temp_directory_path() / "ising-test-binary-output";
+    prepareOutdir(outdir);
+
+    Lattice const lat{{128_i, 2_i}, 1.5};
+    Parameters const params{0.4, -0.1};
+
+    SECTION("Observables")
+    {
+        Observables obs(lat);
+        obs.energy = {1.0, -2.5, 3.25};
+        obs.magnetisation = {0.5, 0.25, -0.125};
+        for (auto &corr : obs.corr.correlator) {
+            corr = {1.0, 0.5, 0.1};
+        }
+        write(outdir, 3, obs, params, lat, ProgConfig::Meas::BINARY);
+
+        auto const [meta, format, chunks] = readBinary(outdir/"0003.dat.bin");
+        REQUIRE(meta == "# J=0.4 h=-0.1 shape=[128, 2]");
+        REQUIRE(format == "# format=binary version=1");
+        REQUIRE(std::size(chunks) == 2);
+        REQUIRE(chunks[0].name == "energy");
+        REQUIRE(chunks[0].dtype == "f8");
+        REQUIRE(decodeDoubles(chunks[0]) == obs.energy);
+        REQUIRE(chunks[1].name == "magnetisation");
+        REQUIRE(decodeDoubles(chunks[1]) == obs.magnetisation);
+
+        auto const [cmeta, cformat, cchunks] = readBinary(outdir/"0003.corr.bin");
+        REQUIRE(std::size(cchunks) == std::size(obs.corr.sqDistances) + 1);
+        REQUIRE(cchunks[0].name == "distances");
+        REQUIRE(cchunks[0].count == std::size(obs.corr.sqDistances));
+        for (std::size_t i = 1; i < std::size(cchunks); ++i) {
+            REQUIRE(cchunks[i].name == "correlator");
+            REQUIRE(decodeDoubles(cchunks[i]) == obs.corr.correlator[i-1]);
+        }
+        REQUIRE_FALSE(fs::exists(outdir/"0003.modes.bin"));
+
+        Observables withModes(lat, Observables::Correlator::Method::PAIR_SUM,
+                              Observables::Mode::HISTORY, MeasurementIntervals{1, 1, 1, 1});
+        withModes.fourierModes = {{0.25, 0.5}, {0.125, 0.0}};
+        write(outdir, 4, withModes, params, lat, ProgConfig::Meas::BINARY);
+        auto const [mmeta, mformat, mchunks] = readBinary(outdir/"0004.modes.bin");
+        REQUIRE(std::size(mchunks) == 3);
+        REQUIRE(mchunks[0].name == "momenta");
+        auto const momenta = decodeDoubles(mchunks[0]);
+        REQUIRE(momenta[0] == Approx(2.0 * std::acos(-1.0) / 128.0));
+        REQUIRE(momenta[1] == Approx(std::acos(-1.0)));
+        for (std::size_t d = 0; d < 2; ++d) {
+            REQUIRE(mchunks[d+1].name == "fourier_mode");
+            REQUIRE(decodeDoubles(mchunks[d+1]) == withModes.fourierModes[d]);
+        }
+    }
+
+    SECTION("Configurations are bit-packed")
+    {
+        Rng rng{size(lat), 7};
+        std::vector<Configuration> cfgs;
+        {
+            CfgWriter writer{outdir, 0, params, lat, ProgConfig::Meas::BINARY};
+            for (int i = 0; i < 3; ++i) {
+                cfgs.push_back(randomCfg(size(lat), rng));
+                writer.write(cfgs.back());
+            }
+            // packed configurations are written in row-major layout as well
+            cfgs.push_back(randomCfg(size(lat), rng));
+            writer.write(PackedConfiguration{cfgs.back(), lat});
+        }
+
+        auto const [meta, format, chunks] = readBinary(outdir/"0000.cfg.bin");
+        REQUIRE(meta == "# J=0.4 h=-0.1 shape=[128, 2]");
+        REQUIRE(std::size(chunks) == std::size(cfgs));
+        for (std::size_t c = 0; c < std::size(cfgs); ++c) {
+            REQUIRE(chunks[c].name == "cfg");
+            REQUIRE(chunks[c].dtype == "bits");
+            REQUIRE(chunks[c].count == size(lat).get());
+            REQUIRE(std::size(chunks[c].data) == size(lat).get()/8);
+            for (Index i = 0_i; i < size(lat); ++i) {
+                bool const up = (chunks[c].data[i.get()/8] >> (i.get()%8)) & 1u;
+                REQUIRE(up == (cfgs[c][i] == Spin{+1}));
+            }
+        }
+    }
+
+    SECTION("Configurations are stored in fixed size records")
+    {
+        Rng rng{size(lat), 11};
+        std::vector<Configuration> cfgs;
+        std::uintmax_t sizeAfterTwo;
+        {
+            CfgWriter writer{outdir, 1, params, lat, ProgConfig::Meas::RECORDS};
+            for (int i = 0; i < 3; ++i) {
+                cfgs.push_back(randomCfg(size(lat), rng));
+                writer.write(cfgs.back());
+                if (i == 1) {
+                    sizeAfterTwo = writer.flush();
+                }
+            }
+            cfgs.push_back(randomCfg(size(lat), rng));
+            writer.write(PackedConfiguration{cfgs.back(), lat});
+        }
+
+        fs::path const fname = outdir/"0001.cfg.rec";
+        {
+            std::ifstream ifs{fname, std::ios::binary};
+            std::string meta, format;
+            std::getline(ifs, meta);
+            std::getline(ifs, format);
+            REQUIRE(meta == "# J=0.4 h=-0.1 shape=[128, 2]");
+            REQUIRE(format.rfind("# format=records version=1 record_size=32 ", 0) == 0);
+            REQUIRE(ifs.tellg() % 64 == 0);
+            REQUIRE(fs::file_size(fname) == static_cast<std::uintmax_t>(ifs.tellg()) + 4*32);
+        }
+
+        for (long r = 0; r < 4; ++r) {
+            REQUIRE(sameSpins(readCfgRecord(fname, r, lat.shape()), cfgs[static_cast<std::size_t>(r)]));
+        }
+        REQUIRE(sameSpins(readCfgRecord(fname, -1, lat.shape()), cfgs.back()));
+        REQUIRE(sameSpins(readCfgRecord(fname, -4, lat.shape()), cfgs.front()));
+        REQUIRE_THROWS_AS(readCfgRecord(fname, 4, lat.shape()), std::runtime_error);
+        REQUIRE_THROWS_AS(readCfgRecord(fname, -5, lat.shape()), std::runtime_error);
+        REQUIRE_THROWS_AS(readCfgRecord(fname, 0, MultiIndex{2_i, 128_i}), std::runtime_error);
+
+        // resuming discards records written after the given size
+        {
+            CfgWriter writer{outdir, 1, sizeAfterTwo, ProgConfig::Meas::RECORDS};
+            writer.write(cfgs[3]);
+        }
+        REQUIRE(sameSpins(readCfgRecord(fname, -1, lat.shape()), cfgs[3]));
+        REQUIRE(sameSpins(readCfgRecord(fname, 1, lat.shape()), cfgs[1]));
+        REQUIRE_THROWS_AS(readCfgRecord(fname, 3, lat.shape()), std::runtime_error);
+
+        // records need not fill whole bytes
+        Lattice const odd{{3_i, 5_i}};
+        Configuration const cfg = randomCfg(size(odd), rng);
+        CfgWriter{outdir, 2, params, odd, ProgConfig::Meas::RECORDS}.write(cfg);
+        REQUIRE(sameSpins(readCfgRecord(outdir/"0002.cfg.rec", 0, odd.shape()), cfg));
+        REQUIRE_THROWS_AS(readCfgRecord(outdir/"0000.cfg.rec", 0, odd.shape()),
+                          std::runtime_error);
+    }
+
+    fs::remove_all(outdir);
 }
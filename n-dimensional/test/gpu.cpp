@@ -0,0 +1,182 @@
+#include "gpu.hpp"
+
+#include <numeric>
+
+#include "catch.hpp"
+
+// There is no device backend yet, so these test the host backend.
+
+namespace {
+    /// Checkerboard sweeps on the host with the same random numbers as GpuCheckerboard.
+    std::tuple<Configuration, double, double, double>
+    referenceChain(Configuration cfg, double energy, Parameters const &params,
+                   Lattice const &lat, SiteRng &rng, size_t const nsweep)
+    {
+        BoltzmannTable const boltzmann{params, lat.ndim()};
+        size_t naccept = 0;
+
+        for (size_t sweep = 0; sweep < nsweep; ++sweep) {
+            for (size_t colour = 0; colour < 2; ++colour) {
+                MultiIndex index(lat.ndim().get(), 0_i);
+                for (Index site = 0_i; site < size(lat); ++site) {
+                    Index const parity = std::accumulate(std::begin(index), std::end(index), 0_i);
+                    if (parity.get() % 2 == colour) {
+                        Spin const nsum = sumOfNeighbours(cfg, site, lat);
+                        size_t const idx = boltzmann.index(cfg[site], nsum);
+                        double const acceptance = boltzmann.acceptance(idx);
+                        if (acceptance >= 1.0 or acceptance > rng.uniform(site.get())) {
+                            energy += boltzmann.deltaE(idx);
+                            cfg[site] = cfg[site]*Spin{-1};
+                            ++naccept;
+                        }
+                    }
+                    increment(index, lat.shape());
+                }
+            }
+            ++rng.sweep;
+        }
+
+        double const magn = magnetisation(cfg);
+        return std::make_tuple(std::move(cfg), energy, magn,
+                               static_cast<double>(naccept) / static_cast<double>(nsweep)
+                               / static_cast<double>(size(lat).get()));
+    }
+}
+
+TEST_CASE("GPU backend falls back to the host", "[GPU]")
+{
+    Lattice const lat{{4_i, 6_i}, 0.0};
+    GpuCheckerboard const gpu{lat, 1};
+    REQUIRE_FALSE(gpuAvailable());
+    REQUIRE_FALSE(gpu.onDevice());
+    REQUIRE(gpu.ndim() == 2_i);
+    REQUIRE(&gpu.lattice() == &lat);
+    REQUIRE(gpu.nsweep() == 0);
+
+    REQUIRE_THROWS_AS(GpuCheckerboard(Lattice{{3_i, 4_i}, 0.0}, 1), std::invalid_argument);
+    REQUIRE_THROWS_AS(GpuCheckerboard(Lattice(MultiIndex(9, 2_i), 0.0), 1),
+                      std::invalid_argument);
+}
+
+TEST_CASE("GPU checkerboard chain matches the host", "[GPU]")
+{
+    std::vector<std::vector<Index>> const shapes{
+        {16_i},
+        {8_i, 6_i},
+        {4_i, 4_i, 6_i},
+        {2_i, 4_i, 2_i, 8_i}
+    };
+    std::vector<Parameters> const params{
+        {0.3, 0.0},
+        {0.6, -0.2},
+        {-0.4, 0.5}
+    };
+    constexpr size_t nsweep = 10;
+
+    for (auto const &shape : shapes) {
+        Lattice const lat{shape, 2.5};
+        Rng rng(size(lat), 61);
+        GpuCheckerboard gpu{lat, 17};
+        SiteRng siteRng{17, 0};
+
+        for (auto const &p : params) {
+            Configuration const start = randomCfg(size(lat), rng);
+            double const startEnergy = hamiltonian(start, p, lat);
+            gpu.upload(start);
+            REQUIRE(gpu.couplingSum() == couplingSum(start, lat));
+            REQUIRE(gpu.hamiltonian(p) == Approx(startEnergy));
+            REQUIRE(static_cast<double>(gpu.spinSum())
+                    == Approx(magnetisation(start)*static_cast<double>(size(lat).get())));
+
+            auto const [reference, referenceEnergy, referenceMagn, referenceRate]
+                = referenceChain(start, startEnergy, p, lat, siteRng, nsweep);
+
+            Observables obs(lat);
+            std::int64_t coupling = couplingSum(start, lat);
+            auto const [cfg, energy, magn, accRate] = evolveGpu(start, coupling, p, gpu,
+                                                                nsweep, &obs);
+            REQUIRE(gpu.nsweep() == siteRng.sweep);
+            REQUIRE(std::equal(begin(cfg), end(cfg), begin(reference)));
+            REQUIRE(coupling == couplingSum(cfg, lat));
+            REQUIRE(energy == Approx(referenceEnergy));
+            REQUIRE(magn == Approx(referenceMagn));
+            REQUIRE(accRate == referenceRate);
+
+            // measurements on the device agree with those on the host
+            Observables hostObs(lat);
+            measure(hostObs, lat, cfg, energy);
+            REQUIRE(obs.energy.back() == energy);
+            REQUIRE(obs.magnetisation.back() == Approx(hostObs.magnetisation.back()));
+            for (size_t sqdi = 0; sqdi < std::size(obs.corr.sqDistances); ++sqdi) {
+                REQUIRE(obs.corr.correlator[sqdi].back()
+                        == Approx(hostObs.corr.correlator[sqdi].back()));
+            }
+        }
+    }
+}
+
+TEST_CASE("GPU extra measurements see every configuration", "[GPU]")
+{
+    // without interactions every flip is accepted, so a sweep inverts all spins
+    Lattice const lat{{4_i, 8_i}, 0.0};
+    Rng rng(size(lat), 2);
+    Configuration const start = randomCfg(size(lat), rng);
+    GpuCheckerboard gpu{lat, 3};
+
+    std::vector<Configuration> seen;
+    std::int64_t coupling = couplingSum(start, lat);
+    auto const [cfg, energy, magn, accRate] = evolveGpu(
+        start, coupling, Parameters{0.0, 0.0}, gpu, 3, nullptr,
+        {[&seen](Configuration const &c, double) { seen.push_back(c); }});
+    REQUIRE(accRate == 1.0);
+    REQUIRE(magn == -magnetisation(start));
+    REQUIRE(coupling == couplingSum(start, lat));
+    REQUIRE(std::size(seen) == 3);
+    for (Index i = 0_i; i < size(lat); ++i) {
+        REQUIRE(seen[0][i] == start[i]*Spin{-1});
+        REQUIRE(seen[1][i] == start[i]);
+        REQUIRE(cfg[i] == start[i]*Spin{-1});
+    }
+}
+
+TEST_CASE("GPU configurations are only copied back when measured", "[GPU]")
+{
+    struct Snapshots
+    {
+        std::size_t interval;
+        std::vector<Configuration> cfgs{};
+
+        void operator()(ChainState<Configuration> const &state)
+        {
+            REQUIRE(state.magnetisation == magnetisation(state.cfg));
+            cfgs.push_back(state.cfg);
+        }
+    };
+
+    // without interactions every flip is accepted, so a sweep inverts all spins
+    Lattice const lat{{4_i, 8_i}, 0.0};
+    Rng rng(size(lat), 5);
+    Configuration const start = randomCfg(size(lat), rng);
+    GpuCheckerboard gpu{lat, 3};
+
+    // measured in sweeps 0, 3, 6 and never
+    MeasurementSet meas{Snapshots{3}, Snapshots{0}};
+    std::int64_t coupling = couplingSum(start, lat);
+    auto const [cfg, energy, magn, accRate] = evolveGpu(start, coupling, Parameters{0.0, 0.0},
+                                                        gpu, 7, nullptr, meas);
+    REQUIRE(accRate == 1.0);
+    REQUIRE(std::empty(meas.get<1>().cfgs));
+    auto const &seen = meas.get<0>().cfgs;
+    REQUIRE(std::size(seen) == 3);
+    for (Index i = 0_i; i < size(lat); ++i) {
+        REQUIRE(seen[0][i] == start[i]*Spin{-1});
+        REQUIRE(seen[1][i] == start[i]);
+        REQUIRE(seen[2][i] == start[i]*Spin{-1});
+        REQUIRE(cfg[i] == start[i]*Spin{-1});
+    }
+
+    // the set keeps counting across calls
+    std::tie(std::ignore, std::ignore, std::ignore, std::ignore)
+        = evolveGpu(cfg, coupling, Parameters{0.0, 0.0}, gpu, 3, nullptr, meas);
+    REQUIRE(std::size(meas.get<0>().cfgs) == 4);
+}
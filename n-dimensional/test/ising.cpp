@@ -125,6 +125,31 @@ TEST_CASE("Hamiltonian", "[Ising]")
     }
 }
 
+TEST_CASE("Hamiltonian on fixed lattices", "[Ising]")
+{
+    Rng rng(1_i, 7153);
+    constexpr size_t nsamples = 10;
+
+    auto const check = [&rng](auto const &fixed) {
+        Lattice const &lat = fixed;
+        rng.setLatsize(size(lat));
+
+        for (size_t sample = 0; sample < nsamples; ++sample) {
+            Parameters const params{rng.genReal()*2.0-1.0, rng.genReal()*3.2-1.6};
+            Configuration const cfg = randomCfg(size(lat), rng);
+            REQUIRE(hamiltonian(cfg, params, fixed) == Approx(hamiltonian(cfg, params, lat)));
+            for (Index site = 0_i; site < size(cfg); ++site) {
+                REQUIRE(sumOfNeighbours(cfg, site, fixed) == sumOfNeighbours(cfg, site, lat));
+            }
+        }
+    };
+
+    check(FixedLattice<1>{{9_i}, 0.0});
+    check(FixedLattice<2>{{6_i, 5_i}, 0.0});
+    check(FixedLattice<3>{{4_i, 3_i, 6_i}, 0.0});
+    check(FixedLattice<4>{{4_i, 2_i, 3_i, 5_i}, 0.0});
+}
+
 TEST_CASE("Delta E", "[Ising]")
 {
     std::vector<std::vector<Index>> const shapes{
@@ -158,3 +183,54 @@ TEST_CASE("Delta E", "[Ising]")
         }
     }
 }
+
+TEST_CASE("Boltzmann table", "[Ising]")
+{
+    std::vector<std::vector<Index>> const shapes{
+        {3_i, 3_i},
+        {5_i, 5_i, 5_i},
+        {8_i, 4_i, 8_i, 5_i}
+    };
+    Rng rng(1_i, 4921);
+    constexpr size_t nsamples = 10;
+
+    SECTION("Table entries match deltaE")
+    {
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            rng.setLatsize(size(lat));
+
+            for (size_t sample = 0; sample < nsamples; ++sample) {
+                Parameters const params{rng.genReal()*2.0-1.0, rng.genReal()*3.2-1.6};
+                INFO("Sample " << sample << " with JT=" << params.JT << " hT=" << params.hT);
+                BoltzmannTable const table{params, lat.ndim()};
+                Configuration const cfg = randomCfg(size(lat), rng);
+
+                for (Index site = 0_i; site < size(cfg); ++site) {
+                    double const delta = deltaE(cfg, site, params, lat);
+                    size_t const idx = table.index(cfg[site], sumOfNeighbours(cfg, site, lat));
+                    REQUIRE(table.deltaE(idx) == Approx(delta));
+                    REQUIRE(table.acceptance(idx) == Approx(std::min(1.0, std::exp(-delta))));
+                }
+            }
+        }
+    }
+
+    SECTION("Table entries match changes in the coupling sum")
+    {
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            rng.setLatsize(size(lat));
+            BoltzmannTable const table{Parameters{0.5, 0.1}, lat.ndim()};
+            Configuration cfg = randomCfg(size(lat), rng);
+            std::int64_t const coupling = couplingSum(cfg, lat);
+
+            for (Index site = 0_i; site < size(cfg); site = site + 7_i) {
+                size_t const idx = table.index(cfg[site], sumOfNeighbours(cfg, site, lat));
+                cfg.flip(site);
+                REQUIRE(table.deltaCoupling(idx) == couplingSum(cfg, lat) - coupling);
+                cfg.flip(site);
+            }
+        }
+    }
+}
@@ -1,6 +1,9 @@
 #include "lattice.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
 
 #include "catch.hpp"
 
@@ -109,6 +112,96 @@ TEST_CASE("Nearest Neighbour Indices", "[Lattice]")
     }
 }
 
+TEST_CASE("Stencil neighbours", "[Lattice]")
+{
+    using Mode = Lattice::NeighbourMode;
+
+    std::vector<IVec> const shapes{
+        {8_i},
+        {5_i},
+        {32_i, 16_i},
+        {3_i, 7_i},
+        {16_i, 2_i, 8_i, 4_i},
+        {4_i, 3_i, 2_i, 5_i, 1_i}
+    };
+
+    SECTION("Stencil lattices do not store neighbours")
+    {
+        Lattice const lat{{4_i, 4_i}, 0.0, Lattice::DistanceFn::EUCLIDEAN, Mode::STENCIL};
+        REQUIRE(lat.neighbourMode() == Mode::STENCIL);
+        REQUIRE(lat.neighbourList().empty());
+    }
+
+    SECTION("Stencil neighbours are the same as stored ones")
+    {
+        for (auto const &shape : shapes) {
+            Lattice const stored{shape, 0.0};
+            Lattice const stencil{shape, 0.0, Lattice::DistanceFn::EUCLIDEAN, Mode::STENCIL};
+
+            for (Index i = 0_i; i < stored.size(); ++i) {
+                REQUIRE(sortedNeighbours(stencil, i) == sortedNeighbours(stored, i));
+                for (Index n = 0_i; n < 2_i*stored.ndim(); ++n) {
+                    REQUIRE(stencil.neighbour(i, n) == stored.neighbour(i, n));
+                }
+            }
+        }
+    }
+
+    SECTION("Fixed lattices require stored neighbours")
+    {
+        REQUIRE_THROWS_AS(FixedLattice<3>(IVec{4_i, 3_i, 6_i}, 0.0,
+                                          Lattice::DistanceFn::EUCLIDEAN, Mode::STENCIL),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("Lattice with fixed number of dimensions", "[Lattice]")
+{
+    SECTION("Shape must match the number of dimensions")
+    {
+        REQUIRE_THROWS_AS(FixedLattice<2>(IVec{4_i}), std::invalid_argument);
+        REQUIRE_THROWS_AS(FixedLattice<2>(IVec{4_i, 2_i, 3_i}), std::invalid_argument);
+    }
+
+    SECTION("Neighbours are the same as for dynamic lattices")
+    {
+        auto const check = [](auto const &fixed) {
+            Lattice const lat{fixed.shape(), 0.0};
+            REQUIRE(fixed.ndim() == lat.ndim());
+
+            for (Index i = 0_i; i < lat.size(); ++i) {
+                auto const [begin, end] = fixed.neighbours(i);
+                REQUIRE(end-begin == 2*lat.ndim().get());
+
+                for (Index n = 0_i; n < 2_i*lat.ndim(); ++n) {
+                    REQUIRE(fixed.neighbour(i, n) == lat.neighbour(i, n));
+                    REQUIRE(*(begin+n.get()) == lat.neighbour(i, n));
+                }
+            }
+        };
+
+        check(FixedLattice<1>{{7_i}, 0.0});
+        check(FixedLattice<2>{{5_i, 8_i}, 0.0});
+        check(FixedLattice<3>{{4_i, 3_i, 6_i}, 0.0});
+        check(FixedLattice<4>{{4_i, 2_i, 3_i, 5_i}, 0.0});
+    }
+
+    SECTION("Shape and strides are stored in arrays")
+    {
+        FixedLattice<3> const lat{{4_i, 3_i, 6_i}, 0.0};
+        REQUIRE(std::equal(begin(lat.extents()), end(lat.extents()),
+                           begin(lat.shape()), end(lat.shape())));
+        REQUIRE(lat.strides() == std::array{18_i, 6_i, 1_i});
+        for (Index d = 0_i; d < lat.ndim(); ++d) {
+            REQUIRE(lat.extend(d) == lat.shape()[d.get()]);
+        }
+
+        FixedLattice<1> const line{{7_i}, 0.0};
+        REQUIRE(line.extents() == std::array{7_i});
+        REQUIRE(line.strides() == std::array{1_i});
+    }
+}
+
 TEST_CASE("Lattice layout", "[Lattice]")
 {
     SECTION("1D lattice layout is a flat vector")
@@ -176,3 +269,185 @@ TEST_CASE("Lattice layout", "[Lattice]")
         }
     }
 }
+
+TEST_CASE("Blocked site layout", "[Lattice]")
+{
+    auto const blocked = [](MultiIndex const &shape) {
+        return Lattice{shape, 0.0, Lattice::DistanceFn::EUCLIDEAN,
+                       Lattice::NeighbourMode::STORED, Lattice::SiteLayout::BLOCKED};
+    };
+
+    SECTION("Manual 2D case")
+    {
+        Lattice const lat = blocked({4_i, 8_i});
+        REQUIRE(lat.layout() == Lattice::SiteLayout::BLOCKED);
+        // first row of the first block, then its second row
+        REQUIRE(lat.toRowMajor(3_i) == 3_i);
+        REQUIRE(lat.toRowMajor(4_i) == 8_i);
+        // first site of the second block
+        REQUIRE(lat.toRowMajor(16_i) == 4_i);
+        REQUIRE(lat.fromRowMajor(31_i) == 31_i);
+        REQUIRE(lat.neighbour(0_i, 0_i) == 4_i);
+        REQUIRE(lat.neighbour(0_i, 1_i) == 12_i);
+        REQUIRE(lat.neighbour(3_i, 2_i) == 16_i);
+    }
+
+    SECTION("Neighbours are the same as in row-major layout")
+    {
+        std::vector<IVec> const shapes{
+            {8_i},
+            {4_i, 12_i},
+            {8_i, 4_i, 4_i, 8_i}
+        };
+
+        for (auto const &shape : shapes) {
+            Lattice const lat = blocked(shape);
+            Lattice const rowMajor{shape, 0.0};
+            for (Index site = 0_i; site < size(lat); ++site) {
+                REQUIRE(lat.fromRowMajor(lat.toRowMajor(site)) == site);
+                for (Index n = 0_i; n < 2_i*lat.ndim(); ++n) {
+                    REQUIRE(lat.toRowMajor(lat.neighbour(site, n))
+                            == rowMajor.neighbour(lat.toRowMajor(site), n));
+                }
+            }
+        }
+
+        Lattice const lat{shapes[1], 0.0};
+        REQUIRE(lat.layout() == Lattice::SiteLayout::ROW_MAJOR);
+        REQUIRE(lat.toRowMajor(17_i) == 17_i);
+        REQUIRE(lat.fromRowMajor(17_i) == 17_i);
+    }
+
+    SECTION("Checkerboard sublattices are sorted")
+    {
+        Lattice const lat = blocked({4_i, 8_i, 4_i});
+        Lattice const rowMajor{lat.shape(), 0.0};
+        auto const sublattices = checkerboard(lat);
+        auto const rowMajorSublattices = checkerboard(rowMajor);
+        for (int c = 0; c < 2; ++c) {
+            REQUIRE(std::is_sorted(begin(sublattices[c]), end(sublattices[c])));
+            IVec translated;
+            for (Index const site : sublattices[c]) {
+                translated.push_back(lat.toRowMajor(site));
+            }
+            std::sort(begin(translated), end(translated));
+            REQUIRE(translated == rowMajorSublattices[c]);
+        }
+    }
+
+    SECTION("Unsupported lattices are rejected")
+    {
+        REQUIRE_THROWS_AS(blocked({4_i, 6_i}), std::invalid_argument);
+        REQUIRE_THROWS_AS(Lattice({4_i, 8_i}, 0.0, Lattice::DistanceFn::EUCLIDEAN,
+                                  Lattice::NeighbourMode::STENCIL, Lattice::SiteLayout::BLOCKED),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("Checkerboard decomposition", "[Lattice]")
+{
+    using Catch::Matchers::VectorContains;
+
+    SECTION("Manual 2D case")
+    {
+        Lattice const lat{{2_i, 4_i}, 0.0};
+        auto const [even, odd] = checkerboard(lat);
+        REQUIRE(even == IVec{0_i, 2_i, 5_i, 7_i});
+        REQUIRE(odd == IVec{1_i, 3_i, 4_i, 6_i});
+    }
+
+    SECTION("Neighbours are always on the other sublattice")
+    {
+        std::vector<IVec> const shapes{
+            {8_i},
+            {32_i, 16_i},
+            {4_i, 6_i, 2_i, 8_i}
+        };
+
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            auto const sublattices = checkerboard(lat);
+            REQUIRE(std::size(sublattices[0]) == size(lat).get()/2);
+            REQUIRE(std::size(sublattices[1]) == size(lat).get()/2);
+
+            std::vector<int> colour(size(lat).get(), -1);
+            for (int c = 0; c < 2; ++c) {
+                for (Index const site : sublattices[c]) {
+                    colour[site.get()] = c;
+                }
+            }
+
+            for (Index i = 0_i; i < size(lat); ++i) {
+                REQUIRE(colour[i.get()] != -1);
+                for (Index n = 0_i; n < 2_i*lat.ndim(); ++n) {
+                    REQUIRE(colour[lat.neighbour(i, n).get()] != colour[i.get()]);
+                }
+            }
+        }
+    }
+
+    SECTION("Odd extents are rejected")
+    {
+        REQUIRE_THROWS_AS(checkerboard(Lattice{{4_i, 3_i}, 0.0}), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Distance map", "[Lattice]")
+{
+    // minimum image distance of a displacement in one dimension
+    auto const mindist = [](Index const offset, Index const extent) {
+        return std::min(static_cast<int>(offset.get()),
+                        static_cast<int>((extent - offset).get()));
+    };
+
+    SECTION("Displacements have the distance they are stored with")
+    {
+        std::vector<IVec> const shapes{
+            {8_i},
+            {5_i, 6_i},
+            {4_i, 3_i, 6_i}
+        };
+
+        for (auto const &shape : shapes) {
+            for (double const maxDist : {1.5, 2.1, 3.0}) {
+                for (auto const distfn : {Lattice::DistanceFn::EUCLIDEAN,
+                                          Lattice::DistanceFn::MANHATTAN}) {
+                    Lattice const lat{shape, maxDist, distfn};
+                    for (int const sqd : lat.sqDistances()) {
+                        REQUIRE(std::sqrt(static_cast<double>(sqd)) < maxDist);
+                        for (auto const &displacement : lat.displacementsWithSqDistance(sqd)) {
+                            REQUIRE(std::size(displacement) == std::size(shape));
+                            int sum = 0, sqsum = 0;
+                            for (size_t d = 0; d < std::size(shape); ++d) {
+                                REQUIRE(displacement[d] < shape[d]);
+                                int const dist = mindist(displacement[d], shape[d]);
+                                sum += dist;
+                                sqsum += dist*dist;
+                            }
+                            REQUIRE(sqd == (distfn == Lattice::DistanceFn::EUCLIDEAN ? sqsum : sum*sum));
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    SECTION("Without max distance all displacements are stored")
+    {
+        Lattice const lat{{4_i, 3_i, 6_i}, std::nullopt};
+        size_t ndisp = 0;
+        for (int const sqd : lat.sqDistances()) {
+            ndisp += std::size(lat.displacementsWithSqDistance(sqd));
+        }
+        REQUIRE(ndisp == size(lat).get());
+        REQUIRE(lat.displacementsWithSqDistance(0) == std::vector<IVec>{IVec(3, 0_i)});
+    }
+
+    SECTION("Displaced indices wrap around")
+    {
+        IVec const shape{4_i, 3_i};
+        REQUIRE(displacedIndex({0_i, 0_i}, {1_i, 2_i}, shape) == totalIndex({1_i, 2_i}, shape));
+        REQUIRE(displacedIndex({3_i, 1_i}, {1_i, 2_i}, shape) == totalIndex({0_i, 0_i}, shape));
+        REQUIRE(displacedIndex({2_i, 2_i}, {3_i, 0_i}, shape) == totalIndex({1_i, 2_i}, shape));
+    }
+}
@@ -0,0 +1,256 @@
+#include "measurements.hpp"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "checkerboardupdate.hpp"
+#include "clusterupdate.hpp"
+#include "localupdate.hpp"
+
+#include "catch.hpp"
+
+namespace {
+    /// Record energy and magnetisation of every measured sweep.
+    struct History
+    {
+        std::size_t interval = 1;
+        std::vector<double> energies{};
+        std::vector<double> magnetisations{};
+
+        template <typename Cfg>
+        void operator()(ChainState<Cfg> const &state)
+        {
+            REQUIRE(state.magnetisation == Approx(magnetisation(state.cfg)));
+            energies.push_back(state.energy);
+            magnetisations.push_back(state.magnetisation);
+        }
+    };
+}
+
+TEST_CASE("Measurement sets", "[Measurements]")
+{
+    Lattice const lat{{6_i, 4_i}, 0.0};
+    Parameters const params{0.4, 0.1};
+    constexpr size_t nsweep = 10;
+
+    SECTION("Measurements are performed at their own interval")
+    {
+        Rng rng(size(lat), 51);
+        Configuration const cfg = randomCfg(size(lat), rng);
+
+        MeasurementSet meas{History{1}, History{3}, History{0}, MagnetisationMoments{2}};
+        REQUIRE_FALSE(meas.empty());
+        for (int i = 0; i < 2; ++i) {
+            // the set counts sweeps across calls
+            std::int64_t coupling = couplingSum(cfg, lat);
+            evolveLocal(cfg, coupling, params, lat, rng, nsweep, nullptr, meas);
+        }
+        REQUIRE(std::size(meas.get<0>().energies) == 2*nsweep);
+        REQUIRE(std::size(meas.get<1>().energies) == 7);
+        REQUIRE(std::empty(meas.get<2>().energies));
+        REQUIRE(meas.get<3>().count == nsweep);
+        REQUIRE(MeasurementSet{History{0}}.empty());
+    }
+
+    SECTION("Sweeps can be counted from a later start")
+    {
+        Rng rng(size(lat), 51);
+        Configuration const cfg = randomCfg(size(lat), rng);
+
+        // measures in sweeps 6 and 9 of the chain
+        MeasurementSet meas{History{3}};
+        meas.setSweep(5);
+        REQUIRE_FALSE(meas.due());
+        std::int64_t coupling = couplingSum(cfg, lat);
+        evolveLocal(cfg, coupling, params, lat, rng, 5, nullptr, meas);
+        REQUIRE(std::size(meas.get<0>().energies) == 2);
+    }
+
+    SECTION("Static and run time measurements see the same chain")
+    {
+        for (auto const rule : {UpdateRule::METROPOLIS, UpdateRule::HEAT_BATH,
+                                UpdateRule::DEMON}) {
+            for (auto const order : {SiteOrder::RANDOM, SiteOrder::TYPEWRITER,
+                                     SiteOrder::CHECKERBOARD}) {
+                Rng rngA(size(lat), 9), rngB(size(lat), 9);
+                Configuration const start = randomCfg(size(lat), rngA);
+                randomCfg(size(lat), rngB);
+                std::int64_t couplingA = couplingSum(start, lat), couplingB = couplingA;
+
+                std::vector<double> energiesA;
+                auto const [cfgA, energyA, magnA, accA] = evolveLocal(
+                    start, couplingA, params, lat, rngA, nsweep, nullptr,
+                    {[&energiesA](Configuration const &, double const e) {
+                        energiesA.push_back(e);
+                    }},
+                    rule, order);
+
+                MeasurementSet meas{History{}};
+                auto const [cfgB, energyB, magnB, accB] = evolveLocal(
+                    start, couplingB, params, lat, rngB, nsweep, nullptr, meas, rule, order);
+
+                REQUIRE(std::equal(begin(cfgA), end(cfgA), begin(cfgB)));
+                REQUIRE(energyA == energyB);
+                REQUIRE(accA == accB);
+                REQUIRE(meas.get<0>().energies == energiesA);
+                REQUIRE(meas.get<0>().magnetisations.back() == magnB);
+            }
+        }
+    }
+
+    SECTION("Sets can be passed as run time measurements")
+    {
+        FixedLattice<2> const fixedLat{{6_i, 4_i}, 0.0};
+        Rng rng(size(fixedLat), 7);
+        Configuration const cfg = randomCfg(size(fixedLat), rng);
+        std::int64_t coupling = couplingSum(cfg, fixedLat);
+
+        MeasurementSet meas{History{2}, History{0}};
+        MeasurementSet every{History{}};
+        auto const [evolved, energy, magn, clusterSize] = evolveWolff(
+            cfg, coupling, params, fixedLat, rng, nsweep, nullptr,
+            {asMeasurement<Configuration>(meas, fixedLat),
+             asMeasurement<Configuration>(every, fixedLat)});
+        REQUIRE(std::size(meas.get<0>().energies) == nsweep/2);
+        REQUIRE(std::empty(meas.get<1>().energies));
+        REQUIRE(std::size(every.get<0>().energies) == nsweep);
+        REQUIRE(every.get<0>().energies.back() == Approx(energy));
+        REQUIRE(every.get<0>().magnetisations.back() == Approx(magn));
+    }
+}
+
+TEST_CASE("Measurement sets in checkerboard and cluster updates", "[Measurements]")
+{
+    // packed storage needs the first extent to be a multiple of 128
+    Lattice const lat{{128_i, 2_i}, 0.0};
+    Parameters const params{0.4, 0.1};
+    constexpr size_t nsweep = 10;
+    Rng rng(size(lat), 17);
+    Configuration const start = randomCfg(size(lat), rng);
+    std::int64_t const startCoupling = couplingSum(start, lat);
+
+    // runs a scheme once with run time measurements and once with a set
+    auto const check = [&](auto const &evolveWith, auto const &startCfg) {
+        using Cfg = std::decay_t<decltype(startCfg)>;
+        std::vector<double> energies;
+        std::vector<MeasurementFor<Cfg>> const extraMeas{
+            [&energies](Cfg const &, double const e) { energies.push_back(e); }};
+        std::int64_t couplingA = startCoupling;
+        auto const [cfgA, energyA, magnA, rateA] = evolveWith(startCfg, couplingA, extraMeas);
+
+        MeasurementSet meas{History{}, History{3}, History{0}};
+        std::int64_t couplingB = startCoupling;
+        auto const [cfgB, energyB, magnB, rateB] = evolveWith(startCfg, couplingB, meas);
+
+        REQUIRE(std::equal(begin(cfgA), end(cfgA), begin(cfgB)));
+        REQUIRE(energyA == energyB);
+        REQUIRE(couplingA == couplingB);
+        REQUIRE(rateA == rateB);
+        REQUIRE(meas.get<0>().energies == energies);
+        REQUIRE(meas.get<0>().magnetisations.back() == magnB);
+        REQUIRE(std::size(meas.get<1>().energies) == 4);
+        REQUIRE(std::empty(meas.get<2>().energies));
+    };
+
+    SECTION("Checkerboard")
+    {
+        for (auto const simd : {std::optional<SimdLevel>{}, std::optional{SimdLevel::SCALAR}}) {
+            check([&](Configuration cfg, std::int64_t &coupling, auto &meas) {
+                      std::vector<Rng> rngs{Rng{size(lat), 5, 1}, Rng{size(lat), 5, 2}};
+                      return evolveCheckerboard(std::move(cfg), coupling, params, lat, rngs,
+                                                nsweep, nullptr, meas, simd);
+                  }, start);
+        }
+    }
+
+    SECTION("Packed checkerboard")
+    {
+        check([&](PackedConfiguration cfg, std::int64_t &coupling, auto &meas) {
+                  std::vector<Rng> rngs{Rng{size(lat), 5, 1}, Rng{size(lat), 5, 2}};
+                  return evolveCheckerboard(std::move(cfg), coupling, params, lat, rngs,
+                                            nsweep, nullptr, meas);
+              }, PackedConfiguration{start, lat});
+    }
+
+    SECTION("Wolff")
+    {
+        check([&](Configuration cfg, std::int64_t &coupling, auto &meas) {
+                  Rng r(size(lat), 5);
+                  return evolveWolff(std::move(cfg), coupling, params, lat, r, nsweep, nullptr,
+                                     meas);
+              }, start);
+    }
+
+    SECTION("Swendsen-Wang")
+    {
+        check([&](Configuration cfg, std::int64_t &coupling, auto &meas) {
+                  Rng r(size(lat), 5);
+                  return evolveSwendsenWang(std::move(cfg), coupling, params, lat, r, nsweep,
+                                            nullptr, meas);
+              }, start);
+    }
+
+    SECTION("Checkerboard measurements are only performed when due")
+    {
+        // a throwing measurement aborts the chain in the first sweep in which it is due
+        struct Throwing
+        {
+            std::size_t interval = 4;
+
+            void operator()(ChainState<Configuration> const &) const
+            {
+                throw std::runtime_error("measurement failed");
+            }
+        };
+        MeasurementSet meas{Throwing{}};
+        meas.setSweep(1);
+        std::vector<Rng> rngs{Rng{size(lat), 5, 1}, Rng{size(lat), 5, 2}};
+        std::int64_t coupling = startCoupling;
+        Configuration cfg = start;
+        REQUIRE_NOTHROW(std::tie(cfg, std::ignore, std::ignore, std::ignore) = evolveCheckerboard(
+                            cfg, coupling, params, lat, rngs, 3, nullptr, meas));
+        REQUIRE_THROWS_AS(evolveCheckerboard(cfg, coupling, params, lat, rngs, 1, nullptr, meas),
+                          std::runtime_error);
+    }
+}
+
+TEST_CASE("Magnetisation moments", "[Measurements]")
+{
+    Lattice const lat{{8_i, 8_i}, 0.0};
+    Rng rng(size(lat), 3);
+
+    SECTION("Ordered configurations")
+    {
+        // no flips are accepted this deep in the ordered phase
+        Parameters const params{10.0, 0.0};
+        Configuration const cfg{size(lat), Spin{-1}};
+        std::int64_t coupling = couplingSum(cfg, lat);
+        MeasurementSet meas{MagnetisationMoments{}};
+        evolveLocal(cfg, coupling, params, lat, rng, 20, nullptr, meas);
+
+        auto const &moments = meas.get<0>();
+        REQUIRE(moments.count == 20);
+        REQUIRE(moments.susceptibility() == Approx(0.0).margin(1e-12));
+        REQUIRE(moments.binderCumulant() == Approx(2.0/3.0));
+    }
+
+    SECTION("Uncorrelated spins")
+    {
+        // at J = 0, m^2 averages to 1/V and the Binder cumulant vanishes for large V
+        Parameters const params{0.0, 0.0};
+        Configuration const cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+        MeasurementSet meas{MagnetisationMoments{}};
+        evolveLocal(cfg, coupling, params, lat, rng, 20000, nullptr, meas,
+                    UpdateRule::HEAT_BATH);
+
+        auto const &moments = meas.get<0>();
+        double const volume = static_cast<double>(size(lat).get());
+        REQUIRE(moments.sum2 / static_cast<double>(moments.count)
+                == Approx(1.0 / volume).epsilon(0.05));
+        REQUIRE(moments.binderCumulant() == Approx(0.0).margin(0.05));
+    }
+}
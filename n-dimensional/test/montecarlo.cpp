@@ -0,0 +1,808 @@
+#include "montecarlo.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <map>
+
+#include "localupdate.hpp"
+
+#include "catch.hpp"
+
+TEST_CASE("Energy and magnetisation are tracked by evolve", "[MonteCarlo]")
+{
+    std::vector<std::vector<Index>> const shapes{
+        {16_i},
+        {8_i, 6_i},
+        {4_i, 4_i, 6_i}
+    };
+    std::vector<Parameters> const params{
+        {0.3, 0.0},
+        {0.6, -0.2},
+        {-0.4, 0.5}
+    };
+    constexpr size_t nsweep = 20;
+
+    SECTION("Random site updates")
+    {
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            Rng rng(size(lat), 812);
+
+            for (auto const &p : params) {
+                Configuration cfg = randomCfg(size(lat), rng);
+                std::int64_t coupling = couplingSum(cfg, lat);
+                double energy;
+                double magn, accRate;
+                std::tie(cfg, energy, magn, accRate) = evolve(cfg, coupling, p, lat, rng,
+                                                              nsweep, nullptr);
+                REQUIRE(energy == Approx(hamiltonian(cfg, p, lat)));
+                REQUIRE(coupling == couplingSum(cfg, lat));
+                REQUIRE(magn == Approx(magnetisation(cfg)));
+                REQUIRE(accRate >= 0.0);
+                REQUIRE(accRate <= 1.0);
+            }
+        }
+    }
+
+    SECTION("Sequential updates")
+    {
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            Rng rng(size(lat), 812);
+
+            for (auto const &p : params) {
+                for (auto const order : {SiteOrder::TYPEWRITER, SiteOrder::CHECKERBOARD}) {
+                    Configuration cfg = randomCfg(size(lat), rng);
+                    std::int64_t coupling = couplingSum(cfg, lat);
+                    double energy;
+                    double magn, accRate;
+                    std::tie(cfg, energy, magn, accRate) = evolveSequential(
+                        cfg, coupling, p, lat, rng, nsweep, nullptr, {}, order);
+                    REQUIRE(energy == Approx(hamiltonian(cfg, p, lat)));
+                    REQUIRE(coupling == couplingSum(cfg, lat));
+                    REQUIRE(magn == Approx(magnetisation(cfg)));
+                    REQUIRE(accRate >= 0.0);
+                    REQUIRE(accRate <= 1.0);
+                }
+            }
+        }
+    }
+
+    SECTION("Local update rules")
+    {
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            Rng rng(size(lat), 812);
+
+            for (auto const &p : params) {
+                for (auto const rule : {UpdateRule::METROPOLIS, UpdateRule::HEAT_BATH,
+                                        UpdateRule::DEMON}) {
+                    for (auto const order : {SiteOrder::RANDOM, SiteOrder::TYPEWRITER,
+                                             SiteOrder::CHECKERBOARD}) {
+                        Configuration cfg = randomCfg(size(lat), rng);
+                        std::int64_t coupling = couplingSum(cfg, lat);
+                        double energy;
+                        double magn, accRate;
+                        std::tie(cfg, energy, magn, accRate) = evolveLocal(
+                            cfg, coupling, p, lat, rng, nsweep, nullptr, {}, rule, order);
+                        REQUIRE(energy == Approx(hamiltonian(cfg, p, lat)).margin(1e-10));
+                        REQUIRE(coupling == couplingSum(cfg, lat));
+                        REQUIRE(magn == Approx(magnetisation(cfg)));
+                        REQUIRE(accRate >= 0.0);
+                        REQUIRE(accRate <= 1.0);
+                    }
+                }
+            }
+        }
+
+        // Metropolis updates reproduce evolve() and evolveSequential() exactly
+        Lattice const lat{shapes[1], 0.0};
+        Rng rngA(size(lat), 3), rngB(size(lat), 3);
+        Configuration const start = randomCfg(size(lat), rngA);
+        randomCfg(size(lat), rngB);
+        std::int64_t couplingA = couplingSum(start, lat), couplingB = couplingA;
+        auto const [cfgA, energyA, magnA, accA] = evolve(start, couplingA, params[1], lat, rngA,
+                                                         nsweep, nullptr);
+        auto const [cfgB, energyB, magnB, accB] = evolveLocal(
+            start, couplingB, params[1], lat, rngB, nsweep, nullptr, {},
+            UpdateRule::METROPOLIS, SiteOrder::RANDOM);
+        REQUIRE(std::equal(begin(cfgA), end(cfgA), begin(cfgB)));
+        REQUIRE(energyA == energyB);
+        REQUIRE(accA == accB);
+    }
+
+    SECTION("Updates on fixed lattices")
+    {
+        FixedLattice<3> const lat{{4_i, 4_i, 6_i}, 0.0};
+        Rng rng(size(lat), 812);
+        std::vector<Rng> rngs{Rng{size(lat), 812, 1}, Rng{size(lat), 812, 2}};
+
+        for (auto const &p : params) {
+            Configuration cfg = randomCfg(size(lat), rng);
+            std::int64_t coupling = couplingSum(cfg, lat);
+            double energy;
+            double magn, accRate;
+            std::tie(cfg, energy, magn, accRate) = evolve(cfg, coupling, p, lat, rng,
+                                                          nsweep, nullptr);
+            REQUIRE(energy == Approx(hamiltonian(cfg, p, lat)));
+            REQUIRE(coupling == couplingSum(cfg, lat));
+            REQUIRE(magn == Approx(magnetisation(cfg)));
+            std::tie(cfg, energy, magn, accRate) = evolveCheckerboard(cfg, coupling, p, lat, rngs,
+                                                                      nsweep, nullptr);
+            REQUIRE(energy == Approx(hamiltonian(cfg, p, lat)));
+            REQUIRE(coupling == couplingSum(cfg, lat));
+            REQUIRE(magn == Approx(magnetisation(cfg)));
+        }
+    }
+
+    SECTION("Cluster updates")
+    {
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            Rng rng(size(lat), 812);
+
+            // the number of Wolff clusters per sweep is calibrated in every call
+            auto const wolff = +[](Configuration c, std::int64_t &k, Parameters const &p,
+                                   Lattice const &l, Rng &r, size_t const n, Observables * const o,
+                                   std::vector<Measurement> const &m) {
+                return evolveWolff(std::move(c), k, p, l, r, n, o, m);
+            };
+            auto const swendsenWang = +[](Configuration c, std::int64_t &k, Parameters const &p,
+                                          Lattice const &l, Rng &r, size_t const n,
+                                          Observables * const o,
+                                          std::vector<Measurement> const &m) {
+                return evolveSwendsenWang(std::move(c), k, p, l, r, n, o, m);
+            };
+            for (auto const &p : params) {
+                for (auto const evolveCluster : {wolff, swendsenWang}) {
+                    Configuration cfg = randomCfg(size(lat), rng);
+                    std::int64_t coupling = couplingSum(cfg, lat);
+                    double energy;
+                    double magn, clusterSize;
+                    Observables obs(lat);
+                    std::tie(cfg, energy, magn, clusterSize) = evolveCluster(
+                        cfg, coupling, p, lat, rng, nsweep, &obs, {});
+                    REQUIRE(energy == Approx(hamiltonian(cfg, p, lat)));
+                    REQUIRE(coupling == couplingSum(cfg, lat));
+                    REQUIRE(magn == Approx(magnetisation(cfg)));
+                    REQUIRE(std::size(obs.energy) == nsweep);
+                    REQUIRE(clusterSize >= 1.0);
+                    REQUIRE(clusterSize <= static_cast<double>(size(lat).get()));
+                }
+            }
+        }
+    }
+
+    SECTION("Checkerboard updates")
+    {
+        for (size_t const nthreads : {1ul, 3ul}) {
+            for (auto const &shape : shapes) {
+                Lattice const lat{shape, 0.0};
+                Rng rng(size(lat), 812);
+                std::vector<Rng> rngs;
+                for (size_t thread = 0; thread < nthreads; ++thread) {
+                    rngs.emplace_back(size(lat), 812, thread);
+                }
+
+                for (auto const &p : params) {
+                    Configuration cfg = randomCfg(size(lat), rng);
+                    std::int64_t coupling = couplingSum(cfg, lat);
+                    double energy;
+                    double magn, accRate;
+                    Observables obs(lat);
+                    std::tie(cfg, energy, magn, accRate) = evolveCheckerboard(
+                        cfg, coupling, p, lat, rngs, nsweep, &obs);
+                    REQUIRE(energy == Approx(hamiltonian(cfg, p, lat)));
+                    REQUIRE(coupling == couplingSum(cfg, lat));
+                    REQUIRE(magn == Approx(magnetisation(cfg)));
+                    REQUIRE(std::size(obs.energy) == nsweep);
+                    REQUIRE(accRate >= 0.0);
+                    REQUIRE(accRate <= 1.0);
+                }
+            }
+        }
+    }
+
+    SECTION("Packed checkerboard updates")
+    {
+        std::vector<std::vector<Index>> const packedShapes{
+            {128_i},
+            {128_i, 6_i},
+            {256_i, 2_i, 4_i}
+        };
+
+        for (size_t const nthreads : {1ul, 3ul}) {
+            for (auto const &shape : packedShapes) {
+                Lattice const lat{shape, 0.0};
+                Rng rng(size(lat), 812);
+                std::vector<Rng> rngs;
+                for (size_t thread = 0; thread < nthreads; ++thread) {
+                    rngs.emplace_back(size(lat), 812, thread);
+                }
+
+                for (auto const &p : params) {
+                    PackedConfiguration cfg{randomCfg(size(lat), rng), lat};
+                    std::int64_t coupling = couplingSum(cfg, lat);
+                    double energy;
+                    double magn, accRate;
+                    Observables obs(lat);
+                    std::tie(cfg, energy, magn, accRate) = evolveCheckerboard(
+                        cfg, coupling, p, lat, rngs, nsweep, &obs);
+                    REQUIRE(energy == Approx(hamiltonian(cfg, p, lat)));
+                    REQUIRE(coupling == couplingSum(cfg, lat));
+                    REQUIRE(magn == Approx(magnetisation(cfg)));
+                    REQUIRE(obs.magnetisation.back() == Approx(magnetisation(cfg.unpack())));
+                    REQUIRE(accRate >= 0.0);
+                    REQUIRE(accRate <= 1.0);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Tracked energies are exact", "[MonteCarlo]")
+{
+    // vectorised kernels and packed storage need even extents
+    Lattice const lat{{128_i, 4_i, 2_i}, 0.0};
+    Parameters const params{0.1 + 0.2, -0.07};
+    constexpr size_t nsweep = 50;
+    Rng rng(size(lat), 93);
+    Configuration const start = randomCfg(size(lat), rng);
+    std::vector<Rng> rngs{Rng{size(lat), 93, 1}, Rng{size(lat), 93, 2}};
+
+    // the coupling sum is passed in and updated to that of the final configuration
+    std::int64_t const startCoupling = couplingSum(start, lat);
+    std::int64_t coupling;
+
+    for (auto const rule : {UpdateRule::METROPOLIS, UpdateRule::HEAT_BATH,
+                            UpdateRule::DEMON}) {
+        for (auto const order : {SiteOrder::RANDOM, SiteOrder::CHECKERBOARD}) {
+            coupling = startCoupling;
+            auto const [cfg, energy, magn, accRate] = evolveLocal(
+                start, coupling, params, lat, rng, nsweep, nullptr, {}, rule, order);
+            REQUIRE(energy == hamiltonian(cfg, params, lat));
+            REQUIRE(coupling == couplingSum(cfg, lat));
+        }
+    }
+
+    for (auto const simd : {std::optional<SimdLevel>{}, std::optional{SimdLevel::SCALAR}}) {
+        coupling = startCoupling;
+        auto const [cfg, energy, magn, accRate] = evolveCheckerboard(
+            start, coupling, params, lat, rngs, nsweep, nullptr, {}, simd);
+        REQUIRE(energy == hamiltonian(cfg, params, lat));
+        REQUIRE(coupling == couplingSum(cfg, lat));
+    }
+
+    coupling = startCoupling;
+    auto const [packed, packedEnergy, packedMagn, packedAccRate] = evolveCheckerboard(
+        PackedConfiguration{start, lat}, coupling, params, lat, rngs, nsweep, nullptr, {});
+    REQUIRE(packedEnergy == hamiltonian(packed, params, lat));
+    REQUIRE(coupling == couplingSum(packed, lat));
+
+    coupling = startCoupling;
+    auto const [wolffCfg, wolffEnergy, wolffMagn, wolffSize] = evolveWolff(
+        start, coupling, params, lat, rng, nsweep, nullptr);
+    REQUIRE(wolffEnergy == hamiltonian(wolffCfg, params, lat));
+    REQUIRE(coupling == couplingSum(wolffCfg, lat));
+
+    coupling = startCoupling;
+    auto const [swCfg, swEnergy, swMagn, swSize] = evolveSwendsenWang(
+        start, coupling, params, lat, rng, nsweep, nullptr);
+    REQUIRE(swEnergy == hamiltonian(swCfg, params, lat));
+    REQUIRE(coupling == couplingSum(swCfg, lat));
+}
+
+TEST_CASE("Sequential sweeps visit every site once", "[MonteCarlo]")
+{
+    // without interactions every flip is accepted, so a sweep inverts all spins
+    Parameters const params{0.0, 0.0};
+
+    for (auto const &shape : std::vector<std::vector<Index>>{{7_i}, {4_i, 5_i}, {3_i, 2_i, 5_i}}) {
+        Lattice const lat{shape, 0.0};
+        Rng rng(size(lat), 4);
+        for (auto const order : {SiteOrder::TYPEWRITER, SiteOrder::CHECKERBOARD}) {
+            Configuration const start = randomCfg(size(lat), rng);
+            std::int64_t coupling = couplingSum(start, lat);
+            auto const [cfg, energy, magn, accRate] = evolveSequential(
+                start, coupling, params, lat, rng, 1, nullptr, {}, order);
+            REQUIRE(accRate == 1.0);
+            REQUIRE(magn == -magnetisation(start));
+            for (Index i = 0_i; i < size(lat); ++i) {
+                REQUIRE(cfg[i] == start[i]*Spin{-1});
+            }
+        }
+    }
+}
+
+TEST_CASE("Local update rules sample the Boltzmann distribution", "[MonteCarlo]")
+{
+    // small enough to sum over all configurations
+    Lattice const lat{{3_i, 4_i}, 0.0};
+    Parameters const params{0.3, 0.2};
+    std::size_t const volume = size(lat).get();
+
+    double partition = 0.0, exactEnergy = 0.0;
+    for (unsigned long bits = 0; bits < (1ul << volume); ++bits) {
+        Configuration cfg{size(lat)};
+        for (Index i = 0_i; i < size(lat); ++i) {
+            cfg[i] = (bits >> i.get()) & 1ul ? Spin{+1} : Spin{-1};
+        }
+        double const energy = hamiltonian(cfg, params, lat);
+        partition += std::exp(-energy);
+        exactEnergy += energy * std::exp(-energy);
+    }
+    exactEnergy /= partition;
+
+    constexpr size_t nsweep = 50000;
+    for (auto const rule : {UpdateRule::METROPOLIS, UpdateRule::HEAT_BATH, UpdateRule::DEMON}) {
+        for (auto const order : {SiteOrder::RANDOM, SiteOrder::TYPEWRITER,
+                                 SiteOrder::CHECKERBOARD}) {
+            Rng rng(size(lat), 91);
+            Configuration const cfg = randomCfg(size(lat), rng);
+            double energySum = 0.0;
+            Measurement const sumEnergy = [&energySum](Configuration const &, double const e) {
+                energySum += e;
+            };
+            std::int64_t coupling = couplingSum(cfg, lat);
+            evolveLocal(cfg, coupling, params, lat, rng, nsweep, nullptr, {sumEnergy}, rule, order);
+            // energy per site within about 5 standard deviations
+            REQUIRE(energySum / nsweep / static_cast<double>(volume)
+                    == Approx(exactEnergy / static_cast<double>(volume)).margin(0.01));
+        }
+    }
+}
+
+TEST_CASE("Correlator matches sum over all pairs", "[MonteCarlo]")
+{
+    std::vector<std::vector<Index>> const shapes{
+        {12_i},
+        {6_i, 5_i},
+        {4_i, 3_i, 4_i}
+    };
+    Parameters const params{0.3, 0.0};
+    double const maxDist = 2.5;
+
+    for (auto const &shape : shapes) {
+        Lattice const lat{shape, maxDist};
+        Rng rng(size(lat), 54);
+        Configuration cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+        double accRate;
+        Observables obs(lat);
+        std::tie(cfg, std::ignore, std::ignore, accRate) = evolve(cfg, coupling, params, lat, rng,
+                                                                  1, &obs);
+
+        // brute force over all ordered pairs of sites
+        std::map<int, std::pair<double, double>> expected;
+        std::vector<Index> site0(std::size(shape), 0_i);
+        for (Index i = 0_i; i < size(lat); ++i) {
+            std::vector<Index> site1(std::size(shape), 0_i);
+            for (Index j = 0_i; j < size(lat); ++j) {
+                int sqd = 0;
+                for (size_t d = 0; d < std::size(shape); ++d) {
+                    int const diff = std::abs(static_cast<int>(site0[d].get())
+                                              - static_cast<int>(site1[d].get()));
+                    int const dist = std::min(diff, static_cast<int>(shape[d].get()) - diff);
+                    sqd += dist*dist;
+                }
+                if (std::sqrt(static_cast<double>(sqd)) < maxDist) {
+                    expected[sqd].first += static_cast<double>(cfg[i]*cfg[j]);
+                    expected[sqd].second += 1.0;
+                }
+                increment(site1, shape);
+            }
+            increment(site0, shape);
+        }
+
+        REQUIRE(std::size(obs.corr.sqDistances) == std::size(expected));
+        for (size_t sqdi = 0; sqdi < std::size(obs.corr.sqDistances); ++sqdi) {
+            auto const [sum, n] = expected.at(obs.corr.sqDistances[sqdi]);
+            REQUIRE(obs.corr.correlator[sqdi].back() == Approx(sum / n));
+        }
+    }
+}
+
+TEST_CASE("FFT correlator matches pair sum", "[MonteCarlo]")
+{
+    std::vector<std::vector<Index>> const shapes{
+        {12_i},
+        {6_i, 5_i},
+        {4_i, 3_i, 4_i}
+    };
+    Parameters const params{0.3, 0.1};
+
+    for (auto const &shape : shapes) {
+        for (auto const maxDist : {std::optional<double>{2.5}, std::optional<double>{}}) {
+            Lattice const lat{shape, maxDist};
+            Rng rng(size(lat), 91);
+            Configuration const cfg = randomCfg(size(lat), rng);
+            std::int64_t pairCoupling = couplingSum(cfg, lat), fftCoupling = pairCoupling;
+
+            Observables pairObs(lat, Observables::Correlator::Method::PAIR_SUM);
+            Rng pairRng = rng;
+            evolve(cfg, pairCoupling, params, lat, pairRng, 3, &pairObs);
+
+            Observables fftObs(lat, Observables::Correlator::Method::FFT);
+            Rng fftRng = rng;
+            evolve(cfg, fftCoupling, params, lat, fftRng, 3, &fftObs);
+
+            REQUIRE(fftObs.corr.sqDistances == pairObs.corr.sqDistances);
+            for (size_t sqdi = 0; sqdi < std::size(pairObs.corr.sqDistances); ++sqdi) {
+                REQUIRE(std::size(fftObs.corr.correlator[sqdi]) == 3);
+                for (size_t i = 0; i < 3; ++i) {
+                    REQUIRE(fftObs.corr.correlator[sqdi][i]
+                            == Approx(pairObs.corr.correlator[sqdi][i]).margin(1e-10));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Streaming observables match history", "[MonteCarlo]")
+{
+    Lattice const lat{{6_i, 4_i}, 2.5};
+    Parameters const params{0.4, 0.1};
+    Rng rng(size(lat), 5);
+    Configuration const cfg = randomCfg(size(lat), rng);
+    std::int64_t historyCoupling = couplingSum(cfg, lat), streamingCoupling = historyCoupling;
+    constexpr size_t nsweep = 100;
+
+    Observables history(lat);
+    Rng historyRng = rng;
+    evolve(cfg, historyCoupling, params, lat, historyRng, nsweep, &history);
+    REQUIRE_FALSE(history.summary);
+
+    Observables streaming(lat, Observables::Correlator::Method::PAIR_SUM,
+                          Observables::Mode::STREAMING);
+    Rng streamingRng = rng;
+    evolve(cfg, streamingCoupling, params, lat, streamingRng, nsweep, &streaming);
+    REQUIRE(streaming.summary);
+    REQUIRE(std::empty(streaming.energy));
+    REQUIRE(std::empty(streaming.magnetisation));
+
+    auto const mean = [](std::vector<double> const &vec) {
+        double sum = 0.0;
+        for (double const x : vec) {
+            sum += x;
+        }
+        return sum / static_cast<double>(std::size(vec));
+    };
+
+    auto const &summary = *streaming.summary;
+    REQUIRE(summary.energy.count() == nsweep);
+    REQUIRE(summary.energy.mean() == Approx(mean(history.energy)));
+    REQUIRE(summary.magnetisation.mean() == Approx(mean(history.magnetisation)));
+    REQUIRE(std::size(summary.correlator) == std::size(history.corr.sqDistances));
+    for (size_t sqdi = 0; sqdi < std::size(summary.correlator); ++sqdi) {
+        REQUIRE(std::empty(streaming.corr.correlator[sqdi]));
+        REQUIRE(summary.correlator[sqdi].mean()
+                == Approx(mean(history.corr.correlator[sqdi])));
+    }
+}
+
+TEST_CASE("Observables are measured at their intervals", "[MonteCarlo]")
+{
+    Lattice const lat{{6_i, 4_i}, 2.5};
+    Parameters const params{0.4, 0.1};
+    Rng rng(size(lat), 8);
+    Configuration const cfg = randomCfg(size(lat), rng);
+    std::int64_t everyCoupling = couplingSum(cfg, lat), thinnedCoupling = everyCoupling;
+    constexpr size_t nsweep = 10;
+
+    Observables every(lat);
+    Rng everyRng = rng;
+    evolve(cfg, everyCoupling, params, lat, everyRng, nsweep, &every);
+    REQUIRE(every.nsweep == nsweep);
+
+    // same chain, only the measurements are thinned out
+    Observables thinned(lat, Observables::Correlator::Method::FFT, Observables::Mode::HISTORY,
+                        MeasurementIntervals{2, 0, 3});
+    Rng thinnedRng = rng;
+    evolve(cfg, thinnedCoupling, params, lat, thinnedRng, nsweep, &thinned);
+    REQUIRE(thinned.nsweep == nsweep);
+
+    REQUIRE(std::size(thinned.energy) == 5);
+    for (size_t i = 0; i < std::size(thinned.energy); ++i) {
+        REQUIRE(thinned.energy[i] == every.energy[2*i]);
+    }
+    REQUIRE(std::empty(thinned.magnetisation));
+    for (size_t sqdi = 0; sqdi < std::size(thinned.corr.sqDistances); ++sqdi) {
+        REQUIRE(std::size(thinned.corr.correlator[sqdi]) == 4);
+        for (size_t i = 0; i < 4; ++i) {
+            REQUIRE(thinned.corr.correlator[sqdi][i]
+                    == Approx(every.corr.correlator[sqdi][3*i]).margin(1e-10));
+        }
+    }
+
+    // no work space for a correlator that is never measured
+    Observables const noCorrelator(lat, Observables::Correlator::Method::FFT,
+                                   Observables::Mode::HISTORY, MeasurementIntervals{1, 1, 0});
+    REQUIRE_FALSE(noCorrelator.corr.fourier);
+    REQUIRE_FALSE(noCorrelator.fourierSums);
+    REQUIRE(std::empty(every.fourierModes[0]));
+}
+
+TEST_CASE("Fourier modes", "[MonteCarlo]")
+{
+    Lattice const lat{{4_i, 6_i, 5_i}, 0.0};
+    Parameters const params{0.3, 0.1};
+    Rng rng(size(lat), 17);
+    Configuration cfg = randomCfg(size(lat), rng);
+    double const volume = static_cast<double>(size(lat).get());
+
+    // sum over all sites with explicit coordinates
+    auto const exactModes = [&lat, volume](Configuration const &c) {
+        std::vector<double> modes;
+        for (size_t d = 0; d < lat.ndim().get(); ++d) {
+            double const k = 2.0 * std::acos(-1.0) / static_cast<double>(lat.shape()[d].get());
+            std::complex<double> sum{0.0, 0.0};
+            MultiIndex coords(lat.ndim().get(), 0_i);
+            for (Index site = 0_i; site < size(lat); ++site) {
+                REQUIRE(totalIndex(coords, lat.shape()) == site);
+                sum += static_cast<double>(c[site].get())
+                    * std::polar(1.0, k * static_cast<double>(coords[d].get()));
+                increment(coords, lat.shape());
+            }
+            modes.push_back(std::norm(sum) / (volume*volume));
+        }
+        return modes;
+    };
+
+    SECTION("Fourier sums are updated by single spin flips")
+    {
+        FourierSums sums{lat};
+        sums.reset(cfg);
+        REQUIRE(sums.nmodes() == 3);
+        for (int i = 0; i < 200; ++i) {
+            Index const site = rng.genIndex();
+            cfg.flip(site);
+            sums.flip(site, cfg[site]);
+        }
+        auto const exact = exactModes(cfg);
+        for (size_t d = 0; d < sums.nmodes(); ++d) {
+            REQUIRE(sums.squaredMagnitude(d) == Approx(exact[d]).margin(1e-12));
+        }
+
+        // a uniform configuration has no weight at nonzero momentum
+        sums.reset(Configuration{size(lat), Spin{-1}});
+        for (size_t d = 0; d < sums.nmodes(); ++d) {
+            REQUIRE(sums.squaredMagnitude(d) == Approx(0.0).margin(1e-12));
+        }
+    }
+
+    SECTION("Tracked and recomputed modes agree")
+    {
+        constexpr size_t nsweep = 12;
+        std::int64_t const startCoupling = couplingSum(cfg, lat);
+        std::vector<std::vector<double>> expected;
+        std::vector<Measurement> const recompute{
+            [&expected, &exactModes](Configuration const &c, double) {
+                expected.push_back(exactModes(c));
+            }};
+
+        for (size_t const interval : {1, 3}) {
+            for (auto const order : {SiteOrder::RANDOM, SiteOrder::CHECKERBOARD}) {
+                expected.clear();
+                Observables obs(lat, Observables::Correlator::Method::PAIR_SUM,
+                                Observables::Mode::HISTORY, MeasurementIntervals{1, 1, 0, interval});
+                Rng chainRng = rng;
+                std::int64_t coupling = startCoupling;
+                evolveLocal(cfg, coupling, params, lat, chainRng, nsweep, &obs, recompute,
+                            UpdateRule::HEAT_BATH, order);
+
+                for (size_t d = 0; d < lat.ndim().get(); ++d) {
+                    REQUIRE(std::size(obs.fourierModes[d]) == (nsweep + interval - 1) / interval);
+                    for (size_t i = 0; i < std::size(obs.fourierModes[d]); ++i) {
+                        REQUIRE(obs.fourierModes[d][i]
+                                == Approx(expected[interval*i][d]).margin(1e-12));
+                    }
+                }
+            }
+        }
+
+        // cluster updates always compute the modes from the configuration
+        expected.clear();
+        Observables obs(lat, Observables::Correlator::Method::PAIR_SUM,
+                        Observables::Mode::HISTORY, MeasurementIntervals{1, 1, 0, 1});
+        std::int64_t coupling = startCoupling;
+        evolveWolff(cfg, coupling, params, lat, rng, nsweep, &obs, recompute);
+        for (size_t i = 0; i < nsweep; ++i) {
+            REQUIRE(obs.fourierModes[1][i] == Approx(expected[i][1]).margin(1e-12));
+        }
+    }
+}
+
+TEST_CASE("Monte Carlo with blocked site layout", "[MonteCarlo]")
+{
+    MultiIndex const shape{8_i, 4_i, 4_i};
+    Lattice const lat{shape, 2.5, Lattice::DistanceFn::EUCLIDEAN,
+                      Lattice::NeighbourMode::STORED, Lattice::SiteLayout::BLOCKED};
+    Lattice const rowMajorLat{shape, 2.5};
+    Parameters const params{0.3, 0.1};
+    Rng rng(size(lat), 62);
+    Configuration const rowMajor = randomCfg(size(lat), rng);
+    Configuration const cfg = fromRowMajor(rowMajor, lat);
+
+    SECTION("Configurations are translated to and from row-major order")
+    {
+        Configuration const back = toRowMajor(cfg, lat);
+        REQUIRE(std::equal(begin(back), end(back), begin(rowMajor), end(rowMajor)));
+        for (Index site = 0_i; site < size(lat); ++site) {
+            REQUIRE(cfg[site] == rowMajor[lat.toRowMajor(site)]);
+        }
+        REQUIRE(hamiltonian(cfg, params, lat) == Approx(hamiltonian(rowMajor, params, rowMajorLat)));
+    }
+
+    SECTION("Sites of each parity are visited in checkerboard order")
+    {
+        auto const sublattices = checkerboard(lat);
+        for (size_t parity = 0; parity < 2; ++parity) {
+            std::vector<Index> visited;
+            forEachSiteWithParity(lat, parity, [&visited](Index const site) {
+                visited.push_back(site);
+            });
+            REQUIRE(visited == sublattices[parity]);
+        }
+    }
+
+    SECTION("Observables are measured in row-major order")
+    {
+        double const energy = hamiltonian(cfg, params, lat);
+        for (auto const method : {Observables::Correlator::Method::PAIR_SUM,
+                                  Observables::Correlator::Method::FFT}) {
+            Observables obs(lat, method, Observables::Mode::HISTORY,
+                            MeasurementIntervals{1, 1, 1, 1});
+            measure(obs, lat, cfg, energy);
+            Observables expected(rowMajorLat, method, Observables::Mode::HISTORY,
+                                 MeasurementIntervals{1, 1, 1, 1});
+            measure(expected, rowMajorLat, rowMajor, energy);
+
+            REQUIRE(obs.corr.sqDistances == expected.corr.sqDistances);
+            for (size_t sqdi = 0; sqdi < std::size(obs.corr.sqDistances); ++sqdi) {
+                REQUIRE(obs.corr.correlator[sqdi][0]
+                        == Approx(expected.corr.correlator[sqdi][0]).margin(1e-12));
+            }
+            for (size_t d = 0; d < lat.ndim().get(); ++d) {
+                REQUIRE(obs.fourierModes[d][0] == Approx(expected.fourierModes[d][0]).margin(1e-12));
+            }
+        }
+    }
+
+    SECTION("Energies and Fourier modes are tracked by local updates")
+    {
+        constexpr size_t nsweep = 10;
+        std::vector<std::vector<double>> recomputed;
+        std::vector<Measurement> const recompute{
+            [&recomputed, &lat](Configuration const &c, double const e) {
+                Observables obs(lat, Observables::Correlator::Method::PAIR_SUM,
+                                Observables::Mode::HISTORY, MeasurementIntervals{1, 1, 0, 1});
+                measure(obs, lat, c, e);
+                recomputed.emplace_back();
+                for (auto const &modes : obs.fourierModes) {
+                    recomputed.back().push_back(modes[0]);
+                }
+            }};
+
+        for (auto const order : {SiteOrder::RANDOM, SiteOrder::TYPEWRITER,
+                                 SiteOrder::CHECKERBOARD}) {
+            recomputed.clear();
+            Observables obs(lat, Observables::Correlator::Method::PAIR_SUM,
+                            Observables::Mode::HISTORY, MeasurementIntervals{1, 1, 0, 1});
+            Rng chainRng = rng;
+            std::int64_t coupling = couplingSum(cfg, lat);
+            auto const [evolved, energy, magn, accRate] = evolveLocal(
+                cfg, coupling, params, lat, chainRng, nsweep, &obs,
+                recompute, UpdateRule::METROPOLIS, order);
+            REQUIRE(energy == Approx(hamiltonian(evolved, params, lat)));
+            for (size_t d = 0; d < lat.ndim().get(); ++d) {
+                for (size_t i = 0; i < nsweep; ++i) {
+                    REQUIRE(obs.fourierModes[d][i] == Approx(recomputed[i][d]).margin(1e-12));
+                }
+            }
+        }
+    }
+
+    SECTION("Checkerboard updates use the blocked sublattices")
+    {
+        std::vector<Rng> rngs{Rng{size(lat), 62, 1}, Rng{size(lat), 62, 2}};
+        std::int64_t coupling = couplingSum(cfg, lat);
+        auto const [evolved, energy, magn, accRate] = evolveCheckerboard(
+            cfg, coupling, params, lat, rngs, 10, nullptr, {}, std::nullopt);
+        REQUIRE(energy == hamiltonian(evolved, params, lat));
+        REQUIRE_THROWS_AS(evolveCheckerboard(cfg, coupling, params, lat, rngs, 1, nullptr, {},
+                                             SimdLevel::SCALAR),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("Cluster sizes", "[MonteCarlo]")
+{
+    FixedLattice<2> const lat{{8_i, 6_i}, 0.0};
+    Rng rng(size(lat), 4);
+    double energy, clusterSize;
+    std::int64_t coupling;
+
+    SECTION("Without coupling all clusters are single sites")
+    {
+        Parameters const params{0.0, 0.3};
+        Configuration cfg = randomCfg(size(lat), rng);
+        coupling = couplingSum(cfg, lat);
+        std::tie(cfg, energy, std::ignore, clusterSize) = evolveWolff(
+            cfg, coupling, params, lat, rng, 5, nullptr);
+        REQUIRE(clusterSize == Approx(1.0));
+        std::tie(cfg, energy, std::ignore, clusterSize) = evolveSwendsenWang(
+            cfg, coupling, params, lat, rng, 5, nullptr);
+        REQUIRE(clusterSize == Approx(1.0));
+    }
+
+    SECTION("Strong coupling bonds the whole ordered lattice")
+    {
+        Parameters const ferro{20.0, 0.0};
+        Configuration cfg{size(lat), Spin{+1}};
+        coupling = couplingSum(cfg, lat);
+        std::tie(cfg, energy, std::ignore, clusterSize) = evolveWolff(
+            cfg, coupling, ferro, lat, rng, 5, nullptr);
+        REQUIRE(clusterSize == Approx(static_cast<double>(size(lat).get())));
+        REQUIRE(energy == Approx(hamiltonian(cfg, ferro, lat)));
+
+        // anti-ferromagnetic coupling bonds anti-aligned neighbours
+        Parameters const antiferro{-20.0, 0.0};
+        auto const [even, odd] = checkerboard(lat);
+        for (Index const site : even) {
+            cfg[site] = Spin{+1};
+        }
+        for (Index const site : odd) {
+            cfg[site] = Spin{-1};
+        }
+        coupling = couplingSum(cfg, lat);
+        std::tie(cfg, energy, std::ignore, clusterSize) = evolveSwendsenWang(
+            cfg, coupling, antiferro, lat, rng, 5, nullptr);
+        REQUIRE(clusterSize == Approx(static_cast<double>(size(lat).get())));
+        REQUIRE(energy == Approx(hamiltonian(cfg, antiferro, lat)));
+    }
+}
+
+TEST_CASE("Chunked Wolff updates", "[MonteCarlo]")
+{
+    FixedLattice<2> const lat{{8_i, 8_i}, 0.0};
+    Parameters const params{0.4, 0.05};
+    Rng rng(size(lat), 12);
+    Configuration const start = randomCfg(size(lat), rng);
+    std::int64_t const startCoupling = couplingSum(start, lat);
+    constexpr size_t nsweep = 20;
+
+    // one call of nsweep sweeps
+    Rng wholeRng = rng;
+    Observables wholeObs(lat);
+    std::int64_t wholeCoupling = startCoupling;
+    auto const [wholeCfg, wholeEnergy, wholeMagn, wholeClusterSize] = evolveWolff(
+        start, wholeCoupling, params, lat, wholeRng, nsweep, &wholeObs);
+    REQUIRE(wholeClusterSize > 1.0);
+
+    // nsweep calls of one sweep each, calibrating only in the first
+    Rng chunkRng = rng;
+    Observables chunkObs(lat);
+    Configuration chunkCfg = start;
+    double chunkEnergy, chunkMagn;
+    size_t nclustersPerSweep = 0;
+    std::int64_t chunkCoupling = startCoupling;
+    double clusterSizeSum = 0.0;
+    for (size_t i = 0; i < nsweep; ++i) {
+        double clusterSize;
+        std::tie(chunkCfg, chunkEnergy, chunkMagn, clusterSize) = evolveWolff(
+            chunkCfg, chunkCoupling, params, lat, chunkRng, 1, &chunkObs, {}, &nclustersPerSweep);
+        clusterSizeSum += clusterSize;
+    }
+    REQUIRE(nclustersPerSweep > 0);
+    // every call flips the same number of clusters in its sweep, calibration is not counted
+    REQUIRE(clusterSizeSum / nsweep == Approx(wholeClusterSize));
+    REQUIRE(chunkCoupling == wholeCoupling);
+
+    REQUIRE(std::equal(begin(chunkCfg), end(chunkCfg), begin(wholeCfg)));
+    REQUIRE(chunkEnergy == wholeEnergy);
+    REQUIRE(chunkMagn == wholeMagn);
+    REQUIRE(chunkObs.energy == wholeObs.energy);
+    REQUIRE(chunkObs.magnetisation == wholeObs.magnetisation);
+    REQUIRE(chunkRng.genIndex() == wholeRng.genIndex());
+}
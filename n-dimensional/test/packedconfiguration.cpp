@@ -0,0 +1,114 @@
+#include "packedconfiguration.hpp"
+
+#include "catch.hpp"
+
+#include "rng.hpp"
+
+using IVec = std::vector<Index>;
+
+namespace {
+    std::vector<IVec> const shapes{
+        {128_i},
+        {256_i, 4_i},
+        {128_i, 2_i, 6_i},
+        {128_i, 4_i, 2_i, 2_i}
+    };
+}
+
+TEST_CASE("Packing configurations", "[PackedConfiguration]")
+{
+    Rng rng(1_i, 3971);
+
+    SECTION("Packing and unpacking gives the original configuration")
+    {
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            rng.setLatsize(size(lat));
+            Configuration const cfg = randomCfg(size(lat), rng);
+            PackedConfiguration const packed{cfg, lat};
+
+            REQUIRE(size(packed) == size(cfg));
+            for (Index i = 0_i; i < size(cfg); ++i) {
+                REQUIRE(packed[i] == cfg[i]);
+            }
+            auto const unpacked = packed.unpack();
+            REQUIRE(std::equal(begin(cfg), end(cfg), begin(unpacked)));
+        }
+    }
+
+    SECTION("Flipping changes only one spin")
+    {
+        Lattice const lat{{128_i, 2_i}, 0.0};
+        PackedConfiguration packed{lat, Spin{-1}};
+        packed.flip(131_i);
+        for (Index i = 0_i; i < size(lat); ++i) {
+            REQUIRE(packed[i] == (i == 131_i ? Spin{+1} : Spin{-1}));
+        }
+    }
+
+    SECTION("Unsupported shapes are rejected")
+    {
+        Lattice const tooShort{{64_i, 4_i}, 0.0};
+        REQUIRE_THROWS_AS(PackedConfiguration(tooShort), std::invalid_argument);
+        Lattice const odd{{128_i, 3_i}, 0.0};
+        REQUIRE_THROWS_AS(PackedConfiguration(odd), std::invalid_argument);
+    }
+
+    SECTION("Copies share the word lattice")
+    {
+        Lattice const lat{{256_i, 4_i}, 0.0};
+        PackedConfiguration const cfg{lat};
+        PackedConfiguration const copy = cfg;
+        REQUIRE(&copy.wordLattice() == &cfg.wordLattice());
+        REQUIRE(cfg.wordLattice().shape() == wordLattice(lat).shape());
+    }
+}
+
+TEST_CASE("Neighbours of packed spins", "[PackedConfiguration]")
+{
+    SECTION("Aligned neighbour words hold the lattice neighbours of each bit")
+    {
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            Lattice const wordLat = wordLattice(lat);
+
+            for (Index site = 0_i; site < size(lat); ++site) {
+                // configuration with only this site flipped to locate it
+                PackedConfiguration marker{lat, Spin{-1}};
+                marker.flip(site);
+
+                for (Index n = 0_i; n < 2_i*lat.ndim(); ++n) {
+                    PackedConfiguration neighbour{lat, Spin{-1}};
+                    neighbour.flip(lat.neighbour(site, n));
+
+                    // find word and bit of site
+                    for (Index w = 0_i; w < marker.nwords(); ++w) {
+                        if (marker.word(w) != 0) {
+                            REQUIRE(alignedNeighbour(neighbour, w, n, wordLat) == marker.word(w));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Observables on packed configurations", "[PackedConfiguration]")
+{
+    Rng rng(1_i, 1836);
+    constexpr size_t nsamples = 5;
+
+    for (auto const &shape : shapes) {
+        Lattice const lat{shape, 0.0};
+        rng.setLatsize(size(lat));
+
+        for (size_t sample = 0; sample < nsamples; ++sample) {
+            Parameters const params{rng.genReal()*2.0-1.0, rng.genReal()*3.2-1.6};
+            Configuration const cfg = randomCfg(size(lat), rng);
+            PackedConfiguration const packed{cfg, lat};
+
+            REQUIRE(hamiltonian(packed, params, lat) == Approx(hamiltonian(cfg, params, lat)));
+            REQUIRE(magnetisation(packed) == Approx(magnetisation(cfg)));
+        }
+    }
+}
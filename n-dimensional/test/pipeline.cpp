@@ -0,0 +1,136 @@
+#include "pipeline.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+#include "catch.hpp"
+
+TEST_CASE("Asynchronous measurements", "[Pipeline]")
+{
+    Lattice const lat{{6_i, 4_i}, 2.0};
+    Rng rng{size(lat), 65};
+
+    SECTION("Blocking pipelines process all configurations in order")
+    {
+        for (std::size_t const capacity : {1ul, 2ul, 5ul}) {
+            std::vector<double> energies;
+            std::vector<Configuration> cfgs;
+            {
+                AsyncMeasurements<Configuration> pipeline{
+                    {[&energies](Configuration const &, double const e, std::size_t) {
+                         energies.push_back(e);
+                     },
+                     [&cfgs](Configuration const &c, double, std::size_t) { cfgs.push_back(c); }},
+                    capacity, Backpressure::BLOCK};
+
+                std::vector<Configuration> expected;
+                for (int i = 0; i < 20; ++i) {
+                    expected.push_back(randomCfg(size(lat), rng));
+                    pipeline.push(expected.back(), static_cast<double>(i));
+                }
+                pipeline.flush();
+
+                REQUIRE(pipeline.nskipped() == 0);
+                REQUIRE(std::size(energies) == 20);
+                REQUIRE(std::size(cfgs) == 20);
+                for (int i = 0; i < 20; ++i) {
+                    REQUIRE(energies[static_cast<std::size_t>(i)] == static_cast<double>(i));
+                    REQUIRE(std::equal(begin(cfgs[static_cast<std::size_t>(i)]),
+                                       end(cfgs[static_cast<std::size_t>(i)]),
+                                       begin(expected[static_cast<std::size_t>(i)])));
+                }
+            }
+        }
+    }
+
+    SECTION("Skipping pipelines drop configurations when full")
+    {
+        std::atomic<bool> release{false};
+        std::atomic<std::size_t> nmeasured{0};
+        std::vector<std::size_t> sweeps;
+        std::vector<double> energies;
+        AsyncMeasurements<Configuration> pipeline{
+            {[&](Configuration const &, double const e, std::size_t const sweep) {
+                while (not release) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                ++nmeasured;
+                sweeps.push_back(sweep);
+                energies.push_back(e);
+            }},
+            2, Backpressure::SKIP};
+
+        Configuration const cfg = randomCfg(size(lat), rng);
+        pipeline.setSweep(5);
+        for (int i = 5; i < 15; ++i) {
+            pipeline.push(cfg, static_cast<double>(i));
+        }
+        release = true;
+        pipeline.flush();
+
+        // at most one in progress plus two buffered
+        REQUIRE(nmeasured + pipeline.nskipped() == 10);
+        REQUIRE(nmeasured <= 3);
+        REQUIRE(nmeasured >= 2);
+
+        // measurements see the sweeps in which configurations were pushed, not their count
+        REQUIRE(sweeps.front() == 5);
+        REQUIRE(std::is_sorted(begin(sweeps), end(sweeps)));
+
+        // the sweep keeps counting after dropped configurations
+        pipeline.push(cfg, 15.0);
+        pipeline.flush();
+        REQUIRE(std::size(sweeps) == nmeasured);
+        REQUIRE(sweeps.back() == 15);
+        for (std::size_t i = 0; i < std::size(sweeps); ++i) {
+            REQUIRE(energies[i] == static_cast<double>(sweeps[i]));
+        }
+    }
+
+    SECTION("Exceptions are propagated to the producer")
+    {
+        AsyncMeasurements<Configuration> pipeline{
+            {[](Configuration const &, double const e, std::size_t) {
+                if (e > 2.0) {
+                    throw std::runtime_error("measurement failed");
+                }
+            }},
+            2, Backpressure::BLOCK};
+
+        Configuration const cfg = randomCfg(size(lat), rng);
+        REQUIRE_THROWS_AS([&] {
+            for (int i = 0; i < 10; ++i) {
+                pipeline.push(cfg, static_cast<double>(i));
+            }
+            pipeline.flush();
+        }(), std::runtime_error);
+    }
+
+    SECTION("Asynchronous observables match synchronous ones")
+    {
+        Parameters const params{0.4, 0.1};
+        Configuration const cfg = randomCfg(size(lat), rng);
+        std::int64_t syncCoupling = couplingSum(cfg, lat), asyncCoupling = syncCoupling;
+
+        Observables syncObs{lat};
+        Rng syncRng = rng;
+        evolve(cfg, syncCoupling, params, lat, syncRng, 15, &syncObs);
+
+        Observables asyncObs{lat};
+        Rng asyncRng = rng;
+        {
+            AsyncMeasurements<Configuration> pipeline{
+                {[&](Configuration const &c, double const e, std::size_t) {
+                     measure(asyncObs, lat, c, e);
+                 }},
+                3, Backpressure::BLOCK};
+            evolve(cfg, asyncCoupling, params, lat, asyncRng, 15, nullptr, {pipeline.measurement()});
+            pipeline.flush();
+        }
+
+        REQUIRE(asyncObs.energy == syncObs.energy);
+        REQUIRE(asyncObs.magnetisation == syncObs.magnetisation);
+        REQUIRE(asyncObs.corr.correlator == syncObs.corr.correlator);
+    }
+}
@@ -0,0 +1,119 @@
+#include "profile.hpp"
+
+#include <thread>
+
+#include <yaml-cpp/yaml.h>
+
+#include "catch.hpp"
+
+namespace {
+    using namespace std::chrono_literals;
+
+    double seconds(PhaseTimes const &times, Phase const phase)
+    {
+        return times.seconds[static_cast<std::size_t>(phase)];
+    }
+
+    std::uint64_t calls(PhaseTimes const &times, Phase const phase)
+    {
+        return times.calls[static_cast<std::size_t>(phase)];
+    }
+}
+
+TEST_CASE("Nested timers count time only for the innermost phase", "[Profile]")
+{
+    if constexpr (not profiling) {
+        WARN("Built without ISING_PROFILE, skipping");
+        return;
+    }
+
+    Profiler profiler;
+    {
+        // no active profiler, nothing is recorded
+        ScopedTimer const timer{Phase::UPDATE};
+    }
+    {
+        ProfileScope const scope{&profiler};
+        ScopedTimer const outer{Phase::UPDATE};
+        std::this_thread::sleep_for(5ms);
+        for (int i = 0; i < 2; ++i) {
+            ScopedTimer const inner{Phase::MEASUREMENT};
+            std::this_thread::sleep_for(10ms);
+        }
+        {
+            ProfileScope const disabled{nullptr};
+            ScopedTimer const ignored{Phase::OUTPUT};
+        }
+    }
+    {
+        ScopedTimer const timer{Phase::UPDATE};
+    }
+
+    auto const times = profiler.totals();
+    REQUIRE(calls(times, Phase::UPDATE) == 1);
+    REQUIRE(calls(times, Phase::MEASUREMENT) == 2);
+    REQUIRE(calls(times, Phase::OUTPUT) == 0);
+    REQUIRE(seconds(times, Phase::MEASUREMENT) >= 0.02);
+    REQUIRE(seconds(times, Phase::UPDATE) >= 0.005);
+    // sleeping may overshoot but not by as much as the time of the inner timers
+    REQUIRE(seconds(times, Phase::UPDATE) < 0.02);
+}
+
+TEST_CASE("Timers of several threads add to the same profiler", "[Profile]")
+{
+    if constexpr (not profiling) {
+        WARN("Built without ISING_PROFILE, skipping");
+        return;
+    }
+
+    Profiler profiler;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&profiler] {
+            ProfileScope const scope{&profiler};
+            for (int i = 0; i < 100; ++i) {
+                ScopedTimer const timer{Phase::CORRELATOR};
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    REQUIRE(calls(profiler.totals(), Phase::CORRELATOR) == 400);
+    REQUIRE(Profiler::active() == nullptr);
+}
+
+TEST_CASE("Profiling report", "[Profile]")
+{
+    namespace fs = std::filesystem;
+    fs::path const fname = fs::temp_directory_path() / "ising-test-profile.yml";
+
+    PhaseTimes setup;
+    setup.seconds[static_cast<std::size_t>(Phase::LATTICE)] = 0.5;
+    setup.calls[static_cast<std::size_t>(Phase::LATTICE)] = 1;
+    PhaseTimes phases;
+    phases.seconds[static_cast<std::size_t>(Phase::UPDATE)] = 2.0;
+    phases.calls[static_cast<std::size_t>(Phase::UPDATE)] = 3;
+    phases.seconds[static_cast<std::size_t>(Phase::CORRELATOR)] = 1.0;
+    phases.calls[static_cast<std::size_t>(Phase::CORRELATOR)] = 100;
+    writeProfile(fname, setup, {EnsembleProfile{3, Parameters{0.4, 0.1}, 100, 64, 4.0,
+                                                phases, 1024}});
+
+    auto const report = YAML::LoadFile(fname.string());
+    REQUIRE(report["setup"]["seconds"].as<double>() == 0.5);
+    REQUIRE(report["setup"]["phases"]["lattice"]["fraction"].as<double>() == 1.0);
+
+    auto const ensemble = report["ensembles"][0];
+    REQUIRE(ensemble["ensemble"].as<std::size_t>() == 3);
+    REQUIRE(ensemble["J"].as<double>() == 0.4);
+    REQUIRE(ensemble["sweeps"].as<std::size_t>() == 100);
+    REQUIRE(ensemble["updates_per_second"].as<double>() == Approx(3200.0));
+    REQUIRE(ensemble["peak_rss_kib"].as<std::size_t>() == 1024);
+    REQUIRE(ensemble["phases"]["update"]["calls"].as<std::uint64_t>() == 3);
+    REQUIRE(ensemble["phases"]["update"]["fraction"].as<double>() == 0.5);
+    REQUIRE(ensemble["phases"]["correlator"]["fraction"].as<double>() == 0.25);
+    REQUIRE_FALSE(ensemble["phases"]["measurement"]);
+
+    REQUIRE(report["peak_rss_kib"].as<std::size_t>() > 0);
+    fs::remove(fname);
+}
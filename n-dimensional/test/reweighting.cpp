@@ -0,0 +1,201 @@
+#include "reweighting.hpp"
+
+#include <cmath>
+#include <map>
+#include <vector>
+
+#include "fileio.hpp"
+#include "montecarlo.hpp"
+#include "packedconfiguration.hpp"
+#include "rng.hpp"
+
+#include "catch.hpp"
+
+namespace {
+    /// Set configuration cfg to the spins given by the bits of state.
+    void setState(Configuration &cfg, std::size_t const state)
+    {
+        for (Index i = 0_i; i < size(cfg); ++i) {
+            cfg[i] = Spin{(state >> i.get()) & 1u ? +1 : -1};
+        }
+    }
+
+    /// Observables at given parameters from a sum over all configurations.
+    ReweightedObservables exactObservables(Lattice const &lat, Parameters const &params)
+    {
+        double const V = static_cast<double>(size(lat).get());
+        Configuration cfg{size(lat)};
+        double Z = 0.0, e = 0.0, e2 = 0.0, m = 0.0, absm = 0.0, m2 = 0.0, m4 = 0.0;
+        for (std::size_t state = 0; state < (std::size_t{1} << size(lat).get()); ++state) {
+            setState(cfg, state);
+            double const energy = hamiltonian(cfg, params, lat);
+            double const magn = magnetisation(cfg);
+            double const weight = std::exp(-energy);
+            Z += weight;
+            e += weight*energy;
+            e2 += weight*energy*energy;
+            m += weight*magn;
+            absm += weight*std::abs(magn);
+            m2 += weight*magn*magn;
+            m4 += weight*magn*magn*magn*magn;
+        }
+        e /= Z; e2 /= Z; m /= Z; absm /= Z; m2 /= Z; m4 /= Z;
+        return {e/V, (e2 - e*e)/V, m, absm, V*(m2 - absm*absm), 1.0 - m4/(3.0*m2*m2)};
+    }
+
+    /// Number of configurations with given coupling sum and spin sum.
+    std::map<JointHistogram::Key, std::uint64_t> densityOfStates(Lattice const &lat)
+    {
+        std::map<JointHistogram::Key, std::uint64_t> density;
+        Configuration cfg{size(lat)};
+        for (std::size_t state = 0; state < (std::size_t{1} << size(lat).get()); ++state) {
+            setState(cfg, state);
+            std::int64_t magn = 0;
+            for (Index i = 0_i; i < size(cfg); ++i) {
+                magn += cfg[i].get();
+            }
+            ++density[JointHistogram::Key{couplingSum(cfg, lat), magn}];
+        }
+        return density;
+    }
+
+    /// Expected histogram with a given number of measurements at given parameters.
+    JointHistogram expectedHistogram(std::map<JointHistogram::Key, std::uint64_t> const &density,
+                                     Parameters const &params, double const nmeas)
+    {
+        double Z = 0.0;
+        for (auto const &[key, g] : density) {
+            Z += static_cast<double>(g) * std::exp(params.JT*static_cast<double>(key.first)
+                                                   + params.hT*static_cast<double>(key.second));
+        }
+        JointHistogram histogram;
+        for (auto const &[key, g] : density) {
+            double const p = static_cast<double>(g) / Z
+                * std::exp(params.JT*static_cast<double>(key.first)
+                           + params.hT*static_cast<double>(key.second));
+            auto const count = static_cast<std::uint64_t>(std::llround(nmeas*p));
+            if (count > 0) {
+                histogram.add(key.first, key.second, count);
+            }
+        }
+        return histogram;
+    }
+
+    void requireApprox(ReweightedObservables const &a, ReweightedObservables const &b,
+                       double const epsilon)
+    {
+        REQUIRE(a.energy == Approx(b.energy).epsilon(epsilon));
+        REQUIRE(a.specificHeat == Approx(b.specificHeat).epsilon(epsilon));
+        REQUIRE(a.magnetisation == Approx(b.magnetisation).epsilon(epsilon).margin(epsilon));
+        REQUIRE(a.absMagnetisation == Approx(b.absMagnetisation).epsilon(epsilon));
+        REQUIRE(a.susceptibility == Approx(b.susceptibility).epsilon(epsilon));
+        REQUIRE(a.binderCumulant == Approx(b.binderCumulant).epsilon(epsilon));
+    }
+}
+
+TEST_CASE("Coupling sums", "[Reweighting]")
+{
+    Lattice const lat{{128_i, 4_i}, 0.0};
+    Rng rng{size(lat), 5};
+    Parameters const params{0.7, -0.2};
+    for (int i = 0; i < 3; ++i) {
+        Configuration const cfg = randomCfg(size(lat), rng);
+        std::int64_t const coupling = couplingSum(cfg, lat);
+        REQUIRE(hamiltonian(cfg, params, lat)
+                == Approx(-params.JT*static_cast<double>(coupling)
+                          - params.hT*static_cast<double>(size(lat).get())*magnetisation(cfg)));
+        REQUIRE(couplingSum(PackedConfiguration{cfg, lat}, lat) == coupling);
+    }
+    Configuration const up{size(lat)};
+    REQUIRE(couplingSum(up, lat) == static_cast<std::int64_t>(2*size(lat).get()));
+}
+
+TEST_CASE("Histogram reweighting reproduces exact results", "[Reweighting]")
+{
+    Lattice const lat{{4_i, 4_i}, 0.0};
+    auto const density = densityOfStates(lat);
+    std::vector<Parameters> const targets{{0.2, 0.0}, {0.35, 0.05}, {0.5, -0.1}};
+
+    SECTION("Single histogram")
+    {
+        // all states are equally likely at J = h = 0, so counts are the density of states
+        JointHistogram histogram;
+        for (auto const &[key, g] : density) {
+            histogram.add(key.first, key.second, g);
+        }
+        REQUIRE(histogram.total() == 1u << 16);
+        auto const dos = singleHistogram(histogram, Parameters{0.0, 0.0});
+        for (auto const &params : targets) {
+            requireApprox(reweight(dos, params, size(lat)), exactObservables(lat, params), 1e-10);
+        }
+
+        // reweighting to the simulated parameters gives plain averages
+        auto const atSource = reweight(dos, Parameters{0.0, 0.0}, size(lat));
+        REQUIRE(atSource.magnetisation == Approx(0.0).margin(1e-12));
+        REQUIRE(atSource.energy == Approx(0.0).margin(1e-12));
+    }
+
+    SECTION("Multi histogram")
+    {
+        Parameters const low{0.2, 0.0}, high{0.5, 0.0};
+        JointHistogram const lowHist = expectedHistogram(density, low, 1e12);
+        JointHistogram const highHist = expectedHistogram(density, high, 3e12);
+
+        auto const dos = multiHistogram({HistogramRun{low, lowHist}, HistogramRun{high, highHist}});
+        REQUIRE(std::size(dos.logDensity) == std::size(density));
+        for (auto const &params : targets) {
+            requireApprox(reweight(dos, params, size(lat)), exactObservables(lat, params), 1e-6);
+        }
+
+        // the multi-histogram method reduces to the single histogram method for one run
+        auto const single = singleHistogram(lowHist, low);
+        auto const multi = multiHistogram({HistogramRun{low, lowHist}});
+        requireApprox(reweight(multi, targets[1], size(lat)),
+                      reweight(single, targets[1], size(lat)), 1e-12);
+
+        REQUIRE_THROWS_AS(multiHistogram({}), std::invalid_argument);
+        JointHistogram const empty;
+        REQUIRE_THROWS_AS(multiHistogram({HistogramRun{low, empty}}), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Histograms are measured and written", "[Reweighting]")
+{
+    Lattice const lat{{6_i, 4_i}, 0.0};
+    Parameters const params{0.1 + 0.2, 0.05};
+    Rng rng{size(lat), 21};
+    Configuration const cfg = randomCfg(size(lat), rng);
+    constexpr std::size_t nsweep = 40;
+
+    Observables obs(lat, Observables::Correlator::Method::PAIR_SUM, Observables::Mode::HISTORY,
+                    MeasurementIntervals{1, 1, 0, 0, 2});
+    std::int64_t coupling = couplingSum(cfg, lat);
+    evolve(cfg, coupling, params, lat, rng, nsweep, &obs);
+    REQUIRE(obs.histogram->total() == nsweep / 2);
+
+    // pairs in the histogram reproduce the measured energies
+    double histogramEnergy = 0.0;
+    for (auto const &[key, count] : obs.histogram->counts()) {
+        histogramEnergy += static_cast<double>(count)
+            * (-params.JT*static_cast<double>(key.first) - params.hT*static_cast<double>(key.second));
+    }
+    double measuredEnergy = 0.0;
+    for (std::size_t i = 0; i < nsweep; i += 2) {
+        measuredEnergy += obs.energy[i];
+    }
+    REQUIRE(histogramEnergy == Approx(measuredEnergy));
+
+    fs::path const outdir = fs::temp_directory_path() / "ising-test-histogram";
+    prepareOutdir(outdir);
+    write(outdir, 1, obs, params, lat, ProgConfig::Meas::BINARY);
+    auto const loaded = readHistogram(outdir/"0001.hist");
+    REQUIRE(loaded.params.JT == params.JT);
+    REQUIRE(loaded.params.hT == params.hT);
+    REQUIRE(loaded.shape == lat.shape());
+    REQUIRE(loaded.histogram.counts() == obs.histogram->counts());
+    REQUIRE(loaded.histogram.total() == obs.histogram->total());
+
+    REQUIRE_THROWS_AS(readHistogram(outdir/"0001.dat.bin"), std::runtime_error);
+    REQUIRE_THROWS_AS(readHistogram(outdir/"0002.hist"), std::runtime_error);
+    fs::remove_all(outdir);
+}
@@ -1,5 +1,8 @@
 #include "rng.hpp"
 
+#include <cmath>
+#include <sstream>
+
 #include "catch.hpp"
 #include "util.hpp"
 
@@ -111,3 +114,140 @@ SCENARIO("Rng latsize can be reset", "[Rng]")
         }
     }
 }
+
+TEST_CASE("Buffered generators produce numbers in the correct range", "[Rng]")
+{
+    constexpr Index latsize = 143_i;
+    // more than fit into the buffer
+    constexpr size_t ncheck = 3*Rng::bufferSize;
+
+    for (auto const generator : {Rng::Generator::XOSHIRO256PP, Rng::Generator::PHILOX4X32}) {
+        Rng rng(latsize, 538, generator);
+        REQUIRE(rng.generator() == generator);
+
+        REQUIRE(produceAndCheck([&rng](){ return rng.genIndex(); },
+                                IndexPredicate{latsize},
+                                ncheck));
+        REQUIRE(produceAndCheck([&rng](){ return rng.genReal(); },
+                                [](double const real) { return real >= 0.0 and real < 1.0; },
+                                ncheck));
+        REQUIRE(produceAndCheck([&rng](){ return rng.genSpin(); },
+                                [](Spin const spin) { return spin == Spin{-1} or spin == Spin{+1}; },
+                                ncheck));
+    }
+}
+
+TEST_CASE("Xoshiro256++ matches reference implementation", "[Rng]")
+{
+    Xoshiro256pp gen{0, 0};
+    gen.state = {1, 2, 3, 4};
+    REQUIRE(gen() == 41943041);
+    REQUIRE(gen() == 58720359);
+    REQUIRE(gen() == 3588806011781223);
+
+    // streams are seeded directly, so even large stream numbers are cheap
+    Xoshiro256pp const first{17, 0}, second{17, 1}, far{17, std::uint64_t{1} << 62};
+    REQUIRE(first.state != second.state);
+    REQUIRE(first.state != far.state);
+    REQUIRE(second.state != far.state);
+}
+
+TEST_CASE("Philox4x32-10 matches known answers", "[Rng]")
+{
+    using Block = std::array<std::uint32_t, 4>;
+    REQUIRE(Philox4x32::block({0, 0, 0, 0}, {0, 0})
+            == Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8});
+    REQUIRE(Philox4x32::block({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+                              {0xffffffff, 0xffffffff})
+            == Block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd});
+}
+
+TEST_CASE("Rng streams", "[Rng]")
+{
+    constexpr Index latsize = 1000_i;
+    constexpr size_t ncheck = 2*Rng::bufferSize;
+
+    for (auto const generator : {Rng::Generator::MT19937, Rng::Generator::XOSHIRO256PP,
+                                 Rng::Generator::PHILOX4X32}) {
+        auto const values = [&](Rng rng) {
+            return produce([&rng](){ return rng.genReal(); }, ncheck);
+        };
+
+        // reproducible
+        REQUIRE(values(Rng{latsize, 5, 1, generator}) == values(Rng{latsize, 5, 1, generator}));
+        // different streams and seeds differ
+        REQUIRE(values(Rng{latsize, 5, 1, generator}) != values(Rng{latsize, 5, 2, generator}));
+        REQUIRE(values(Rng{latsize, 5, 1, generator}) != values(Rng{latsize, 6, 1, generator}));
+        if (generator != Rng::Generator::MT19937) {
+            REQUIRE(values(Rng{latsize, 5, 0, generator}) == values(Rng{latsize, 5, generator}));
+        }
+    }
+}
+
+TEST_CASE("Buffered generators", "[Rng]")
+{
+    constexpr Index latsize = 7_i;
+
+    for (auto const generator : {Rng::Generator::XOSHIRO256PP, Rng::Generator::PHILOX4X32}) {
+        // bulk generation does not depend on how the range is split
+        Rng whole{latsize, 3, generator}, parts{latsize, 3, generator};
+        std::vector<std::uint64_t> wholeValues(3000), partValues(3000);
+        whole.generate(wholeValues.data(), wholeValues.data() + 3000);
+        parts.generate(partValues.data(), partValues.data() + 1000);
+        parts.generate(partValues.data() + 1000, partValues.data() + 3000);
+        REQUIRE(wholeValues == partValues);
+
+        // indices are uniform
+        constexpr size_t ndraw = 70000;
+        std::vector<size_t> counts(latsize.get(), 0);
+        for (size_t i = 0; i < ndraw; ++i) {
+            ++counts[whole.genIndex().get()];
+        }
+        double const expected = static_cast<double>(ndraw) / static_cast<double>(latsize.get());
+        for (size_t const count : counts) {
+            REQUIRE(static_cast<double>(count) == Approx(expected).margin(5.0*std::sqrt(expected)));
+        }
+
+        // state round trip in the middle of a buffer
+        std::stringstream ss;
+        ss << whole;
+        Rng restored{latsize, 0};
+        ss >> restored;
+        REQUIRE(restored.generator() == generator);
+        for (size_t i = 0; i < 2*Rng::bufferSize; ++i) {
+            REQUIRE(restored.genReal() == whole.genReal());
+        }
+    }
+}
+
+TEST_CASE("Counter based site random numbers", "[Rng]")
+{
+    SiteRng rng{41, 0};
+    constexpr std::uint64_t nsites = 20000;
+
+    double sum = 0.0;
+    std::int64_t spinSum = 0;
+    std::vector<double> first;
+    for (std::uint64_t site = 0; site < nsites; ++site) {
+        double const x = rng.uniform(site);
+        REQUIRE(x >= 0.0);
+        REQUIRE(x < 1.0);
+        sum += x;
+        first.emplace_back(x);
+        spinSum += rng.spin(site);
+    }
+    REQUIRE(sum / static_cast<double>(nsites) == Approx(0.5).margin(0.01));
+    REQUIRE(std::abs(static_cast<double>(spinSum)) < 5.0*std::sqrt(static_cast<double>(nsites)));
+
+    // numbers depend only on seed, site, and sweep
+    ++rng.sweep;
+    size_t nequal = 0;
+    for (std::uint64_t site = 0; site < nsites; ++site) {
+        nequal += rng.uniform(site) == first[site];
+        REQUIRE(rng.spin(site) == SiteRng{41, 0}.spin(site));
+    }
+    REQUIRE(nequal == 0);
+    rng.sweep = 0;
+    REQUIRE(rng.uniform(1234) == first[1234]);
+    REQUIRE(SiteRng{42, 0}.uniform(1234) != first[1234]);
+}
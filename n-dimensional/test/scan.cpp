@@ -0,0 +1,72 @@
+#include "scan.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#include "catch.hpp"
+
+TEST_CASE("Warm start chains cover all ensembles", "[Scan]")
+{
+    REQUIRE(warmStartChains(5, 1) == std::vector<Chain>{{0, 1, 2, 3, 4}});
+    REQUIRE(warmStartChains(5, 2) == std::vector<Chain>{{0, 1, 2}, {3, 4}});
+    REQUIRE(warmStartChains(3, 0) == std::vector<Chain>{{0}, {1}, {2}});
+    REQUIRE(warmStartChains(2, 8) == std::vector<Chain>{{0}, {1}});
+    REQUIRE(std::empty(warmStartChains(0, 3)));
+
+    for (size_t const nchains : {1ul, 3ul, 7ul, 52ul}) {
+        auto const chains = warmStartChains(52, nchains);
+        REQUIRE(std::size(chains) == nchains);
+
+        size_t next = 0;
+        for (auto const &chain : chains) {
+            REQUIRE(std::size(chain) >= 52 / nchains);
+            REQUIRE(std::size(chain) <= 52 / nchains + 1);
+            for (size_t const i : chain) {
+                REQUIRE(i == next++);
+            }
+        }
+        REQUIRE(next == 52);
+    }
+}
+
+TEST_CASE("Chains run concurrently", "[Scan]")
+{
+    auto const chains = warmStartChains(11, 4);
+    ThreadPool pool{3};
+
+    // Catch's assertions are not thread safe, so only collect results in the chains
+    std::mutex mutex;
+    std::vector<size_t> visited;
+    bool matchingChains = true;
+    std::ostringstream os;
+    runChains(chains, pool, os, [&](size_t const c, Chain const &chain, std::ostream &log) {
+        for (size_t const i : chain) {
+            log << "chain " << c << " ensemble " << i << '\n';
+            std::lock_guard lock{mutex};
+            visited.push_back(i);
+            matchingChains = matchingChains and &chain == &chains[c];
+        }
+    });
+
+    REQUIRE(matchingChains);
+    std::sort(visited.begin(), visited.end());
+    REQUIRE(visited == std::vector<size_t>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+
+    // messages of each chain are not interleaved with those of others
+    std::istringstream lines{os.str()};
+    for (size_t c = 0; c < std::size(chains); ++c) {
+        std::string line;
+        std::getline(lines, line);
+        std::string const prefix = line.substr(0, line.find(" ensemble"));
+        for (size_t i = 1; i < std::size(chains[std::stoul(prefix.substr(6))]); ++i) {
+            std::getline(lines, line);
+            REQUIRE(line.substr(0, std::size(prefix)) == prefix);
+        }
+    }
+
+    REQUIRE_THROWS_AS(runChains(chains, pool, os, [](size_t, Chain const &, std::ostream &) {
+        throw std::runtime_error("failed chain");
+    }), std::runtime_error);
+}
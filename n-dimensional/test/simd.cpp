@@ -0,0 +1,164 @@
+#include "simd.hpp"
+
+#include <numeric>
+
+#include "montecarlo.hpp"
+
+#include "catch.hpp"
+
+namespace {
+    /// Return all instruction sets the CPU running the tests supports.
+    std::vector<SimdLevel> supportedLevels()
+    {
+        std::vector<SimdLevel> levels;
+        for (auto const level : {SimdLevel::SCALAR, SimdLevel::AVX2, SimdLevel::AVX512}) {
+            if (simdSupported(level)) {
+                levels.emplace_back(level);
+            }
+        }
+        return levels;
+    }
+
+    std::vector<Rng> makeRngs(Lattice const &lat, size_t const nthreads)
+    {
+        std::vector<Rng> rngs;
+        for (size_t thread = 0; thread < nthreads; ++thread) {
+            rngs.emplace_back(size(lat), 71, thread+1, Rng::Generator::XOSHIRO256PP);
+        }
+        return rngs;
+    }
+}
+
+TEST_CASE("LaneRng matches xoshiro128++ reference implementation", "[SIMD]")
+{
+    Rng rng{1_i, 3};
+    LaneRng laneRng{rng};
+    for (auto &word : laneRng.state) {
+        word.fill(0);
+    }
+    laneRng.state[0].fill(1);
+    laneRng.state[1].fill(2);
+    laneRng.state[2].fill(3);
+    laneRng.state[3].fill(4);
+
+    for (std::uint32_t const expected : {641u, 1573767u, 3222811527u}) {
+        auto const result = laneRng();
+        for (std::uint32_t const x : result) {
+            REQUIRE(x == expected);
+        }
+    }
+
+    // lanes seeded from an rng are different
+    LaneRng seeded{rng};
+    auto const result = seeded();
+    for (size_t lane = 1; lane < LaneRng::nlanes; ++lane) {
+        REQUIRE(result[lane] != result[0]);
+    }
+}
+
+TEST_CASE("SIMD detection", "[SIMD]")
+{
+    REQUIRE(simdSupported(SimdLevel::SCALAR));
+    REQUIRE(simdSupported(detectSimdLevel()));
+}
+
+TEST_CASE("All instruction sets produce the same chain", "[SIMD]")
+{
+    // include rows shorter than and not a multiple of a group of sites
+    std::vector<std::vector<Index>> const shapes{
+        {6_i},
+        {72_i},
+        {8_i, 6_i},
+        {2_i, 34_i},
+        {4_i, 4_i, 6_i},
+        {2_i, 4_i, 2_i, 40_i}
+    };
+    std::vector<Parameters> const params{
+        {0.3, 0.0},
+        {0.6, -0.2},
+        {-0.4, 0.5}
+    };
+    constexpr size_t nsweep = 10;
+
+    for (size_t const nthreads : {1ul, 3ul}) {
+        for (auto const &shape : shapes) {
+            Lattice const lat{shape, 0.0};
+            Rng rng(size(lat), 93);
+
+            for (auto const &p : params) {
+                Configuration const start = randomCfg(size(lat), rng);
+                std::int64_t const startCoupling = couplingSum(start, lat);
+
+                std::vector<Rng> referenceRngs = makeRngs(lat, nthreads);
+                Observables referenceObs(lat);
+                std::int64_t referenceCoupling = startCoupling;
+                auto const [reference, referenceEnergy, referenceMagn, referenceRate]
+                    = evolveCheckerboard(start, referenceCoupling, p, lat, referenceRngs, nsweep,
+                                         &referenceObs, {}, SimdLevel::SCALAR);
+                REQUIRE(referenceEnergy == Approx(hamiltonian(reference, p, lat)));
+                REQUIRE(referenceMagn == Approx(magnetisation(reference)));
+                REQUIRE(referenceObs.magnetisation.back() == referenceMagn);
+                REQUIRE(referenceRate > 0.0);
+                REQUIRE(referenceRate <= 1.0);
+
+                for (auto const level : supportedLevels()) {
+                    std::vector<Rng> rngs = makeRngs(lat, nthreads);
+                    std::int64_t coupling = startCoupling;
+                    auto const [cfg, energy, magn, accRate] = evolveCheckerboard(
+                        start, coupling, p, lat, rngs, nsweep, nullptr, {}, level);
+                    REQUIRE(energy == referenceEnergy);
+                    REQUIRE(coupling == referenceCoupling);
+                    REQUIRE(magn == referenceMagn);
+                    REQUIRE(accRate == referenceRate);
+                    REQUIRE(std::equal(begin(cfg), end(cfg), begin(reference)));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("SIMD checkerboard sweeps visit every site once", "[SIMD]")
+{
+    // without interactions every flip is accepted, so a sweep inverts all spins
+    Parameters const params{0.0, 0.0};
+
+    for (auto const &shape : std::vector<std::vector<Index>>{{8_i}, {4_i, 38_i}, {2_i, 6_i, 4_i}}) {
+        Lattice const lat{shape, 0.0};
+        Rng rng(size(lat), 4);
+        for (auto const level : supportedLevels()) {
+            std::vector<Rng> rngs = makeRngs(lat, 2);
+            Configuration const start = randomCfg(size(lat), rng);
+            std::int64_t coupling = couplingSum(start, lat);
+            auto const [cfg, energy, magn, accRate] = evolveCheckerboard(
+                start, coupling, params, lat, rngs, 1, nullptr, {}, level);
+            REQUIRE(accRate == 1.0);
+            REQUIRE(magn == -magnetisation(start));
+            for (Index i = 0_i; i < size(lat); ++i) {
+                REQUIRE(cfg[i] == start[i]*Spin{-1});
+            }
+        }
+    }
+}
+
+TEST_CASE("SIMD checkerboard updates sample the same distribution", "[SIMD]")
+{
+    Lattice const lat{{16_i, 16_i}, 0.0};
+    Parameters const params{0.3, 0.1};
+    constexpr size_t nsweep = 4000;
+
+    auto const meanMagnetisation = [&](std::optional<SimdLevel> const simd) {
+        Rng rng(size(lat), 5);
+        std::vector<Rng> rngs = makeRngs(lat, 1);
+        Configuration cfg = randomCfg(size(lat), rng);
+        std::int64_t coupling = couplingSum(cfg, lat);
+        std::tie(cfg, std::ignore, std::ignore, std::ignore) = evolveCheckerboard(
+            cfg, coupling, params, lat, rngs, 200, nullptr, {}, simd);
+        Observables obs(lat);
+        evolveCheckerboard(cfg, coupling, params, lat, rngs, nsweep, &obs, {}, simd);
+        return std::accumulate(std::begin(obs.magnetisation), std::end(obs.magnetisation), 0.0)
+            / static_cast<double>(nsweep);
+    };
+
+    REQUIRE(meanMagnetisation(detectSimdLevel())
+            == Approx(meanMagnetisation(std::nullopt)).margin(0.01));
+}
@@ -0,0 +1,101 @@
+#include "statistics.hpp"
+
+#include <cmath>
+#include <random>
+
+#include "catch.hpp"
+
+namespace {
+    /// Generate an AR(1) process x_t = phi x_{t-1} + noise which has tau_int = (1+phi)/(1-phi)/2.
+    std::vector<double> autoregressive(double const phi, size_t const n, unsigned const seed)
+    {
+        std::mt19937 gen{seed};
+        std::normal_distribution<double> noise{0.0, 1.0};
+        std::vector<double> data(n);
+        double x = 0.0;
+        for (auto &d : data) {
+            x = phi*x + noise(gen);
+            d = x;
+        }
+        return data;
+    }
+}
+
+TEST_CASE("Binning accumulator", "[Statistics]")
+{
+    SECTION("Empty accumulator")
+    {
+        BinningAccumulator const acc;
+        REQUIRE(acc.count() == 0);
+        REQUIRE(acc.nlevels() == 0);
+        REQUIRE(acc.mean() == 0.0);
+        REQUIRE(acc.error() == 0.0);
+    }
+
+    SECTION("Mean and variance match direct computation")
+    {
+        auto const data = autoregressive(0.3, 1000, 17);
+        BinningAccumulator acc;
+        double sum = 0.0;
+        for (double const x : data) {
+            acc.push(x);
+            sum += x;
+        }
+        double const mean = sum / static_cast<double>(std::size(data));
+        double sqsum = 0.0;
+        for (double const x : data) {
+            sqsum += (x-mean)*(x-mean);
+        }
+
+        REQUIRE(acc.count() == std::size(data));
+        REQUIRE(acc.mean() == Approx(mean));
+        REQUIRE(acc.variance() == Approx(sqsum / static_cast<double>(std::size(data)-1)));
+        REQUIRE(acc.binnedError(0) == Approx(std::sqrt(acc.variance() / 1000.0)));
+    }
+
+    SECTION("Memory is logarithmic in the number of measurements")
+    {
+        BinningAccumulator acc;
+        for (size_t i = 0; i < 1024; ++i) {
+            acc.push(static_cast<double>(i % 3));
+        }
+        REQUIRE(acc.nlevels() == 11);
+        for (size_t l = 0; l < acc.nlevels(); ++l) {
+            REQUIRE(acc.nblocks(l) == 1024 >> l);
+        }
+    }
+
+    SECTION("Binned means are block averages")
+    {
+        BinningAccumulator acc;
+        for (double const x : {1.0, 3.0, 5.0, 7.0}) {
+            acc.push(x);
+        }
+        // level 1 holds blocks 2 and 6
+        REQUIRE(acc.nblocks(1) == 2);
+        REQUIRE(acc.binnedError(1) == Approx(std::sqrt(8.0 / 2.0)));
+    }
+
+    SECTION("Uncorrelated data")
+    {
+        BinningAccumulator acc;
+        for (double const x : autoregressive(0.0, 1 << 16, 3)) {
+            acc.push(x);
+        }
+        REQUIRE(acc.mean() == Approx(0.0).margin(5.0*acc.error()));
+        REQUIRE(acc.tauInt() == Approx(0.5).epsilon(0.25));
+    }
+
+    SECTION("Correlated data")
+    {
+        double const phi = 0.8;
+        double const tauInt = 0.5*(1.0+phi)/(1.0-phi);
+        BinningAccumulator acc;
+        for (double const x : autoregressive(phi, 1 << 18, 9)) {
+            acc.push(x);
+        }
+        REQUIRE(acc.error() > acc.binnedError(0));
+        REQUIRE(acc.tauInt() == Approx(tauInt).epsilon(0.25));
+        REQUIRE(acc.mean() == Approx(0.0).margin(5.0*acc.error()));
+    }
+}
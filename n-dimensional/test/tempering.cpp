@@ -0,0 +1,93 @@
+#include "tempering.hpp"
+
+#include <atomic>
+
+#include "catch.hpp"
+
+TEST_CASE("Thread pool", "[ThreadPool]")
+{
+    SECTION("All tasks are executed exactly once")
+    {
+        for (size_t const nthreads : {1ul, 3ul}) {
+            ThreadPool pool{nthreads};
+            REQUIRE(pool.size() == nthreads);
+            for (size_t const ntasks : {0ul, 1ul, 2ul, 17ul}) {
+                std::vector<std::atomic<int>> counts(ntasks);
+                pool.run(ntasks, [&counts](size_t const i) { ++counts[i]; });
+                for (auto const &count : counts) {
+                    REQUIRE(count == 1);
+                }
+            }
+        }
+    }
+
+    SECTION("Exceptions are rethrown")
+    {
+        ThreadPool pool{2};
+        REQUIRE_THROWS_AS(pool.run(5, [](size_t const i) {
+                    if (i == 3) {
+                        throw std::runtime_error("task failed");
+                    }
+                }), std::runtime_error);
+        // the pool is still usable afterwards
+        std::atomic<size_t> sum{0};
+        pool.run(4, [&sum](size_t const i) { sum += i; });
+        REQUIRE(sum == 6);
+    }
+}
+
+TEST_CASE("Replica exchange", "[Tempering]")
+{
+    FixedLattice<2> const lat{{6_i, 4_i}, 0.0};
+    constexpr size_t nsweep = 30;
+
+    auto makeReplicas = [&lat](std::vector<Parameters> const &params) {
+        Rng rng{size(lat), 17};
+        std::vector<Replica> replicas;
+        for (size_t i = 0; i < std::size(params); ++i) {
+            Configuration cfg = randomCfg(size(lat), rng);
+            std::int64_t const coupling = couplingSum(cfg, lat);
+            replicas.push_back(Replica{std::move(cfg), coupling, Rng{size(lat), 17, i+1}});
+        }
+        return replicas;
+    };
+
+    SECTION("Coupling sums are tracked")
+    {
+        std::vector<Parameters> const params{{0.2, 0.0}, {0.4, 0.1}, {0.6, 0.0}, {0.8, -0.1}};
+        ThreadPool pool{3};
+        Rng swapRng{size(lat), 3};
+        std::vector<Observables> obs(std::size(params), Observables{lat});
+
+        auto [replicas, accRates, swapRates] = replicaExchange(
+            makeReplicas(params), params, lat, swapRng, nsweep, 4, pool, &obs);
+
+        REQUIRE(std::size(replicas) == std::size(params));
+        REQUIRE(std::size(accRates) == std::size(params));
+        REQUIRE(std::size(swapRates) == std::size(params)-1);
+        for (size_t i = 0; i < std::size(params); ++i) {
+            REQUIRE(replicas[i].coupling == couplingSum(replicas[i].cfg, lat));
+            REQUIRE(std::size(obs[i].energy) == nsweep);
+            REQUIRE(obs[i].energy.back() == Approx(hamiltonian(replicas[i].cfg, params[i], lat)));
+            REQUIRE(accRates[i] >= 0.0);
+            REQUIRE(accRates[i] <= 1.0);
+        }
+        for (double const rate : swapRates) {
+            REQUIRE(rate >= 0.0);
+            REQUIRE(rate <= 1.0);
+        }
+    }
+
+    SECTION("Swaps between identical parameters are always accepted")
+    {
+        std::vector<Parameters> const params(3, Parameters{0.4, 0.2});
+        ThreadPool pool{2};
+        Rng swapRng{size(lat), 3};
+
+        auto const [replicas, accRates, swapRates] = replicaExchange(
+            makeReplicas(params), params, lat, swapRng, nsweep, 5, pool, nullptr);
+        for (double const rate : swapRates) {
+            REQUIRE(rate == Approx(1.0));
+        }
+    }
+}
@@ -1,2 +1,21 @@
+#ifdef ISING_MPI
+
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+
+#include <mpi.h>
+
+int main(int argc, char *argv[])
+{
+    MPI_Init(&argc, &argv);
+    int const result = Catch::Session().run(argc, argv);
+    MPI_Finalize();
+    return result;
+}
+
+#else
+
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
+
+#endif